@@ -26,15 +26,14 @@ public class NAI : ModuleRules
 			new string[]
 			{
 				"Core",
+				"NAISimulation",
 				"Engine",
+				"NetCore",
 				"Slate",
 				"SlateCore",
 				"InputCore",
 				"NavigationSystem",
-				"PropertyEditor",
 				"Projects",
-				"AssetTools",
-				"UnrealEd",
 				//"AlembicLibrary",
 				// ... add other public dependencies that you statically link with here ...
 			}
@@ -45,11 +44,25 @@ public class NAI : ModuleRules
 			new string[]
 			{
 				"CoreUObject",
+				"Navmesh",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
 		
 		
+		// The details customizations, these don't exist outside the editor
+		if (Target.bBuildEditor)
+		{
+			PublicDependencyModuleNames.AddRange(
+				new string[]
+				{
+					"PropertyEditor",
+					"AssetTools",
+					"UnrealEd",
+				}
+				);
+		}
+		
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]
 			{
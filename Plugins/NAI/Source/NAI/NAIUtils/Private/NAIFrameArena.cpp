@@ -0,0 +1,105 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAI/NAIUtils/Public/NAIFrameArena.h"
+
+/** The arena the current thread should be allocating temporaries from. */
+static thread_local FNAIFrameArena* GActiveFrameArena = nullptr;
+
+FNAIFrameArena::FNAIFrameArena(const SIZE_T InPageSize)
+	: CurrentBuffer(0),
+	FrameNumber(0),
+	PageSize(InPageSize),
+	PeakBytesUsed(0)
+{ }
+
+FNAIFrameArena::~FNAIFrameArena()
+{
+	Buffers[0].Free();
+	Buffers[1].Free();
+}
+
+void* FNAIFrameArena::Allocate(const SIZE_T Size, const uint32 Alignment)
+{
+	FBuffer& Buffer = Buffers[CurrentBuffer];
+
+	// Try fit it in the last page first, that's the only one with any room left
+	if(Buffer.Pages.Num() > 0)
+	{
+		FPage& Page = Buffer.Pages.Last();
+		const SIZE_T AlignedOffset = Align(Page.Data + Page.Used, Alignment) - Page.Data;
+		if(AlignedOffset + Size <= Page.Size)
+		{
+			Buffer.BytesUsed += (AlignedOffset + Size) - Page.Used;
+			Page.Used = AlignedOffset + Size;
+			PeakBytesUsed = FMath::Max(PeakBytesUsed, GetBytesUsed());
+			return Page.Data + AlignedOffset;
+		}
+	}
+
+	// Didn't fit, grab a new page big enough for this allocation
+	FPage NewPage;
+	NewPage.Size = FMath::Max(PageSize, Size + Alignment);
+	NewPage.Data = static_cast<uint8*>(FMemory::Malloc(NewPage.Size, FMath::Max(Alignment, (uint32)DEFAULT_ALIGNMENT)));
+	NewPage.Used = Size;
+	Buffer.Pages.Add(NewPage);
+
+	Buffer.BytesUsed += Size;
+	PeakBytesUsed = FMath::Max(PeakBytesUsed, GetBytesUsed());
+	return NewPage.Data;
+}
+
+void FNAIFrameArena::BeginFrame()
+{
+	CurrentBuffer ^= 1;
+	FrameNumber++;
+
+	// This buffer holds everything from two frames ago, nothing should be using it now
+	Buffers[CurrentBuffer].Reset(PageSize);
+}
+
+FNAIFrameArena* FNAIFrameArena::GetActive()
+{
+	return GActiveFrameArena;
+}
+
+void FNAIFrameArena::SetActive(FNAIFrameArena* InArena)
+{
+	GActiveFrameArena = InArena;
+}
+
+void FNAIFrameArena::FBuffer::Reset(const SIZE_T InPageSize)
+{
+	BytesUsed = 0;
+
+	if(Pages.Num() > 1)
+	{
+		SIZE_T TotalSize = 0;
+		for(const FPage& Page : Pages)
+		{
+			TotalSize += Page.Size;
+		}
+		Free();
+
+		FPage MergedPage;
+		MergedPage.Size = FMath::Max(InPageSize, TotalSize);
+		MergedPage.Data = static_cast<uint8*>(FMemory::Malloc(MergedPage.Size));
+		MergedPage.Used = 0;
+		Pages.Add(MergedPage);
+		return;
+	}
+
+	for(FPage& Page : Pages)
+	{
+		Page.Used = 0;
+	}
+}
+
+void FNAIFrameArena::FBuffer::Free()
+{
+	for(const FPage& Page : Pages)
+	{
+		FMemory::Free(Page.Data);
+	}
+	Pages.Reset();
+	BytesUsed = 0;
+}
@@ -7,30 +7,13 @@
 class NAI_API FNAICalculator
 {
 public:
+	/**
+	 * The distance between A and B.
+	 * For more than a handful of points use FNAIVectorMath::Distance() instead.
+	 */
 	static FORCEINLINE float Distance(const FVector& A, const FVector& B)
 	{
-		const float Result = (
-			(A.X * A.X) - (B.X * B.X) +
-			(A.Y * A.Y) - (B.Y * B.Y) +
-			(A.Z * A.X) - (B.Z * B.Z)
-		);
-	
-		return SqrRoot(Result);
-	}
-	
-	static FORCEINLINE float SqrRoot(const float InNumber)
-	{
-		const float Half = InNumber * 0.5f;
-		const float ThreeHalves = 1.5f;
-
-		long i = *(long*)&InNumber;	// evil floating point bit level hacking
-		i  = 0x5f3759df - (i >> 1);		// what the fuck? 
-		float N  = *(float*)&i;
-		N  = N * (ThreeHalves - (Half * N * N));	// 1st iteration
-		// N  = N * (ThreeHalves - (Half * N * N));	// 2nd iteration, this can be removed ..
-	
-		return N * InNumber;
-		// ty id <3
+		return FMath::Sqrt(FVector::DistSquared(A, B));
 	}
 
 	static FORCEINLINE void GetHighestHitPoint(const TArray<FHitResult>& Hits, FVector& OutHighestHit)
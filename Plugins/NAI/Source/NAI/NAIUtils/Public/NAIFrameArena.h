@@ -0,0 +1,279 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** The size of each page the arena allocates when it runs out of room. */
+#define NAI_FRAME_ARENA_DEFAULT_PAGE_SIZE (64 * 1024)
+
+/**
+ * Linear, double-buffered allocator owned by the AgentManager.
+ * Every temporary the manager creates during a frame (hit location lists,
+ * hit point arrays.. etc) is bumped out of the current buffer, and nothing is
+ * ever freed individually. Once per frame BeginFrame() flips to the other buffer
+ * and resets it in one go.
+ *
+ * Because there are two buffers, anything allocated during frame N stays valid
+ * for the whole of frame N + 1. This is what lets the async trace callbacks,
+ * which run after the manager has ticked, hand their results over to the next Tick.
+ * @note This is NOT thread-safe, it's only meant to be used from the GameThread.
+ * @brief Per-frame bump allocator for the AgentManager's temporaries.
+ */
+class NAI_API FNAIFrameArena
+{
+public:
+	explicit FNAIFrameArena(const SIZE_T InPageSize = NAI_FRAME_ARENA_DEFAULT_PAGE_SIZE);
+	~FNAIFrameArena();
+
+	FNAIFrameArena(const FNAIFrameArena&) = delete;
+	FNAIFrameArena& operator=(const FNAIFrameArena&) = delete;
+
+	/**
+	 * Grab a block of memory from the current buffer.
+	 * @param Size The amount of bytes needed.
+	 * @param Alignment The alignment of the block.
+	 * @return Pointer to the start of the block, which lives until the frame after next.
+	 */
+	void* Allocate(const SIZE_T Size, const uint32 Alignment = DEFAULT_ALIGNMENT);
+
+	/**
+	 * Typed helper for Allocate(). The memory is NOT constructed,
+	 * only use this with trivially constructible types.
+	 */
+	template<typename T>
+	FORCEINLINE T* AllocateArray(const int32 Num)
+	{
+		return static_cast<T*>(Allocate(sizeof(T) * Num, alignof(T)));
+	}
+
+	/**
+	 * Swap the buffers and reset the one we're about to use.
+	 * Should be called exactly once at the start of every frame.
+	 */
+	void BeginFrame();
+
+	/** Get the number of the frame the arena is currently allocating for. */
+	FORCEINLINE uint32 GetFrameNumber() const { return FrameNumber; }
+
+	/**
+	 * Check if memory allocated during the given frame is still valid.
+	 * @param InFrameNumber The frame number the allocation was made in.
+	 */
+	FORCEINLINE bool IsFrameLive(const uint32 InFrameNumber) const
+	{
+		return (InFrameNumber == FrameNumber) || (InFrameNumber + 1 == FrameNumber);
+	}
+
+	/** Total amount of bytes in use across both buffers. */
+	FORCEINLINE SIZE_T GetBytesUsed() const { return Buffers[0].BytesUsed + Buffers[1].BytesUsed; }
+
+	/** The highest amount of bytes that have ever been in use at once. */
+	FORCEINLINE SIZE_T GetPeakBytesUsed() const { return PeakBytesUsed; }
+
+	/** The arena set as active on this thread by FNAIFrameArenaScope, if any. */
+	static FNAIFrameArena* GetActive();
+
+private:
+	friend class FNAIFrameArenaScope;
+
+	struct FPage
+	{
+		uint8* Data;
+		SIZE_T Size;
+		SIZE_T Used;
+	};
+
+	struct FBuffer
+	{
+		TArray<FPage, TInlineAllocator<4>> Pages;
+		SIZE_T BytesUsed;
+
+		FBuffer() : BytesUsed(0) { }
+
+		/**
+		 * Rewind the buffer. If it needed more than one page last time around,
+		 * the pages are merged into one big page so we stay linear from then on.
+		 */
+		void Reset(const SIZE_T InPageSize);
+		void Free();
+	};
+
+	FBuffer Buffers[2];
+	uint8 CurrentBuffer;
+	uint32 FrameNumber;
+	SIZE_T PageSize;
+	SIZE_T PeakBytesUsed;
+
+	static void SetActive(FNAIFrameArena* InArena);
+};
+
+/**
+ * Makes the given arena the active one on this thread until the scope ends.
+ * Any TNAIFrameArray created inside the scope will allocate from it.
+ */
+class NAI_API FNAIFrameArenaScope
+{
+public:
+	explicit FNAIFrameArenaScope(FNAIFrameArena& InArena)
+		: PreviousArena(FNAIFrameArena::GetActive())
+	{
+		FNAIFrameArena::SetActive(&InArena);
+	}
+
+	~FNAIFrameArenaScope()
+	{
+		FNAIFrameArena::SetActive(PreviousArena);
+	}
+
+private:
+	FNAIFrameArena* PreviousArena;
+};
+
+/**
+ * Container allocator which pulls its memory from the active FNAIFrameArena.
+ * Modelled after TMemStackAllocator. If there is no arena active when the
+ * container first allocates, it falls back to the heap so it's always safe to use.
+ */
+template<uint32 Alignment = DEFAULT_ALIGNMENT>
+class TNAIFrameArenaAllocator
+{
+public:
+	using SizeType = int32;
+
+	enum { NeedsElementType = false };
+	enum { RequireRangeCheck = true };
+
+	class ForAnyElementType
+	{
+	public:
+		ForAnyElementType() : Data(nullptr), bIsHeapAllocation(false)
+		{ }
+
+		~ForAnyElementType()
+		{
+			if(Data && bIsHeapAllocation)
+			{
+				FMemory::Free(Data);
+			}
+		}
+
+		FORCEINLINE void MoveToEmpty(ForAnyElementType& Other)
+		{
+			checkSlow(this != &Other);
+
+			if(Data && bIsHeapAllocation)
+			{
+				FMemory::Free(Data);
+			}
+
+			Data = Other.Data;
+			bIsHeapAllocation = Other.bIsHeapAllocation;
+			Other.Data = nullptr;
+			Other.bIsHeapAllocation = false;
+		}
+
+		FORCEINLINE FScriptContainerElement* GetAllocation() const { return Data; }
+
+		void ResizeAllocation(
+			const SizeType PreviousNumElements, const SizeType NumElements, const SIZE_T NumBytesPerElement)
+		{
+			if(bIsHeapAllocation)
+			{
+				// Once on the heap, stay on the heap
+				if(NumElements)
+				{
+					Data = (FScriptContainerElement*)FMemory::Realloc(
+						Data, NumElements * NumBytesPerElement, Alignment);
+				}
+				else
+				{
+					FMemory::Free(Data);
+					Data = nullptr;
+					bIsHeapAllocation = false;
+				}
+				return;
+			}
+
+			FScriptContainerElement* OldData = Data;
+			if(NumElements == 0)
+			{
+				Data = nullptr;
+				return;
+			}
+
+			FNAIFrameArena* Arena = FNAIFrameArena::GetActive();
+			if(Arena)
+			{
+				Data = (FScriptContainerElement*)Arena->Allocate(NumElements * NumBytesPerElement, Alignment);
+			}
+			else
+			{
+				Data = (FScriptContainerElement*)FMemory::Malloc(NumElements * NumBytesPerElement, Alignment);
+				bIsHeapAllocation = true;
+			}
+
+			// The old block belongs to the arena, so just copy out of it and leave it be
+			if(OldData && PreviousNumElements)
+			{
+				const SizeType NumCopiedElements = FMath::Min(NumElements, PreviousNumElements);
+				FMemory::Memcpy(Data, OldData, NumCopiedElements * NumBytesPerElement);
+			}
+		}
+
+		FORCEINLINE SizeType CalculateSlackReserve(const SizeType NumElements, const SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackReserve(NumElements, NumBytesPerElement, false, Alignment);
+		}
+
+		FORCEINLINE SizeType CalculateSlackShrink(
+			const SizeType NumElements, const SizeType NumAllocatedElements, const SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackShrink(NumElements, NumAllocatedElements, NumBytesPerElement, false, Alignment);
+		}
+
+		FORCEINLINE SizeType CalculateSlackGrow(
+			const SizeType NumElements, const SizeType NumAllocatedElements, const SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackGrow(NumElements, NumAllocatedElements, NumBytesPerElement, false, Alignment);
+		}
+
+		FORCEINLINE SIZE_T GetAllocatedSize(const SizeType NumAllocatedElements, const SIZE_T NumBytesPerElement) const
+		{
+			return NumAllocatedElements * NumBytesPerElement;
+		}
+
+		FORCEINLINE bool HasAllocation() const { return !!Data; }
+		FORCEINLINE SizeType GetInitialCapacity() const { return 0; }
+
+	private:
+		ForAnyElementType(const ForAnyElementType&) = delete;
+		ForAnyElementType& operator=(const ForAnyElementType&) = delete;
+
+		FScriptContainerElement* Data;
+		uint8 bIsHeapAllocation : 1;
+	};
+
+	template<typename ElementType>
+	class ForElementType : public ForAnyElementType
+	{
+	public:
+		FORCEINLINE ElementType* GetAllocation() const
+		{
+			return (ElementType*)ForAnyElementType::GetAllocation();
+		}
+	};
+
+	typedef void ForFreeElementType;
+};
+
+template<uint32 Alignment>
+struct TAllocatorTraits<TNAIFrameArenaAllocator<Alignment>> : TAllocatorTraitsBase<TNAIFrameArenaAllocator<Alignment>>
+{
+	enum { SupportsMove = true };
+	enum { IsZeroConstruct = true };
+};
+
+/** Array type for per-frame temporaries. Only use this with trivially destructible types. */
+template<typename T>
+using TNAIFrameArray = TArray<T, TNAIFrameArenaAllocator<>>;
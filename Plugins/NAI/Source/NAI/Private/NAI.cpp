@@ -4,13 +4,17 @@
 #include "NAIAgentClient.h"
 #include "NAIAgentManager.h"
 #include "NAI/Slate/Public/NAISlateStyleSet.h"
+
+#if WITH_EDITOR
 #include "NAI/Slate/Public/NAIAgentDetailsView.h"
 #include "PropertyEditorModule.h"
+#endif
 
 #define LOCTEXT_NAMESPACE "FNAIModule"
 
 void FNAIModule::StartupModule()
 {
+#if WITH_EDITOR
 	// Get a reference to the PropertyModule to add the custom DetailsViews
 	FPropertyEditorModule& PropertyModule = FModuleManager::LoadModuleChecked<FPropertyEditorModule>("PropertyEditor");
 
@@ -25,6 +29,7 @@ void FNAIModule::StartupModule()
 		ANAIAgentManager::StaticClass()->GetFName(),
 		FOnGetDetailCustomizationInstance::CreateStatic(&FCustomAgentManagerDetailsPanel::MakeInstance)
 	);
+#endif
 
 	FNAISlateStyleSet::Initialize();
 }
@@ -0,0 +1,101 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIAgentArchetype.h"
+
+#include "NAIAgentManager.h"
+#include "NAIStats.h"
+
+TMap<const UWorld*, TUniquePtr<FNAIAgentArchetypeTable>> FNAIAgentArchetypeTable::Tables;
+FCriticalSection FNAIAgentArchetypeTable::TablesLock;
+
+FNAIAgentArchetypeTable& FNAIAgentArchetypeTable::Get(const UWorld* InWorld)
+{
+	FScopeLock ScopeLock(&TablesLock);
+	
+	TUniquePtr<FNAIAgentArchetypeTable>& Table = Tables.FindOrAdd(InWorld);
+	if(!Table.IsValid())
+	{
+		LLM_SCOPE_BYTAG(NAI);
+		Table = MakeUnique<FNAIAgentArchetypeTable>();
+	}
+	return *Table;
+}
+
+void FNAIAgentArchetypeTable::Remove(const UWorld* InWorld)
+{
+	FScopeLock ScopeLock(&TablesLock);
+	Tables.Remove(InWorld);
+}
+
+const FAgentProperties* FNAIAgentArchetypeTable::FindOrAdd(const FAgentArchetypeDesc& Desc)
+{
+	FScopeLock ScopeLock(&Lock);
+	
+	for(int32 i = 0; i < Count; i++)
+	{
+		if(Descs[i] == Desc)
+		{
+			return &Entries[i];
+		}
+	}
+
+	if(Count >= NAI_MAX_AGENT_ARCHETYPES)
+		return nullptr;
+
+	Entries[Count].Initialize(Desc);
+	Descs[Count] = Desc;
+	return &Entries[Count++];
+}
+
+int32 FNAIAgentArchetypeTable::Num() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Count;
+}
+
+void FAgentProperties::Initialize(const FAgentArchetypeDesc& Desc)
+{
+	AgentType = Desc.AgentType;
+	CapsuleRadius = Desc.CapsuleRadius;
+	CapsuleHalfHeight = Desc.CapsuleHalfHeight;
+	MaxStepHeight = Desc.MaxStepHeight;
+	
+	NavigationProperties.NavAgentProperties.AgentRadius = CapsuleRadius;
+	NavigationProperties.NavAgentProperties.AgentHeight = (CapsuleHalfHeight * 2.0f);
+	NavigationProperties.NavAgentProperties.bCanFly = false;
+	NavigationProperties.NavAgentProperties.bCanJump = false;
+	NavigationProperties.NavAgentProperties.bCanSwim = false;
+
+	NavigationProperties.LocalBoundsCheckProperties.InitializeOrUpdate(
+		CapsuleRadius, CapsuleHalfHeight
+	);
+	
+	// Set up avoidance settings.
+	AvoidanceProperties.Initialize(
+		Desc.AvoidanceLevel,
+		CapsuleRadius, CapsuleHalfHeight
+	);
+
+	// Set up stepping settings. 
+	NavigationProperties.StepProperties.Initialize(
+		CapsuleRadius, CapsuleHalfHeight,
+		MaxStepHeight
+	);
+}
+
+UNAIAgentArchetype::UNAIAgentArchetype()
+{
+	AgentType = EAgentType::PathToPlayer;
+	AvoidanceLevel = EAgentAvoidanceLevel::Advanced;
+	CapsuleRadius = 42.0f;
+	CapsuleHalfHeight = 96.0f;
+	MaxStepHeight = 25.0f;
+	
+	MoveSpeed = 50.0f;
+	LookAtRotationRate = 0.5f;
+
+	MoveTickInterval = 0.033f;
+	PathfindingTickInterval = 0.5f;
+	AvoidanceTickInterval = 0.3f;
+	GroundCheckTickInterval = 0.05f;
+}
@@ -3,6 +3,7 @@
 #include "NAIAgentClient.h"
 
 #include "DrawDebugHelpers.h"
+#include "NAIAgentArchetype.h"
 #include "NAIAgentManager.h"
 
 #include "Components/CapsuleComponent.h"
@@ -33,8 +34,15 @@ ANAIAgentClient::ANAIAgentClient()
 	MoveTickInterval = 0.033f;
 	PathfindingTickInterval = 0.5f;
 	AvoidanceTickInterval = 0.3f;
+	GroundCheckTickInterval = 0.05f;
 	
 	bBlockInput = true;
+	Archetype = nullptr;
+	bIsPooled = false;
+	bHasPhysicsBody = true;
+	CapsuleCollisionEnabled = ECollisionEnabled::QueryAndPhysics;
+	MeshCollisionEnabled = ECollisionEnabled::NoCollision;
+	AnimationLOD = EAgentAnimationLOD::Full;
 	
 	PrimaryActorTick.bCanEverTick = false;
 }
@@ -43,105 +51,195 @@ void ANAIAgentClient::BeginPlay()
 {
 	Super::BeginPlay();
 
-	ANAIAgentManager* AgentManager = (UAgentManagerStatics::bManagerExists)
-		? (UAgentManagerStatics::GetManagerReference()) : (nullptr);
+	// The manager that pooled us has already set up our Agent
+	if(bIsPooled)
+		return;
+
+	// Find the shard that owns the region of the World we spawned in
+	ANAIAgentManager* AgentManager = FNAIAgentManagerRegistry::FindManagerForLocation(
+		GetWorld(), GetActorLocation());
+	
+	// The server's copy of us is simulated, and shown here through the replication proxies
+	if(AgentManager && AgentManager->IsReplicatedClient())
+	{
+		Destroy();
+		return;
+	}
 	
 	if(AgentManager)
 	{
-		// Create the Agent guid at Runtime, not in the constructor
-		Guid = FGuid::NewGuid();
-		UE_LOG(LogTemp, Warning, TEXT("Hey my Guid: %s"), *Guid.ToString());
-		
 		// Init the agent we're going to add here
 		FAgent Agent;
-
-		const float CapsuleRadius = CapsuleComponent->GetUnscaledCapsuleRadius();
-		const float CapsuleHalfHeight = CapsuleComponent->GetUnscaledCapsuleHalfHeight();
-		
-		Agent.Guid = Guid;
-		Agent.AgentClient = this;
-		Agent.AgentManager = AgentManager;
-		// Set the agents properties
-		Agent.AgentProperties.AgentType = AgentType;
-		Agent.AgentProperties.CapsuleRadius = CapsuleRadius;
-		Agent.AgentProperties.CapsuleHalfHeight = CapsuleHalfHeight;
-		Agent.AgentProperties.MoveSpeed = MoveSpeed;
-		Agent.AgentProperties.LookAtRotationRate = LookAtRotationRate;
-		Agent.AgentProperties.MaxStepHeight = MaxStepHeight;
-
-		Agent.PathTask.InitializeTask(PathfindingTickInterval);
-		Agent.AvoidanceFrontTask.InitializeTask(AvoidanceTickInterval);
-		Agent.AvoidanceRightTask.InitializeTask(AvoidanceTickInterval);
-		Agent.AvoidanceLeftTask.InitializeTask(AvoidanceTickInterval);
-		Agent.FloorCheckTask.InitializeTask(0.01f);
-		Agent.StepCheckTask.InitializeTask(0.01f);
-
-		Agent.LocalBoundsCheckTask.InitializeTask(0.02f);
+		InitializeAgent(Agent);
 		
-		Agent.MoveTask.InitializeTask(MoveTickInterval);
-		
-		Agent.AgentProperties.NavigationProperties.NavAgentProperties.AgentRadius =
-			CapsuleRadius;
-		Agent.AgentProperties.NavigationProperties.NavAgentProperties.AgentHeight =
-			(CapsuleHalfHeight * 2.0f);
-		Agent.AgentProperties.NavigationProperties.NavAgentProperties.bCanFly = false;
-		Agent.AgentProperties.NavigationProperties.NavAgentProperties.bCanJump = false;
-		Agent.AgentProperties.NavigationProperties.NavAgentProperties.bCanSwim = false;
-
-		Agent.AgentProperties.NavigationProperties.LocalBoundsCheckProperties.InitializeOrUpdate(
-			CapsuleRadius, CapsuleHalfHeight
-		);
-		
-		// Set up avoidance settings.
-		Agent.AgentProperties.AvoidanceProperties.Initialize(
-			AvoidanceLevel,
-			CapsuleRadius, CapsuleHalfHeight
-		);
-
-		// Set up stepping settings. 
-		Agent.AgentProperties.NavigationProperties.StepProperties.Initialize(
-			CapsuleRadius, CapsuleHalfHeight,
-			Agent.AgentProperties.MaxStepHeight
-		);
-
-		Agent.SetIsHalted(false);
-
-		Agent.PathTask.GetOnCompleteDelegate().BindUObject(
-			AgentManager, &ANAIAgentManager::OnAsyncPathComplete, Guid
-		);
-
-		Agent.AvoidanceFrontTask.GetOnCompleteDelegate().BindUObject(
-			AgentManager, &ANAIAgentManager::OnAvoidanceTraceComplete,
-			Guid, EAgentAvoidanceTraceDirection::TracingFront
-		);
-
-		Agent.AvoidanceRightTask.GetOnCompleteDelegate().BindUObject(
-			AgentManager, &ANAIAgentManager::OnAvoidanceTraceComplete,
-			Guid, EAgentAvoidanceTraceDirection::TracingRight
-		);
-
-		Agent.AvoidanceLeftTask.GetOnCompleteDelegate().BindUObject(
-			AgentManager, &ANAIAgentManager::OnAvoidanceTraceComplete,
-			Guid, EAgentAvoidanceTraceDirection::TracingLeft
-		);
-		
-		Agent.FloorCheckTask.GetOnCompleteDelegate().BindUObject(
-			AgentManager, &ANAIAgentManager::OnFloorCheckTraceComplete, Guid
-		);
+		//  Move the agent into the TMap<FGuid, FAgent> AgentMap, which is for all active agents
+		AgentManager->AddAgent(MoveTemp(Agent));
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("AGENT COULD NOT FIND MANAGER!"));
+	}
+}
+
+void ANAIAgentClient::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	if(bIsPooled || !Guid.IsValid())
+		return;
+
+	// We may have been handed off since we spawned, so make sure none of the shards keep us
+	for(ANAIAgentManager* AgentManager : FNAIAgentManagerRegistry::GetManagers(GetWorld()))
+	{
+		AgentManager->RemoveAgent(Guid);
+	}
+}
 
-		Agent.StepCheckTask.GetOnCompleteDelegate().BindUObject(
-			AgentManager, &ANAIAgentManager::OnStepCheckTraceComplete, Guid
-		);
+float ANAIAgentClient::TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, AController* EventInstigator,
+	AActor* DamageCauser)
+{
+	const float DamageTaken = Super::TakeDamage(DamageAmount, DamageEvent, EventInstigator, DamageCauser);
+
+	if(!bIsPooled && Guid.IsValid())
+	{
+		for(ANAIAgentManager* AgentManager : FNAIAgentManagerRegistry::GetManagers(GetWorld()))
+		{
+			AgentManager->WakeAgent(this);
+		}
+	}
+	return DamageTaken;
+}
+
+void ANAIAgentClient::InitializeAgent(FAgent& Agent)
+{
+	// Create the Agent guid at Runtime, not in the constructor
+	if(!Guid.IsValid())
+	{
+		Guid = FGuid::NewGuid();
+	}
 
-		Agent.LocalBoundsCheckTask.GetOnCompleteDelegate().BindUObject(
-			AgentManager, &ANAIAgentManager::OnLocalBoundsCheckTraceComplete, Guid
-		);
+	// Take our properties from the archetype if we have one
+	if(Archetype)
+	{
+		AgentType = Archetype->AgentType;
+		AvoidanceLevel = Archetype->AvoidanceLevel;
+		MaxStepHeight = Archetype->MaxStepHeight;
+		MoveSpeed = Archetype->MoveSpeed;
+		LookAtRotationRate = Archetype->LookAtRotationRate;
+		MoveTickInterval = Archetype->MoveTickInterval;
+		PathfindingTickInterval = Archetype->PathfindingTickInterval;
+		AvoidanceTickInterval = Archetype->AvoidanceTickInterval;
+		GroundCheckTickInterval = Archetype->GroundCheckTickInterval;
 		
-		//  Add the agent to the TMap<FGuid, FAgent> AgentMap, which is for all active agents
-		AgentManager->AddAgent(Agent);
+		if(CapsuleComponent->GetUnscaledCapsuleRadius() != Archetype->CapsuleRadius ||
+			CapsuleComponent->GetUnscaledCapsuleHalfHeight() != Archetype->CapsuleHalfHeight)
+		{
+			CapsuleComponent->SetCapsuleSize(Archetype->CapsuleRadius, Archetype->CapsuleHalfHeight);
+		}
 	}
-	else
+
+	// Find or build the archetype that matches us
+	FAgentArchetypeDesc Desc;
+	Desc.AgentType = AgentType;
+	Desc.AvoidanceLevel = AvoidanceLevel;
+	Desc.CapsuleRadius = CapsuleComponent->GetUnscaledCapsuleRadius();
+	Desc.CapsuleHalfHeight = CapsuleComponent->GetUnscaledCapsuleHalfHeight();
+	Desc.MaxStepHeight = MaxStepHeight;
+	
+	if(!Agent.SetArchetype(GetWorld(), Desc))
 	{
-		UE_LOG(LogTemp, Warning, TEXT("AGENT COULD NOT FIND MANAGER!"));
+		UE_LOG(LogTemp, Warning, TEXT("%s: The Agent archetype table is full (%d), this Agent gets its own copy of its properties."),
+			*GetName(), NAI_MAX_AGENT_ARCHETYPES);
+	}
+	
+	Agent.Guid = Guid;
+	Agent.AgentClient = this;
+	Agent.Overrides.MoveSpeed = MoveSpeed;
+	Agent.Overrides.LookAtRotationRate = LookAtRotationRate;
+
+	Agent.PathTask.InitializeTask(PathfindingTickInterval);
+	Agent.AvoidanceFrontTask.InitializeTask(AvoidanceTickInterval);
+	Agent.AvoidanceRightTask.InitializeTask(AvoidanceTickInterval);
+	Agent.AvoidanceLeftTask.InitializeTask(AvoidanceTickInterval);
+	Agent.FloorCheckTask.InitializeTask(GroundCheckTickInterval);
+	Agent.StepCheckTask.InitializeTask(GroundCheckTickInterval);
+
+	Agent.LocalBoundsCheckTask.InitializeTask(GroundCheckTickInterval);
+	
+	Agent.MoveTask.InitializeTask(MoveTickInterval);
+
+	Agent.SetIsHalted(false);
+}
+
+void ANAIAgentClient::SetIsPooled(const bool bInIsPooled)
+{
+	bIsPooled = bInIsPooled;
+
+	SetActorHiddenInGame(bInIsPooled);
+	SetActorEnableCollision(!bInIsPooled);
+	// Shared and Frozen meshes are never ticked, their pose comes from elsewhere
+	SkeletalMeshComponent->SetComponentTickEnabled(!bInIsPooled &&
+		(AnimationLOD == EAgentAnimationLOD::Full || AnimationLOD == EAgentAnimationLOD::Reduced));
+
+	if(bInIsPooled)
+	{
+		Speed = 0.0f;
+		Velocity = FVector::ZeroVector;
+	}
+}
+
+void ANAIAgentClient::SetHasPhysicsBody(const bool bInHasPhysicsBody)
+{
+	if(bHasPhysicsBody == bInHasPhysicsBody)
+		return;
+	bHasPhysicsBody = bInHasPhysicsBody;
+
+	// Changing these recreates the physics state, so the bodies really leave the scene rather than just ignoring everything
+	if(bInHasPhysicsBody)
+	{
+		CapsuleComponent->SetCollisionEnabled(CapsuleCollisionEnabled);
+		SkeletalMeshComponent->SetCollisionEnabled(MeshCollisionEnabled);
+		return;
+	}
+	CapsuleCollisionEnabled = CapsuleComponent->BodyInstance.GetCollisionEnabled(false);
+	MeshCollisionEnabled = SkeletalMeshComponent->BodyInstance.GetCollisionEnabled(false);
+	CapsuleComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SkeletalMeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+}
+
+void ANAIAgentClient::SetAnimationLOD(const EAgentAnimationLOD InAnimationLOD, const float ReducedTickInterval,
+	USkeletalMeshComponent* PoseLeader)
+{
+	const EAgentAnimationLOD NewLOD = (InAnimationLOD == EAgentAnimationLOD::Shared && !PoseLeader)
+		? EAgentAnimationLOD::Frozen : InAnimationLOD;
+	if(NewLOD == AnimationLOD &&
+		(NewLOD != EAgentAnimationLOD::Shared || SkeletalMeshComponent->MasterPoseComponent.Get() == PoseLeader))
+		return;
+
+	AnimationLOD = NewLOD;
+	if(NewLOD != EAgentAnimationLOD::Shared && SkeletalMeshComponent->MasterPoseComponent.IsValid())
+	{
+		SkeletalMeshComponent->SetMasterPoseComponent(nullptr);
 	}
+
+	switch(NewLOD)
+	{
+		case EAgentAnimationLOD::Full:
+			SkeletalMeshComponent->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPose;
+			SkeletalMeshComponent->SetComponentTickInterval(0.0f);
+			break;
+		case EAgentAnimationLOD::Reduced:
+			// Skipped frames are made up for, the DeltaTime builds up until the next tick
+			SkeletalMeshComponent->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+			SkeletalMeshComponent->SetComponentTickInterval(ReducedTickInterval);
+			break;
+		case EAgentAnimationLOD::Shared:
+			SkeletalMeshComponent->SetMasterPoseComponent(PoseLeader);
+			break;
+		default:
+			break;
+	}
+
+	SkeletalMeshComponent->SetComponentTickEnabled(!bIsPooled &&
+		(NewLOD == EAgentAnimationLOD::Full || NewLOD == EAgentAnimationLOD::Reduced));
 }
@@ -2,707 +2,3357 @@
 
 #include "NAIAgentManager.h"
 
-#include "DrawDebugHelpers.h"
 #include "NAIAgentClient.h"
+#include "NAICollisionProxy.h"
+#include "NAIDensityQueryFilter.h"
+#include "NAIDebugDraw.h"
+#include "NAIStats.h"
+#include "NAISimResults.h"
+#include "NAIWorldQueryAdapter.h"
+#include "Animation/AnimationAsset.h"
 #include "Async/Async.h"
-#include "Kismet/KismetMathLibrary.h"
-#include "Kismet/KismetSystemLibrary.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/NetDriver.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Crc.h"
+#include "NavMesh/RecastNavMesh.h"
 
 #define NULL_VECTOR FVector(125.0f, 420.0f, -31700.4f)
 #define MAX_AGENT_PRE_ALLOC 1024
 
-#define ZERO_QUAT FQuat(0.0f, 0.0f, 0.0f, 0.0f)
+/** Flags for each of the tasks that can be due for an Agent in a frame. */
+#define AGENT_TASK_PATH					(1 << 0)
+#define AGENT_TASK_AVOIDANCE_FRONT		(1 << 1)
+#define AGENT_TASK_AVOIDANCE_RIGHT		(1 << 2)
+#define AGENT_TASK_AVOIDANCE_LEFT		(1 << 3)
+#define AGENT_TASK_FLOOR_CHECK			(1 << 4)
+#define AGENT_TASK_STEP_CHECK			(1 << 5)
+#define AGENT_TASK_LOCAL_BOUNDS_CHECK	(1 << 6)
 
-bool UAgentManagerStatics::bManagerExists = false;
-ANAIAgentManager* UAgentManagerStatics::CurrentManager = nullptr;
+/** The cell size of the physics free Agents' hash. About the reach of an avoidance grid. */
+#define AGENT_HASH_CELL_SIZE 200.0f
 
-void UAgentManagerStatics::SetManagerReference(ANAIAgentManager* InManager)
+TMap<const UWorld*, TArray<ANAIAgentManager*>> FNAIAgentManagerRegistry::Managers;
+
+void FNAIAgentManagerRegistry::RegisterManager(ANAIAgentManager* InManager)
+{
+	if(!InManager || !InManager->GetWorld())
+		return;
+
+	const UWorld* World = InManager->GetWorld();
+	Managers.FindOrAdd(World).AddUnique(InManager);
+	RefreshTickPrerequisites(World);
+}
+
+void FNAIAgentManagerRegistry::UnregisterManager(ANAIAgentManager* InManager)
 {
 	if(!InManager)
 		return;
-	CurrentManager = InManager;
-	bManagerExists = true;
+
+	// Search every World, the manager may already have lost its World pointer during teardown
+	for(auto It = Managers.CreateIterator(); It; ++It)
+	{
+		if(It.Value().Remove(InManager) > 0)
+		{
+			for(ANAIAgentManager* Manager : It.Value())
+			{
+				Manager->RemoveTickPrerequisiteActor(InManager);
+				InManager->RemoveTickPrerequisiteActor(Manager);
+				Manager->ComputeTickFunction.RemovePrerequisite(InManager, InManager->PrimaryActorTick);
+				InManager->ComputeTickFunction.RemovePrerequisite(Manager, Manager->PrimaryActorTick);
+				Manager->ApplyTickFunction.RemovePrerequisite(InManager, InManager->ComputeTickFunction);
+				InManager->ApplyTickFunction.RemovePrerequisite(Manager, Manager->ComputeTickFunction);
+			}
+
+			const UWorld* World = It.Key();
+			if(It.Value().Num() == 0)
+			{
+				// The World's last shard is gone, and its Agents with it
+				FNAIAgentArchetypeTable::Remove(World);
+#if NAI_DEBUG_DRAW
+				FNAIDebugDraw::RemoveWorld(World);
+#endif
+				It.RemoveCurrent();
+			}
+			else
+			{
+				RefreshTickPrerequisites(World);
+			}
+			return;
+		}
+	}
+}
+
+bool FNAIAgentManagerRegistry::HasManager(const UWorld* InWorld)
+{
+	const TArray<ANAIAgentManager*>* WorldManagers = Managers.Find(InWorld);
+	return WorldManagers && WorldManagers->Num() > 0;
+}
+
+const TArray<ANAIAgentManager*>& FNAIAgentManagerRegistry::GetManagers(const UWorld* InWorld)
+{
+	static const TArray<ANAIAgentManager*> NoManagers;
+	const TArray<ANAIAgentManager*>* WorldManagers = Managers.Find(InWorld);
+	return WorldManagers ? *WorldManagers : NoManagers;
+}
+
+ANAIAgentManager* FNAIAgentManagerRegistry::GetLeadManager(const UWorld* InWorld)
+{
+	const TArray<ANAIAgentManager*>& WorldManagers = GetManagers(InWorld);
+	return WorldManagers.Num() > 0 ? WorldManagers[0] : nullptr;
 }
 
-ANAIAgentManager* UAgentManagerStatics::GetManagerReference()
+ANAIAgentManager* FNAIAgentManagerRegistry::FindManagerForLocation(const UWorld* InWorld, const FVector& Location)
 {
-	return CurrentManager;
+	ANAIAgentManager* Fallback = nullptr;
+	for(ANAIAgentManager* Manager : GetManagers(InWorld))
+	{
+		if(Manager->bOwnsEntireWorld)
+		{
+			if(!Fallback)
+				Fallback = Manager;
+		}
+		else if(Manager->OwnsLocation(Location))
+		{
+			return Manager;
+		}
+	}
+	return Fallback;
 }
 
-void UAgentManagerStatics::Reset()
+void FNAIAgentManagerRegistry::RefreshTickPrerequisites(const UWorld* InWorld)
 {
-	CurrentManager = nullptr;
-	bManagerExists = false;
+	ANAIAgentManager* Lead = GetLeadManager(InWorld);
+	if(!Lead)
+		return;
+	
+	/**
+	 * The lead runs the parallel parts of every shard's tick, so the rest have to wait for it.
+	 * Its Compute tick integrates every shard's moves, so it waits for every shard's Prepare,
+	 * and every shard's Apply waits for it in turn.
+	 */
+	for(ANAIAgentManager* Manager : GetManagers(InWorld))
+	{
+		if(Manager != Lead)
+		{
+			Manager->AddTickPrerequisiteActor(Lead);
+			Lead->ComputeTickFunction.AddPrerequisite(Manager, Manager->PrimaryActorTick);
+			Manager->ApplyTickFunction.AddPrerequisite(Lead, Lead->ComputeTickFunction);
+		}
+	}
 }
 
 ANAIAgentManager::ANAIAgentManager()
 {
 	MaxAgentCount = MAX_AGENT_PRE_ALLOC;
+
+	bOwnsEntireWorld = true;
+	bRunComputeOffGameThread = true;
+	bIsAgentSetLocked = false;
+	bWakeAllAgentsQueued = false;
+	HaltedAgentCount = 0;
+	PathQueriesInFlight = 0;
+	PublishFrameIndex = 0;
+	ShardRegion = FBox(ForceInit);
+
+	PooledAgentClass = nullptr;
+	PoolPrewarmCount = 0;
+	MaxPooledAgents = MAX_AGENT_PRE_ALLOC;
+	MaxSpawnsPerFrame = 32;
+	SpawnBudgetMs = 1.0f;
+	PooledAgentCount = 0;
+	SpawnQueueHead = 0;
+
+	bReplicateAgents = false;
+	ReplicationCellSize = 4000.0f;
+	ReplicationRelevancyDistance = 15000.0f;
+	ReplicationNearDistance = 3000.0f;
+	ReplicationFarDistance = 8000.0f;
+	NearUpdateRate = 20.0f;
+	MidUpdateRate = 10.0f;
+	FarUpdateRate = 3.0f;
+	ClientInterpolationDelay = 0.1f;
+	ReplicationUpdateCount = 0;
+	ReplicationUpdateTime = 0.0f;
+	ReplicationBitsSent = 0;
+	ReplicationStatsTime = 0.0f;
+
+	bLockstep = false;
+	LockstepTickRate = 30.0f;
+	LockstepInputDelay = 3;
+	bLockstepWaitForConfirmation = true;
+	LockstepPeerId = 0;
+	LockstepSeed = 0;
+	LockstepStep = 0;
+	LockstepConfirmedStep = -1;
+	LockstepSequence = 0;
+	LockstepSpawnCount = 0;
+	LockstepAccumulator = 0.0f;
+	bIsLockstepStepping = false;
+	bIsApplyingLockstepResults = false;
+	LockstepQueriesInFlight = 0;
+	FMemory::Memzero(LockstepChecksums);
+	CrowdGoalLocation = FVector::ZeroVector;
+	bHasCrowdGoal = false;
+
+	bBudgetAnimation = true;
+	FullAnimationDistance = 2500.0f;
+	ReducedAnimationDistance = 7000.0f;
+	ReducedAnimationRate = 10.0f;
+	MaxAnimationUpdatesPerFrame = 200;
+	SharedPoseLeaderCount = 4;
+	AnimationLODUpdateInterval = 0.25f;
+	AnimationLODTime = 0.0f;
+	FMemory::Memzero(AnimationLODCounts);
+
+	GroupSlotUpdateInterval = 0.1f;
+	GroupCatchUpSpeedScale = 1.5f;
+	NextGroupId = 0;
+
+	bUseDensityField = true;
+	DensityCellSize = 300.0f;
+	DensityPathCost = 0.5f;
+	DensityPathUpdateInterval = 0.5f;
+	SeparationStrength = 200.0f;
+	MaxSeparationSpeed = 150.0f;
+	DenseAvoidanceThreshold = 4.0f;
+	DensityBounds = FBox2D(ForceInit);
+	DensityFieldFrame = 0;
+	DensityPathTime = 0.0f;
+
+	bPredictQueries = true;
+	MaxLookAheadTime = 0.2f;
+	AverageTraceLatencyMs = 0.0f;
+	LookAheadTime = 0.0f;
+
+	bAdaptiveQueryIntervals = true;
+	AdaptiveIntervalBackoff = 1.5f;
+	MaxAdaptiveIntervalScale = 4.0f;
+	AdaptiveMoveThreshold = 25.0f;
+
+	bAllowDormancy = true;
+	DormancyGoalRadius = 100.0f;
+	DormancyDistance = 0.0f;
+	DormancyHeartbeat = 5.0f;
+	DormancyCheckInterval = 0.5f;
+	DormancyCheckIndex = 0;
+	DormancyGoalLocation = FVector::ZeroVector;
+
+	bPhysicsFreeAgents = false;
+	CollisionProxyCount = 32;
+	CollisionProxyDistance = 1000.0f;
 	
 	WorldRef = nullptr;
 	NavSysRef = nullptr;
 	NavDataRef = nullptr;
 	 
+	/**
+	 * The work is split over three tick functions:
+	 * Prepare (the PrimaryActorTick) in TG_PrePhysics, Compute in TG_DuringPhysics
+	 * so it overlaps with the physics simulation, and Apply in TG_PostPhysics.
+	 */
 	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	ComputeTickFunction.bCanEverTick = true;
+	ComputeTickFunction.bStartWithTickEnabled = true;
+	ComputeTickFunction.TickGroup = TG_DuringPhysics;
+	ComputeTickFunction.EndTickGroup = TG_EndPhysics;
+
+	ApplyTickFunction.bCanEverTick = true;
+	ApplyTickFunction.bStartWithTickEnabled = true;
+	ApplyTickFunction.TickGroup = TG_PostPhysics;
 }
 
 void ANAIAgentManager::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// TODO: Throw some error if there is more than 1 AgentManager in the level
-
-	/** Add this manager as the current active manager. */
-	UAgentManagerStatics::SetManagerReference(this);
+	/** Add this manager as one of the shards for this World. */
+	FNAIAgentManagerRegistry::RegisterManager(this);
 	
 	AgentMap.Reserve(MAX_AGENT_PRE_ALLOC);
+	LockstepRandom.Initialize(LockstepSeed);
+
+	// Clients only show what the server sends them, so they never spawn Agents of their own
+	if(!IsReplicatedClient())
+	{
+		PrewarmPool();
+	}
 }
 
 void ANAIAgentManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 
-	/** Remove the reference to this manager. */
-	UAgentManagerStatics::Reset();
-}
-
-#undef MAX_AGENT_PRE_ALLOC
-
-/**
- * If this is enabled with a lot of agents active in the game it will crash the editor,
- * so use it with caution.
-*/
-#define ENABLE_DEBUG_DRAW_LINE false
-
-void ANAIAgentManager::Tick(const float DeltaTime)
-{
-	Super::Tick(DeltaTime);
+	/** Don't leave any tasks running that point back at us. */
+	WaitForOutstandingTasks();
 	
-	if(WorldRef)
+	/** Remove this shard from the registry. */
+	FNAIAgentManagerRegistry::UnregisterManager(this);
+
+	/** The pooled clients go with the level, we just have to let go of them. */
+	AgentPools.Empty();
+	PooledAgentCount = 0;
+	SpawnQueue.Empty();
+	SpawnQueueHead = 0;
+	DespawnQueue.Empty();
+
+	/** The proxies are destroyed with the level, the clients' views go with their AgentClients. */
+	ReplicationProxies.Empty();
+	ReplicatedAgents.Empty();
+	ReplicatedViews.Empty();
+	ReplicatedClientPools.Empty();
+
+	/** The collision proxies go with the level too, but the manager can be destroyed without it. */
+	for(ANAIAgentCollisionProxy* Proxy : CollisionProxies)
 	{
-		const int AgentCount = AgentMap.Num();
-		if(AgentCount > 0)
+		if(IsValid(Proxy))
 		{
-			for(int i = 0; i < AgentCount; i++)
-			{
-				// Get the Guid for this iteration, and use it to get a ref to the agent
-				const FGuid Guid = AgentGuids[i];
-				/**
-				 * Grab a reference to the Agent we want to work on.
-				 * We don't take a copy to avoid having to unbox it after
-				 */
-				FAgent *Agent = &AgentMap[Guid];
-
-				// Update all the agents timers for their tasks
-				Agent->UpdateTimers(DeltaTime);
-
-				const FVector AgentLocation = Agent->AgentClient->GetActorLocation();
-				// Calculate the Agents Speed and update the property on the AgentClient object
-				Agent->CalculateAndUpdateSpeed(AgentLocation, DeltaTime);
-
-				// If the Agent has been set to stop, don't do anything
-		        if(Agent->IsHalted())
-		        {
-		            continue;
-		        }
-
-				/** Execute the Pathfinding Task TODO: Doc this properly */
-				if(Agent->PathTask.IsReady())
-				{
-					// Get the Goal Location from the Agent type
-					const FVector PlayerLocation = GetActorLocation(); // TODO: GET THE PLAYER!!!
-					const EAgentType AgentType = Agent->AgentProperties.AgentType;
-					const FVector GoalLocation = GetAgentGoalLocationFromType(AgentType, PlayerLocation);
-					
-					AgentPathTaskAsync(AgentLocation, GoalLocation,
-						Agent->AgentProperties.NavigationProperties.NavAgentProperties,
-						Agent->PathTask.GetOnCompleteDelegate());
-					Agent->PathTask.Reset(); // Reset the timer
-				}
-
-				const FVector AgentForward = Agent->AgentClient->GetActorForwardVector();
-				const FVector AgentRight = Agent->AgentClient->GetActorRightVector();
-				
-				/** Execute the Front avoidance task TODO: Doc this properly */
-				if(Agent->AvoidanceFrontTask.IsReady())
-				{
-					AgentAvoidanceTraceTaskAsync(
-						EAgentAvoidanceTraceDirection::TracingFront,
-						AgentLocation, AgentForward, AgentRight, Agent->AgentProperties,
-						Agent->AvoidanceFrontTask.GetOnCompleteDelegate()
-					);
-					
-					Agent->AvoidanceFrontTask.Reset();
-				}
-
-				/** Is there something in front of the Agent? */
-				if(Agent->AvoidanceFrontTask.GetResult().IsBlocked())
-				{
-					/** Check both sides to see which way the Agent can strafe. */
-					
-					if(Agent->AvoidanceRightTask.IsReady())
-					{
-						AgentAvoidanceTraceTaskAsync(
-							EAgentAvoidanceTraceDirection::TracingRight,
-							AgentLocation, AgentForward, AgentRight, Agent->AgentProperties,
-							Agent->AvoidanceRightTask.GetOnCompleteDelegate()
-						);
-
-						Agent->AvoidanceRightTask.Reset();
-					}
-					
-					if(Agent->AvoidanceLeftTask.IsReady())
-					{
-						AgentAvoidanceTraceTaskAsync(
-							EAgentAvoidanceTraceDirection::TracingLeft,
-							AgentLocation, AgentForward, AgentRight, Agent->AgentProperties,
-							Agent->AvoidanceLeftTask.GetOnCompleteDelegate()
-						);
+			Proxy->Destroy();
+		}
+	}
+	CollisionProxies.Empty();
+	CollisionSources.Empty();
+}
 
-						Agent->AvoidanceLeftTask.Reset();
-					}
-				}
+FAgentQueryRecord& ANAIAgentManager::FindOrAddQueryRecord(const FGuid& Guid)
+{
+	LLM_SCOPE_BYTAG(NAI_TraceResults);
+	FAgentQueryRecord& Record = QueryRecords.FindOrAdd(Guid);
+	Record.bIsReleased = false;
+	return Record;
+}
 
-				/**
-				 * The Object types to query for AsyncLineTraceByObjectType calls.
-				 * This converts each added ECC_XXXX channel to a bitfield, add more channels with the |
-				 * operator. Read the comments on the FCollisionObjectQueryParams type for more info.
-				 */
-				const FCollisionObjectQueryParams ObjectQueryParams =
-					(ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic));
+void ANAIAgentManager::ReleaseQueryRecord(const FGuid& Guid)
+{
+	FAgentQueryRecord* Record = QueryRecords.Find(Guid);
+	if(!Record)
+		return;
 
-				/** Conduct the floor check TODO: Doc this properly */
-				if(Agent->FloorCheckTask.IsReady())
-				{
-					const FVector StartPoint = FVector(
-						AgentLocation.X, AgentLocation.Y,
-						(AgentLocation.Z - (Agent->AgentProperties.CapsuleHalfHeight - 1.0f)));
-					const FVector EndPoint = StartPoint - FVector(0.0f, 0.0f, 100.0f);
-					
-					WorldRef->AsyncLineTraceByObjectType(
-						EAsyncTraceType::Multi, StartPoint, EndPoint, ObjectQueryParams,
-						FCollisionQueryParams::DefaultQueryParam,
-						&Agent->FloorCheckTask.GetOnCompleteDelegate()
-					);
-					
-					Agent->FloorCheckTask.Reset();
-				}
+	Record->bIsReleased = true;
+	// The step doesn't wait on an Agent that's gone, its late results are thrown away
+	LockstepQueriesInFlight = FMath::Max(LockstepQueriesInFlight - Record->LockstepQueriesInFlight, 0);
+	Record->LockstepQueriesInFlight = 0;
+	if(Record->QueriesInFlight == 0)
+	{
+		DrainedQueryRecords.Add(Guid);
+	}
+}
 
-				/** Execute the step check task TODO: Doc this properly */
-				if(Agent->StepCheckTask.IsReady())
-				{
-					const FVector StartPoint =
-						AgentLocation +
-							(AgentForward * Agent->AgentProperties.NavigationProperties.StepProperties.ForwardOffset) +
-							(FVector(0.0f, 0.0f, -1.0f) * Agent->AgentProperties.NavigationProperties.StepProperties.DownwardOffset);
-					const FVector EndPoint = StartPoint - FVector(0.0f, 0.0f, 100.0f);
-					
-					WorldRef->AsyncLineTraceByObjectType(
-						EAsyncTraceType::Multi, StartPoint, EndPoint, ObjectQueryParams,
-						FCollisionQueryParams::DefaultQueryParam,
-						&Agent->StepCheckTask.GetOnCompleteDelegate()
-					);
-				}
-				
-				const FAgentVirtualCapsuleSweepProperties CapsuleSweepProperties
-					= Agent->AgentProperties.NavigationProperties.LocalBoundsCheckProperties; 
+bool ANAIAgentManager::AcceptQueryResult(const FGuid& Guid)
+{
+	FAgentQueryRecord* Record = QueryRecords.Find(Guid);
+	if(!Record)
+		return false;
 
-				if(Agent->LocalBoundsCheckTask.IsReady())
-				{
-					// const FVector StartPoint = AgentLocation + FVector(0.0f, 0.0f, CapsuleSweepProperties.HalfHeight);
-					const FVector EndPoint = AgentLocation - FVector(0.0f, 0.0f, (CapsuleSweepProperties.HalfHeight * 2.0f));
-					
-					WorldRef->AsyncSweepByObjectType(
-						EAsyncTraceType::Multi, AgentLocation, EndPoint, ZERO_QUAT,
-						ObjectQueryParams,
-						CapsuleSweepProperties.VirtualCapsule,
-						FCollisionQueryParams::DefaultQueryParam,
-						&Agent->LocalBoundsCheckTask.GetOnCompleteDelegate()
-					);
-
-					const FVector DebugLocation = AgentLocation - FVector(0.0f, 0.0f, CapsuleSweepProperties.HalfHeight);
-					UKismetSystemLibrary::DrawDebugCapsule(WorldRef, DebugLocation,
-					CapsuleSweepProperties.HalfHeight, CapsuleSweepProperties.Radius,
-						FRotator(0.0f), FLinearColor(0, 100, 255), 2.0f, 1.0f
-					);
-
-					Agent->LocalBoundsCheckTask.Reset();
-				}
-				
-				/** Execute the movement task TODO: Doc this properly */
-				if(Agent->MoveTask.IsReady())
-				{
-					const TArray<FNavPathPoint> PathPoints = Agent->PathTask.GetResult().Points;
-					
-					// No reason to move if we don't have a path
-					if(PathPoints.Num() > 1) // Need at least 2 path points for it to be a path
-					{			
-						// Calculate the new FVector for this move update
-						const FVector Start = PathPoints[0].Location;
-						const FVector End = PathPoints[1].Location;
-#if (ENABLE_DEBUG_DRAW_LINE)
-						DrawDebugLine(WorldRef, Start, End, FColor(0, 255, 0),
-                        	false, 2.0f, 0, 2.0f);
-#endif
-						// Get the direction in a normalized format
-						const FVector Direction = (End - Start).GetSafeNormal();
+	FAgentQueryRecord& QueryRecord = *Record;
+	QueryRecord.QueriesInFlight = FMath::Max(QueryRecord.QueriesInFlight - 1, 0);
+	if(!QueryRecord.bIsReleased)
+		return true;
 
-						FVector NewLoc = (AgentLocation + (Direction * (Agent->AgentProperties.MoveSpeed * DeltaTime)));
+	// We're inside the result's callback, so the record is dropped at the start of the next frame rather than now
+	if(QueryRecord.QueriesInFlight == 0)
+	{
+		DrainedQueryRecords.Add(Guid);
+	}
+	return false;
+}
 
+bool ANAIAgentManager::HasQueriesInFlight(const FGuid& Guid) const
+{
+	for(const ANAIAgentManager* Shard : FNAIAgentManagerRegistry::GetManagers(WorldRef))
+	{
+		const FAgentQueryRecord* Record = Shard->QueryRecords.Find(Guid);
+		if(Record && Record->QueriesInFlight > 0)
+			return true;
+	}
+	return false;
+}
 
-						if(Agent->LocalBoundsCheckTask.GetResult().bIsValidResult)
-						{
-							const float NewZ = (Agent->LocalBoundsCheckTask.GetResult().GetHighestHitPoint().Z +
-								(Agent->AgentProperties.CapsuleHalfHeight + 1.0f)
-							);
+#undef MAX_AGENT_PRE_ALLOC
 
-							NewLoc.Z = NewZ;
-						}
-						else
-						{
-							// Try get height of ground with the simple checks
-						}
+void FNAIAgentManagerTickFunction::ExecuteTick(
+	float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread,
+	const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if(!Target || Target->IsPendingKill())
+		return;
 
-						
-						/** 
-						 * We need to check the step before the floor, since if there is a step
-						 * we want to adjust our height for that. But if we don't have a step detected
-						 * then we can just use the floor height.
-						 * TODO: This can be better..
-						 */
-						//if(Agent->StepCheckTask.GetResult().bIsValidResult)
-						//{
-						//	NewLoc.Z = (Agent->StepCheckTask.GetResult().DetectedHitLocation.Z +
-						//		(Agent->AgentProperties.CapsuleHalfHeight + 1.0f)); // an offset is applied to avoid the agent getting stuck on the floor
-						//}
-						//else if(Agent->FloorCheckTask.GetResult().bIsValidResult)
-						//{			
-						//	NewLoc.Z = (Agent->FloorCheckTask.GetResult().DetectedHitLocation.Z +
-						//		(Agent->AgentProperties.CapsuleHalfHeight + 1.0f)); // an offset is applied to avoid the agent getting stuck on the floor
-						//}
-
-						// Calculate the difference in movement
-						// This difference calc is also done inside the FindLookAtRotation function below,
-						// so we're doing this twice...replace the function
-						const FVector MoveDelta = NewLoc - AgentLocation;
-
-						// Calculate our new rotation
-						FRotator LookAtRotation = UKismetMathLibrary::FindLookAtRotation(AgentLocation, NewLoc);
-						LookAtRotation.Roll	= 0.0f; LookAtRotation.Pitch = 0.0f;
-						const FRotator LerpRotation = FMath::Lerp(Agent->AgentClient->GetActorRotation(),
-							LookAtRotation, Agent->AgentProperties.LookAtRotationRate
-						);
-
-						// FHitResult Hit; // TODO: Perhaps can get rid of the simgple floor/step check thanks to this 
-
-						// We directly move the agent by moving it's root component as it avoids a shit load
-						// of function calls, along with extra GetActorLocation() function calls
-						// when we already have the agents location in this scope, before we finally get to this function
-						// so we're directly calling it here instead of SetActorLocation() / SetActorRotation()
-						Agent->AgentClient->GetRootComponent()->MoveComponent(
-							MoveDelta, LerpRotation, true);
-					}
-					
-					Agent->MoveTask.Reset();
-				}
-			}
-		}
-	}
-	else
+	switch(Phase)
 	{
-		Initialize();
+		case EAgentManagerTickPhase::Compute:
+			Target->TickCompute(DeltaTime);
+			break;
+		case EAgentManagerTickPhase::Apply:
+			Target->TickApply(DeltaTime);
+			break;
+		default:
+			break;
 	}
 }
 
-#define ENABLE_DEBUG_PRINT_SCREEN			false 
-
-#if (ENABLE_DEBUG_PRINT_SCREEN)
-	#define ENABLE_FLOOR_DEBUG_PRINT_SCREEN		false
-#else
-	#define ENABLE_FLOOR_DEBUG_PRINT_SCREEN		false
-#endif
+FString FNAIAgentManagerTickFunction::DiagnosticMessage()
+{
+	return Target->GetFullName() + ((Phase == EAgentManagerTickPhase::Compute)
+		? TEXT("[TickCompute]") : TEXT("[TickApply]"));
+}
 
-void ANAIAgentManager::OnAsyncPathComplete(
-	uint32 PathId, ENavigationQueryResult::Type ResultType, FNavPathSharedPtr NavPointer,
-	FGuid Guid)
+FName FNAIAgentManagerTickFunction::DiagnosticContext(bool bDetailed)
 {
-	if(ResultType == ENavigationQueryResult::Success)
-	{
-		const FAgentPathResult NewResult = FAgentPathResult(true, NavPointer.Get()->GetPathPoints());
-		UpdateAgentPathResult(Guid, NewResult);
-	}
-	else
-	{
-		// Handle Pathfinding failed 
-	}
+	return Target->GetClass()->GetFName();
 }
 
-void ANAIAgentManager::OnAvoidanceTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data,
-	FGuid Guid, EAgentAvoidanceTraceDirection Direction)
+void ANAIAgentManager::RegisterActorTickFunctions(bool bRegister)
 {
-	if(!Handle.IsValid())
-		return;
-	
-	if(Data.OutHits.Num() == 0)
+	Super::RegisterActorTickFunctions(bRegister);
+
+	if(bRegister)
 	{
-		UpdateAgentAvoidanceResult(Guid, Direction, false);
+		if(!PrimaryActorTick.IsTickFunctionRegistered())
+			return;
+		
+		/**
+		 * Compute waits on Prepare (our PrimaryActorTick), and Apply waits on Compute.
+		 * The tick groups keep Compute overlapped with physics, and Apply after it.
+		 */
+		ComputeTickFunction.Target = this;
+		ComputeTickFunction.Phase = EAgentManagerTickPhase::Compute;
+		ComputeTickFunction.bRunOnAnyThread = bRunComputeOffGameThread;
+		ComputeTickFunction.RegisterTickFunction(GetLevel());
+		ComputeTickFunction.AddPrerequisite(this, PrimaryActorTick);
+
+		ApplyTickFunction.Target = this;
+		ApplyTickFunction.Phase = EAgentManagerTickPhase::Apply;
+		ApplyTickFunction.RegisterTickFunction(GetLevel());
+		ApplyTickFunction.AddPrerequisite(this, ComputeTickFunction);
 	}
 	else
 	{
-		UpdateAgentAvoidanceResult(Guid, Direction,
-	CheckIfBlockedByAgent(Data.OutHits, Guid));
-	}
-#if (ENABLE_DEBUG_DRAW_LINE)
-	if(WorldRef)
-	{
-		DrawDebugLine(WorldRef, Data.Start, Data.End, FColor(0, 255, 0),
-			false, 2, 0, 2.0f);
+		if(ComputeTickFunction.IsTickFunctionRegistered())
+		{
+			ComputeTickFunction.UnRegisterTickFunction();
+		}
+		if(ApplyTickFunction.IsTickFunctionRegistered())
+		{
+			ApplyTickFunction.UnRegisterTickFunction();
+		}
 	}
-#endif
 }
 
-void ANAIAgentManager::OnFloorCheckTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data, FGuid Guid)
-{
-	UE_LOG(LogTemp, Warning, TEXT("Guid: %s"), *Guid.ToString());
+/**
+ * The AgentManager's frame is built as a graph of phases:
+ *
+ *   AdvanceTimers -> GatherDueTasks -> IssueQueries (GameThread, TG_PrePhysics)
+ *                                  \-> IntegrateMovement (worker, TG_DuringPhysics)
+ *                                        -> ApplyTransforms (GameThread, TG_PostPhysics)
+ *                                              -> PublishState (worker)
+ *
+ * AdvanceTimers and GatherDueTasks run as task graph tasks, launched by the lead
+ * shard for every shard at once, and the lead's Compute tick runs IntegrateMovement
+ * for every shard at once too. IssueQueries stays on each shard's own Tick(), the
+ * world queries can only be sent from the GameThread. PublishState is left running
+ * on a worker after ApplyTransforms, and only has to be done before the next frame's
+ * PublishState, so it overlaps with the first half of the next frame.
+ */
 
-	if(!Handle.IsValid())
-		return;
+void ANAIAgentManager::Tick(const float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	LLM_SCOPE_BYTAG(NAI);
 
-#if (ENABLE_DEBUG_DRAW_LINE)
-	if(WorldRef)
-	{
-		DrawDebugLine(WorldRef, Data.Start, Data.End, FColor(0, 255, 0),
-			false, 2, 0, 2.0f);
-	}
-#endif
-	if(Data.OutHits.Num() == 0)
+	// The server runs the simulation, we just show the results
+	if(IsReplicatedClient())
 	{
-		UpdateAgentFloorCheckResult(Guid, FVector::ZeroVector, false);
+		TickReplicatedClient(DeltaTime);
 		return;
 	}
+
+	// Throw away everything from two frames ago, and make the arena available to
+	// any TNAIFrameArray created from here on
+	FrameArena.BeginFrame();
+	FNAIFrameArenaScope ArenaScope(FrameArena);
 	
-	const TArray<FVector> Locations = GetAllHitLocationsNotFromAgents(Data.OutHits);
-#if (ENABLE_FLOOR_DEBUG_PRINT_SCREEN)
-	if(GEngine)
-		GEngine->AddOnScreenDebugMessage(
-			-1, 1.0f, FColor::Yellow,
-			FString::Printf(TEXT("Total number non agents locs: %d"),
-			Locations.Num()));
-#endif
-	if(Locations.Num() == 0)
-	{
-		UpdateAgentFloorCheckResult(Guid, FVector::ZeroVector, false);
-		return;
-	}
-	FVector HighestVector = FVector::ZeroVector;
-	for(int i = 0; i < Locations.Num(); i++)
+	if(WorldRef)
 	{
-		if(Locations[i].Z > HighestVector.Z)
+		/**
+		 * The lead shard kicks off the AdvanceTimers -> GatherDueTasks chain for every
+		 * shard in the World. The other shards tick after the lead, so by the time
+		 * they get here their chain is already running, or done.
+		 */
+		// In lockstep the simulation only moves on in whole steps, and some frames don't get one
+		if(bLockstep && !BeginLockstepStep(DeltaTime))
+			return;
+		const float SimulationDeltaTime = GetSimulationDeltaTime(DeltaTime);
+		
+		if(IsLeadShard() && !bLockstep)
+		{
+			for(ANAIAgentManager* Shard : FNAIAgentManagerRegistry::GetManagers(WorldRef))
+			{
+				// Shards that haven't initialized yet don't get past Initialize() this frame
+				if(Shard->WorldRef)
+				{
+					Shard->LaunchSimulationTasks(SimulationDeltaTime);
+				}
+			}
+		}
+
+		/**
+		 * Launch our own chain if the lead didn't. In lockstep there's only the one shard, and
+		 * a lead that hasn't initialized yet spends its Tick() in Initialize() instead.
+		 */
+		if(!SimulationEvent.IsValid())
+		{
+			LaunchSimulationTasks(SimulationDeltaTime);
+		}
+
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(SimulationEvent, ENamedThreads::GameThread);
+		SimulationEvent = nullptr;
+
+		UpdateAgentGroups(SimulationDeltaTime);
+
+		if(bUseDensityField)
 		{
-			HighestVector = Locations[i];
+			UpdateDensityQueryFilter(SimulationDeltaTime);
 		}
+		
+		IssueQueries();
+	}
+	else
+	{
+		Initialize();
 	}
-	UpdateAgentFloorCheckResult(Guid, HighestVector, true);
 }
 
-void ANAIAgentManager::OnStepCheckTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data, FGuid Guid)
+void ANAIAgentManager::LaunchSimulationTasks(const float DeltaTime)
 {
-	if(!Handle.IsValid())
+	if(SimulationEvent.IsValid())
 		return;
 
-#if (ENABLE_DEBUG_DRAW_LINE)
-	if(WorldRef)
-	{
-		DrawDebugLine(WorldRef, Data.Start, Data.End, FColor(0, 255, 0),
-			false, 2, 0, 2.0f);
-	}
-#endif
-	if(Data.OutHits.Num() == 0)
-	{
-		UpdateAgentStepCheckResult(Guid, FVector::ZeroVector, false);
-		return; 
-	}
-	const TArray<FVector> Locations = GetAllHitLocationsNotFromAgents(Data.OutHits);
-#if (ENABLE_DEBUG_PRINT_SCREEN)
-	if(GEngine)
-		GEngine->AddOnScreenDebugMessage(
-			-1, 1.0f, FColor::Yellow,
-			FString::Printf(TEXT("Total number non agents locs: %d"),
-			Locations.Num()));
-#endif
-	if(Locations.Num() == 0)
+	// No Agents can be added or removed until the GameThread is done with IssueQueries()
+	AddIncomingAgents();
+	bIsAgentSetLocked = true;
+
+	// The tasks can't touch the Actors, so everything they need from them is copied out here, on the GameThread
+	const int32 AgentCount = AgentGuids.Num();
+	AgentLocations.SetNumUninitialized(AgentCount, false);
+	AgentRotations.SetNumUninitialized(AgentCount, false);
+	for(int32 i = 0; i < AgentCount; i++)
 	{
-		UpdateAgentStepCheckResult(Guid, FVector::ZeroVector, false);
-		return;
+		const FTransform& Transform = AgentMap[AgentGuids[i]].AgentClient->GetActorTransform();
+		AgentLocations[i] = Transform.GetLocation();
+		AgentRotations[i] = Transform.GetRotation();
 	}
 
-	FVector HighestVector = FVector::ZeroVector;
-	for(int i = 0; i < Locations.Num(); i++)
+	// The latency is measured in wall time, so it can't be used in lockstep, where every peer has to agree
+	LookAheadTime = 0.0f;
+	if(bPredictQueries)
 	{
-		if(Locations[i].Z > HighestVector.Z)
-		{
-			HighestVector = Locations[i];
-		}
+		LookAheadTime = bLockstep ? (DeltaTime * 2.0f) : ((AverageTraceLatencyMs / 1000.0f) + DeltaTime);
 	}
-	UpdateAgentStepCheckResult(Guid, HighestVector, true);
-}
 
-#define ENABLE_LOCAL_BOUNDS_DEBUG true
+	FGraphEventRef TimersEvent = FFunctionGraphTask::CreateAndDispatchWhenReady(
+		[this, DeltaTime]() { AdvanceTimers(DeltaTime); },
+		TStatId(), nullptr, ENamedThreads::AnyHiPriThreadNormalTask);
 
-void ANAIAgentManager::OnLocalBoundsCheckTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data, FGuid Guid)
-{
-	if(!Handle.IsValid())
-		return;
+	FGraphEventArray GatherPrerequisites;
+	GatherPrerequisites.Add(TimersEvent);
+	SimulationEvent = FFunctionGraphTask::CreateAndDispatchWhenReady(
+		[this]() { GatherDueTasks(); },
+		TStatId(), &GatherPrerequisites, ENamedThreads::AnyHiPriThreadNormalTask);
+}
 
-	const int HitResultCount = Data.OutHits.Num();
+void ANAIAgentManager::AdvanceTimers(const float DeltaTime)
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_AdvanceTimers);
+	LLM_SCOPE_BYTAG(NAI);
+	FAgentManagerPhaseScope PhaseScope(PhaseTimings, EAgentManagerPhase::AdvanceTimers);
 	
-	/**
-	 * We didn't hit anything at all... this means we're in mid-air...
-	 * Reset the result with the type's default constructor
-	 */
-	if(HitResultCount == 0)
-	{
-		AgentMap[Guid].UpdateLocalBoundsCheckResult(/* Default */);
-		AgentMap.Add(FGuid::NewGuid(), FAgent());
-		return;
-	}
+	const int32 AgentCount = AgentGuids.Num();
+	SpeedPositionsThisFrame.SetNum(AgentCount);
+	SpeedPositionsLastFrame.SetNum(AgentCount);
 	
-	/** 
-	 * Handle Singular Hit output
-	 * We pass the only impact point as the highest vector since there are no others
-	 * This can be either the floor height, or the location of an object the agent collided with
-	 * in mid-air
-	 */
-	if(HitResultCount == 1)
+	for(int32 i = 0; i < AgentCount; i++)
 	{
-		AgentMap[Guid].UpdateLocalBoundsCheckResult(
-			FAgentLocalBoundsCheckResult(true, Data.OutHits.Last().ImpactPoint)
-		);
-		
-		return;
-	}
+		FAgent& Agent = AgentMap[AgentGuids[i]];
 
-	/** IF we got here it means we have multiple hits. */
+		// Update all the agents timers for their tasks
+		Agent.UpdateTimers(DeltaTime);
 
-	// Get the highest vector from the list of hits
-	FVector HighestVector = FVector::ZeroVector;
-	FNAICalculator::GetHighestHitPoint(Data.OutHits, HighestVector);
+		Agent.UpdatePosition(AgentLocations[i]);
+		SpeedPositionsThisFrame.Set(i, Agent.GetPositionThisFrame());
+		SpeedPositionsLastFrame.Set(i, Agent.GetPositionLastFrame());
+	}
 
-	// assemble a list of vectors representing the hit locations
-	TArray<FVector> HitPoints;
-	for(int i = 0; i < HitResultCount; i++)
+	// Calculate the Agents Speed in one go, and update the property on the AgentClient object.
+	FNAIVectorMath::Speed(SpeedPositionsThisFrame, SpeedPositionsLastFrame, DeltaTime, Speeds);
+	for(int32 i = 0; i < AgentCount; i++)
 	{
-		HitPoints.Add(Data.OutHits[i].ImpactPoint);
+		AgentMap[AgentGuids[i]].SetSpeed(Speeds[i]);
 	}
-	// Update the result
-	AgentMap[Guid].UpdateLocalBoundsCheckResult(
-		FAgentLocalBoundsCheckResult(true, HighestVector, true, HitPoints)
-	);
+}
 
-	
-#if (ENABLE_LOCAL_BOUNDS_DEBUG)
-	if(GEngine)
+/**
+ * Find the point a distance ahead along a path, starting from where the Agent is rather than the path's first point.
+ * The height is left where the Agent is, the ground checks find the floor from there.
+ */
+static FVector GetLookAheadLocation(const FVector& Location, const TArray<FNavPathPoint>& PathPoints, const float Distance)
+{
+	FVector Current = Location;
+	float Remaining = Distance;
+	for(int32 i = 1; i < PathPoints.Num() && Remaining > 0.0f; i++)
 	{
-		// Print the highest vector to screen as a string
-		GEngine->AddOnScreenDebugMessage(
-			-1, 1.0f, FColor::Yellow,
-			FString::Printf(TEXT("Highest Vector Hit: %s"),
-			*HighestVector.ToString())
-		);
+		const FVector Segment = FVector(PathPoints[i].Location.X, PathPoints[i].Location.Y, Location.Z) - Current;
+		const float Length = Segment.Size2D();
+		if(Length >= Remaining)
+			return Current + (Segment * (Remaining / Length));
 
-		// Draw a small capsule at the location of the highest vector
-		UKismetSystemLibrary::DrawDebugCapsule(WorldRef, HighestVector,
-	5.0f, 5.0f,
-	FRotator(0.0f), FLinearColor(255, 0, 150), 5.0f, 1.0f
-		);
+		Remaining -= Length;
+		Current += Segment;
 	}
-#endif
+	// The path ends sooner, and the Agent stops there
+	return Current;
 }
 
-bool ANAIAgentManager::CheckIfBlockedByAgent(const TArray<FHitResult>& Objects, const FGuid& Guid) const
+void ANAIAgentManager::GatherDueTasks()
 {
-	for(int i = 0; i < Objects.Num(); i++)
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_GatherDueTasks);
+	LLM_SCOPE_BYTAG(NAI);
+	FAgentManagerPhaseScope PhaseScope(PhaseTimings, EAgentManagerPhase::GatherDueTasks);
+
+	DueTasks.Reset();
+	PendingMoves.Reset();
+	AgentsGoingDormant.Reset();
+	HaltedAgentCount = 0;
+	int32 StaleResultCount = 0;
+
+	// Every peer has its own players, so in lockstep the Agents all stay awake to keep the simulation the same
+	const bool bCanGoDormant = bAllowDormancy && !bLockstep;
+	const float DormancyGoalRadiusSquared = FMath::Square(DormancyGoalRadius);
+	const float DormancyDistanceSquared = FMath::Square(DormancyDistance);
+
+	// Build this frame's density field over the area the Agents covered last frame, plus a margin for the ones that moved out of it
+	FBox2D NextDensityBounds(ForceInit);
+	if(bUseDensityField)
 	{
-		if(Objects[i].Actor.IsValid())
+		DensityFieldNext.Reset(DensityBounds.bIsValid ? DensityBounds.ExpandBy(DensityCellSize * 2.0f) : DensityBounds,
+			DensityCellSize, 256);
+		DensityFieldFrame++;
+
+		// Dormant Agents, halted ones included, still take up space. They don't move, so where they stopped will do
+		for(const FGuid& Guid : DormantAgentGuids)
 		{
-			if(Objects[i].Actor.Get()->IsA(ANAIAgentClient::StaticClass()))
-			{
-				// TODO: This check is not needed for line traces since the they should always start outside the agents collider
-				if(Guid != Cast<ANAIAgentClient>(Objects[i].Actor.Get())->GetGuid())
-				{
-					// If we got here then it means with DID hit an agent, and it WAS NOT this one
-					return true; // Don't need to check any others since only one needs to be in the way
-				}
-			}
+			FAgent& Agent = AgentMap[Guid];
+			const FVector2D Location2D(Agent.GetPositionThisFrame());
+			DensityFieldNext.Splat(Location2D);
+			Agent.DensitySplatLocation = Location2D;
+			Agent.DensitySplatFrame = DensityFieldFrame;
+			NextDensityBounds += Location2D;
 		}
 	}
-	return false;
-}
 
-TArray<FVector> ANAIAgentManager::GetAllHitLocationsNotFromAgents(const TArray<FHitResult>& HitResults) const
-{
-	TArray<FVector> Locations;
-	
-	for(int i = 0; i < HitResults.Num(); i++)
+	/**
+	 * Without physics bodies the avoidance traces can't see the other Agents, so the Agents find each other
+	 * in a hash of everyone's locations as well. The active Agents go in first, so an Agent's index in
+	 * AgentGuids is its index in the hash too.
+	 */
+	if(bPhysicsFreeAgents)
 	{
-		if(HitResults[i].Actor.IsValid())
+		AgentHashGuids.Reset();
+		AgentHashPoints.Reset();
+		AgentHashGuids.Append(AgentGuids);
+		for(const FVector& Location : AgentLocations)
 		{
-			if(!HitResults[i].Actor.Get()->IsA(ANAIAgentClient::StaticClass()))
-			{
-				Locations.Add(HitResults[i].ImpactPoint);
-			}
+			AgentHashPoints.Add(FVector2D(Location));
+		}
+		for(const FGuid& Guid : DormantAgentGuids)
+		{
+			AgentHashGuids.Add(Guid);
+			// Dormant Agents don't move, so the position they stopped at saves reading their Actors from here
+			AgentHashPoints.Add(FVector2D(AgentMap[Guid].GetPositionThisFrame()));
 		}
+		AgentHash.Build(AgentHashPoints, AGENT_HASH_CELL_SIZE);
 	}
-	
-	return Locations; 
-}
-
-#undef ENABLE_DEBUG_DRAW_LINE
-#undef ENABLE_FLOOR_DEBUG_PRINT_SCREEN
-#undef ENABLE_DEBUG_PRINT_SCREEN
+	// The traces still go out for the world, players and proxies, this is ORed into what they find
+	auto CheckNeighbours = [this](FAgent* Agent, const int32 AgentIndex, const EAgentAvoidanceTraceDirection Direction)
+	{
+		const FTransform Transform(AgentRotations[AgentIndex], AgentLocations[AgentIndex]);
+		const uint8 DirectionFlag = 1 << (uint8)Direction;
+		if(IsAvoidanceBlockedByNeighbour(*Agent, AgentIndex, Transform, Direction))
+		{
+			Agent->NeighbourBlockedDirections |= DirectionFlag;
+		}
+		else
+		{
+			Agent->NeighbourBlockedDirections &= ~DirectionFlag;
+		}
+	};
+	
+	for(int32 AgentIndex = 0; AgentIndex < AgentGuids.Num(); AgentIndex++)
+	{
+		/**
+		 * Grab a reference to the Agent we want to work on.
+		 * We don't take a copy to avoid having to unbox it after
+		 */
+		const FGuid& Guid = AgentGuids[AgentIndex];
+		FAgent *Agent = &AgentMap[Guid];
+
+		// Halted Agents still take up space, so they're counted before anything else
+		float Density = 0.0f;
+		FVector2D DensityGradient = FVector2D::ZeroVector;
+		if(bUseDensityField)
+		{
+			const FVector2D Location2D(AgentLocations[AgentIndex]);
+			// Last frame's field has this Agent in it too, where it was then, and it shouldn't be pushed away from itself
+			const FVector2D* OwnSplat = (Agent->DensitySplatFrame == DensityFieldFrame - 1) ? &Agent->DensitySplatLocation : nullptr;
+			Density = DensityField.Sample(Location2D);
+			DensityGradient = DensityField.Gradient(Location2D, OwnSplat);
+
+			DensityFieldNext.Splat(Location2D);
+			Agent->DensitySplatLocation = Location2D;
+			Agent->DensitySplatFrame = DensityFieldFrame;
+			NextDensityBounds += Location2D;
+		}
+
+		/**
+		 * Agents with nothing to do are taken out of AgentGuids at the end of the frame.
+		 * Group members never go dormant, they'd be left behind when the leader moves on.
+		 */
+		if(bCanGoDormant && Agent->GroupId == INDEX_NONE)
+		{
+			const FVector& Location = Agent->GetPositionThisFrame();
+			const TArray<FNavPathPoint>& PathPoints = Agent->PathTask.GetResult().Points;
+			const bool bAtGoal = PathPoints.Num() > 0 &&
+				FVector::DistSquared2D(PathPoints.Last().Location, Location) <= DormancyGoalRadiusSquared;
+			
+			bool bIsFar = DormancyDistance > 0.0f && DormancyViewLocations.Num() > 0;
+			for(int32 i = 0; bIsFar && i < DormancyViewLocations.Num(); i++)
+			{
+				bIsFar = FVector::DistSquared2D(DormancyViewLocations[i], Location) > DormancyDistanceSquared;
+			}
+
+			if(Agent->IsHalted() || bAtGoal || bIsFar)
+			{
+				Agent->bIsDormant = true;
+				Agent->bIsDormantFromDistance = bIsFar;
+				Agent->bIsDormantFromHalt = Agent->IsHalted();
+				AgentsGoingDormant.Add(Guid);
+				continue;
+			}
+		}
+
+		// If the Agent has been set to stop, don't do anything
+		if(Agent->IsHalted())
+		{
+			HaltedAgentCount++;
+			continue;
+		}
+
+		// Group members follow their slot, so they don't need a path or avoidance traces of their own
+		const FAgentGroup* Group = (Agent->GroupId != INDEX_NONE) ? AgentGroups.Find(Agent->GroupId) : nullptr;
+		const bool bFollowsSlot = Group && Group->SlotLocations.IsValidIndex(Agent->GroupSlot);
+
+		// Separation keeps the Agents apart in crowded cells, the traces would only see each other there
+		const bool bSkipAvoidance = bFollowsSlot ||
+			((DenseAvoidanceThreshold > 0.0f) && (Density >= DenseAvoidanceThreshold));
+		
+		uint8 TaskFlags = 0;
+		if(Agent->PathTask.IsReady())
+		{
+			if(!bFollowsSlot)
+			{
+				TaskFlags |= AGENT_TASK_PATH;
+			}
+			Agent->PathTask.Reset(); // Reset the timer
+		}
+		if(Agent->AvoidanceFrontTask.IsReady())
+		{
+			if(!bSkipAvoidance)
+			{
+				if(bPhysicsFreeAgents)
+				{
+					CheckNeighbours(Agent, AgentIndex, EAgentAvoidanceTraceDirection::TracingFront);
+				}
+				TaskFlags |= AGENT_TASK_AVOIDANCE_FRONT;
+			}
+			Agent->AvoidanceFrontTask.Reset();
+		}
+		
+		/**
+		 * Is there something in front of the Agent? Check both sides to see which way it can strafe.
+		 * A stale block is from a trace that's been skipped or lost since, so it isn't acted on.
+		 */
+		bool bIsBlockedInFront = Agent->AvoidanceFrontTask.GetResult().IsBlocked() && !bSkipAvoidance;
+		if(bIsBlockedInFront && Agent->AvoidanceFrontTask.IsResultStale())
+		{
+			bIsBlockedInFront = false;
+			StaleResultCount++;
+		}
+		if(bIsBlockedInFront)
+		{
+			if(Agent->AvoidanceRightTask.IsReady())
+			{
+				if(bPhysicsFreeAgents)
+				{
+					CheckNeighbours(Agent, AgentIndex, EAgentAvoidanceTraceDirection::TracingRight);
+				}
+				TaskFlags |= AGENT_TASK_AVOIDANCE_RIGHT;
+				Agent->AvoidanceRightTask.Reset();
+			}
+			if(Agent->AvoidanceLeftTask.IsReady())
+			{
+				if(bPhysicsFreeAgents)
+				{
+					CheckNeighbours(Agent, AgentIndex, EAgentAvoidanceTraceDirection::TracingLeft);
+				}
+				TaskFlags |= AGENT_TASK_AVOIDANCE_LEFT;
+				Agent->AvoidanceLeftTask.Reset();
+			}
+		}
+		
+		if(Agent->FloorCheckTask.IsReady())
+		{
+			TaskFlags |= AGENT_TASK_FLOOR_CHECK;
+			Agent->FloorCheckTask.Reset();
+		}
+		if(Agent->StepCheckTask.IsReady())
+		{
+			TaskFlags |= AGENT_TASK_STEP_CHECK;
+			Agent->StepCheckTask.Reset();
+		}
+		if(Agent->LocalBoundsCheckTask.IsReady())
+		{
+			TaskFlags |= AGENT_TASK_LOCAL_BOUNDS_CHECK;
+			Agent->LocalBoundsCheckTask.Reset();
+		}
+
+		const bool bWantsToMove = Agent->MoveTask.IsReady();
+		if(TaskFlags == 0 && !bWantsToMove)
+			continue;
+		
+		const FVector& AgentLocation = AgentLocations[AgentIndex];
+		const FQuat& AgentRotation = AgentRotations[AgentIndex];
+
+		if(TaskFlags != 0)
+		{
+			FAgentDueTasks& Due = DueTasks.AddDefaulted_GetRef();
+			Due.Guid = Guid;
+			Due.TaskFlags = TaskFlags;
+			Due.Location = AgentLocation;
+			Due.QueryLocation = AgentLocation;
+
+			/**
+			 * A result stands in until the next one comes back, a whole interval later, and the ground checks
+			 * stretch theirs the most. So aim for the middle of the longest interval any of these will be used for.
+			 */
+			float LongestInterval = 0.0f;
+			if(TaskFlags & AGENT_TASK_AVOIDANCE_FRONT)
+				LongestInterval = FMath::Max(LongestInterval, Agent->AvoidanceFrontTask.GetTickRate());
+			if(TaskFlags & AGENT_TASK_AVOIDANCE_RIGHT)
+				LongestInterval = FMath::Max(LongestInterval, Agent->AvoidanceRightTask.GetTickRate());
+			if(TaskFlags & AGENT_TASK_AVOIDANCE_LEFT)
+				LongestInterval = FMath::Max(LongestInterval, Agent->AvoidanceLeftTask.GetTickRate());
+			if(TaskFlags & AGENT_TASK_FLOOR_CHECK)
+				LongestInterval = FMath::Max(LongestInterval, Agent->FloorCheckTask.GetTickRate());
+			if(TaskFlags & AGENT_TASK_STEP_CHECK)
+				LongestInterval = FMath::Max(LongestInterval, Agent->StepCheckTask.GetTickRate());
+			if(TaskFlags & AGENT_TASK_LOCAL_BOUNDS_CHECK)
+				LongestInterval = FMath::Max(LongestInterval, Agent->LocalBoundsCheckTask.GetTickRate());
+			const float AgentLookAheadTime = (LookAheadTime > 0.0f)
+				? FMath::Min(LookAheadTime + (LongestInterval * 0.5f), MaxLookAheadTime) : 0.0f;
+
+			const float LookAheadDistance = Agent->Speed * AgentLookAheadTime;
+			if(LookAheadDistance > KINDA_SMALL_NUMBER)
+			{
+				if(bFollowsSlot)
+				{
+					const FVector ToSlot = Group->SlotLocations[Agent->GroupSlot] - AgentLocation;
+					Due.QueryLocation += FVector(ToSlot.X, ToSlot.Y, 0.0f).GetClampedToMaxSize2D(LookAheadDistance);
+				}
+				else
+				{
+					Due.QueryLocation = GetLookAheadLocation(AgentLocation, Agent->PathTask.GetResult().Points, LookAheadDistance);
+				}
+			}
+			Due.Forward = AgentRotation.GetAxisX();
+			Due.Right = AgentRotation.GetAxisY();
+		}
+
+		/**
+		 * Gather everything the move needs now.
+		 * The IntegrateMovement phase only ever reads from the FAgentPendingMove, never the Agent,
+		 * so Agents can be added or removed while it's running.
+		 */
+		if(bWantsToMove)
+		{
+			// Don't copy the path, it's only read from here
+			const TArray<FNavPathPoint>& PathPoints = Agent->PathTask.GetResult().Points;
+
+			FVector PathStart = FVector::ZeroVector;
+			FVector PathEnd = FVector::ZeroVector;
+			float MoveSpeed = Agent->Overrides.MoveSpeed;
+			bool bHasMove = false;
+			if(bFollowsSlot)
+			{
+				// Head straight for the slot, it's already been projected onto the navmesh
+				const FVector& SlotLocation = Group->SlotLocations[Agent->GroupSlot];
+				const float SlotDistance = FVector::Dist2D(AgentLocation, SlotLocation);
+
+				// Close enough, don't shuffle about on the spot
+				if(SlotDistance > Group->Spacing * 0.1f)
+				{
+					PathStart = AgentLocation;
+					PathEnd = FVector(SlotLocation.X, SlotLocation.Y, AgentLocation.Z);
+					// Hurry to catch up when far behind, and slow down when close so the member settles on the slot
+					MoveSpeed *= FMath::Min(SlotDistance / Group->Spacing, GroupCatchUpSpeedScale);
+					bHasMove = true;
+				}
+			}
+			else if(PathPoints.Num() > 1) // No reason to move if we don't have a path, which needs at least 2 points
+			{
+				PathStart = PathPoints[0].Location;
+				PathEnd = PathPoints[1].Location;
+				bHasMove = true;
+			}
+			
+			if(bHasMove)
+			{
+				FAgentPendingMove& Move = PendingMoves.AddDefaulted_GetRef();
+				Move.Guid = Guid;
+				Move.Location = AgentLocation;
+				Move.Rotation = AgentRotation;
+				Move.PathStart = PathStart;
+				Move.PathEnd = PathEnd;
+				Move.MoveSpeed = MoveSpeed;
+				Move.LookAtRotationRate = Agent->Overrides.LookAtRotationRate;
+				Move.CapsuleHalfHeight = Agent->GetProperties().CapsuleHalfHeight;
+				// A stale ground height would snap the Agent to wherever the floor was, so go without
+				Move.bHasGroundHeight = Agent->LocalBoundsCheckTask.GetResult().bIsValidResult;
+				if(Move.bHasGroundHeight && Agent->LocalBoundsCheckTask.IsResultStale())
+				{
+					Move.bHasGroundHeight = false;
+					StaleResultCount++;
+				}
+				Move.GroundHeight = Agent->LocalBoundsCheckTask.GetResult().GetHighestHitPoint().Z;
+				// Down the gradient, away from the crowd. The gradient is per cm, so scale it up to per cell
+				const FVector2D Separation = -DensityGradient * (DensityField.GetCellSize() * SeparationStrength);
+				Move.Separation = FVector(Separation.GetClampedToMaxSize(MaxSeparationSpeed), 0.0f);
+			}
+			
+			Agent->MoveTask.Reset();
+		}
+	}
+
+	if(bUseDensityField)
+	{
+		Swap(DensityField, DensityFieldNext);
+		DensityBounds = NextDensityBounds;
+	}
+
+	INC_DWORD_STAT_BY(STAT_NAI_ActiveAgents, AgentGuids.Num() - HaltedAgentCount - AgentsGoingDormant.Num());
+	INC_DWORD_STAT_BY(STAT_NAI_HaltedAgents, HaltedAgentCount);
+	INC_DWORD_STAT_BY(STAT_NAI_StaleResults, StaleResultCount);
+}
+
+void ANAIAgentManager::IssueQueries()
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_IssueQueries);
+	FAgentManagerPhaseScope PhaseScope(PhaseTimings, EAgentManagerPhase::IssueQueries);
+	QueryCounts.Reset();
+
+	// The density filter is rebuilt every so often, so the paths pick up whichever one is current
+	WorldQuery->SetQueryFilter(DensityQueryFilter.IsValid() ? DensityQueryFilter : NavQueryRef);
+	
+	for(const FAgentDueTasks& Due : DueTasks)
+	{
+		// The Agent set is still locked, so the Agent can't have gone
+		FAgent* Agent = &AgentMap[Due.Guid];
+		// Every query is counted here, so the Agent can be moved while they're in flight
+		FAgentQueryRecord& QueryRecord = FindOrAddQueryRecord(Due.Guid);
+		const int32 QueriesInFlightBefore = QueryRecord.QueriesInFlight;
+		// Shared by every Agent of this archetype, so it's likely still in cache from the last one
+		const FAgentProperties& AgentProperties = Agent->GetProperties();
+		const FVector& AgentLocation = Due.Location;
+		const FVector& QueryLocation = Due.QueryLocation;
+		const FVector& AgentForward = Due.Forward;
+		const FVector& AgentRight = Due.Right;
+		
+		/** Execute the Pathfinding Task TODO: Doc this properly */
+		if(Due.TaskFlags & AGENT_TASK_PATH)
+		{
+			// Get the Goal Location from the Agent type
+			const FVector PlayerLocation = bHasCrowdGoal ? CrowdGoalLocation : GetActorLocation(); // TODO: GET THE PLAYER!!!
+			const EAgentType AgentType = AgentProperties.AgentType;
+			const FVector GoalLocation = GetAgentGoalLocationFromType(AgentType, PlayerLocation);
+			
+			const bool bWasSent = AgentPathTaskAsync(AgentLocation, GoalLocation,
+				AgentProperties.NavigationProperties.NavAgentProperties, Due.Guid);
+			Agent->PathTask.MarkIssued(AgentLocation);
+			if(bWasSent)
+			{
+				QueryCounts.PathQueries++;
+				QueryRecord.QueriesInFlight++;
+			}
+		}
+		
+		/** Execute the avoidance tasks TODO: Doc this properly */
+		if(Due.TaskFlags & AGENT_TASK_AVOIDANCE_FRONT)
+		{
+			AgentAvoidanceTraceTaskAsync(
+				EAgentAvoidanceTraceDirection::TracingFront,
+				QueryLocation, AgentForward, AgentRight, AgentProperties, Due.Guid
+			);
+			Agent->AvoidanceFrontTask.MarkIssued(AgentLocation);
+			const uint8 CellCount = AgentProperties.AvoidanceProperties.GridCellCounts[(uint8)EAgentAvoidanceTraceDirection::TracingFront];
+			Agent->BeginAvoidanceCells(EAgentAvoidanceTraceDirection::TracingFront, CellCount);
+			QueryCounts.LineTraces += CellCount;
+			QueryRecord.QueriesInFlight += CellCount;
+		}
+		if(Due.TaskFlags & AGENT_TASK_AVOIDANCE_RIGHT)
+		{
+			AgentAvoidanceTraceTaskAsync(
+				EAgentAvoidanceTraceDirection::TracingRight,
+				QueryLocation, AgentForward, AgentRight, AgentProperties, Due.Guid
+			);
+			Agent->AvoidanceRightTask.MarkIssued(AgentLocation);
+			const uint8 CellCount = AgentProperties.AvoidanceProperties.GridCellCounts[(uint8)EAgentAvoidanceTraceDirection::TracingRight];
+			Agent->BeginAvoidanceCells(EAgentAvoidanceTraceDirection::TracingRight, CellCount);
+			QueryCounts.LineTraces += CellCount;
+			QueryRecord.QueriesInFlight += CellCount;
+		}
+		if(Due.TaskFlags & AGENT_TASK_AVOIDANCE_LEFT)
+		{
+			AgentAvoidanceTraceTaskAsync(
+				EAgentAvoidanceTraceDirection::TracingLeft,
+				QueryLocation, AgentForward, AgentRight, AgentProperties, Due.Guid
+			);
+			Agent->AvoidanceLeftTask.MarkIssued(AgentLocation);
+			const uint8 CellCount = AgentProperties.AvoidanceProperties.GridCellCounts[(uint8)EAgentAvoidanceTraceDirection::TracingLeft];
+			Agent->BeginAvoidanceCells(EAgentAvoidanceTraceDirection::TracingLeft, CellCount);
+			QueryCounts.LineTraces += CellCount;
+			QueryRecord.QueriesInFlight += CellCount;
+		}
+
+		/** Conduct the floor check TODO: Doc this properly */
+		if(Due.TaskFlags & AGENT_TASK_FLOOR_CHECK)
+		{
+			const FVector StartPoint = FVector(
+				QueryLocation.X, QueryLocation.Y,
+				(QueryLocation.Z - (AgentProperties.CapsuleHalfHeight - 1.0f)));
+			const FVector EndPoint = StartPoint - FVector(0.0f, 0.0f, 100.0f);
+			
+			WorldQuery->RaycastAsync(StartPoint, EndPoint, ENAISimQueryFilter::World, true,
+				FNAISimQueryTicket(Due.Guid, (uint8)ENAILockstepResultType::FloorCheck));
+			Agent->FloorCheckTask.MarkIssued(AgentLocation);
+			QueryCounts.LineTraces++;
+			QueryRecord.QueriesInFlight++;
+		}
+
+		/** Execute the step check task TODO: Doc this properly */
+		if(Due.TaskFlags & AGENT_TASK_STEP_CHECK)
+		{
+			const FVector StartPoint =
+				QueryLocation +
+					(AgentForward * AgentProperties.NavigationProperties.StepProperties.ForwardOffset) +
+					(FVector(0.0f, 0.0f, -1.0f) * AgentProperties.NavigationProperties.StepProperties.DownwardOffset);
+			const FVector EndPoint = StartPoint - FVector(0.0f, 0.0f, 100.0f);
+			
+			WorldQuery->RaycastAsync(StartPoint, EndPoint, ENAISimQueryFilter::World, true,
+				FNAISimQueryTicket(Due.Guid, (uint8)ENAILockstepResultType::StepCheck));
+			Agent->StepCheckTask.MarkIssued(AgentLocation);
+			QueryCounts.LineTraces++;
+			QueryRecord.QueriesInFlight++;
+		}
+		
+		if(Due.TaskFlags & AGENT_TASK_LOCAL_BOUNDS_CHECK)
+		{
+			const FAgentVirtualCapsuleSweepProperties& CapsuleSweepProperties
+				= AgentProperties.NavigationProperties.LocalBoundsCheckProperties; 
+			
+			// const FVector StartPoint = AgentLocation + FVector(0.0f, 0.0f, CapsuleSweepProperties.HalfHeight);
+			const FVector EndPoint = QueryLocation - FVector(0.0f, 0.0f, (CapsuleSweepProperties.HalfHeight * 2.0f));
+			
+			WorldQuery->SweepCapsuleAsync(QueryLocation, EndPoint,
+				CapsuleSweepProperties.Radius, CapsuleSweepProperties.HalfHeight, ENAISimQueryFilter::World,
+				FNAISimQueryTicket(Due.Guid, (uint8)ENAILockstepResultType::LocalBounds));
+			Agent->LocalBoundsCheckTask.MarkIssued(AgentLocation);
+			QueryCounts.Sweeps++;
+			QueryRecord.QueriesInFlight++;
+
+#if NAI_DEBUG_DRAW
+			if(FNAIDebugDraw::ShouldDraw(ENAIDebugCategory::LocalBounds, Agent->AgentClient))
+			{
+				FNAIDebugDraw::AddCapsule(WorldRef, QueryLocation - FVector(0.0f, 0.0f, CapsuleSweepProperties.HalfHeight),
+					CapsuleSweepProperties.HalfHeight, CapsuleSweepProperties.Radius, FColor(0, 100, 255));
+			}
+#endif
+		}
+
+		if(bLockstep)
+		{
+			QueryRecord.LockstepQueriesInFlight += QueryRecord.QueriesInFlight - QueriesInFlightBefore;
+		}
+	}
+	DueTasks.Reset();
+
+	PathQueriesInFlight += QueryCounts.PathQueries;
+	INC_DWORD_STAT_BY(STAT_NAI_PathQueriesIssued, QueryCounts.PathQueries);
+	INC_DWORD_STAT_BY(STAT_NAI_PathQueriesInFlight, QueryCounts.PathQueries);
+	INC_DWORD_STAT_BY(STAT_NAI_TracesIssued, QueryCounts.LineTraces);
+	INC_DWORD_STAT_BY(STAT_NAI_SweepsIssued, QueryCounts.Sweeps);
+
+	// Every one of these calls back once, and the next step waits until they all have, or their Agent leaves
+	if(bLockstep)
+	{
+		LockstepQueriesInFlight += QueryCounts.PathQueries + QueryCounts.LineTraces + QueryCounts.Sweeps;
+	}
+
+#if NAI_DEBUG_DRAW
+	if(FNAIDebugDraw::IsCategoryEnabled(ENAIDebugCategory::Paths))
+	{
+		for(const FAgentPendingMove& Move : PendingMoves)
+		{
+			if(ShouldDebugDraw(ENAIDebugCategory::Paths, Move.Guid))
+			{
+				FNAIDebugDraw::AddLine(WorldRef, Move.PathStart, Move.PathEnd, FColor::Green);
+			}
+		}
+	}
+#endif
+	
+	// DueTasks is done with, so the Agents can be added and removed again
+	bIsAgentSetLocked = false;
+}
+
+void ANAIAgentManager::TickCompute(const float DeltaTime)
+{
+	/**
+	 * This runs in TG_DuringPhysics, on a worker thread unless bRunComputeOffGameThread is off.
+	 * The lead shard integrates every shard's moves at once, the other shards' Apply ticks wait on it.
+	 */
+	if(!WorldRef || !IsLeadShard())
+		return;
+	
+	const TArray<ANAIAgentManager*>& Shards = FNAIAgentManagerRegistry::GetManagers(WorldRef);
+	ParallelFor(Shards.Num(), [&Shards, DeltaTime](const int32 ShardIndex)
+	{
+		Shards[ShardIndex]->IntegrateMovement(DeltaTime);
+	});
+}
+
+void ANAIAgentManager::IntegrateMovement(const float DeltaTime)
+{
+	// Only ever touches the PendingMoves, so it's safe on any thread
+	if(bLockstep && !bIsLockstepStepping)
+		return;
+	
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_IntegrateMovement);
+	LLM_SCOPE_BYTAG(NAI);
+	FAgentManagerPhaseScope PhaseScope(PhaseTimings, EAgentManagerPhase::IntegrateMovement);
+	
+	MoveIntegrator.Integrate(MakeArrayView(PendingMoves), GetSimulationDeltaTime(DeltaTime));
+}
+
+void ANAIAgentManager::TickApply(const float DeltaTime)
+{
+	/** This is the ApplyTransforms phase, running in TG_PostPhysics on the GameThread. */
+	if(IsReplicatedClient() || (bLockstep && !bIsLockstepStepping))
+		return;
+
+	LLM_SCOPE_BYTAG(NAI);
+	FNAIFrameArenaScope ArenaScope(FrameArena);
+
+	{
+		NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_ApplyTransforms);
+		FAgentManagerPhaseScope PhaseScope(PhaseTimings, EAgentManagerPhase::ApplyTransforms);
+
+		// The PublishState task from two frames ago may still be reading this buffer
+		const uint8 WriteIndex = PublishFrameIndex & 1;
+		if(PublishEvents[WriteIndex].IsValid())
+		{
+			FTaskGraphInterface::Get().WaitUntilTaskCompletes(PublishEvents[WriteIndex], ENamedThreads::GameThread);
+		}
+		TArray<FAgentPublishedState>& PublishBuffer = PublishBuffers[WriteIndex];
+		PublishBuffer.Reset(PendingMoves.Num());
+		
+		for(const FAgentPendingMove& Move : PendingMoves)
+		{
+			// The Agent may have been removed, or handed off, since the Prepare phase
+			const FAgent* Agent = AgentMap.Find(Move.Guid);
+			if(!Agent)
+				continue;
+			
+			// FHitResult Hit; // TODO: Perhaps can get rid of the simgple floor/step check thanks to this 
+
+			// We directly move the agent by moving it's root component as it avoids a shit load
+			// of function calls, along with extra GetActorLocation() function calls
+			// when we already have the agents location in this scope, before we finally get to this function
+			// so we're directly calling it here instead of SetActorLocation() / SetActorRotation()
+			FVector MoveDelta = Move.MoveDelta;
+			{
+				SCOPE_CYCLE_COUNTER(STAT_NAI_MoveComponent);
+				// Without a body there's nothing for MoveComponent() to sweep, so the walls are checked for here
+				if(bPhysicsFreeAgents)
+				{
+					ClipMoveToWorldStatic(*Agent, Move.Location, MoveDelta);
+				}
+				Agent->AgentClient->GetRootComponent()->MoveComponent(
+					MoveDelta, Move.NewRotation, !bPhysicsFreeAgents);
+			}
+
+			FAgentPublishedState& Published = PublishBuffer.AddDefaulted_GetRef();
+			Published.Guid = Move.Guid;
+			Published.Location = Move.Location + MoveDelta;
+			Published.Yaw = Move.NewRotation.Rotator().Yaw;
+		}
+		PendingMoves.Reset();
+
+		// AdvanceTimers worked these out on a worker, so the AgentClients are only given them here
+		for(const FGuid& Guid : AgentGuids)
+		{
+			const FAgent& Agent = AgentMap[Guid];
+			Agent.AgentClient->Speed = Agent.Speed;
+		}
+
+		if(WorldRef && AgentGuids.Num() > 0)
+		{
+			HandOffAgentsOutsideShard();
+		}
+
+		UpdateDormancy(DeltaTime);
+
+		if(bPhysicsFreeAgents && WorldRef)
+		{
+			UpdateCollisionProxies();
+		}
+	}
+
+	if(bLockstep)
+	{
+		EndLockstepStep();
+	}
+
+	LaunchPublishState();
+
+	// Nothing else is touching the Agents now, so this is the safest place to add and remove them
+	ProcessSpawnQueue();
+
+	const ENetMode NetMode = GetNetMode();
+	if(bReplicateAgents && WorldRef && (NetMode == NM_DedicatedServer || NetMode == NM_ListenServer))
+	{
+		UpdateReplication(DeltaTime);
+	}
+
+	// One budget and one set of pose leaders for the whole World, so the lead picks for every shard
+	if(bBudgetAnimation && NetMode != NM_DedicatedServer && IsLeadShard())
+	{
+		UpdateAnimationBudget(DeltaTime);
+	}
+
+#if NAI_DEBUG_DRAW
+	/**
+	 * Everything drawn since the last flush, by every shard's IssueQueries and callbacks, goes to the
+	 * line batcher in one go. Only the lead does it, so the World's shards share the one primitive budget.
+	 */
+	if(IsLeadShard())
+	{
+		FNAIDebugDraw::Flush(WorldRef);
+	}
+#endif
+
+	SET_MEMORY_STAT(STAT_NAI_FrameArenaUsed, FrameArena.GetBytesUsed());
+	SET_MEMORY_STAT(STAT_NAI_FrameArenaPeak, FrameArena.GetPeakBytesUsed());
+}
+
+void ANAIAgentManager::LaunchPublishState()
+{
+	const uint8 ReadIndex = PublishFrameIndex & 1;
+	PublishFrameIndex++;
+
+	const int32 AgentCount = AgentMap.Num();
+	const int32 HaltedCount = HaltedAgentCount;
+	
+	// Publishing is ordered frame to frame, but nothing else in the next frame waits on it
+	FGraphEventArray Prerequisites;
+	if(LatestPublishEvent.IsValid())
+	{
+		Prerequisites.Add(LatestPublishEvent);
+	}
+	
+	LatestPublishEvent = FFunctionGraphTask::CreateAndDispatchWhenReady(
+		[this, ReadIndex, AgentCount, HaltedCount]()
+		{
+			NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_PublishState);
+			LLM_SCOPE_BYTAG(NAI);
+			FAgentManagerPhaseScope PhaseScope(PhaseTimings, EAgentManagerPhase::PublishState);
+
+			const TArray<FAgentPublishedState>& PublishBuffer = PublishBuffers[ReadIndex];
+			PublishedState.AgentCount = AgentCount;
+			PublishedState.HaltedAgentCount = HaltedCount;
+			PublishedState.MovedAgentCount = PublishBuffer.Num();
+			PublishedState.MovedAgents = PublishBuffer;
+		},
+		TStatId(), &Prerequisites, ENamedThreads::AnyBackgroundThreadNormalTask);
+	PublishEvents[ReadIndex] = LatestPublishEvent;
+}
+
+const FAgentManagerPublishedState& ANAIAgentManager::GetPublishedState() const
+{
+	if(LatestPublishEvent.IsValid() && !LatestPublishEvent->IsComplete())
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(LatestPublishEvent, ENamedThreads::GameThread);
+	}
+	return PublishedState;
+}
+
+FAgentManagerMemoryFootprint ANAIAgentManager::GetMemoryFootprint() const
+{
+	check(IsInGameThread() && !bIsAgentSetLocked);
+
+	FAgentManagerMemoryFootprint Footprint;
+	Footprint.AgentCount = AgentMap.Num();
+	// The map's allocation holds the FAgent records themselves
+	Footprint.AgentRecordBytes = AgentMap.GetAllocatedSize() + AgentGuids.GetAllocatedSize() +
+		DormantAgentGuids.GetAllocatedSize() + IncomingAgents.GetAllocatedSize() + OutgoingAgents.GetAllocatedSize();
+	Footprint.TraceResultBytes = FrameArena.GetBytesUsed() + QueryRecords.GetAllocatedSize();
+	if(WorldQuery.IsValid())
+	{
+		Footprint.TraceResultBytes += WorldQuery->GetAllocatedSize();
+	}
+
+	for(const TPair<FGuid, FAgent>& Pair : AgentMap)
+	{
+		const FAgent& Agent = Pair.Value;
+		Footprint.PathBytes += Agent.GetPathAllocatedSize();
+
+		if(!IsValid(Agent.AgentClient))
+			continue;
+
+		Footprint.ActorBytes += Agent.AgentClient->GetClass()->GetStructureSize() +
+			Agent.AgentClient->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+		TInlineComponentArray<UActorComponent*> Components(Agent.AgentClient);
+		for(const UActorComponent* Component : Components)
+		{
+			Footprint.ActorBytes += Component->GetClass()->GetStructureSize() +
+				Component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+		}
+	}
+	return Footprint;
+}
+
+void ANAIAgentManager::GetAgentCountsByAvoidanceLevel(int32& OutNormalCount, int32& OutAdvancedCount) const
+{
+	check(IsInGameThread());
+
+	OutNormalCount = 0;
+	OutAdvancedCount = 0;
+	for(const TPair<FGuid, FAgent>& Pair : AgentMap)
+	{
+		if(Pair.Value.GetProperties().AvoidanceProperties.AvoidanceLevel == EAgentAvoidanceLevel::Normal)
+		{
+			OutNormalCount++;
+		}
+		else
+		{
+			OutAdvancedCount++;
+		}
+	}
+}
+
+void ANAIAgentManager::WaitForOutstandingTasks()
+{
+	if(SimulationEvent.IsValid())
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(SimulationEvent, ENamedThreads::GameThread);
+		SimulationEvent = nullptr;
+		DueTasks.Reset();
+		bIsAgentSetLocked = false;
+	}
+	if(LatestPublishEvent.IsValid())
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(LatestPublishEvent, ENamedThreads::GameThread);
+	}
+	LatestPublishEvent = nullptr;
+	PublishEvents[0] = nullptr;
+	PublishEvents[1] = nullptr;
+}
+
+void ANAIAgentManager::OnTraceComplete(const FNAISimTraceResult& Result)
+{
+	// The Agent has left us since the trace was sent
+	if(!AcceptQueryResult(Result.Ticket.Guid))
+		return;
+	
+	if(ShouldDeferLockstepResult())
+	{
+		FNAILockstepDeferredResult& Deferred =
+			DeferLockstepResult((ENAILockstepResultType)Result.Ticket.Type, Result.Ticket.Guid);
+		Deferred.Direction = Result.Ticket.Direction;
+		Deferred.Start = Result.Start;
+		Deferred.End = Result.End;
+		Deferred.Hits.Append(Result.Hits.GetData(), Result.Hits.Num());
+		return;
+	}
+	
+	DispatchTraceResult(Result);
+}
+
+void ANAIAgentManager::OnPathComplete(const FNAISimQueryTicket& Ticket, const bool bSucceeded,
+	const TArrayView<const FVector>& Points)
+{
+	if(!AcceptQueryResult(Ticket.Guid))
+	{
+		// The Agent has left us since the query was sent
+		PathQueriesInFlight = FMath::Max(PathQueriesInFlight - 1, 0);
+		DEC_DWORD_STAT(STAT_NAI_PathQueriesInFlight);
+		return;
+	}
+	
+	if(ShouldDeferLockstepResult())
+	{
+		FNAILockstepDeferredResult& Deferred = DeferLockstepResult(ENAILockstepResultType::Path, Ticket.Guid);
+		Deferred.bPathSucceeded = bSucceeded;
+		Deferred.PathPoints.Append(Points.GetData(), Points.Num());
+		return;
+	}
+	
+	OnAsyncPathComplete(Ticket.Guid, bSucceeded, Points);
+}
+
+void ANAIAgentManager::DispatchTraceResult(const FNAISimTraceResult& Result)
+{
+	switch((ENAILockstepResultType)Result.Ticket.Type)
+	{
+		case ENAILockstepResultType::Avoidance:
+			OnAvoidanceTraceComplete(Result);
+			break;
+		case ENAILockstepResultType::FloorCheck:
+			OnFloorCheckTraceComplete(Result);
+			break;
+		case ENAILockstepResultType::StepCheck:
+			OnStepCheckTraceComplete(Result);
+			break;
+		case ENAILockstepResultType::LocalBounds:
+			OnLocalBoundsCheckTraceComplete(Result);
+			break;
+		default:
+			break;
+	}
+}
+
+void ANAIAgentManager::OnAsyncPathComplete(const FGuid& Guid, const bool bSucceeded,
+	const TArrayView<const FVector>& Points)
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_PathCallback);
+	INC_DWORD_STAT(STAT_NAI_CallbacksReceived);
+	DEC_DWORD_STAT(STAT_NAI_PathQueriesInFlight);
+	LLM_SCOPE_BYTAG(NAI_Paths);
+
+	PathQueriesInFlight = FMath::Max(PathQueriesInFlight - 1, 0);
+	if(const FAgent* Agent = AgentMap.Find(Guid))
+	{
+		TaskLatency.Record(Agent->PathTask.GetMsSinceIssued());
+	}
+
+	if(bSucceeded)
+	{
+		// The path is persistent, so it's built straight into the Agent's result rather than going through the arena
+		TArray<FNavPathPoint> PathPoints;
+		PathPoints.Reserve(Points.Num());
+		for(const FVector& Point : Points)
+		{
+			PathPoints.Emplace(Point);
+		}
+		UpdateAgentPathResult(Guid, FAgentPathResult(true, MoveTemp(PathPoints)));
+	}
+	else
+	{
+		// Handle Pathfinding failed 
+	}
+}
+
+void ANAIAgentManager::OnAvoidanceTraceComplete(const FNAISimTraceResult& Result)
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_AvoidanceCallback);
+	INC_DWORD_STAT(STAT_NAI_CallbacksReceived);
+	LLM_SCOPE_BYTAG(NAI_TraceResults);
+
+	const FGuid& Guid = Result.Ticket.Guid;
+	const bool bIsBlocked = bPhysicsFreeAgents ?
+		FNAISimResults::IsBlockedByWorld(Result.Hits, Guid) : FNAISimResults::IsBlockedByAgent(Result.Hits, Guid);
+	UpdateAgentAvoidanceResult(Guid, (EAgentAvoidanceTraceDirection)Result.Ticket.Direction, bIsBlocked);
+#if NAI_DEBUG_DRAW
+	if(ShouldDebugDraw(ENAIDebugCategory::Avoidance, Guid))
+	{
+		FNAIDebugDraw::AddLine(WorldRef, Result.Start, Result.End,
+			Result.Hits.Num() > 0 ? FColor::Red : FColor::Green);
+	}
+#endif
+}
+
+void ANAIAgentManager::OnFloorCheckTraceComplete(const FNAISimTraceResult& Result)
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_FloorCheckCallback);
+	INC_DWORD_STAT(STAT_NAI_CallbacksReceived);
+	LLM_SCOPE_BYTAG(NAI_TraceResults);
+
+	const FGuid& Guid = Result.Ticket.Guid;
+#if NAI_DEBUG_DRAW
+	if(ShouldDebugDraw(ENAIDebugCategory::GroundChecks, Guid))
+	{
+		FNAIDebugDraw::AddLine(WorldRef, Result.Start, Result.End, FColor::Cyan);
+	}
+#endif
+	// The Agents are never the floor
+	FVector HighestVector;
+	if(!FNAISimResults::GetHighestHitPoint(Result.Hits, HighestVector, true))
+	{
+		UpdateAgentFloorCheckResult(Guid, FVector::ZeroVector, false);
+		return;
+	}
+	UpdateAgentFloorCheckResult(Guid, HighestVector, true);
+}
+
+void ANAIAgentManager::OnStepCheckTraceComplete(const FNAISimTraceResult& Result)
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_StepCheckCallback);
+	INC_DWORD_STAT(STAT_NAI_CallbacksReceived);
+	LLM_SCOPE_BYTAG(NAI_TraceResults);
+
+	const FGuid& Guid = Result.Ticket.Guid;
+#if NAI_DEBUG_DRAW
+	if(ShouldDebugDraw(ENAIDebugCategory::GroundChecks, Guid))
+	{
+		FNAIDebugDraw::AddLine(WorldRef, Result.Start, Result.End, FColor::Cyan);
+	}
+#endif
+	// Nor are they a step
+	FVector HighestVector;
+	if(!FNAISimResults::GetHighestHitPoint(Result.Hits, HighestVector, true))
+	{
+		UpdateAgentStepCheckResult(Guid, FVector::ZeroVector, false);
+		return;
+	}
+	UpdateAgentStepCheckResult(Guid, HighestVector, true);
+}
+
+void ANAIAgentManager::OnLocalBoundsCheckTraceComplete(const FNAISimTraceResult& Result)
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_LocalBoundsCallback);
+	INC_DWORD_STAT(STAT_NAI_CallbacksReceived);
+	LLM_SCOPE_BYTAG(NAI_TraceResults);
+
+	const int HitResultCount = Result.Hits.Num();
+	
+	/**
+	 * We didn't hit anything at all... this means we're in mid-air...
+	 * Reset the result with the type's default constructor
+	 */
+	FAgent* Agent = AgentMap.Find(Result.Ticket.Guid);
+	if(!Agent)
+		return; // Removed while the held back sweep was waiting for the step
+	RecordTraceLatency(Agent->LocalBoundsCheckTask.GetMsSinceIssued());
+	
+	if(HitResultCount == 0)
+	{
+		Agent->UpdateLocalBoundsCheckResult(GetAdaptiveIntervalSettings() /* Default result */);
+		return;
+	}
+	
+	/** 
+	 * Handle Singular Hit output
+	 * We pass the only impact point as the highest vector since there are no others
+	 * This can be either the floor height, or the location of an object the agent collided with
+	 * in mid-air
+	 */
+	if(HitResultCount == 1)
+	{
+		Agent->UpdateLocalBoundsCheckResult(GetAdaptiveIntervalSettings(),
+			FAgentLocalBoundsCheckResult(true, Result.Hits.Last().Location)
+		);
+		
+		return;
+	}
+
+	/** IF we got here it means we have multiple hits. */
+
+	// Get the highest vector from the list of hits
+	FVector HighestVector = FVector::ZeroVector;
+	FNAISimResults::GetHighestHitPoint(Result.Hits, HighestVector);
+
+	// assemble a list of vectors representing the hit locations
+	// This is kept in the Agent, so it goes on the heap rather than in the FrameArena
+	TArray<FVector> HitPoints;
+	HitPoints.Reserve(HitResultCount);
+	for(int i = 0; i < HitResultCount; i++)
+	{
+		HitPoints.Add(Result.Hits[i].Location);
+	}
+	Agent->UpdateLocalBoundsCheckResult(GetAdaptiveIntervalSettings(),
+		FAgentLocalBoundsCheckResult(true, HighestVector, true, MoveTemp(HitPoints))
+	);
+
+
+#if NAI_DEBUG_DRAW
+	if(FNAIDebugDraw::ShouldDraw(ENAIDebugCategory::LocalBounds, Agent->AgentClient))
+	{
+		FNAIDebugDraw::AddPoint(WorldRef, HighestVector, FColor::Magenta);
+	}
+#endif
+}
+
+void ANAIAgentManager::AddIncomingAgents()
+{
+	check(!bIsAgentSetLocked);
+	
+	for(const FGuid& Guid : OutgoingAgents)
+	{
+		RemoveAgent(Guid);
+	}
+	OutgoingAgents.Reset();
+	
+	for(FAgent& Agent : IncomingAgents)
+	{
+		AddAgent(MoveTemp(Agent));
+	}
+	IncomingAgents.Reset();
+
+	// None of their callbacks are running now, so the records whose queries have all come back can go
+	for(const FGuid& Guid : DrainedQueryRecords)
+	{
+		const FAgentQueryRecord* Record = QueryRecords.Find(Guid);
+		if(Record && Record->bIsReleased && Record->QueriesInFlight == 0)
+		{
+			QueryRecords.Remove(Guid);
+		}
+	}
+	DrainedQueryRecords.Reset();
+}
+
+void ANAIAgentManager::HandOffAgentsOutsideShard()
+{
+	// Only shards with a region can lose Agents, everything else falls back to the world owner
+	if(bOwnsEntireWorld && FNAIAgentManagerRegistry::GetManagers(WorldRef).Num() < 2)
+		return;
+
+	TNAIFrameArray<TPair<FGuid, ANAIAgentManager*>> LeavingAgents;
+	for(const FGuid& Guid : AgentGuids)
+	{
+		const FVector Location = AgentMap[Guid].AgentClient->GetActorLocation();
+		
+		// Still inside our own region, nothing to do
+		if(!bOwnsEntireWorld && OwnsLocation(Location))
+			continue;
+		
+		ANAIAgentManager* NewOwner = FNAIAgentManagerRegistry::FindManagerForLocation(WorldRef, Location);
+		if(NewOwner && NewOwner != this)
+		{
+			LeavingAgents.Add(TPair<FGuid, ANAIAgentManager*>(Guid, NewOwner));
+		}
+	}
+
+	for(const TPair<FGuid, ANAIAgentManager*>& Leaving : LeavingAgents)
+	{
+		FAgent Agent = MoveTemp(AgentMap[Leaving.Key]);
+		RemoveAgent(Leaving.Key);
+		
+		// Groups don't cross shards, the new owner has it path on its own
+		LeaveAgentGroup(Agent);
+
+		// Any results still in flight come back through our record for it, and are thrown away
+		Leaving.Value->QueueIncomingAgent(MoveTemp(Agent));
+	}
+}
+
+bool ANAIAgentManager::IsLeadShard() const
+{
+	return FNAIAgentManagerRegistry::GetLeadManager(WorldRef) == this;
+}
+
+bool ANAIAgentManager::TakeAgent(const FGuid& Guid, FAgent& OutAgent)
+{
+	if(bIsAgentSetLocked)
+		return false;
+
+	FAgent* Agent = AgentMap.Find(Guid);
+	if(!Agent)
+		return false;
+
+	OutAgent = MoveTemp(*Agent);
+	RemoveAgent(Guid);
+	return true;
+}
+
+int32 ANAIAgentManager::SpawnAgents(
+	TSubclassOf<ANAIAgentClient> AgentClass, const int32 Count, const TArray<FVector>& Locations)
+{
+	if(bLockstep)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: SpawnAgents() isn't deterministic, use IssueLockstepCommand() in lockstep mode."), *GetName());
+		return 0;
+	}
+	
+	if(!AgentClass)
+	{
+		AgentClass = PooledAgentClass;
+	}
+	if(!AgentClass || Count <= 0 || Locations.Num() == 0)
+		return 0;
+
+	// Don't queue more than we're allowed to have
+	const int32 Available = MaxAgentCount - (AgentMap.Num() + IncomingAgents.Num() + GetPendingSpawnCount());
+	const int32 SpawnCount = FMath::Min(Count, Available);
+	if(SpawnCount <= 0)
+		return 0;
+
+	SpawnQueue.Reserve(SpawnQueue.Num() + SpawnCount);
+	for(int32 i = 0; i < SpawnCount; i++)
+	{
+		SpawnQueue.Emplace(AgentClass, FTransform(Locations[i % Locations.Num()]));
+	}
+	return SpawnCount;
+}
+
+void ANAIAgentManager::DespawnAgents(const TArray<ANAIAgentClient*>& AgentClients)
+{
+	DespawnQueue.Reserve(DespawnQueue.Num() + AgentClients.Num());
+	for(ANAIAgentClient* AgentClient : AgentClients)
+	{
+		if(AgentClient && !AgentClient->IsPooled())
+		{
+			DespawnQueue.Add(AgentClient);
+		}
+	}
+}
+
+void ANAIAgentManager::PrewarmPool()
+{
+	if(!PooledAgentClass || PoolPrewarmCount <= 0)
+		return;
+
+	// Park them on the manager, they're hidden and have no collision so it doesn't matter where
+	const FTransform PoolTransform(GetActorLocation());
+	for(int32 i = 0; i < PoolPrewarmCount; i++)
+	{
+		SpawnPooledAgent(PooledAgentClass, PoolTransform);
+	}
+}
+
+void ANAIAgentManager::SpawnPooledAgent(const TSubclassOf<ANAIAgentClient>& AgentClass, const FTransform& Transform)
+{
+	UWorld* World = GetWorld();
+	if(!World)
+		return;
+	
+	LLM_SCOPE_BYTAG(NAI_Actors);
+	ANAIAgentClient* AgentClient = World->SpawnActorDeferred<ANAIAgentClient>(
+		AgentClass, Transform, this, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if(!AgentClient)
+		return;
+
+	// Has to be set before it finishes spawning, so it doesn't register itself with a shard
+	AgentClient->SetIsPooled(true);
+	AgentClient->FinishSpawning(Transform);
+
+	FAgent Agent;
+	AgentClient->InitializeAgent(Agent);
+
+	ReleaseAgentToPool(AgentClient, MoveTemp(Agent));
+}
+
+void ANAIAgentManager::ReleaseAgentToPool(ANAIAgentClient* AgentClient, FAgent&& Agent)
+{
+	if(PooledAgentCount >= MaxPooledAgents)
+	{
+		AgentClient->Destroy();
+		return;
+	}
+
+	AgentClient->SetIsPooled(true);
+	
+	FNAIAgentClientPool& Pool = AgentPools.FindOrAdd(AgentClient->GetClass());
+	Pool.Clients.Add(AgentClient);
+	Pool.Agents.Add(MoveTemp(Agent));
+	PooledAgentCount++;
+}
+
+ANAIAgentClient* ANAIAgentManager::SpawnFromPool(const FAgentSpawnRequest& Request)
+{
+	FNAIAgentClientPool* Pool = AgentPools.Find(Request.AgentClass.Get());
+	if(!Pool)
+		return nullptr;
+	
+	for(int32 PoolIndex = Pool->Clients.Num() - 1; PoolIndex >= 0; PoolIndex--)
+	{
+		ANAIAgentClient* AgentClient = Pool->Clients[PoolIndex];
+		
+		// Its late results would land on the new spawn, so it waits until they're all back
+		if(IsValid(AgentClient) && HasQueriesInFlight(Pool->Agents[PoolIndex].Guid))
+			continue;
+		
+		FAgent Agent = MoveTemp(Pool->Agents[PoolIndex]);
+		Pool->Clients.RemoveAtSwap(PoolIndex, 1, false);
+		Pool->Agents.RemoveAtSwap(PoolIndex, 1, false);
+		PooledAgentCount--;
+
+		// Something else destroyed it while it was in the pool
+		if(!IsValid(AgentClient))
+			continue;
+
+		const FVector Location = Request.Transform.GetLocation();
+		AgentClient->SetActorLocationAndRotation(
+			Location, Request.Transform.GetRotation(), false, nullptr, ETeleportType::TeleportPhysics);
+		AgentClient->SetIsPooled(false);
+
+		// The Agent keeps its Guid, but nothing it sent before it was despawned is still out
+		Agent.ResetForReuse(Location);
+
+		// The spawn location may belong to another shard
+		ANAIAgentManager* Owner = FNAIAgentManagerRegistry::FindManagerForLocation(WorldRef, Location);
+		if(!Owner)
+		{
+			Owner = this;
+		}
+		Owner->AddAgent(MoveTemp(Agent));
+		return AgentClient;
+	}
+	return nullptr;
+}
+
+void ANAIAgentManager::ProcessSpawnQueue()
+{
+	if(!WorldRef)
+		return;
+
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_ProcessSpawnQueue);
+	
+	// Despawns are cheap, so they're all done straight away
+	for(ANAIAgentClient* AgentClient : DespawnQueue)
+	{
+		if(!IsValid(AgentClient) || AgentClient->IsPooled())
+			continue;
+
+		FAgent Agent;
+		for(ANAIAgentManager* Shard : FNAIAgentManagerRegistry::GetManagers(WorldRef))
+		{
+			if(Shard->TakeAgent(AgentClient->GetGuid(), Agent))
+			{
+				ReleaseAgentToPool(AgentClient, MoveTemp(Agent));
+				break;
+			}
+		}
+	}
+	DespawnQueue.Reset();
+
+	if(SpawnQueueHead >= SpawnQueue.Num())
+		return;
+	
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	int32 SpawnCount = 0;
+	while(SpawnQueueHead < SpawnQueue.Num() && SpawnCount < MaxSpawnsPerFrame)
+	{
+		// Always do at least one, so the queue can't stall on a tiny budget
+		if(SpawnCount > 0 &&
+			FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) > SpawnBudgetMs)
+			break;
+		
+		const FAgentSpawnRequest& Request = SpawnQueue[SpawnQueueHead++];
+		SpawnCount++;
+		
+		if(SpawnFromPool(Request))
+			continue;
+
+		// The pool is empty, so fall back to a regular spawn. The client registers itself in BeginPlay
+		LLM_SCOPE_BYTAG(NAI_Actors);
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		WorldRef->SpawnActor<ANAIAgentClient>(Request.AgentClass, Request.Transform, SpawnParameters);
+	}
+
+	if(SpawnQueueHead >= SpawnQueue.Num())
+	{
+		SpawnQueue.Reset();
+		SpawnQueueHead = 0;
+	}
+}
+
+void ANAIAgentManager::UpdateReplication(const float DeltaTime)
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_Replication);
+	LLM_SCOPE_BYTAG(NAI);
+
+	// Work out what the last second of replication cost
+	ReplicationStatsTime += DeltaTime;
+	for(const TPair<FIntPoint, ANAIAgentReplicationProxy*>& Pair : ReplicationProxies)
+	{
+		if(IsValid(Pair.Value))
+		{
+			ReplicationBitsSent += Pair.Value->ConsumeBitsSent();
+		}
+	}
+	if(ReplicationStatsTime >= 1.0f)
+	{
+		const UNetDriver* NetDriver = WorldRef->GetNetDriver();
+		ReplicationStats.ReplicatedAgentCount = ReplicatedAgents.Num();
+		ReplicationStats.ProxyCount = ReplicationProxies.Num();
+		ReplicationStats.ConnectionCount = NetDriver ? NetDriver->ClientConnections.Num() : 0;
+		ReplicationStats.BytesPerSecond = (ReplicationBitsSent / 8.0f) / ReplicationStatsTime;
+		ReplicationStats.BytesPerAgentPerSecond = ReplicationStats.BytesPerSecond /
+			(FMath::Max(ReplicationStats.ReplicatedAgentCount, 1) * FMath::Max(ReplicationStats.ConnectionCount, 1));
+		ReplicationBitsSent = 0;
+		ReplicationStatsTime = 0.0f;
+	}
+	INC_DWORD_STAT_BY(STAT_NAI_ReplicatedAgents, ReplicatedAgents.Num());
+	INC_DWORD_STAT_BY(STAT_NAI_ReplicationBytesPerSecond, (uint32)ReplicationStats.BytesPerSecond);
+
+	// Nothing is sent faster than the nearest cells update, so there's no point gathering faster either
+	ReplicationUpdateTime += DeltaTime;
+	if(ReplicationUpdateTime < 1.0f / NearUpdateRate)
+		return;
+	ReplicationUpdateTime = 0.0f;
+	ReplicationUpdateCount++;
+
+	// Dormant Agents don't move, so SetAgent() won't mark them dirty, but they still have to be seen to stay replicated
+	for(const TArray<FGuid>* Guids : { &AgentGuids, &DormantAgentGuids })
+	{
+		for(const FGuid& Guid : *Guids)
+		{
+			FAgent* Agent = AgentMap.Find(Guid);
+			if(!Agent || !IsValid(Agent->AgentClient))
+				continue;
+
+			// The NetId travels with the Agent, so a hand off between shards looks like a move between cells
+			if(Agent->NetId == 0)
+			{
+				Agent->NetId = ANAIAgentReplicationProxy::AllocateNetId();
+			}
+
+			const FVector Location = Agent->AgentClient->GetActorLocation();
+			const FIntPoint Cell = GetReplicationCell(Location);
+
+			FNAIReplicatedAgentRecord* Record = ReplicatedAgents.Find(Guid);
+			if(Record && Record->Cell != Cell)
+			{
+				if(ANAIAgentReplicationProxy* OldProxy = ReplicationProxies.FindRef(Record->Cell))
+				{
+					OldProxy->RemoveAgent(Record->NetId);
+				}
+			}
+			if(!Record)
+			{
+				Record = &ReplicatedAgents.Add(Guid);
+			}
+			Record->Cell = Cell;
+			Record->NetId = Agent->NetId;
+			Record->LastUpdate = ReplicationUpdateCount;
+
+			FindOrSpawnReplicationProxy(Cell)->SetAgent(
+				Agent->NetId, Agent->AgentClient->GetClass(), Location, Agent->AgentClient->GetActorRotation().Yaw);
+		}
+	}
+
+	// Anything we didn't see has been despawned, destroyed or handed off
+	for(auto It = ReplicatedAgents.CreateIterator(); It; ++It)
+	{
+		if(It.Value().LastUpdate == ReplicationUpdateCount)
+			continue;
+
+		if(ANAIAgentReplicationProxy* Proxy = ReplicationProxies.FindRef(It.Value().Cell))
+		{
+			Proxy->RemoveAgent(It.Value().NetId);
+		}
+		It.RemoveCurrent();
+	}
+
+	// Update the cells near a player more often than the ones far from all of them
+	TArray<FVector, TInlineAllocator<8>> ViewLocations;
+	for(FConstPlayerControllerIterator It = WorldRef->GetPlayerControllerIterator(); It; ++It)
+	{
+		if(const APlayerController* PlayerController = It->Get())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			ViewLocations.Add(ViewLocation);
+		}
+	}
+
+	const float NearDistanceSquared = FMath::Square(ReplicationNearDistance);
+	const float FarDistanceSquared = FMath::Square(ReplicationFarDistance);
+	for(auto It = ReplicationProxies.CreateIterator(); It; ++It)
+	{
+		ANAIAgentReplicationProxy* Proxy = It.Value();
+		if(!IsValid(Proxy) || Proxy->GetAgentCount() == 0)
+		{
+			if(IsValid(Proxy))
+			{
+				Proxy->Destroy();
+			}
+			It.RemoveCurrent();
+			continue;
+		}
+
+		float ClosestSquared = MAX_flt;
+		for(const FVector& ViewLocation : ViewLocations)
+		{
+			ClosestSquared = FMath::Min(ClosestSquared, FVector::DistSquared2D(ViewLocation, Proxy->GetActorLocation()));
+		}
+
+		if(ClosestSquared < NearDistanceSquared)
+		{
+			Proxy->NetUpdateFrequency = NearUpdateRate;
+		}
+		else if(ClosestSquared < FarDistanceSquared)
+		{
+			Proxy->NetUpdateFrequency = MidUpdateRate;
+		}
+		else
+		{
+			Proxy->NetUpdateFrequency = FarUpdateRate;
+		}
+		Proxy->MinNetUpdateFrequency = FMath::Min(Proxy->NetUpdateFrequency, FarUpdateRate);
+	}
+}
+
+ANAIAgentReplicationProxy* ANAIAgentManager::FindOrSpawnReplicationProxy(const FIntPoint& Cell)
+{
+	if(ANAIAgentReplicationProxy* Proxy = ReplicationProxies.FindRef(Cell))
+	{
+		if(IsValid(Proxy))
+			return Proxy;
+	}
+
+	// The proxy sits in the middle of its cell, so the engine's distance based relevancy and priority work for it
+	const FVector CellCenter(
+		(Cell.X + 0.5f) * ReplicationCellSize, (Cell.Y + 0.5f) * ReplicationCellSize, GetActorLocation().Z);
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	ANAIAgentReplicationProxy* Proxy = WorldRef->SpawnActor<ANAIAgentReplicationProxy>(
+		ANAIAgentReplicationProxy::StaticClass(), FTransform(CellCenter), SpawnParameters);
+	check(Proxy);
+
+	// The Agents can be anywhere in the cell, so it stays relevant for half a cell diagonal further out
+	Proxy->Setup(ReplicationRelevancyDistance + (ReplicationCellSize * 0.71f), ReplicationNearDistance, ReplicationFarDistance);
+	ReplicationProxies.Add(Cell, Proxy);
+	return Proxy;
+}
+
+void ANAIAgentManager::ReceiveReplicatedAgent(const ANAIAgentReplicationProxy* Proxy, const uint32 NetId,
+	UClass* AgentClass, const FVector& Location, const float Yaw)
+{
+	const UWorld* World = GetWorld();
+	if(!World || !Proxy)
+		return;
+
+	FNAIReplicatedAgentView& View = ReplicatedViews.FindOrAdd(NetId);
+	View.RemoveTime = -1.0;
+	View.OwnerProxy = Proxy;
+	View.Snapshots.Add(Proxy->GetServerTime(), Location, Yaw);
+
+	if(!View.AgentClient.IsValid())
+	{
+		View.AgentClient = AcquireReplicatedClient(AgentClass ? AgentClass : PooledAgentClass.Get(), Location, Yaw);
+	}
+}
+
+void ANAIAgentManager::ReceiveReplicatedAgentRemoval(const ANAIAgentReplicationProxy* Proxy, const uint32 NetId)
+{
+	const UWorld* World = GetWorld();
+	FNAIReplicatedAgentView* View = ReplicatedViews.Find(NetId);
+	if(!World || !View)
+		return;
+
+	// A late removal from the cell it left, it's already being replicated through another one
+	if(View->OwnerProxy.Get(true) != Proxy)
+		return;
+
+	// Give it a moment to turn up in its new cell before it's hidden
+	View->RemoveTime = World->GetTimeSeconds() + FMath::Max(ClientInterpolationDelay * 2.0f, 0.5f);
+}
+
+void ANAIAgentManager::TickReplicatedClient(const float DeltaTime)
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_Replication);
+	LLM_SCOPE_BYTAG(NAI);
+
+	const UWorld* World = GetWorld();
+	if(!World)
+		return;
+
+	// The states are stamped with the server's time, so they're drawn against our estimate of it
+	const double Now = World->GetTimeSeconds();
+	const AGameStateBase* GameState = World->GetGameState();
+	const double ServerNow = GameState ? GameState->GetServerWorldTimeSeconds() : Now;
+	for(auto It = ReplicatedViews.CreateIterator(); It; ++It)
+	{
+		FNAIReplicatedAgentView& View = It.Value();
+		ANAIAgentClient* AgentClient = View.AgentClient.Get();
+		if(View.RemoveTime >= 0.0 && Now >= View.RemoveTime)
+		{
+			if(AgentClient)
+			{
+				ReleaseReplicatedClient(AgentClient);
+			}
+			It.RemoveCurrent();
+			continue;
+		}
+		if(!AgentClient)
+			continue;
+
+		// Slower cells need a longer delay to always have a state either side of the time being drawn
+		const float Delay = FMath::Clamp(View.Snapshots.GetLatestInterval() * 1.5f, ClientInterpolationDelay, 1.0f);
+		FVector Location;
+		float Yaw;
+		if(!View.Snapshots.Sample(ServerNow - Delay, Location, Yaw))
+			continue;
+
+		// Keep Speed and Velocity up to date for the animation blueprints
+		if(DeltaTime > KINDA_SMALL_NUMBER)
+		{
+			AgentClient->Velocity = (Location - AgentClient->GetActorLocation()) / DeltaTime;
+			AgentClient->Speed = AgentClient->Velocity.Size2D();
+		}
+		AgentClient->SetActorLocationAndRotation(Location, FRotator(0.0f, Yaw, 0.0f));
+	}
+	INC_DWORD_STAT_BY(STAT_NAI_ReplicatedAgents, ReplicatedViews.Num());
+
+	if(bBudgetAnimation && IsLeadShard())
+	{
+		UpdateAnimationBudget(DeltaTime);
+	}
+}
+
+ANAIAgentClient* ANAIAgentManager::AcquireReplicatedClient(UClass* AgentClass, const FVector& Location, const float Yaw)
+{
+	UWorld* World = GetWorld();
+	if(!World || !AgentClass)
+		return nullptr;
+
+	const FTransform Transform(FRotator(0.0f, Yaw, 0.0f), Location);
+	if(FNAIAgentClientPool* Pool = ReplicatedClientPools.Find(AgentClass))
+	{
+		while(Pool->Clients.Num() > 0)
+		{
+			ANAIAgentClient* AgentClient = Pool->Clients.Pop(false);
+			if(!IsValid(AgentClient))
+				continue;
+
+			AgentClient->SetActorTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+			AgentClient->SetIsPooled(false);
+			return AgentClient;
+		}
+	}
+
+	LLM_SCOPE_BYTAG(NAI_Actors);
+	ANAIAgentClient* AgentClient = World->SpawnActorDeferred<ANAIAgentClient>(
+		AgentClass, Transform, this, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if(!AgentClient)
+		return nullptr;
+
+	// Spawn it as pooled, so it doesn't register itself with a shard and get simulated
+	AgentClient->SetIsPooled(true);
+	AgentClient->FinishSpawning(Transform);
+	AgentClient->SetIsPooled(false);
+	return AgentClient;
+}
+
+void ANAIAgentManager::ReleaseReplicatedClient(ANAIAgentClient* AgentClient)
+{
+	AgentClient->SetIsPooled(true);
+	ReplicatedClientPools.FindOrAdd(AgentClient->GetClass()).Clients.Add(AgentClient);
+}
+
+static int32 GNAILockstepLogChecksums = 0;
+static FAutoConsoleVariableRef CVarNAILockstepLogChecksums(
+	TEXT("NAI.Lockstep.LogChecksums"), GNAILockstepLogChecksums,
+	TEXT("Log the checksum of every lockstep step, so the logs of two processes can be diffed to find where they desynced."));
+
+FNAILockstepCommand ANAIAgentManager::IssueLockstepCommand(FNAILockstepCommand Command)
+{
+	check(IsInGameThread());
+
+	Command.Step = LockstepStep + LockstepInputDelay;
+	Command.PeerId = LockstepPeerId;
+	Command.Sequence = LockstepSequence++;
+	if(Command.Type == ENAILockstepCommandType::Spawn)
+	{
+		// Unique across peers without them having to agree on anything, the top byte is the peer
+		Command.NetId = (int32)(((uint32)(LockstepPeerId & 0xFF) << 24) | (uint32)(++LockstepSpawnCount & 0xFFFFFF));
+	}
+
+	LockstepCommands.Add(Command);
+	OnLockstepCommandIssued.Broadcast(Command);
+	return Command;
+}
+
+void ANAIAgentManager::ReceiveLockstepCommand(const FNAILockstepCommand& Command)
+{
+	check(IsInGameThread());
+
+	// Running it now would run it on a different step to everyone else, so the peers have to resync instead
+	if(Command.Step < LockstepStep)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s: Lockstep command from peer %d arrived for step %d, but we're already on step %d. Dropped it, the peers need to resync."),
+			*GetName(), Command.PeerId, Command.Step, LockstepStep);
+		OnLockstepDesync.Broadcast(Command.Step, 0);
+		return;
+	}
+	LockstepCommands.Add(Command);
+}
+
+void ANAIAgentManager::ConfirmLockstepStep(const int32 Step)
+{
+	LockstepConfirmedStep = FMath::Max(LockstepConfirmedStep, Step);
+}
+
+bool ANAIAgentManager::GetLockstepChecksum(const int32 Step, int32& OutChecksum) const
+{
+	if(Step < 0 || Step >= LockstepStep || Step <= LockstepStep - NAI_LOCKSTEP_CHECKSUM_HISTORY)
+		return false;
+
+	OutChecksum = (int32)LockstepChecksums[Step % NAI_LOCKSTEP_CHECKSUM_HISTORY];
+	return true;
+}
+
+bool ANAIAgentManager::CompareLockstepChecksum(const int32 Step, const int32 RemoteChecksum)
+{
+	int32 LocalChecksum;
+	if(!GetLockstepChecksum(Step, LocalChecksum) || LocalChecksum == RemoteChecksum)
+		return true;
+
+	UE_LOG(LogTemp, Error, TEXT("%s: Lockstep desync on step %d, our checksum is %08X and theirs is %08X"),
+		*GetName(), Step, (uint32)LocalChecksum, (uint32)RemoteChecksum);
+	OnLockstepDesync.Broadcast(Step, RemoteChecksum);
+	return false;
+}
+
+bool ANAIAgentManager::BeginLockstepStep(const float DeltaTime)
+{
+	const float StepTime = 1.0f / LockstepTickRate;
+
+	// Never bank more than a few steps, a long hitch shouldn't turn into a long fast forward
+	LockstepAccumulator = FMath::Min(LockstepAccumulator + DeltaTime, StepTime * 4.0f);
+	if(LockstepAccumulator < StepTime)
+		return false;
+
+	// The last step's results all have to be in before they can be applied in order
+	if(LockstepQueriesInFlight > 0)
+		return false;
+
+	if(bLockstepWaitForConfirmation && LockstepConfirmedStep < LockstepStep)
+		return false;
+
+	LockstepAccumulator -= StepTime;
+	bIsLockstepStepping = true;
+
+	ApplyLockstepResults();
+	ExecuteLockstepCommands();
+	return true;
+}
+
+void ANAIAgentManager::ExecuteLockstepCommands()
+{
+	if(LockstepCommands.Num() == 0)
+		return;
+
+	LockstepCommands.Sort();
+
+	int32 CommandCount = 0;
+	while(CommandCount < LockstepCommands.Num() && LockstepCommands[CommandCount].Step <= LockstepStep)
+	{
+		const FNAILockstepCommand& Command = LockstepCommands[CommandCount++];
+		switch(Command.Type)
+		{
+			case ENAILockstepCommandType::Spawn:
+			{
+				const TSubclassOf<ANAIAgentClient> AgentClass = Command.AgentClass ? Command.AgentClass : PooledAgentClass;
+				if(!AgentClass)
+					break;
+
+				// Spawned straight away rather than through the spawn queue, that depends on how long the spawns take
+				const FAgentSpawnRequest Request(AgentClass, FTransform(FRotator(0.0f, Command.Yaw, 0.0f), Command.Location));
+				ANAIAgentClient* AgentClient = SpawnFromPool(Request);
+				if(!AgentClient)
+				{
+					LLM_SCOPE_BYTAG(NAI_Actors);
+					FActorSpawnParameters SpawnParameters;
+					SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+					AgentClient = WorldRef->SpawnActor<ANAIAgentClient>(AgentClass, Request.Transform, SpawnParameters);
+				}
+				if(!AgentClient)
+					break;
+
+				for(ANAIAgentManager* Shard : FNAIAgentManagerRegistry::GetManagers(WorldRef))
+				{
+					if(FAgent* Agent = Shard->AgentMap.Find(AgentClient->GetGuid()))
+					{
+						Agent->NetId = (uint32)Command.NetId;
+						break;
+					}
+				}
+				break;
+			}
+			case ENAILockstepCommandType::Despawn:
+			{
+				for(const FGuid& Guid : AgentGuids)
+				{
+					FAgent* Agent = AgentMap.Find(Guid);
+					if(Agent && Agent->NetId == (uint32)Command.NetId)
+					{
+						ANAIAgentClient* AgentClient = Agent->AgentClient;
+						FAgent TakenAgent;
+						if(IsValid(AgentClient) && TakeAgent(Guid, TakenAgent))
+						{
+							ReleaseAgentToPool(AgentClient, MoveTemp(TakenAgent));
+						}
+						break;
+					}
+				}
+				break;
+			}
+			case ENAILockstepCommandType::SetGoal:
+				CrowdGoalLocation = Command.Location;
+				bHasCrowdGoal = true;
+				break;
+			default:
+				break;
+		}
+	}
+	LockstepCommands.RemoveAt(0, CommandCount, false);
+}
+
+void ANAIAgentManager::ApplyLockstepResults()
+{
+	if(LockstepResults.Num() == 0)
+		return;
+
+	// Agent order, then task, then where the trace started for the avoidance grid cells
+	TMap<FGuid, int32>& AgentIndices = LockstepAgentIndices;
+	AgentIndices.Reset();
+	AgentIndices.Reserve(AgentGuids.Num());
+	for(int32 i = 0; i < AgentGuids.Num(); i++)
+	{
+		AgentIndices.Add(AgentGuids[i], i);
+	}
+	LockstepResults.Sort([&AgentIndices](const FNAILockstepDeferredResult& A, const FNAILockstepDeferredResult& B)
+	{
+		// Agents that have gone since go last, their results are thrown away anyway
+		const int32* IndexA = AgentIndices.Find(A.Guid);
+		const int32* IndexB = AgentIndices.Find(B.Guid);
+		const int32 OrderA = IndexA ? *IndexA : MAX_int32;
+		const int32 OrderB = IndexB ? *IndexB : MAX_int32;
+		if(OrderA != OrderB)
+			return OrderA < OrderB;
+		if(A.Type != B.Type)
+			return A.Type < B.Type;
+		if(A.Direction != B.Direction)
+			return A.Direction < B.Direction;
+		if(A.Start.X != B.Start.X)
+			return A.Start.X < B.Start.X;
+		if(A.Start.Y != B.Start.Y)
+			return A.Start.Y < B.Start.Y;
+		return A.Start.Z < B.Start.Z;
+	});
+
+	bIsApplyingLockstepResults = true;
+	for(const FNAILockstepDeferredResult& Deferred : LockstepResults)
+	{
+		if(Deferred.Type == ENAILockstepResultType::Path)
+		{
+			OnAsyncPathComplete(Deferred.Guid, Deferred.bPathSucceeded, Deferred.PathPoints);
+			continue;
+		}
+
+		FNAISimTraceResult Result;
+		Result.Ticket = FNAISimQueryTicket(Deferred.Guid, (uint8)Deferred.Type, Deferred.Direction);
+		Result.Start = Deferred.Start;
+		Result.End = Deferred.End;
+		Result.Hits = Deferred.Hits;
+		DispatchTraceResult(Result);
+	}
+	bIsApplyingLockstepResults = false;
+	LockstepResults.Reset();
+}
+
+FNAILockstepDeferredResult& ANAIAgentManager::DeferLockstepResult(const ENAILockstepResultType Type, const FGuid& Guid)
+{
+	// Only what's still counted comes off, the count for an Agent that left was taken off when it did
+	FAgentQueryRecord* Record = QueryRecords.Find(Guid);
+	if(Record && Record->LockstepQueriesInFlight > 0)
+	{
+		Record->LockstepQueriesInFlight--;
+		LockstepQueriesInFlight = FMath::Max(LockstepQueriesInFlight - 1, 0);
+	}
+
+	FNAILockstepDeferredResult& Deferred = LockstepResults.AddDefaulted_GetRef();
+	Deferred.Type = Type;
+	Deferred.Guid = Guid;
+	return Deferred;
+}
+
+void ANAIAgentManager::EndLockstepStep()
+{
+	// The Guids are random per peer, so the NetId stands in for the Agent
+	uint32 Checksum = FCrc::MemCrc32(&LockstepStep, sizeof(LockstepStep));
+	for(const FGuid& Guid : AgentGuids)
+	{
+		const FAgent* Agent = AgentMap.Find(Guid);
+		if(!Agent || !IsValid(Agent->AgentClient))
+			continue;
+
+		const FVector Location = Agent->AgentClient->GetActorLocation();
+		const FQuat Rotation = Agent->AgentClient->GetActorQuat();
+		Checksum = FCrc::MemCrc32(&Agent->NetId, sizeof(Agent->NetId), Checksum);
+		Checksum = FCrc::MemCrc32(&Location, sizeof(Location), Checksum);
+		Checksum = FCrc::MemCrc32(&Rotation, sizeof(Rotation), Checksum);
+	}
+	LockstepChecksums[LockstepStep % NAI_LOCKSTEP_CHECKSUM_HISTORY] = Checksum;
+
+	if(GNAILockstepLogChecksums)
+	{
+		UE_LOG(LogTemp, Display, TEXT("NAI.Lockstep: %s Step %d Agents %d Checksum %08X"),
+			*GetName(), LockstepStep, AgentGuids.Num(), Checksum);
+	}
+	OnLockstepChecksum.Broadcast(LockstepStep, (int32)Checksum);
+
+	LockstepStep++;
+	bIsLockstepStepping = false;
+}
+
+#if NAI_DEBUG_DRAW
+bool ANAIAgentManager::ShouldDebugDraw(const ENAIDebugCategory Category, const FGuid& Guid) const
+{
+	if(!FNAIDebugDraw::IsCategoryEnabled(Category))
+		return false;
+
+	const FAgent* Agent = AgentMap.Find(Guid);
+	return Agent && FNAIDebugDraw::PassesFilters(Agent->AgentClient);
+}
+#endif
+
+bool ANAIAgentManager::AgentPathTaskAsync(const FVector& Start, const FVector& Goal,
+	const FNavAgentProperties& NavAgentProperties, const FGuid& Guid) const
+{
+	return WorldQuery->FindPathAsync(Start, Goal, NavAgentProperties.AgentRadius, NavAgentProperties.AgentHeight,
+		FNAISimQueryTicket(Guid, (uint8)ENAILockstepResultType::Path));
+}
+
+void ANAIAgentManager::AgentAvoidanceTraceTaskAsync(
+	const EAgentAvoidanceTraceDirection& TraceDirection,
+	const FVector& AgentLocation, const FVector& Forward, const FVector& Right,
+	const FAgentProperties& AgentProperties, const FGuid& Guid) const
+{
+	const FAgentAvoidanceProperties& AvoidanceProperties = AgentProperties.AvoidanceProperties;
+	const uint8 DirectionIndex = (uint8)TraceDirection;
+	const uint8 CellCount = AvoidanceProperties.GridCellCounts[DirectionIndex];
+	const FVector* GridOffsets = AvoidanceProperties.GridOffsets[DirectionIndex];
+
+	/**
+	 * The grid was baked into local space when the archetype was built (see FAgentAvoidanceProperties),
+	 * so all that's left is to transform it by the Agent's basis. The height is in world space, the Agents
+	 * never pitch or roll. This is done for the whole grid before any traces are issued, so the loop
+	 * has nothing in it to branch on.
+	 */
+	FVector StartPoints[FAgentAvoidanceProperties::MaxGridCells];
+	for(uint8 Cell = 0; Cell < CellCount; Cell++)
+	{
+		const FVector& Offset = GridOffsets[Cell];
+		StartPoints[Cell] = AgentLocation + (Forward * Offset.X) + (Right * Offset.Y) + FVector(0.0f, 0.0f, Offset.Z);
+	}
+
+	const FVector& LocalTraceDelta = AvoidanceProperties.GridTraceDeltas[DirectionIndex];
+	const FVector TraceDelta = (Forward * LocalTraceDelta.X) + (Right * LocalTraceDelta.Y);
+	
+	/**
+	 * Without physics bodies the Agents are left out of the scene, and find each other in the hash instead.
+	 * The traces look for everything else in the way then, the walls and props as well as the players and proxies.
+	 */
+	const ENAISimQueryFilter Filter = bPhysicsFreeAgents ? ENAISimQueryFilter::All : ENAISimQueryFilter::Pawns;
+	const FNAISimQueryTicket Ticket(Guid, (uint8)ENAILockstepResultType::Avoidance, DirectionIndex);
+	
+	for(uint8 Cell = 0; Cell < CellCount; Cell++)
+	{
+		WorldQuery->RaycastAsync(StartPoints[Cell], StartPoints[Cell] + TraceDelta, Filter, false, Ticket);
+	}
+}
+
+FVector ANAIAgentManager::GetAgentGoalLocationFromType(const EAgentType& AgentType, const FVector& PlayerLocation) const
+{
+	switch(AgentType)
+	{
+		case EAgentType::PathToPlayer:
+			return PlayerLocation;
+		case EAgentType::PathToLocation:
+			return NULL_VECTOR;
+		case EAgentType::Static:
+			return NULL_VECTOR;
+		case EAgentType::Dynamic:
+			return NULL_VECTOR;
+		case EAgentType::FollowCustomPath:
+			return NULL_VECTOR;
+	}
+	// We only get here if the AgentType was null 
+	return NULL_VECTOR;
+}
+
+#undef NULL_VECTOR
+
+void ANAIAgentManager::Initialize()
+{
+	if(WorldRef == nullptr)
+		WorldRef = GetWorld();
+	if(WorldRef)
+	{
+		if(NavSysRef == nullptr)
+		{
+			NavSysRef = UNavigationSystemV1::GetCurrent(WorldRef);
+			if(NavDataRef == nullptr && NavSysRef)
+			{
+				NavDataRef = NavSysRef->MainNavData;
+				if(NavQueryRef == nullptr && NavDataRef)
+				{
+					NavQueryRef.operator=(UNavigationQueryFilter::GetQueryFilter<UNavigationQueryFilter>(*NavDataRef));
+				}
+			}	
+		}
+
+		if(!WorldQuery.IsValid())
+		{
+			WorldQuery = FNAIWorldQueryAdapter::Create(WorldRef);
+			WorldQuery->SetListener(this);
+		}
+		WorldQuery->SetNavigation(NavSysRef, NavDataRef);
+	}
+}
+
+void ANAIAgentManager::UpdateAnimationBudget(const float DeltaTime)
+{
+	AnimationLODTime += DeltaTime;
+	if(AnimationLODTime < AnimationLODUpdateInterval || !WorldRef)
+		return;
+	AnimationLODTime = 0.0f;
+
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_AnimationBudget);
+	LLM_SCOPE_BYTAG(NAI);
+
+	// Only what's drawn here matters, so only the local players are looked at
+	TArray<FVector, TInlineAllocator<4>> ViewLocations;
+	for(FConstPlayerControllerIterator It = WorldRef->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if(PlayerController && PlayerController->IsLocalController())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			ViewLocations.Add(ViewLocation);
+		}
+	}
+	if(ViewLocations.Num() == 0)
+		return;
+
+	auto AddCandidate = [this, &ViewLocations](ANAIAgentClient* AgentClient, ANAIAgentManager* Shard)
+	{
+		if(!IsValid(AgentClient) || AgentClient->IsPooled() || !AgentClient->GetSkeletalMeshComponent())
+			return;
+
+		const FVector Location = AgentClient->GetActorLocation();
+		float DistanceSquared = MAX_flt;
+		for(const FVector& ViewLocation : ViewLocations)
+		{
+			DistanceSquared = FMath::Min(DistanceSquared, FVector::DistSquared(ViewLocation, Location));
+		}
+		AnimationCandidates.Emplace(DistanceSquared, AgentClient, Shard);
+	};
+
+	// Every shard's AgentClients share the one budget, nearest first wherever they're simulated
+	AnimationCandidates.Reset();
+	for(ANAIAgentManager* Shard : FNAIAgentManagerRegistry::GetManagers(WorldRef))
+	{
+		FMemory::Memzero(Shard->AnimationLODCounts);
+		if(Shard->IsReplicatedClient())
+		{
+			for(const TPair<uint32, FNAIReplicatedAgentView>& Pair : Shard->ReplicatedViews)
+			{
+				AddCandidate(Pair.Value.AgentClient.Get(), Shard);
+			}
+		}
+		else
+		{
+			for(const TPair<FGuid, FAgent>& Pair : Shard->AgentMap)
+			{
+				AddCandidate(Pair.Value.AgentClient, Shard);
+			}
+		}
+	}
+	AnimationCandidates.Sort([](const FAgentAnimationCandidate& A, const FAgentAnimationCandidate& B)
+	{
+		return A.DistanceSquared < B.DistanceSquared;
+	});
+
+	/**
+	 * The budget is in full updates per frame, a Reduced Agent only costs the fraction of frames it updates on.
+	 * The pose leaders always update, so they come out of the budget first, and the ones made for a new mesh
+	 * below are taken out as soon as they're made.
+	 */
+	float Budget = (float)(MaxAnimationUpdatesPerFrame - SharedPoseLeaders.Num());
+	const float ReducedTickInterval = 1.0f / ReducedAnimationRate;
+	const float ReducedCost = FMath::Min(ReducedAnimationRate * DeltaTime, 1.0f);
+	const float FullDistanceSquared = FMath::Square(FullAnimationDistance);
+	const float ReducedDistanceSquared = FMath::Square(ReducedAnimationDistance);
+
+	for(const FAgentAnimationCandidate& Candidate : AnimationCandidates)
+	{
+		ANAIAgentClient* AgentClient = Candidate.AgentClient;
+		EAgentAnimationLOD AnimationLOD = EAgentAnimationLOD::Shared;
+		if(Candidate.DistanceSquared < FullDistanceSquared && Budget >= 1.0f)
+		{
+			AnimationLOD = EAgentAnimationLOD::Full;
+			Budget -= 1.0f;
+		}
+		else if(Candidate.DistanceSquared < ReducedDistanceSquared && Budget >= ReducedCost)
+		{
+			AnimationLOD = EAgentAnimationLOD::Reduced;
+			Budget -= ReducedCost;
+		}
+
+		USkeletalMeshComponent* PoseLeader = nullptr;
+		if(AnimationLOD == EAgentAnimationLOD::Shared)
+		{
+			const int32 LeaderCount = SharedPoseLeaders.Num();
+			PoseLeader = GetSharedPoseLeader(AgentClient);
+			Budget -= (float)(SharedPoseLeaders.Num() - LeaderCount);
+		}
+		AgentClient->SetAnimationLOD(AnimationLOD, ReducedTickInterval, PoseLeader);
+		Candidate.Shard->AnimationLODCounts[(uint8)AgentClient->GetAnimationLOD()]++;
+	}
+}
+
+USkeletalMeshComponent* ANAIAgentManager::GetSharedPoseLeader(ANAIAgentClient* AgentClient)
+{
+	if(SharedPoseLeaderCount <= 0)
+		return nullptr;
+
+	const USkeletalMeshComponent* AgentMesh = AgentClient->GetSkeletalMeshComponent();
+	USkeletalMesh* SkeletalMesh = AgentMesh->SkeletalMesh;
+	if(!SkeletalMesh)
+		return nullptr;
+
+	int32 Start;
+	if(const int32* ExistingStart = SharedPoseLeaderStarts.Find(SkeletalMesh))
+	{
+		Start = *ExistingStart;
+	}
+	else
+	{
+		LLM_SCOPE_BYTAG(NAI_Actors);
+		UAnimationAsset* Animation = SharedPoseAnimations.FindRef(SkeletalMesh);
+		const float AnimationLength = Animation ? Animation->GetPlayLength() : 0.0f;
+
+		Start = SharedPoseLeaders.Num();
+		for(int32 i = 0; i < SharedPoseLeaderCount; i++)
+		{
+			USkeletalMeshComponent* Leader = NewObject<USkeletalMeshComponent>(this);
+			Leader->SetSkeletalMesh(SkeletalMesh);
+			Leader->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			Leader->SetHiddenInGame(true);
+			// Hidden, so it has to be told to keep animating for the Agents copying it
+			Leader->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones;
+			Leader->RegisterComponent();
+			if(Animation)
+			{
+				Leader->PlayAnimation(Animation, true);
+				Leader->SetPosition(AnimationLength * i / SharedPoseLeaderCount, false);
+			}
+			else
+			{
+				Leader->SetAnimInstanceClass(AgentMesh->AnimClass);
+			}
+			SharedPoseLeaders.Add(Leader);
+		}
+		SharedPoseLeaderStarts.Add(SkeletalMesh, Start);
+	}
+
+	// Each AgentClient sticks to the same leader, so it doesn't jump between poses as the LODs are picked again
+	const int32 Index = Start + (int32)(PointerHash(AgentClient) % (uint32)SharedPoseLeaderCount);
+	return SharedPoseLeaders.IsValidIndex(Index) ? SharedPoseLeaders[Index] : nullptr;
+}
+
+void ANAIAgentManager::UpdateDensityQueryFilter(const float DeltaTime)
+{
+#if WITH_RECAST
+	DensityPathTime += DeltaTime;
+	if(DensityPathTime < DensityPathUpdateInterval)
+		return;
+	DensityPathTime = 0.0f;
+
+	if(DensityPathCost <= 0.0f || !NavQueryRef.IsValid() || !Cast<ARecastNavMesh>(NavDataRef))
+	{
+		DensityQueryFilter = nullptr;
+		return;
+	}
+
+	const FRecastQueryFilter* SourceFilter = static_cast<const FRecastQueryFilter*>(NavQueryRef->GetImplementation());
+	if(!SourceFilter)
+		return;
+
+	// A copy, the field itself is rebuilt every frame while the path queries are still reading this
+	const TSharedRef<const FNAIDensityField, ESPMode::ThreadSafe> Snapshot =
+		MakeShared<FNAIDensityField, ESPMode::ThreadSafe>(DensityField);
+	const FNAIDensityQueryFilter DensityFilter(*SourceFilter, Snapshot, DensityPathCost);
+
+	FSharedNavQueryFilter Filter = NavQueryRef->GetCopy();
+	Filter->SetFilterImplementation(&DensityFilter);
+	DensityQueryFilter = Filter;
+#endif
+}
+
+int32 ANAIAgentManager::CreateAgentGroup(ANAIAgentClient* Leader, const TArray<ANAIAgentClient*>& Members,
+	const EAgentFormation Formation, const float Spacing)
+{
+	if(!IsValid(Leader) || Members.Num() == 0)
+		return INDEX_NONE;
+
+	FAgentGroupRequest& Request = GroupRequests.AddDefaulted_GetRef();
+	Request.GroupId = NextGroupId++;
+	Request.Formation = Formation;
+	Request.Spacing = FMath::Max(Spacing, 1.0f);
+	Request.Agents.Reserve(Members.Num() + 1);
+	Request.Agents.Add(Leader->GetGuid());
+	for(const ANAIAgentClient* Member : Members)
+	{
+		if(IsValid(Member) && Member != Leader)
+		{
+			Request.Agents.Add(Member->GetGuid());
+		}
+	}
+	return Request.GroupId;
+}
+
+void ANAIAgentManager::DisbandAgentGroup(const int32 GroupId)
+{
+	FAgentGroupRequest& Request = GroupRequests.AddDefaulted_GetRef();
+	Request.GroupId = GroupId;
+}
 
-void ANAIAgentManager::AgentPathTaskAsync(const FVector& Start, const FVector& Goal,
-	const FNavAgentProperties& NavAgentProperties, const FNavPathQueryDelegate& PathDelegate) const
+void ANAIAgentManager::LeaveAgentGroup(FAgent& Agent)
 {
-	FPathFindingQuery PathfindingQuery;
-	PathfindingQuery.StartLocation = Start;
-	PathfindingQuery.EndLocation = Goal;
-	PathfindingQuery.QueryFilter = NavQueryRef;
-	PathfindingQuery.NavData = NavDataRef;
-	
-	NavSysRef->FindPathAsync(
-		NavAgentProperties,
-		PathfindingQuery,
-		PathDelegate,
-		EPathFindingMode::Regular
-	);
+	// Members have no path of their own, so get one straight away
+	if(Agent.GroupSlot != INDEX_NONE)
+	{
+		Agent.PathTask.Restart();
+	}
+	Agent.GroupId = INDEX_NONE;
+	Agent.GroupSlot = INDEX_NONE;
 }
 
-void ANAIAgentManager::AgentAvoidanceTraceTaskAsync(
-	const EAgentAvoidanceTraceDirection& TraceDirection,
-	const FVector& AgentLocation, const FVector& Forward, const FVector& Right,
-	const FAgentProperties& AgentProperties, FTraceDelegate& TraceDirectionDelegate) const
-{
-	FVector RelativeForward;
-	FVector RelativeRight;
-
-	// Initialize everything...
-	// We check the TraceDirection several times instead of using an if statement for all of them,
-	// because we want the variables to be const. The compiler will optimize out the multiple identical
-	// condition checks anyway
-
-	const uint8 Columns = (TraceDirection == EAgentAvoidanceTraceDirection::TracingFront) ?
-		(AgentProperties.AvoidanceProperties.GridColumns) :
-		(AgentProperties.AvoidanceProperties.SideColumns);
-
-	const uint8 Rows = (TraceDirection == EAgentAvoidanceTraceDirection::TracingFront) ?
-		(AgentProperties.AvoidanceProperties.GridRows) :
-		(AgentProperties.AvoidanceProperties.SideRows)
-	;
-	
-	const float WidthIncrementSize =
-		(TraceDirection == EAgentAvoidanceTraceDirection::TracingFront) ?
-			(AgentProperties.AvoidanceProperties.WidthIncrementSize) :
-			(AgentProperties.AvoidanceProperties.SideWidthIncrementSize)
-	;
-	
-	const float HeightIncrementSize = AgentProperties.AvoidanceProperties.HeightIncrementSize;
-	
-	const float StartOffsetWidth =
-		(TraceDirection == EAgentAvoidanceTraceDirection::TracingFront) ?
-			(AgentProperties.AvoidanceProperties.StartOffsetWidth) :
-			(AgentProperties.AvoidanceProperties.SideStartOffsetWidth)
-	;
-
-	// We don't need to calculate the Height every time like the width,
-	// since the "up" vector is always the same amount in the Z axis,
-	// so the height is precalculated in the Initialize() function of the
-	// FAgentAvoidanceProperties struct in NAIAgentManager.h
-	const FVector StartOffsetHeightVector =
-		(TraceDirection == EAgentAvoidanceTraceDirection::TracingFront) ?
-			(AgentProperties.AvoidanceProperties.StartOffsetHeightVector) :
-			(AgentProperties.AvoidanceProperties.SideStartOffsetHeightVector)
-	;
-	
-	switch(TraceDirection)
-	{
-		case EAgentAvoidanceTraceDirection::TracingFront:
-			
-			RelativeForward = Forward;
-			RelativeRight = Right;
-			break;
-		case EAgentAvoidanceTraceDirection::TracingLeft:
-			RelativeForward = -Right;
-			RelativeRight = -Forward;
-			break;
-		case EAgentAvoidanceTraceDirection::TracingRight:
-			RelativeForward = Right;
-			RelativeRight = Forward;
-			break;
-		default:
-			break;
+void ANAIAgentManager::GetFormationSlotOffsets(const EAgentFormation Formation, const int32 SlotCount, const float Spacing,
+	TArray<FVector2D>& OutOffsets)
+{
+	OutOffsets.Reset(SlotCount);
+	const int32 Columns = FMath::Max(1, FMath::CeilToInt(FMath::Sqrt((float)SlotCount)));
+	for(int32 i = 0; i < SlotCount; i++)
+	{
+		// Right then left, moving a step further out every two slots
+		const float Step = (float)((i / 2) + 1) * Spacing;
+		const float Side = (i % 2 == 0) ? 1.0f : -1.0f;
+		switch(Formation)
+		{
+			case EAgentFormation::Line:
+				OutOffsets.Add(FVector2D(0.0f, Side * Step));
+				break;
+			case EAgentFormation::Wedge:
+				OutOffsets.Add(FVector2D(Step, Side * Step));
+				break;
+			case EAgentFormation::Box:
+				OutOffsets.Add(FVector2D(((i / Columns) + 1) * Spacing, ((i % Columns) - ((Columns - 1) * 0.5f)) * Spacing));
+				break;
+			default:
+				OutOffsets.Add(FVector2D((i + 1) * Spacing, 0.0f));
+				break;
+		}
+	}
+}
+
+/**
+ * Find the point a distance back along a group leader's trail, and the way the trail runs there.
+ * Past the end of the trail it carries on in a straight line.
+ */
+static void GetGroupTrailPoint(const TArray<FVector>& Trail, const FVector& LeaderLocation, const FVector& LeaderForward,
+	const float Distance, FVector& OutPoint, FVector& OutForward)
+{
+	FVector Current = LeaderLocation;
+	OutForward = LeaderForward;
+	float Remaining = Distance;
+	for(int32 i = Trail.Num() - 1; i >= 0 && Remaining > 0.0f; i--)
+	{
+		const FVector Segment = Current - Trail[i];
+		const float Length = Segment.Size2D();
+		if(Length < KINDA_SMALL_NUMBER)
+			continue;
+
+		OutForward = Segment.GetSafeNormal2D();
+		if(Length >= Remaining)
+		{
+			OutPoint = Current - (OutForward * Remaining);
+			return;
+		}
+		Remaining -= Length;
+		Current = Trail[i];
 	}
+	OutPoint = Current - (OutForward * Remaining);
+}
+
+void ANAIAgentManager::UpdateAgentGroups(const float DeltaTime)
+{
+	LLM_SCOPE_BYTAG(NAI_AgentRecords);
+
+	for(FAgentGroupRequest& Request : GroupRequests)
+	{
+		// No Agents means disband it
+		if(Request.Agents.Num() == 0)
+		{
+			FAgentGroup Group;
+			if(AgentGroups.RemoveAndCopyValue(Request.GroupId, Group))
+			{
+				Group.Members.Add(Group.Leader);
+				for(const FGuid& Guid : Group.Members)
+				{
+					FAgent* Agent = AgentMap.Find(Guid);
+					if(Agent && Agent->GroupId == Request.GroupId)
+					{
+						LeaveAgentGroup(*Agent);
+					}
+				}
+			}
+			continue;
+		}
+
+		// Agents moving from another group just leave a gap in it
+		FAgentGroup Group;
+		Group.Spacing = Request.Spacing;
+		TArray<FAgent*, TInlineAllocator<32>> GroupAgents;
+		for(const FGuid& Guid : Request.Agents)
+		{
+			if(FAgent* Agent = AgentMap.Find(Guid))
+			{
+				LeaveAgentGroup(*Agent);
+				GroupAgents.Add(Agent);
+			}
+		}
+		if(GroupAgents.Num() < 2)
+			continue;
+
+		for(int32 i = 0; i < GroupAgents.Num(); i++)
+		{
+			FAgent* Agent = GroupAgents[i];
+			Agent->GroupId = Request.GroupId;
+			WakeAgentByGuid(Agent->Guid);
+			if(i == 0)
+			{
+				Group.Leader = Agent->Guid;
+				continue;
+			}
+			Agent->GroupSlot = Group.Members.Add(Agent->Guid);
+		}
 
-	const FVector ForwardOffset = RelativeForward * (AgentProperties.CapsuleRadius + 1.0f);
-	const FVector RightOffset = RelativeRight * StartOffsetWidth;
-	const FVector StartingPoint = (((AgentLocation +ForwardOffset) + RightOffset) + StartOffsetHeightVector);
+		GetFormationSlotOffsets(Request.Formation, Group.Members.Num(), Group.Spacing, Group.SlotOffsets);
+		float FurthestBack = 0.0f;
+		for(const FVector2D& Offset : Group.SlotOffsets)
+		{
+			FurthestBack = FMath::Max(FurthestBack, Offset.X);
+		}
+		Group.MaxTrailPoints = FMath::CeilToInt((FurthestBack + Group.Spacing) / (Group.Spacing * 0.5f)) + 1;
+		AgentGroups.Add(Request.GroupId, MoveTemp(Group));
+	}
+	GroupRequests.Reset();
 
-	for(uint8 i = 0; i < Rows; i++) // Vertical Traces
+	for(auto It = AgentGroups.CreateIterator(); It; ++It)
 	{
-		for(uint8 j = 0; j < Columns; j++) // Horizontal Traces
+		const int32 GroupId = It.Key();
+		FAgentGroup& Group = It.Value();
+		const auto FindInGroup = [this, GroupId](const FGuid& Guid) -> FAgent*
 		{
-			const FVector CurrentStartPoint = StartingPoint +
-				((-RelativeRight * WidthIncrementSize) * j) +
-				((FVector(0.0f, 0.0f, -1.0f) * HeightIncrementSize) * i);
-			const FVector CurrentEndPoint = CurrentStartPoint + (RelativeForward * 50.0f);
+			FAgent* Agent = AgentMap.Find(Guid);
+			return (Agent && Agent->GroupId == GroupId) ? Agent : nullptr;
+		};
 
-			WorldRef->AsyncLineTraceByObjectType(
-				EAsyncTraceType::Single, CurrentStartPoint, CurrentEndPoint, ECC_Pawn,
-				FCollisionQueryParams::DefaultQueryParam,
-				&TraceDirectionDelegate
-			);
+		// The leader has gone, so the first member still here takes over. The rest keep their slots
+		FAgent* Leader = FindInGroup(Group.Leader);
+		if(!Leader)
+		{
+			for(FGuid& Guid : Group.Members)
+			{
+				if(FAgent* Member = FindInGroup(Guid))
+				{
+					LeaveAgentGroup(*Member);
+					Member->GroupId = GroupId;
+					Group.Leader = Guid;
+					Guid.Invalidate();
+					Leader = Member;
+					break;
+				}
+			}
+		}
+
+		int32 MemberCount = 0;
+		for(const FGuid& Guid : Group.Members)
+		{
+			MemberCount += FindInGroup(Guid) ? 1 : 0;
+		}
+		if(!Leader || MemberCount == 0)
+		{
+			if(Leader)
+			{
+				LeaveAgentGroup(*Leader);
+			}
+			It.RemoveCurrent();
+			continue;
+		}
+
+		const FVector LeaderLocation = Leader->AgentClient->GetActorLocation();
+		if(Group.Trail.Num() == 0 ||
+			FVector::DistSquared2D(Group.Trail.Last(), LeaderLocation) >= FMath::Square(Group.Spacing * 0.5f))
+		{
+			Group.Trail.Add(LeaderLocation);
+			if(Group.Trail.Num() > Group.MaxTrailPoints)
+			{
+				Group.Trail.RemoveAt(0, Group.Trail.Num() - Group.MaxTrailPoints, false);
+			}
+		}
+
+		Group.SlotUpdateTime -= DeltaTime;
+		if(Group.SlotUpdateTime > 0.0f && Group.SlotLocations.Num() == Group.Members.Num())
+			continue;
+		Group.SlotUpdateTime = GroupSlotUpdateInterval;
+
+		// Lay the slots out along the trail, then project them all onto the navmesh in one go
+		const FVector LeaderForward = Leader->AgentClient->GetActorForwardVector().GetSafeNormal2D();
+		TArray<FVector, TInlineAllocator<32>> TrailPoints;
+		TArray<FNavigationProjectionWork>& Projections = GroupSlotProjections;
+		Projections.Reset(Group.Members.Num());
+		for(const FVector2D& Offset : Group.SlotOffsets)
+		{
+			FVector Point, Forward;
+			GetGroupTrailPoint(Group.Trail, LeaderLocation, LeaderForward, Offset.X, Point, Forward);
+			TrailPoints.Add(Point);
+
+			const FVector Right(-Forward.Y, Forward.X, 0.0f);
+			Projections.Emplace(Point + (Right * Offset.Y));
+		}
+
+		if(NavDataRef)
+		{
+			const float HalfHeight = Leader->GetProperties().CapsuleHalfHeight;
+			NavDataRef->BatchProjectPoints(Projections,
+				FVector(Group.Spacing * 0.5f, Group.Spacing * 0.5f, HalfHeight * 2.0f), NavQueryRef);
+		}
+
+		// Slots off the navmesh fall back to the leader's trail, which it managed to walk
+		Group.SlotLocations.SetNum(Projections.Num());
+		for(int32 i = 0; i < Projections.Num(); i++)
+		{
+			Group.SlotLocations[i] = Projections[i].bResult ? Projections[i].OutLocation.Location : TrailPoints[i];
 		}
 	}
 }
 
-FVector ANAIAgentManager::GetAgentGoalLocationFromType(const EAgentType& AgentType, const FVector& PlayerLocation) const
+void ANAIAgentManager::WakeAgent(ANAIAgentClient* AgentClient)
 {
-	switch(AgentType)
+	if(IsValid(AgentClient))
 	{
-		case EAgentType::PathToPlayer:
-			return PlayerLocation;
-		case EAgentType::PathToLocation:
-			return NULL_VECTOR;
-		case EAgentType::Static:
-			return NULL_VECTOR;
-		case EAgentType::Dynamic:
-			return NULL_VECTOR;
-		case EAgentType::FollowCustomPath:
-			return NULL_VECTOR;
+		WakeAgentByGuid(AgentClient->GetGuid());
 	}
-	// We only get here if the AgentType was null 
-	return NULL_VECTOR;
 }
 
-#undef NULL_VECTOR
+void ANAIAgentManager::WakeAgentsInRadius(const FVector& Location, const float Radius)
+{
+	const float RadiusSquared = FMath::Square(Radius);
+	// Waking swaps the last dormant Agent into the woken one's index, going backwards that one's already been looked at
+	for(int32 DormantIndex = DormantAgentGuids.Num() - 1; DormantIndex >= 0; DormantIndex--)
+	{
+		const FGuid Guid = DormantAgentGuids[DormantIndex];
+		if(FVector::DistSquared(AgentMap[Guid].GetPositionThisFrame(), Location) <= RadiusSquared)
+		{
+			WakeAgentByGuid(Guid);
+		}
+	}
+}
 
-void ANAIAgentManager::Initialize()
+void ANAIAgentManager::WakeAllAgents()
 {
-	if(WorldRef == nullptr)
-		WorldRef = GetWorld();
-	if(WorldRef)
+	check(IsInGameThread());
+
+	// GatherDueTasks may be deciding which Agents go dormant right now
+	if(bIsAgentSetLocked)
 	{
-		if(NavSysRef == nullptr)
+		bWakeAllAgentsQueued = true;
+		return;
+	}
+
+	// Every one of them goes back in AgentGuids, so move them all over rather than looking each one up
+	AgentGuids.Reserve(AgentGuids.Num() + DormantAgentGuids.Num());
+	for(const FGuid& Guid : DormantAgentGuids)
+	{
+		FAgent& Agent = AgentMap[Guid];
+		Agent.Wake(Agent.AgentClient->GetActorLocation());
+		AgentGuids.Add(Guid);
+	}
+	DormantAgentGuids.Reset();
+	DormancyCheckIndex = 0;
+
+	// Still waiting in AgentsGoingDormant, so they never left AgentGuids
+	for(const FGuid& Guid : AgentsGoingDormant)
+	{
+		FAgent* Agent = AgentMap.Find(Guid);
+		if(Agent && Agent->bIsDormant)
 		{
-			NavSysRef = UNavigationSystemV1::GetCurrent(WorldRef);
-			if(NavDataRef == nullptr && NavSysRef)
+			Agent->Wake(Agent->AgentClient->GetActorLocation());
+		}
+	}
+	AgentsGoingDormant.Reset();
+	AgentsToWake.Reset();
+}
+
+void ANAIAgentManager::WakeAgentByGuid(const FGuid& Guid)
+{
+	check(IsInGameThread());
+
+	FAgent* Agent = AgentMap.Find(Guid);
+	if(!Agent || !Agent->bIsDormant)
+		return;
+
+	// GatherDueTasks may be deciding which Agents go dormant right now
+	if(bIsAgentSetLocked)
+	{
+		AgentsToWake.AddUnique(Guid);
+		return;
+	}
+
+	const int32 DormantIndex = DormantAgentGuids.IndexOfByKey(Guid);
+	if(DormantIndex != INDEX_NONE)
+	{
+		WakeDormantAgent(DormantIndex);
+	}
+	else
+	{
+		// Still waiting in AgentsGoingDormant, so it never left AgentGuids
+		Agent->Wake(Agent->AgentClient->GetActorLocation());
+	}
+}
+
+void ANAIAgentManager::WakeDormantAgent(const int32 DormantIndex)
+{
+	const FGuid Guid = DormantAgentGuids[DormantIndex];
+	DormantAgentGuids.RemoveAtSwap(DormantIndex, 1, false);
+
+	FAgent& Agent = AgentMap[Guid];
+	Agent.Wake(Agent.AgentClient->GetActorLocation());
+	AgentGuids.Add(Guid);
+}
+
+void ANAIAgentManager::UpdateDormancy(const float DeltaTime)
+{
+	check(!bIsAgentSetLocked);
+	LLM_SCOPE_BYTAG(NAI_AgentRecords);
+
+	const float Now = WorldRef ? WorldRef->GetTimeSeconds() : 0.0f;
+
+	// Take the Agents GatherDueTasks found nothing to do for out of the per frame loops
+	int32 GoingDormantCount = 0;
+	for(const FGuid& Guid : AgentsGoingDormant)
+	{
+		FAgent* Agent = AgentMap.Find(Guid);
+		if(!Agent || !Agent->bIsDormant)
+			continue;
+
+		// Spread the heartbeats out, so Agents that stopped together don't all wake together
+		Agent->DormantWakeTime = Now + DormancyHeartbeat * FMath::FRandRange(1.0f, 1.25f);
+		Agent->Speed = 0.0f;
+		Agent->Velocity = FVector::ZeroVector;
+		DormantAgentGuids.Add(Guid);
+		GoingDormantCount++;
+	}
+	AgentsGoingDormant.Reset();
+	if(GoingDormantCount > 0)
+	{
+		AgentGuids.RemoveAll([this](const FGuid& Guid)
+		{
+			return AgentMap[Guid].bIsDormant;
+		});
+	}
+
+	for(const FGuid& Guid : AgentsToWake)
+	{
+		WakeAgentByGuid(Guid);
+	}
+	AgentsToWake.Reset();
+	if(bWakeAllAgentsQueued)
+	{
+		bWakeAllAgentsQueued = false;
+		WakeAllAgents();
+	}
+
+	// A new goal gives every Agent something to do again
+	const FVector GoalLocation = bHasCrowdGoal ? CrowdGoalLocation : GetActorLocation();
+	if(FVector::DistSquared(GoalLocation, DormancyGoalLocation) > FMath::Square(DormancyGoalRadius))
+	{
+		DormancyGoalLocation = GoalLocation;
+		WakeAllAgents();
+	}
+
+	// The servers players count too, not just the local ones, anyone can walk up to a dormant Agent
+	DormancyViewLocations.Reset();
+	if(DormancyDistance > 0.0f && WorldRef)
+	{
+		for(FConstPlayerControllerIterator It = WorldRef->GetPlayerControllerIterator(); It; ++It)
+		{
+			if(const APlayerController* PlayerController = It->Get())
 			{
-				NavDataRef = NavSysRef->MainNavData;
-				if(NavQueryRef == nullptr && NavDataRef)
+				FVector ViewLocation;
+				FRotator ViewRotation;
+				PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+				DormancyViewLocations.Add(ViewLocation);
+			}
+		}
+	}
+
+	// Only look at a slice of the dormant Agents each frame, so all of them are checked once per interval
+	const int32 DormantCount = DormantAgentGuids.Num();
+	if(DormantCount > 0)
+	{
+		const int32 CheckCount = FMath::Min(DormantCount,
+			FMath::CeilToInt(DormantCount * (DeltaTime / DormancyCheckInterval)));
+		const float WakeDistanceSquared = FMath::Square(DormancyDistance * 0.9f);
+		for(int32 i = 0; i < CheckCount && DormantAgentGuids.Num() > 0; i++)
+		{
+			if(DormancyCheckIndex >= DormantAgentGuids.Num())
+			{
+				DormancyCheckIndex = 0;
+			}
+
+			FAgent& Agent = AgentMap[DormantAgentGuids[DormancyCheckIndex]];
+			bool bShouldWake = (Now >= Agent.DormantWakeTime) || (Agent.bIsDormantFromHalt && !Agent.IsHalted());
+			if(!bShouldWake && Agent.bIsDormantFromDistance)
+			{
+				const FVector& Location = Agent.GetPositionThisFrame();
+				for(const FVector& ViewLocation : DormancyViewLocations)
 				{
-					NavQueryRef.operator=(UNavigationQueryFilter::GetQueryFilter<UNavigationQueryFilter>(*NavDataRef));
+					if(FVector::DistSquared2D(ViewLocation, Location) <= WakeDistanceSquared)
+					{
+						bShouldWake = true;
+						break;
+					}
 				}
-			}	
-		}	
+			}
+
+			// Waking swaps the last Agent into this index, so it's checked next rather than skipped
+			if(bShouldWake)
+			{
+				WakeDormantAgent(DormancyCheckIndex);
+				continue;
+			}
+			DormancyCheckIndex++;
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_NAI_DormantAgents, DormantAgentGuids.Num());
+}
+
+void ANAIAgentManager::AddCollisionSource(AActor* Source)
+{
+	if(IsValid(Source))
+	{
+		CollisionSources.AddUnique(Source);
+	}
+}
+
+void ANAIAgentManager::RemoveCollisionSource(AActor* Source)
+{
+	CollisionSources.RemoveSingleSwap(Source);
+}
+
+int32 ANAIAgentManager::GetActiveCollisionProxyCount() const
+{
+	int32 Count = 0;
+	for(const ANAIAgentCollisionProxy* Proxy : CollisionProxies)
+	{
+		if(IsValid(Proxy) && Proxy->GetAgentClient())
+		{
+			Count++;
+		}
+	}
+	return Count;
+}
+
+bool ANAIAgentManager::IsAvoidanceBlockedByNeighbour(const FAgent& Agent, const int32 HashIndex,
+	const FTransform& AgentTransform, const EAgentAvoidanceTraceDirection Direction) const
+{
+	const FAgentProperties& AgentProperties = Agent.GetProperties();
+	const FAgentAvoidanceProperties& AvoidanceProperties = AgentProperties.AvoidanceProperties;
+	const uint8 DirectionIndex = (uint8)Direction;
+
+	/**
+	 * The local space area the traces would sweep through, grown by a capsule radius so a neighbour
+	 * the traces would only clip the edge of still counts. The height is left out, the hash is flat.
+	 */
+	FBox2D Area(ForceInit);
+	for(uint8 Cell = 0; Cell < AvoidanceProperties.GridCellCounts[DirectionIndex]; Cell++)
+	{
+		const FVector& Offset = AvoidanceProperties.GridOffsets[DirectionIndex][Cell];
+		Area += FVector2D(Offset);
+		Area += FVector2D(Offset + AvoidanceProperties.GridTraceDeltas[DirectionIndex]);
+	}
+	if(!Area.bIsValid)
+		return false;
+	Area = Area.ExpandBy(AgentProperties.CapsuleRadius);
+
+	const FVector2D Location(AgentTransform.GetLocation());
+	const FVector2D Forward(AgentTransform.GetUnitAxis(EAxis::X));
+	const FVector2D Right(AgentTransform.GetUnitAxis(EAxis::Y));
+	const float Reach = FVector2D(
+		FMath::Max(FMath::Abs(Area.Min.X), FMath::Abs(Area.Max.X)),
+		FMath::Max(FMath::Abs(Area.Min.Y), FMath::Abs(Area.Max.Y))).Size();
+
+	bool bIsBlocked = false;
+	AgentHash.ForEachInRadius(Location, Reach, [&](const int32 Index, const float DistanceSquared)
+	{
+		if(bIsBlocked || Index == HashIndex)
+			return;
+
+		const FVector2D Delta = AgentHash.GetPoint(Index) - Location;
+		bIsBlocked = Area.IsInside(FVector2D(Delta | Forward, Delta | Right));
+	});
+	return bIsBlocked;
+}
+
+void ANAIAgentManager::ClipMoveToWorldStatic(const FAgent& Agent, const FVector& Location, FVector& InOutMoveDelta) const
+{
+	const FVector Delta2D(InOutMoveDelta.X, InOutMoveDelta.Y, 0.0f);
+	if(Delta2D.IsNearlyZero())
+		return;
+
+	// The bottom of the capsule is lifted over the steps, so only the walls stop it. The height is left to the ground checks
+	const FAgentProperties& AgentProperties = Agent.GetProperties();
+	const float HalfHeight = FMath::Max(AgentProperties.CapsuleHalfHeight - (AgentProperties.MaxStepHeight * 0.5f),
+		AgentProperties.CapsuleRadius);
+	const FVector Start = Location + FVector(0.0f, 0.0f, AgentProperties.CapsuleHalfHeight - HalfHeight);
+
+	FHitResult Hit;
+	if(!WorldRef->SweepSingleByObjectType(Hit, Start, Start + Delta2D, FQuat::Identity,
+		FCollisionObjectQueryParams(ECC_WorldStatic),
+		FCollisionShape::MakeCapsule(AgentProperties.CapsuleRadius, HalfHeight),
+		FCollisionQueryParams::DefaultQueryParam))
+		return;
+
+	// Already overlapping something, stopping would leave the Agent stuck in it
+	if(Hit.bStartPenetrating)
+		return;
+
+	InOutMoveDelta.X = Delta2D.X * Hit.Time;
+	InOutMoveDelta.Y = Delta2D.Y * Hit.Time;
+}
+
+void ANAIAgentManager::UpdateCollisionProxies()
+{
+	NAI_SCOPE_CYCLE_COUNTER(STAT_NAI_CollisionProxies);
+	LLM_SCOPE_BYTAG(NAI_Actors);
+
+	// Every player can bump into an Agent, not just the local ones
+	CollisionSourceLocations.Reset();
+	for(FConstPlayerControllerIterator It = WorldRef->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if(PlayerController && PlayerController->GetPawn())
+		{
+			CollisionSourceLocations.Add(PlayerController->GetPawn()->GetActorLocation());
+		}
 	}
+	CollisionSources.RemoveAllSwap([](const TWeakObjectPtr<AActor>& Source) { return !Source.IsValid(); });
+	for(const TWeakObjectPtr<AActor>& Source : CollisionSources)
+	{
+		CollisionSourceLocations.Add(Source->GetActorLocation());
+	}
+
+	// Find the Agents near any source, keeping the distance to the nearest one
+	CollisionCandidates.Reset();
+	for(const FVector& SourceLocation : CollisionSourceLocations)
+	{
+		AgentHash.ForEachInRadius(FVector2D(SourceLocation), CollisionProxyDistance,
+			[this](const int32 Index, const float DistanceSquared)
+		{
+			// The hash is from GatherDueTasks, the Agent may have been handed off or removed since
+			const FAgent* Agent = AgentMap.Find(AgentHashGuids[Index]);
+			if(!Agent || !IsValid(Agent->AgentClient) || Agent->AgentClient->IsPooled())
+				return;
+
+			float& NearestSquared = CollisionCandidates.FindOrAdd(Agent->AgentClient, MAX_flt);
+			NearestSquared = FMath::Min(NearestSquared, DistanceSquared);
+		});
+	}
+	CollisionCandidates.ValueSort(TLess<float>());
+
+	// Only the nearest CollisionProxyCount get one, the rest are dropped from the list
+	int32 Rank = 0;
+	for(auto It = CollisionCandidates.CreateIterator(); It; ++It)
+	{
+		if(Rank++ >= CollisionProxyCount)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	/**
+	 * Proxies on an Agent that still needs one stay put, so a player pushing against an Agent never
+	 * has it swapped out from under them. The rest are freed up for the Agents that don't have one yet.
+	 */
+	TArray<ANAIAgentCollisionProxy*, TInlineAllocator<64>> FreeProxies;
+	for(ANAIAgentCollisionProxy* Proxy : CollisionProxies)
+	{
+		if(!IsValid(Proxy))
+			continue;
+
+		if(CollisionCandidates.Remove(Proxy->GetAgentClient()) > 0)
+		{
+			Proxy->FollowAgentClient();
+		}
+		else
+		{
+			Proxy->SetAgentClient(nullptr);
+			FreeProxies.Add(Proxy);
+		}
+	}
+	CollisionProxies.RemoveAllSwap([](const ANAIAgentCollisionProxy* Proxy) { return !IsValid(Proxy); });
+
+	for(const TPair<ANAIAgentClient*, float>& Candidate : CollisionCandidates)
+	{
+		ANAIAgentCollisionProxy* Proxy = nullptr;
+		if(FreeProxies.Num() > 0)
+		{
+			Proxy = FreeProxies.Pop(false);
+		}
+		else if(CollisionProxies.Num() < CollisionProxyCount)
+		{
+			FActorSpawnParameters SpawnParameters;
+			SpawnParameters.Owner = this;
+			SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+			Proxy = WorldRef->SpawnActor<ANAIAgentCollisionProxy>(ANAIAgentCollisionProxy::StaticClass(),
+				Candidate.Key->GetActorTransform(), SpawnParameters);
+			if(!Proxy)
+				break;
+			CollisionProxies.Add(Proxy);
+		}
+		else
+		{
+			break;
+		}
+		Proxy->SetAgentClient(Candidate.Key);
+	}
+
+	INC_DWORD_STAT_BY(STAT_NAI_ActiveCollisionProxies, CollisionProxies.Num() - FreeProxies.Num());
 }
@@ -0,0 +1,176 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIAgentManager.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if !UE_BUILD_SHIPPING
+
+/**
+ * Microbenchmarks for the per-Agent hot paths, at a few crowd sizes.
+ * The results are logged, and written to Saved/Profiling/NAI as a CSV,
+ * so runs can be compared against each other as a regression baseline.
+ */
+namespace NAIBenchmark
+{
+	/** The crowd sizes every benchmark is run at. */
+	static const int32 AgentCounts[] = { 1000, 10000, 100000 };
+
+	struct FResult
+	{
+		const TCHAR* Name;
+		int32 AgentCount;
+		int32 Iterations;
+		double AverageMs;
+	};
+
+	/** Run Func enough times to get a stable average, and record how long it took. */
+	template<typename FuncType>
+	static void Run(TArray<FResult>& Results, const TCHAR* Name, const int32 AgentCount, FuncType&& Func)
+	{
+		// Roughly the same amount of work for every crowd size
+		const int32 Iterations = FMath::Clamp(1000000 / AgentCount, 5, 200);
+
+		// Warm the caches up first, the first run isn't representative
+		Func();
+
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for(int32 i = 0; i < Iterations; i++)
+		{
+			Func();
+		}
+		const double AverageMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) / Iterations;
+
+		Results.Add({ Name, AgentCount, Iterations, AverageMs });
+		UE_LOG(LogTemp, Display, TEXT("NAI.Benchmark: %-22s x%-7d %9.4f ms  %8.2f ns/agent"),
+			Name, AgentCount, AverageMs, (AverageMs * 1000000.0) / AgentCount);
+	}
+
+	/** Reset whichever of the Agent's tasks became ready, the same as GatherDueTasks does when it issues them. */
+	static FORCEINLINE void ConsumeReadyTasks(FAgent& Agent)
+	{
+		FAgentSimpleTask* Tasks[] = { &Agent.PathTask, &Agent.AvoidanceFrontTask, &Agent.AvoidanceRightTask,
+			&Agent.AvoidanceLeftTask, &Agent.FloorCheckTask, &Agent.StepCheckTask, &Agent.LocalBoundsCheckTask, &Agent.MoveTask };
+		for(FAgentSimpleTask* Task : Tasks)
+		{
+			if(Task->IsReady())
+			{
+				Task->Reset();
+			}
+		}
+	}
+
+	static void RunAll()
+	{
+		FRandomStream Random(0x4E4149);
+		TArray<FResult> Results;
+
+		for(const int32 AgentCount : AgentCounts)
+		{
+			/**
+			 * Timer advance, the same work the AdvanceTimers phase does for each Agent.
+			 * Tasks start out ready, and a ready timer doesn't count, so they're started with staggered
+			 * times using the archetype default intervals, and consumed again as they come due.
+			 */
+			{
+				TArray<FAgent> Agents;
+				Agents.SetNum(AgentCount);
+				for(FAgent& Agent : Agents)
+				{
+					Agent.PathTask.InitializeTask(0.5f);
+					Agent.AvoidanceFrontTask.InitializeTask(0.3f);
+					Agent.AvoidanceRightTask.InitializeTask(0.3f);
+					Agent.AvoidanceLeftTask.InitializeTask(0.3f);
+					Agent.FloorCheckTask.InitializeTask(0.05f);
+					Agent.StepCheckTask.InitializeTask(0.05f);
+					Agent.LocalBoundsCheckTask.InitializeTask(0.05f);
+					Agent.MoveTask.InitializeTask(0.033f);
+					
+					ConsumeReadyTasks(Agent);
+					Agent.UpdateTimers(Random.FRandRange(0.0f, 0.5f));
+					ConsumeReadyTasks(Agent);
+				}
+				Run(Results, TEXT("TimerAdvance"), AgentCount, [&Agents]()
+				{
+					for(FAgent& Agent : Agents)
+					{
+						Agent.UpdateTimers(1.0f / 60.0f);
+						ConsumeReadyTasks(Agent);
+					}
+				});
+			}
+
+			/** Avoidance grid generation, as done when an archetype is built. */
+			{
+				FAgentAvoidanceProperties AvoidanceProperties;
+				Run(Results, TEXT("AvoidanceGridBake"), AgentCount, [&AvoidanceProperties, AgentCount]()
+				{
+					for(int32 i = 0; i < AgentCount; i++)
+					{
+						AvoidanceProperties.Initialize((i & 1) ? EAgentAvoidanceLevel::Advanced : EAgentAvoidanceLevel::Normal,
+							34.0f + (i & 7), 88.0f);
+					}
+				});
+			}
+
+			/** The math kernels, through the movement integration and speed passes. */
+			{
+				TArray<FNAISimMove> Moves;
+				Moves.SetNum(AgentCount);
+				for(FNAISimMove& Move : Moves)
+				{
+					Move.Location = Random.GetUnitVector() * 10000.0f;
+					Move.Rotation = FRotator(0.0f, Random.FRandRange(-180.0f, 180.0f), 0.0f).Quaternion();
+					Move.PathStart = Move.Location;
+					Move.PathEnd = Move.Location + (Random.GetUnitVector() * 1000.0f);
+					Move.MoveSpeed = 300.0f;
+					Move.LookAtRotationRate = 0.1f;
+					Move.CapsuleHalfHeight = 88.0f;
+					Move.bHasGroundHeight = Random.RandHelper(2);
+				}
+				FNAISimMovement Movement;
+				Run(Results, TEXT("IntegrateMovement"), AgentCount, [&Moves, &Movement]()
+				{
+					Movement.Integrate(MakeArrayView(Moves), 1.0f / 60.0f);
+				});
+
+				FNAIVectorStreams ThisFrame, LastFrame;
+				FNAIFloatStream Speeds;
+				ThisFrame.SetNum(AgentCount);
+				LastFrame.SetNum(AgentCount);
+				for(int32 i = 0; i < AgentCount; i++)
+				{
+					ThisFrame.Set(i, Moves[i].Location + Moves[i].MoveDelta);
+					LastFrame.Set(i, Moves[i].Location);
+				}
+				Run(Results, TEXT("Speed"), AgentCount, [&ThisFrame, &LastFrame, &Speeds]()
+				{
+					FNAIVectorMath::Speed(ThisFrame, LastFrame, 1.0f / 60.0f, Speeds);
+				});
+			}
+		}
+
+		FString Csv = TEXT("Benchmark,Agents,Iterations,AverageMs,NsPerAgent\n");
+		for(const FResult& Result : Results)
+		{
+			Csv += FString::Printf(TEXT("%s,%d,%d,%.6f,%.3f\n"), Result.Name, Result.AgentCount,
+				Result.Iterations, Result.AverageMs, (Result.AverageMs * 1000000.0) / Result.AgentCount);
+		}
+
+		const FString CsvPath = FPaths::ProfilingDir() / TEXT("NAI") /
+			FString::Printf(TEXT("Benchmark-%s.csv"), *FDateTime::Now().ToString());
+		if(FFileHelper::SaveStringToFile(Csv, *CsvPath))
+		{
+			UE_LOG(LogTemp, Display, TEXT("NAI.Benchmark: Results written to %s"), *CsvPath);
+		}
+	}
+
+	static FAutoConsoleCommand BenchmarkCommand(
+		TEXT("NAI.Benchmark"),
+		TEXT("Run the NAI microbenchmarks (timers, avoidance grid, math kernels) at 1k, 10k and 100k Agents."),
+		FConsoleCommandDelegate::CreateStatic(&RunAll));
+}
+
+#endif
@@ -0,0 +1,63 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAICollisionProxy.h"
+
+#include "NAIAgentClient.h"
+
+#include "Components/CapsuleComponent.h"
+
+ANAIAgentCollisionProxy::ANAIAgentCollisionProxy()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	// The same collision as the AgentClient's own capsule, so nothing can tell the difference
+	CapsuleComponent = CreateDefaultSubobject<UCapsuleComponent>(TEXT("Capsule"));
+	CapsuleComponent->InitCapsuleSize(42.0f, 96.0f);
+	CapsuleComponent->SetCanEverAffectNavigation(false);
+	CapsuleComponent->AreaClass = nullptr;
+	CapsuleComponent->SetCollisionProfileName(TEXT("AgentClient"));
+	CapsuleComponent->SetCollisionObjectType(ECollisionChannel::ECC_Pawn);
+	CapsuleComponent->SetGenerateOverlapEvents(false);
+	CapsuleComponent->PrimaryComponentTick.bCanEverTick = false;
+	RootComponent = CapsuleComponent;
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+}
+
+float ANAIAgentCollisionProxy::TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, AController* EventInstigator,
+	AActor* DamageCauser)
+{
+	if(ANAIAgentClient* Client = AgentClient.Get())
+	{
+		return Client->TakeDamage(DamageAmount, DamageEvent, EventInstigator, DamageCauser);
+	}
+	return Super::TakeDamage(DamageAmount, DamageEvent, EventInstigator, DamageCauser);
+}
+
+void ANAIAgentCollisionProxy::SetAgentClient(ANAIAgentClient* InAgentClient)
+{
+	if(AgentClient.Get() == InAgentClient)
+		return;
+
+	AgentClient = InAgentClient;
+	SetActorEnableCollision(InAgentClient != nullptr);
+	if(!InAgentClient)
+		return;
+
+	if(const UCapsuleComponent* AgentCapsule = InAgentClient->GetCapsuleComponent())
+	{
+		CapsuleComponent->SetCapsuleSize(AgentCapsule->GetUnscaledCapsuleRadius(), AgentCapsule->GetUnscaledCapsuleHalfHeight());
+	}
+	FollowAgentClient();
+}
+
+void ANAIAgentCollisionProxy::FollowAgentClient()
+{
+	if(const ANAIAgentClient* Client = AgentClient.Get())
+	{
+		// Teleport, the Agent has already moved and there's nothing to sweep against on the way
+		SetActorLocationAndRotation(Client->GetActorLocation(), Client->GetActorRotation(), false, nullptr,
+			ETeleportType::TeleportPhysics);
+	}
+}
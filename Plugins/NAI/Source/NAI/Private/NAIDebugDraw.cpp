@@ -0,0 +1,190 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIDebugDraw.h"
+
+#if NAI_DEBUG_DRAW
+
+#include "Components/LineBatchComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+namespace NAIDebugDraw
+{
+	static int32 CategoryEnabled[(uint8)ENAIDebugCategory::Count] = { 0 };
+
+	static FAutoConsoleVariableRef CVarPaths(TEXT("NAI.Debug.Paths"),
+		CategoryEnabled[(uint8)ENAIDebugCategory::Paths],
+		TEXT("Draw the path segment each moving Agent is following."));
+	static FAutoConsoleVariableRef CVarAvoidance(TEXT("NAI.Debug.Avoidance"),
+		CategoryEnabled[(uint8)ENAIDebugCategory::Avoidance],
+		TEXT("Draw the avoidance traces, red when blocked."));
+	static FAutoConsoleVariableRef CVarGroundChecks(TEXT("NAI.Debug.GroundChecks"),
+		CategoryEnabled[(uint8)ENAIDebugCategory::GroundChecks],
+		TEXT("Draw the floor and step check traces."));
+	static FAutoConsoleVariableRef CVarLocalBounds(TEXT("NAI.Debug.LocalBounds"),
+		CategoryEnabled[(uint8)ENAIDebugCategory::LocalBounds],
+		TEXT("Draw the local bounds sweeps, and the highest point they hit."));
+
+	static int32 MaxPrimitives = 2000;
+	static FAutoConsoleVariableRef CVarMaxPrimitives(TEXT("NAI.Debug.MaxPrimitives"), MaxPrimitives,
+		TEXT("The most debug lines to draw in one frame, anything past this is dropped."));
+
+	static int32 bSelectedOnly = 0;
+	static FAutoConsoleVariableRef CVarSelectedOnly(TEXT("NAI.Debug.SelectedOnly"), bSelectedOnly,
+		TEXT("Only draw the Agents selected in the editor."));
+
+	static float Radius = 0.0f;
+	static FAutoConsoleVariableRef CVarRadius(TEXT("NAI.Debug.Radius"), Radius,
+		TEXT("Only draw the Agents within this distance of the first player's view. 0 draws them all."));
+
+	static float Lifetime = 0.1f;
+	static FAutoConsoleVariableRef CVarLifetime(TEXT("NAI.Debug.Lifetime"), Lifetime,
+		TEXT("How long each debug line stays up for, in seconds. Results don't come back every frame, so keep this above zero."));
+}
+
+/** Segments in each ring of a capsule. */
+#define CAPSULE_RING_SEGMENTS 8
+
+TMap<const UWorld*, TArray<FBatchedLine>> FNAIDebugDraw::PendingLines;
+TMap<const UWorld*, FVector> FNAIDebugDraw::ViewLocations;
+int32 FNAIDebugDraw::FrameLineCount = 0;
+int32 FNAIDebugDraw::FrameDroppedCount = 0;
+
+bool FNAIDebugDraw::IsCategoryEnabled(const ENAIDebugCategory Category)
+{
+	return NAIDebugDraw::CategoryEnabled[(uint8)Category] != 0;
+}
+
+bool FNAIDebugDraw::PassesFilters(const AActor* AgentClient)
+{
+	if(!AgentClient)
+		return false;
+
+#if WITH_EDITOR
+	if(NAIDebugDraw::bSelectedOnly && !AgentClient->IsSelected())
+		return false;
+#endif
+
+	if(NAIDebugDraw::Radius > 0.0f)
+	{
+		const FVector* ViewLocation = ViewLocations.Find(AgentClient->GetWorld());
+		if(ViewLocation && FVector::DistSquared(*ViewLocation, AgentClient->GetActorLocation()) > FMath::Square(NAIDebugDraw::Radius))
+			return false;
+	}
+	return true;
+}
+
+TArray<FBatchedLine>* FNAIDebugDraw::GetBatch(const UWorld* World, const int32 LineCount)
+{
+	check(IsInGameThread());
+
+	if(FrameLineCount + LineCount > NAIDebugDraw::MaxPrimitives)
+	{
+		FrameDroppedCount += LineCount;
+		return nullptr;
+	}
+	FrameLineCount += LineCount;
+	return &PendingLines.FindOrAdd(World);
+}
+
+void FNAIDebugDraw::AddLine(const UWorld* World, const FVector& Start, const FVector& End, const FColor& Color)
+{
+	if(TArray<FBatchedLine>* Batch = GetBatch(World, 1))
+	{
+		Batch->Emplace(Start, End, FLinearColor(Color), NAIDebugDraw::Lifetime, 1.0f, SDPG_World);
+	}
+}
+
+void FNAIDebugDraw::AddCapsule(const UWorld* World, const FVector& Center, const float HalfHeight, const float Radius, const FColor& Color)
+{
+	TArray<FBatchedLine>* Batch = GetBatch(World, (CAPSULE_RING_SEGMENTS * 2) + 4);
+	if(!Batch)
+		return;
+
+	const FLinearColor LineColor(Color);
+	const float RingOffset = FMath::Max(HalfHeight - Radius, 0.0f);
+	const FVector Top = Center + FVector(0.0f, 0.0f, RingOffset);
+	const FVector Bottom = Center - FVector(0.0f, 0.0f, RingOffset);
+
+	FVector LastOffset(Radius, 0.0f, 0.0f);
+	for(int32 i = 1; i <= CAPSULE_RING_SEGMENTS; i++)
+	{
+		const float Angle = (2.0f * PI * i) / CAPSULE_RING_SEGMENTS;
+		const FVector Offset(FMath::Cos(Angle) * Radius, FMath::Sin(Angle) * Radius, 0.0f);
+		Batch->Emplace(Top + LastOffset, Top + Offset, LineColor, NAIDebugDraw::Lifetime, 1.0f, SDPG_World);
+		Batch->Emplace(Bottom + LastOffset, Bottom + Offset, LineColor, NAIDebugDraw::Lifetime, 1.0f, SDPG_World);
+		LastOffset = Offset;
+	}
+
+	// The sides, the ends are left as the rings to keep the line count down
+	const FVector Sides[4] = { FVector(Radius, 0.0f, 0.0f), FVector(-Radius, 0.0f, 0.0f),
+		FVector(0.0f, Radius, 0.0f), FVector(0.0f, -Radius, 0.0f) };
+	for(const FVector& Side : Sides)
+	{
+		Batch->Emplace(Top + Side + FVector(0.0f, 0.0f, HalfHeight - RingOffset), Bottom + Side - FVector(0.0f, 0.0f, HalfHeight - RingOffset),
+			LineColor, NAIDebugDraw::Lifetime, 1.0f, SDPG_World);
+	}
+}
+
+void FNAIDebugDraw::AddPoint(const UWorld* World, const FVector& Location, const FColor& Color)
+{
+	TArray<FBatchedLine>* Batch = GetBatch(World, 3);
+	if(!Batch)
+		return;
+
+	const FLinearColor LineColor(Color);
+	Batch->Emplace(Location - FVector(5.0f, 0.0f, 0.0f), Location + FVector(5.0f, 0.0f, 0.0f), LineColor, NAIDebugDraw::Lifetime, 1.0f, SDPG_World);
+	Batch->Emplace(Location - FVector(0.0f, 5.0f, 0.0f), Location + FVector(0.0f, 5.0f, 0.0f), LineColor, NAIDebugDraw::Lifetime, 1.0f, SDPG_World);
+	Batch->Emplace(Location - FVector(0.0f, 0.0f, 5.0f), Location + FVector(0.0f, 0.0f, 5.0f), LineColor, NAIDebugDraw::Lifetime, 1.0f, SDPG_World);
+}
+
+void FNAIDebugDraw::Flush(UWorld* World)
+{
+	check(IsInGameThread());
+	if(!World)
+		return;
+
+	if(NAIDebugDraw::Radius > 0.0f)
+	{
+		const APlayerController* PlayerController = World->GetFirstPlayerController();
+		if(PlayerController)
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			ViewLocations.Add(World, ViewLocation);
+		}
+	}
+
+	TArray<FBatchedLine> Lines;
+	if(PendingLines.RemoveAndCopyValue(World, Lines) && Lines.Num() > 0 && World->LineBatcher)
+	{
+		World->LineBatcher->DrawLines(Lines);
+	}
+
+	// The cap is shared by every World, so it only starts again once they've all been flushed
+	if(PendingLines.Num() == 0)
+	{
+		if(FrameDroppedCount > 0 && GEngine)
+		{
+			GEngine->AddOnScreenDebugMessage((uint64)(UPTRINT)&FrameDroppedCount, 0.0f, FColor::Yellow,
+				FString::Printf(TEXT("NAI.Debug: %d lines over NAI.Debug.MaxPrimitives weren't drawn"), FrameDroppedCount));
+		}
+		FrameLineCount = 0;
+		FrameDroppedCount = 0;
+	}
+}
+
+void FNAIDebugDraw::RemoveWorld(const UWorld* World)
+{
+	check(IsInGameThread());
+	
+	PendingLines.Remove(World);
+	ViewLocations.Remove(World);
+}
+
+#undef CAPSULE_RING_SEGMENTS
+
+#endif
@@ -0,0 +1,33 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIDensityQueryFilter.h"
+
+#if WITH_RECAST
+FNAIDensityQueryFilter::FNAIDensityQueryFilter(const FRecastQueryFilter& Source,
+	const TSharedRef<const FNAIDensityField, ESPMode::ThreadSafe>& InDensity, const float InDensityCost)
+	: FRecastQueryFilter(true), // Has to be virtual, or Detour never calls getVirtualCost()
+	Density(InDensity),
+	DensityCost(InDensityCost)
+{
+	copyFrom(Source);
+}
+
+INavigationQueryFilterInterface* FNAIDensityQueryFilter::CreateCopy() const
+{
+	return new FNAIDensityQueryFilter(*this);
+}
+
+float FNAIDensityQueryFilter::getVirtualCost(const float* pa, const float* pb,
+	const dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly,
+	const dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+	const dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly) const
+{
+	const float Cost = getInlineCost(pa, pb, prevRef, prevTile, prevPoly, curRef, curTile, curPoly, nextRef, nextTile, nextPoly);
+
+	// Recast is Y up, Unreal's X and Y are its -X and -Z
+	const FVector2D Midpoint(-(pa[0] + pb[0]) * 0.5f, -(pa[2] + pb[2]) * 0.5f);
+
+	// Only ever adds to the cost, so the A* heuristic stays admissible
+	return Cost * (1.0f + (DensityCost * Density->Sample(Midpoint)));
+}
+#endif
@@ -0,0 +1,258 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIReplication.h"
+
+#include "NAIAgentClient.h"
+#include "NAIAgentManager.h"
+#include "Engine/World.h"
+#include "Net/UnrealNetwork.h"
+
+void FNAIReplicatedAgent::PreReplicatedRemove(const FNAIReplicatedAgentArray& InArray)
+{
+	if(InArray.Owner)
+	{
+		InArray.Owner->OnAgentRemoved(*this);
+	}
+}
+
+void FNAIReplicatedAgent::PostReplicatedAdd(const FNAIReplicatedAgentArray& InArray)
+{
+	if(InArray.Owner)
+	{
+		InArray.Owner->OnAgentReplicated(*this);
+	}
+}
+
+void FNAIReplicatedAgent::PostReplicatedChange(const FNAIReplicatedAgentArray& InArray)
+{
+	if(InArray.Owner)
+	{
+		InArray.Owner->OnAgentReplicated(*this);
+	}
+}
+
+bool FNAIReplicatedAgentArray::NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+{
+	// Measure what's written, so the cost per Agent can be reported
+	const int64 BitsBefore = DeltaParms.Writer ? DeltaParms.Writer->GetNumBits() : 0;
+
+	const bool bResult = FFastArraySerializer::FastArrayDeltaSerialize<FNAIReplicatedAgent, FNAIReplicatedAgentArray>(
+		Items, DeltaParms, *this);
+
+	if(DeltaParms.Writer && Owner)
+	{
+		Owner->RecordBitsSent(DeltaParms.Writer->GetNumBits() - BitsBefore);
+	}
+	return bResult;
+}
+
+ANAIAgentReplicationProxy::ANAIAgentReplicationProxy()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	bReplicates = true;
+	bAlwaysRelevant = false;
+	bNetLoadOnClient = false;
+	SetReplicatingMovement(false);
+
+	// The manager raises this for the cells near the players
+	NetUpdateFrequency = 10.0f;
+	MinNetUpdateFrequency = 2.0f;
+	NetCullDistanceSquared = FMath::Square(15000.0f);
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	Agents.Owner = this;
+	NearDistanceSquared = 0.0f;
+	FarDistanceSquared = 0.0f;
+	ServerTime = 0.0f;
+	BitsSent = 0;
+}
+
+void ANAIAgentReplicationProxy::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ANAIAgentReplicationProxy, AgentClasses);
+	DOREPLIFETIME(ANAIAgentReplicationProxy, ServerTime);
+	DOREPLIFETIME(ANAIAgentReplicationProxy, Agents);
+}
+
+float ANAIAgentReplicationProxy::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer,
+	AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	const float DistanceSquared = FVector::DistSquared(ViewPos, GetActorLocation());
+
+	float Scale = 1.0f;
+	if(DistanceSquared < NearDistanceSquared)
+	{
+		Scale = 4.0f;
+	}
+	else if(DistanceSquared < FarDistanceSquared)
+	{
+		Scale = 2.0f;
+	}
+	return NetPriority * Time * Scale;
+}
+
+void ANAIAgentReplicationProxy::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Clients don't get told about each Agent when a cell stops being relevant, the whole proxy just goes
+	if(GetNetMode() == NM_Client)
+	{
+		for(const FNAIReplicatedAgent& Item : Agents.Items)
+		{
+			OnAgentRemoved(Item);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ANAIAgentReplicationProxy::Setup(const float RelevancyDistance, const float NearDistance, const float FarDistance)
+{
+	NetCullDistanceSquared = FMath::Square(RelevancyDistance);
+	NearDistanceSquared = FMath::Square(NearDistance);
+	FarDistanceSquared = FMath::Square(FarDistance);
+}
+
+void ANAIAgentReplicationProxy::SetAgent(const uint32 NetId, UClass* AgentClass, const FVector& Location, const float Yaw)
+{
+	// Quantize here, so an Agent that hasn't moved far enough to show up on the client isn't sent again
+	const FVector QuantizedLocation = FVector(
+		FMath::RoundToFloat(Location.X), FMath::RoundToFloat(Location.Y), FMath::RoundToFloat(Location.Z));
+	const uint8 QuantizedYaw = FRotator::CompressAxisToByte(Yaw);
+
+	int32 ClassIndex = AgentClasses.IndexOfByKey(AgentClass);
+	if(ClassIndex == INDEX_NONE)
+	{
+		ClassIndex = AgentClasses.Add(AgentClass);
+	}
+
+	if(const int32* Index = ItemIndices.Find(NetId))
+	{
+		FNAIReplicatedAgent& Item = Agents.Items[*Index];
+		if(Item.Location == QuantizedLocation && Item.Yaw == QuantizedYaw && Item.ClassIndex == ClassIndex)
+			return;
+
+		Item.Location = QuantizedLocation;
+		Item.Yaw = QuantizedYaw;
+		Item.ClassIndex = (uint8)ClassIndex;
+		Agents.MarkItemDirty(Item);
+		ServerTime = GetWorld()->GetTimeSeconds();
+		return;
+	}
+
+	FNAIReplicatedAgent& Item = Agents.Items.AddDefaulted_GetRef();
+	Item.NetId = NetId;
+	Item.Location = QuantizedLocation;
+	Item.Yaw = QuantizedYaw;
+	Item.ClassIndex = (uint8)ClassIndex;
+	Agents.MarkItemDirty(Item);
+	ItemIndices.Add(NetId, Agents.Items.Num() - 1);
+	ServerTime = GetWorld()->GetTimeSeconds();
+}
+
+void ANAIAgentReplicationProxy::RemoveAgent(const uint32 NetId)
+{
+	int32 Index;
+	if(!ItemIndices.RemoveAndCopyValue(NetId, Index))
+		return;
+
+	Agents.Items.RemoveAtSwap(Index, 1, false);
+	if(Agents.Items.IsValidIndex(Index))
+	{
+		ItemIndices.Add(Agents.Items[Index].NetId, Index);
+	}
+	Agents.MarkArrayDirty();
+}
+
+uint32 ANAIAgentReplicationProxy::AllocateNetId()
+{
+	check(IsInGameThread());
+
+	// Zero is left for Agents that haven't been given one yet
+	static uint32 NextNetId = 0;
+	if(++NextNetId == 0)
+	{
+		++NextNetId;
+	}
+	return NextNetId;
+}
+
+void ANAIAgentReplicationProxy::OnAgentReplicated(const FNAIReplicatedAgent& Item)
+{
+	ANAIAgentManager* Manager = GetClientManager();
+	if(!Manager)
+		return;
+
+	UClass* AgentClass = AgentClasses.IsValidIndex(Item.ClassIndex) ? AgentClasses[Item.ClassIndex].Get() : nullptr;
+	Manager->ReceiveReplicatedAgent(this, Item.NetId, AgentClass, Item.Location, FRotator::DecompressAxisFromByte(Item.Yaw));
+}
+
+void ANAIAgentReplicationProxy::OnAgentRemoved(const FNAIReplicatedAgent& Item)
+{
+	if(ANAIAgentManager* Manager = GetClientManager())
+	{
+		Manager->ReceiveReplicatedAgentRemoval(this, Item.NetId);
+	}
+}
+
+ANAIAgentManager* ANAIAgentReplicationProxy::GetClientManager()
+{
+	// Every Agent on a client goes through the lead shard, whichever shard the server has it in
+	if(!ClientManager.IsValid())
+	{
+		ClientManager = FNAIAgentManagerRegistry::GetLeadManager(GetWorld());
+	}
+	return ClientManager.Get();
+}
+
+void FNAIAgentSnapshotBuffer::Add(const double Time, const FVector& Location, const float Yaw)
+{
+	if(Count > 0 && Time <= Times[Newest])
+		return;
+	
+	Newest = (Newest + 1) % Capacity;
+	Locations[Newest] = Location;
+	Yaws[Newest] = Yaw;
+	Times[Newest] = Time;
+	Count = FMath::Min(Count + 1, (int32)Capacity);
+}
+
+bool FNAIAgentSnapshotBuffer::Sample(const double Time, FVector& OutLocation, float& OutYaw) const
+{
+	if(Count == 0)
+		return false;
+
+	// Walk back from the newest state until we find the one just before the time
+	int32 After = Newest;
+	for(int32 i = 1; i < Count; i++)
+	{
+		const int32 Before = (Newest - i + Capacity) % Capacity;
+		if(Times[Before] <= Time)
+		{
+			const double Span = Times[After] - Times[Before];
+			const float Alpha = (Span > KINDA_SMALL_NUMBER) ? (float)FMath::Clamp((Time - Times[Before]) / Span, 0.0, 1.0) : 1.0f;
+			OutLocation = FMath::Lerp(Locations[Before], Locations[After], Alpha);
+			OutYaw = Yaws[Before] + (FRotator::NormalizeAxis(Yaws[After] - Yaws[Before]) * Alpha);
+			return true;
+		}
+		After = Before;
+	}
+
+	// Older than everything we have, or only one state so far
+	const int32 Slot = (Time >= Times[Newest]) ? Newest : After;
+	OutLocation = Locations[Slot];
+	OutYaw = Yaws[Slot];
+	return true;
+}
+
+float FNAIAgentSnapshotBuffer::GetLatestInterval() const
+{
+	if(Count < 2)
+		return 0.0f;
+
+	const int32 Previous = (Newest - 1 + Capacity) % Capacity;
+	return (float)(Times[Newest] - Times[Previous]);
+}
@@ -0,0 +1,129 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIStats.h"
+
+#include "NAIAgentManager.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_STAT(STAT_NAI_AdvanceTimers);
+DEFINE_STAT(STAT_NAI_GatherDueTasks);
+DEFINE_STAT(STAT_NAI_IssueQueries);
+DEFINE_STAT(STAT_NAI_IntegrateMovement);
+DEFINE_STAT(STAT_NAI_ApplyTransforms);
+DEFINE_STAT(STAT_NAI_MoveComponent);
+DEFINE_STAT(STAT_NAI_PublishState);
+DEFINE_STAT(STAT_NAI_ProcessSpawnQueue);
+DEFINE_STAT(STAT_NAI_Replication);
+DEFINE_STAT(STAT_NAI_AnimationBudget);
+DEFINE_STAT(STAT_NAI_CollisionProxies);
+
+DEFINE_STAT(STAT_NAI_PathCallback);
+DEFINE_STAT(STAT_NAI_AvoidanceCallback);
+DEFINE_STAT(STAT_NAI_FloorCheckCallback);
+DEFINE_STAT(STAT_NAI_StepCheckCallback);
+DEFINE_STAT(STAT_NAI_LocalBoundsCallback);
+
+DEFINE_STAT(STAT_NAI_ActiveAgents);
+DEFINE_STAT(STAT_NAI_HaltedAgents);
+DEFINE_STAT(STAT_NAI_DormantAgents);
+DEFINE_STAT(STAT_NAI_PathQueriesIssued);
+DEFINE_STAT(STAT_NAI_PathQueriesInFlight);
+DEFINE_STAT(STAT_NAI_TracesIssued);
+DEFINE_STAT(STAT_NAI_SweepsIssued);
+DEFINE_STAT(STAT_NAI_CallbacksReceived);
+DEFINE_STAT(STAT_NAI_StaleResults);
+DEFINE_STAT(STAT_NAI_ActiveCollisionProxies);
+DEFINE_STAT(STAT_NAI_ReplicatedAgents);
+DEFINE_STAT(STAT_NAI_ReplicationBytesPerSecond);
+
+DEFINE_STAT(STAT_NAI_FrameArenaUsed);
+DEFINE_STAT(STAT_NAI_FrameArenaPeak);
+
+LLM_DEFINE_TAG(NAI);
+// The sub tags roll up into NAI, so its total is everything the crowd costs
+LLM_DEFINE_TAG(NAI_AgentRecords, NAME_None, TEXT("NAI"));
+LLM_DEFINE_TAG(NAI_Paths, NAME_None, TEXT("NAI"));
+LLM_DEFINE_TAG(NAI_TraceResults, NAME_None, TEXT("NAI"));
+LLM_DEFINE_TAG(NAI_Actors, NAME_None, TEXT("NAI"));
+
+UE_TRACE_CHANNEL_DEFINE(NAIChannel);
+
+#if !UE_BUILD_SHIPPING
+
+/** Print what the Agents cost in memory, per shard, in total and per Agent. */
+static void ReportAgentMemory(UWorld* World)
+{
+	if(!World)
+		return;
+
+	const auto ToKB = [](const SIZE_T Bytes) { return Bytes / 1024.0; };
+	const auto PerAgent = [](const SIZE_T Bytes, const int32 AgentCount) { return (AgentCount > 0) ? ((double)Bytes / AgentCount) : 0.0; };
+
+	FAgentManagerMemoryFootprint Total;
+	for(const ANAIAgentManager* Manager : FNAIAgentManagerRegistry::GetManagers(World))
+	{
+		const FAgentManagerMemoryFootprint Footprint = Manager->GetMemoryFootprint();
+		UE_LOG(LogTemp, Display, TEXT("NAI.MemReport: %-24s %6d Agents  %10.1f KB"),
+			*Manager->GetName(), Footprint.AgentCount, ToKB(Footprint.GetTotal()));
+		Total += Footprint;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("NAI.MemReport: %d Agents"), Total.AgentCount);
+	UE_LOG(LogTemp, Display, TEXT("NAI.MemReport: %-14s %12s %12s"), TEXT(""), TEXT("Total KB"), TEXT("Per Agent B"));
+	UE_LOG(LogTemp, Display, TEXT("NAI.MemReport: %-14s %12.1f %12.1f"), TEXT("AgentRecords"),
+		ToKB(Total.AgentRecordBytes), PerAgent(Total.AgentRecordBytes, Total.AgentCount));
+	UE_LOG(LogTemp, Display, TEXT("NAI.MemReport: %-14s %12.1f %12.1f"), TEXT("Paths"),
+		ToKB(Total.PathBytes), PerAgent(Total.PathBytes, Total.AgentCount));
+	UE_LOG(LogTemp, Display, TEXT("NAI.MemReport: %-14s %12.1f %12.1f"), TEXT("TraceResults"),
+		ToKB(Total.TraceResultBytes), PerAgent(Total.TraceResultBytes, Total.AgentCount));
+	UE_LOG(LogTemp, Display, TEXT("NAI.MemReport: %-14s %12.1f %12.1f"), TEXT("Actors"),
+		ToKB(Total.ActorBytes), PerAgent(Total.ActorBytes, Total.AgentCount));
+	UE_LOG(LogTemp, Display, TEXT("NAI.MemReport: %-14s %12.1f %12.1f"), TEXT("Total"),
+		ToKB(Total.GetTotal()), PerAgent(Total.GetTotal(), Total.AgentCount));
+}
+
+static FAutoConsoleCommandWithWorld MemReportCommand(
+	TEXT("NAI.MemReport"),
+	TEXT("Print what the Agents cost in memory, in total and per Agent, split into records, paths, trace results and actors."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&ReportAgentMemory));
+
+/** Print what the Agents cost to replicate, per shard and in total. Run it on the server. */
+static void ReportAgentReplication(UWorld* World)
+{
+	if(!World)
+		return;
+
+	if(World->GetNetMode() == NM_Client || World->GetNetMode() == NM_Standalone)
+	{
+		UE_LOG(LogTemp, Display, TEXT("NAI.NetReport: Only the server sends the Agents, run this on the server."));
+		return;
+	}
+
+	int32 TotalAgents = 0;
+	float TotalBytesPerSecond = 0.0f;
+	int32 ConnectionCount = 0;
+	for(const ANAIAgentManager* Manager : FNAIAgentManagerRegistry::GetManagers(World))
+	{
+		if(!Manager->bReplicateAgents)
+			continue;
+
+		const FAgentManagerReplicationStats& Stats = Manager->GetReplicationStats();
+		UE_LOG(LogTemp, Display, TEXT("NAI.NetReport: %-24s %6d Agents  %4d Proxies  %10.1f B/s  %8.2f B/Agent/s"),
+			*Manager->GetName(), Stats.ReplicatedAgentCount, Stats.ProxyCount,
+			Stats.BytesPerSecond, Stats.BytesPerAgentPerSecond);
+		TotalAgents += Stats.ReplicatedAgentCount;
+		TotalBytesPerSecond += Stats.BytesPerSecond;
+		ConnectionCount = FMath::Max(ConnectionCount, Stats.ConnectionCount);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("NAI.NetReport: %d Agents to %d connections, %.1f KB/s in total, %.2f B per Agent per second per connection"),
+		TotalAgents, ConnectionCount, TotalBytesPerSecond / 1024.0f,
+		TotalBytesPerSecond / (FMath::Max(TotalAgents, 1) * FMath::Max(ConnectionCount, 1)));
+}
+
+static FAutoConsoleCommandWithWorld NetReportCommand(
+	TEXT("NAI.NetReport"),
+	TEXT("Print the bandwidth the replicated Agents use, in total and per Agent per second."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&ReportAgentReplication));
+
+#endif
@@ -0,0 +1,260 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIWorldQueryAdapter.h"
+
+#include "NAIAgentClient.h"
+#include "NAICollisionProxy.h"
+#include "NavigationSystem.h"
+#include "Engine/World.h"
+
+/** The object types every query runs against. */
+#define QUERY_OBJECT_TYPES \
+	(ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic) | ECC_TO_BITFIELD(ECC_Pawn))
+
+FNAIWorldQueryAdapter::FNAIWorldQueryAdapter(UWorld* InWorld)
+	: World(InWorld), NavSys(nullptr), NavData(nullptr)
+{ }
+
+TSharedRef<FNAIWorldQueryAdapter> FNAIWorldQueryAdapter::Create(UWorld* InWorld)
+{
+	TSharedRef<FNAIWorldQueryAdapter> Adapter = MakeShared<FNAIWorldQueryAdapter>(InWorld);
+
+	// Weak, so the queries still in flight when the adapter goes just don't come back
+	Adapter->TraceDelegate.BindSP(Adapter, &FNAIWorldQueryAdapter::OnAsyncTraceComplete);
+	Adapter->PathDelegate.BindSP(Adapter, &FNAIWorldQueryAdapter::OnAsyncPathComplete);
+	return Adapter;
+}
+
+void FNAIWorldQueryAdapter::SetNavigation(UNavigationSystemV1* InNavSys, ANavigationData* InNavData)
+{
+	NavSys = InNavSys;
+	NavData = InNavData;
+}
+
+bool FNAIWorldQueryAdapter::Raycast(const FVector& Start, const FVector& End, FNAISimHit& OutHit) const
+{
+	check(IsInGameThread());
+	if(!World)
+		return false;
+
+	FHitResult Hit;
+	if(!World->LineTraceSingleByObjectType(Hit, Start, End, FCollisionObjectQueryParams(QUERY_OBJECT_TYPES)))
+		return false;
+
+	OutHit = ToSimHit(Hit);
+	return true;
+}
+
+bool FNAIWorldQueryAdapter::SweepCapsule(const FVector& Start, const FVector& End,
+	const float Radius, const float HalfHeight, TArray<FNAISimHit>& OutHits) const
+{
+	check(IsInGameThread());
+	OutHits.Reset();
+	if(!World)
+		return false;
+
+	TArray<FHitResult> Hits;
+	World->SweepMultiByObjectType(Hits, Start, End, FQuat::Identity,
+		FCollisionObjectQueryParams(QUERY_OBJECT_TYPES), FCollisionShape::MakeCapsule(Radius, HalfHeight));
+
+	OutHits.Reserve(Hits.Num());
+	for(const FHitResult& Hit : Hits)
+	{
+		OutHits.Add(ToSimHit(Hit));
+	}
+	return OutHits.Num() > 0;
+}
+
+bool FNAIWorldQueryAdapter::FindPath(const FVector& Start, const FVector& Goal, TArray<FVector>& OutPoints) const
+{
+	check(IsInGameThread());
+	OutPoints.Reset();
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+	if(!NavSys)
+		return false;
+	const ANavigationData* NavData = NavSys->GetDefaultNavDataInstance(FNavigationSystem::DontCreate);
+	if(!NavData)
+		return false;
+
+	const FPathFindingQuery Query(nullptr, *NavData, Start, Goal);
+	const FPathFindingResult Result = NavSys->FindPathSync(Query);
+	if(!Result.IsSuccessful() || !Result.Path.IsValid())
+		return false;
+
+	const TArray<FNavPathPoint>& PathPoints = Result.Path->GetPathPoints();
+	OutPoints.Reserve(PathPoints.Num());
+	for(const FNavPathPoint& Point : PathPoints)
+	{
+		OutPoints.Add(Point.Location);
+	}
+	return OutPoints.Num() > 1;
+}
+
+bool FNAIWorldQueryAdapter::GetGroundHeight(const FVector& Location, const float MaxDrop, float& OutHeight) const
+{
+	check(IsInGameThread());
+	if(!World)
+		return false;
+
+	// The Agents themselves aren't ground, so keep going through them
+	TArray<FHitResult> Hits;
+	World->LineTraceMultiByObjectType(Hits, Location, Location - FVector(0.0f, 0.0f, MaxDrop),
+		FCollisionObjectQueryParams(QUERY_OBJECT_TYPES));
+
+	for(const FHitResult& Hit : Hits)
+	{
+		if(!ToSimHit(Hit).bIsAgent)
+		{
+			OutHeight = Hit.ImpactPoint.Z;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FNAIWorldQueryAdapter::RaycastAsync(const FVector& Start, const FVector& End, const ENAISimQueryFilter Filter,
+	const bool bAllHits, const FNAISimQueryTicket& Ticket)
+{
+	check(IsInGameThread());
+	if(!World)
+		return false;
+
+	const uint32 TicketIndex = TraceTickets.Add(Ticket);
+	World->AsyncLineTraceByObjectType(
+		bAllHits ? EAsyncTraceType::Multi : EAsyncTraceType::Single, Start, End, ToObjectQueryParams(Filter),
+		FCollisionQueryParams::DefaultQueryParam,
+		&TraceDelegate, TicketIndex
+	);
+	return true;
+}
+
+bool FNAIWorldQueryAdapter::SweepCapsuleAsync(const FVector& Start, const FVector& End, const float Radius,
+	const float HalfHeight, const ENAISimQueryFilter Filter, const FNAISimQueryTicket& Ticket)
+{
+	check(IsInGameThread());
+	if(!World)
+		return false;
+
+	const uint32 TicketIndex = TraceTickets.Add(Ticket);
+	World->AsyncSweepByObjectType(
+		EAsyncTraceType::Multi, Start, End, FQuat::Identity, ToObjectQueryParams(Filter),
+		FCollisionShape::MakeCapsule(Radius, HalfHeight),
+		FCollisionQueryParams::DefaultQueryParam,
+		&TraceDelegate, TicketIndex
+	);
+	return true;
+}
+
+bool FNAIWorldQueryAdapter::FindPathAsync(const FVector& Start, const FVector& Goal, const float AgentRadius,
+	const float AgentHeight, const FNAISimQueryTicket& Ticket)
+{
+	check(IsInGameThread());
+	if(!NavSys || !NavData)
+		return false;
+
+	FPathFindingQuery PathfindingQuery;
+	PathfindingQuery.StartLocation = Start;
+	PathfindingQuery.EndLocation = Goal;
+	PathfindingQuery.QueryFilter = QueryFilter;
+	PathfindingQuery.NavData = NavData;
+
+	// The NavData is picked already, so the Agent's size is only passed along for the query's sake
+	const uint32 QueryId = NavSys->FindPathAsync(
+		FNavAgentProperties(AgentRadius, AgentHeight),
+		PathfindingQuery,
+		PathDelegate,
+		EPathFindingMode::Regular
+	);
+	if(QueryId == INVALID_NAVQUERYID)
+		return false;
+
+	PathTickets.Add(QueryId, Ticket);
+	return true;
+}
+
+SIZE_T FNAIWorldQueryAdapter::GetAllocatedSize() const
+{
+	return TraceTickets.GetAllocatedSize() + PathTickets.GetAllocatedSize() +
+		HitScratch.GetAllocatedSize() + PointScratch.GetAllocatedSize();
+}
+
+void FNAIWorldQueryAdapter::OnAsyncTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data)
+{
+	const int32 TicketIndex = (int32)Data.UserData;
+	if(!TraceTickets.IsValidIndex(TicketIndex))
+		return;
+
+	FNAISimTraceResult Result;
+	Result.Ticket = TraceTickets[TicketIndex];
+	TraceTickets.RemoveAt(TicketIndex);
+
+	HitScratch.Reset();
+	for(const FHitResult& Hit : Data.OutHits)
+	{
+		HitScratch.Add(ToSimHit(Hit));
+	}
+
+	if(Listener)
+	{
+		Result.Start = Data.Start;
+		Result.End = Data.End;
+		Result.Hits = HitScratch;
+		Listener->OnTraceComplete(Result);
+	}
+}
+
+void FNAIWorldQueryAdapter::OnAsyncPathComplete(uint32 QueryId, ENavigationQueryResult::Type ResultType,
+	FNavPathSharedPtr Path)
+{
+	FNAISimQueryTicket Ticket;
+	if(!PathTickets.RemoveAndCopyValue(QueryId, Ticket))
+		return;
+
+	PointScratch.Reset();
+	const bool bSucceeded = ResultType == ENavigationQueryResult::Success && Path.IsValid();
+	if(bSucceeded)
+	{
+		const TArray<FNavPathPoint>& PathPoints = Path->GetPathPoints();
+		PointScratch.Reserve(PathPoints.Num());
+		for(const FNavPathPoint& Point : PathPoints)
+		{
+			PointScratch.Add(Point.Location);
+		}
+	}
+
+	if(Listener)
+	{
+		Listener->OnPathComplete(Ticket, bSucceeded, PointScratch);
+	}
+}
+
+FNAISimHit FNAIWorldQueryAdapter::ToSimHit(const FHitResult& Hit)
+{
+	const AActor* Actor = Hit.Actor.Get();
+	if(const ANAIAgentClient* AgentClient = Cast<ANAIAgentClient>(Actor))
+		return FNAISimHit(Hit.ImpactPoint, Hit.ImpactNormal, true, AgentClient->GetGuid());
+
+	// A proxy stands in for its Agent, but it isn't one
+	if(const ANAIAgentCollisionProxy* Proxy = Cast<ANAIAgentCollisionProxy>(Actor))
+	{
+		if(Proxy->GetAgentClient())
+			return FNAISimHit(Hit.ImpactPoint, Hit.ImpactNormal, false, Proxy->GetAgentClient()->GetGuid());
+	}
+	return FNAISimHit(Hit.ImpactPoint, Hit.ImpactNormal);
+}
+
+FCollisionObjectQueryParams FNAIWorldQueryAdapter::ToObjectQueryParams(const ENAISimQueryFilter Filter)
+{
+	switch(Filter)
+	{
+		case ENAISimQueryFilter::World:
+			return FCollisionObjectQueryParams(ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic));
+		case ENAISimQueryFilter::Pawns:
+			return FCollisionObjectQueryParams(ECC_TO_BITFIELD(ECC_Pawn));
+		default:
+			return FCollisionObjectQueryParams(QUERY_OBJECT_TYPES);
+	}
+}
+
+#undef QUERY_OBJECT_TYPES
@@ -0,0 +1,273 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIAgentManager.h"
+#include "NAISimResults.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#define NAI_TEST_FLAGS (EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNAITimedPropertyTest, "NAI.Core.TimedProperty", NAI_TEST_FLAGS)
+
+bool FNAITimedPropertyTest::RunTest(const FString& Parameters)
+{
+	FAgentTimedProperty Timer;
+	TestTrue(TEXT("A new timer starts out ready"), Timer.bIsReady);
+
+	// A ready timer doesn't count
+	Timer.AddTime(0.25f);
+	TestEqual(TEXT("Time isn't added while ready"), Timer.Time, 0.0f);
+
+	// Reset starts the interval over, and unpauses
+	Timer.TickRate = 0.5f;
+	Timer.Pause();
+	Timer.Reset();
+	TestFalse(TEXT("Reset clears the ready state"), Timer.bIsReady);
+	TestFalse(TEXT("Reset unpauses"), Timer.bIsPaused);
+	TestEqual(TEXT("Reset clears the time"), Timer.Time, 0.0f);
+
+	// Regression, AddTime() only noticed the interval had passed on the update after it did
+	Timer.AddTime(0.25f);
+	TestFalse(TEXT("Not ready halfway through the interval"), Timer.bIsReady);
+	Timer.AddTime(0.25f);
+	TestTrue(TEXT("Ready on the same update the interval passes"), Timer.bIsReady);
+	TestEqual(TEXT("The time starts over once ready"), Timer.Time, 0.0f);
+
+	Timer.Reset();
+	Timer.Pause();
+	Timer.AddTime(1.0f);
+	TestFalse(TEXT("A paused timer doesn't become ready"), Timer.bIsReady);
+	TestEqual(TEXT("A paused timer doesn't count"), Timer.Time, 0.0f);
+
+	Timer.AddTimeRaw(1.0f);
+	TestEqual(TEXT("AddTimeRaw counts regardless"), Timer.Time, 1.0f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNAITaskHandleTest, "NAI.Core.TaskHandle", NAI_TEST_FLAGS)
+
+bool FNAITaskHandleTest::RunTest(const FString& Parameters)
+{
+	TAgentTaskHandle<FAgentTraceResult> Task;
+	Task.InitializeTask(0.5f);
+	TestTrue(TEXT("A new task starts out ready"), Task.IsReady());
+	TestEqual(TEXT("The base tick rate is kept"), Task.GetBaseTickRate(), 0.5f);
+
+	Task.Reset();
+	TestFalse(TEXT("Reset clears the ready state"), Task.IsReady());
+	Task.IncrementTimers(0.5f);
+	TestTrue(TEXT("Ready once the interval has passed"), Task.IsReady());
+
+	// The lifespan is two ticks
+	Task.SetResult(FAgentTraceResult(true, FVector(1.0f, 2.0f, 3.0f)));
+	Task.IncrementTimers(0.75f);
+	TestFalse(TEXT("A result inside its lifespan isn't stale"), Task.IsResultStale());
+	Task.IncrementTimers(0.5f);
+	TestTrue(TEXT("A result past its lifespan is stale"), Task.IsResultStale());
+
+	// Unchanged results stretch the interval, up to the max scale
+	FAgentAdaptiveIntervalSettings Settings;
+	Settings.Backoff = 2.0f;
+	Settings.MaxScale = 4.0f;
+	Settings.MoveThresholdSquared = FMath::Square(100.0f);
+
+	Task.MarkIssued(FVector::ZeroVector);
+	Task.UpdateTickRate(false, Settings);
+	TestEqual(TEXT("The first result has no query before it to check the move against"), Task.GetTickRate(), 0.5f);
+	Task.MarkIssued(FVector(10.0f, 0.0f, 0.0f));
+	Task.UpdateTickRate(false, Settings);
+	TestEqual(TEXT("An unchanged result backs the interval off"), Task.GetTickRate(), 1.0f);
+	Task.MarkIssued(FVector(20.0f, 0.0f, 0.0f));
+	Task.UpdateTickRate(false, Settings);
+	Task.MarkIssued(FVector(30.0f, 0.0f, 0.0f));
+	Task.UpdateTickRate(false, Settings);
+	TestEqual(TEXT("The interval doesn't stretch past the max scale"), Task.GetTickRate(), 2.0f);
+
+	// Regression, the move used to be measured from where the query was sent to where the Agent was once it came back
+	Task.MarkIssued(FVector(200.0f, 0.0f, 0.0f));
+	Task.UpdateTickRate(false, Settings);
+	TestEqual(TEXT("Moving past the threshold between queries snaps back to the base interval"), Task.GetTickRate(), 0.5f);
+	Task.MarkIssued(FVector(200.0f, 0.0f, 0.0f));
+	Task.UpdateTickRate(false, Settings);
+	TestEqual(TEXT("Queries sent from the same place back off again"), Task.GetTickRate(), 1.0f);
+
+	Task.UpdateTickRate(true, Settings);
+	TestEqual(TEXT("A changed result snaps back to the base interval"), Task.GetTickRate(), 0.5f);
+
+	Task.UpdateTickRate(false, Settings);
+	Task.Restart();
+	TestTrue(TEXT("Restart makes the task ready"), Task.IsReady());
+	TestEqual(TEXT("Restart goes back to the base interval"), Task.GetTickRate(), 0.5f);
+	TestFalse(TEXT("Restart throws the last result away"), (bool)Task.GetResult().IsBlocked());
+	TestFalse(TEXT("A restarted task has no stale result"), Task.IsResultStale());
+
+	// Regression, FAgentLocalBoundsCheckResult::Reset() used to reset a temporary instead
+	TArray<FVector> HitPoints = { FVector(0.0f, 0.0f, 10.0f), FVector(0.0f, 0.0f, 20.0f) };
+	FAgentLocalBoundsCheckResult BoundsResult(true, FVector(0.0f, 0.0f, 20.0f), true, MoveTemp(HitPoints));
+	BoundsResult.Reset();
+	TestFalse(TEXT("Reset clears the valid flag"), (bool)BoundsResult.bIsValidResult);
+	TestFalse(TEXT("Reset clears the multiple hits flag"), BoundsResult.GetHasMultipleHits());
+	TestEqual(TEXT("Reset clears the hit points"), BoundsResult.GetHitPoints().Num(), 0);
+	TestEqual(TEXT("Reset clears the highest hit"), BoundsResult.GetHighestHitPoint(), FVector::ZeroVector);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNAIAvoidancePropertiesTest, "NAI.Core.AvoidanceProperties", NAI_TEST_FLAGS)
+
+bool FNAIAvoidancePropertiesTest::RunTest(const FString& Parameters)
+{
+	const uint8 Front = (uint8)EAgentAvoidanceTraceDirection::TracingFront;
+	const uint8 Left = (uint8)EAgentAvoidanceTraceDirection::TracingLeft;
+	const uint8 Right = (uint8)EAgentAvoidanceTraceDirection::TracingRight;
+
+	FAgentAvoidanceProperties Properties;
+	Properties.Initialize(EAgentAvoidanceLevel::Normal, 40.0f, 100.0f);
+	TestEqual(TEXT("Grid width"), Properties.GridWidth, 60.0f);
+	TestEqual(TEXT("Grid height"), Properties.GridHeight, 160.0f);
+	TestEqual(TEXT("Normal front grid is 3x3"), (int32)Properties.GridCellCounts[Front], 9);
+	TestEqual(TEXT("Normal side grids are 1x3"), (int32)Properties.GridCellCounts[Left], 3);
+	TestEqual(TEXT("Normal side grids are 1x3"), (int32)Properties.GridCellCounts[Right], 3);
+
+	// Cells go row by row from the top left, one radius and a bit out from the Agent
+	TestEqual(TEXT("Front top left cell"), Properties.GridOffsets[Front][0], FVector(41.0f, 20.0f, 160.0f / 3.0f), KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Front centre cell"), Properties.GridOffsets[Front][4], FVector(41.0f, 0.0f, 0.0f), KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Left centre cell"), Properties.GridOffsets[Left][1], FVector(0.0f, -41.0f, 0.0f), KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Right centre cell"), Properties.GridOffsets[Right][1], FVector(0.0f, 41.0f, 0.0f), KINDA_SMALL_NUMBER);
+
+	TestEqual(TEXT("Front traces go forward"), Properties.GridTraceDeltas[Front], FVector(50.0f, 0.0f, 0.0f));
+	TestEqual(TEXT("Left traces go left"), Properties.GridTraceDeltas[Left], FVector(0.0f, -50.0f, 0.0f));
+	TestEqual(TEXT("Right traces go right"), Properties.GridTraceDeltas[Right], FVector(0.0f, 50.0f, 0.0f));
+
+	Properties.Initialize(EAgentAvoidanceLevel::Advanced, 40.0f, 100.0f);
+	TestEqual(TEXT("Advanced front grid is 5x5"), (int32)Properties.GridCellCounts[Front], 25);
+	TestEqual(TEXT("Advanced side grids are 1x5"), (int32)Properties.GridCellCounts[Left], 5);
+	TestEqual(TEXT("Front centre cell"), Properties.GridOffsets[Front][12], FVector(41.0f, 0.0f, 0.0f), KINDA_SMALL_NUMBER);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNAIStepCheckPropertiesTest, "NAI.Core.StepCheckProperties", NAI_TEST_FLAGS)
+
+bool FNAIStepCheckPropertiesTest::RunTest(const FString& Parameters)
+{
+	FAgentStepCheckProperties Properties;
+	Properties.Initialize(40.0f, 100.0f, 25.0f);
+	TestEqual(TEXT("The step check starts just past the capsule"), Properties.ForwardOffset, 41.0f);
+	TestEqual(TEXT("The step check goes down twice the step height short of the feet"), Properties.DownwardOffset, 50.0f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNAICalculatorTest, "NAI.Core.Calculator", NAI_TEST_FLAGS)
+
+bool FNAICalculatorTest::RunTest(const FString& Parameters)
+{
+	TestEqual(TEXT("Distance"), FNAICalculator::Distance(FVector(1.0f, 1.0f, 1.0f), FVector(4.0f, 5.0f, 1.0f)), 5.0f);
+	TestEqual(TEXT("Distance to itself"), FNAICalculator::Distance(FVector(7.0f), FVector(7.0f)), 0.0f);
+
+	TArray<FHitResult> Hits;
+	Hits.SetNum(3);
+	Hits[0].ImpactPoint = FVector(0.0f, 0.0f, 10.0f);
+	Hits[1].ImpactPoint = FVector(5.0f, 0.0f, 30.0f);
+	Hits[2].ImpactPoint = FVector(0.0f, 5.0f, 20.0f);
+
+	FVector HighestHit(0.0f, 0.0f, -BIG_NUMBER);
+	FNAICalculator::GetHighestHitPoint(Hits, HighestHit);
+	TestEqual(TEXT("The highest hit is found"), HighestHit, FVector(5.0f, 0.0f, 30.0f));
+
+	// Only hits above what's passed in count
+	HighestHit = FVector(0.0f, 0.0f, 100.0f);
+	FNAICalculator::GetHighestHitPoint(Hits, HighestHit);
+	TestEqual(TEXT("Lower hits are ignored"), HighestHit, FVector(0.0f, 0.0f, 100.0f));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNAISimResultsTest, "NAI.Core.SimResults", NAI_TEST_FLAGS)
+
+bool FNAISimResultsTest::RunTest(const FString& Parameters)
+{
+	const FGuid Self = FGuid::NewGuid();
+	const FGuid Other = FGuid::NewGuid();
+	TArray<FNAISimHit> Hits;
+	Hits.Emplace(FVector(0.0f, 0.0f, 10.0f), FVector::UpVector, true, Self);
+	Hits.Emplace(FVector(0.0f, 0.0f, 20.0f), FVector::UpVector, false, Self);
+
+	// Our own capsule and proxy never block us
+	TestFalse(TEXT("Not blocked by itself"), FNAISimResults::IsBlockedByAgent(Hits, Self));
+	TestFalse(TEXT("Not blocked by its own proxy"), FNAISimResults::IsBlockedByWorld(Hits, Self));
+
+	Hits.Emplace(FVector(0.0f, 0.0f, 40.0f), FVector::UpVector, true, Other);
+	TestTrue(TEXT("Blocked by another Agent"), FNAISimResults::IsBlockedByAgent(Hits, Self));
+	TestTrue(TEXT("Another Agent blocks in the world too"), FNAISimResults::IsBlockedByWorld(Hits, Self));
+
+	FVector Highest;
+	TestTrue(TEXT("There's a highest hit"), FNAISimResults::GetHighestHitPoint(Hits, Highest));
+	TestEqual(TEXT("The highest hit can be an Agent"), Highest.Z, 40.0f);
+	TestTrue(TEXT("There's a highest ground hit"), FNAISimResults::GetHighestHitPoint(Hits, Highest, true));
+	TestEqual(TEXT("The Agents aren't ground, their proxies are"), Highest.Z, 20.0f);
+
+	TestEqual(TEXT("Strafes right when it can"), FNAISimResults::ChooseStrafeDirection(false, false), (int8)1);
+	TestEqual(TEXT("Strafes left when the right is blocked"), FNAISimResults::ChooseStrafeDirection(false, true), (int8)-1);
+	TestEqual(TEXT("Doesn't strafe when boxed in"), FNAISimResults::ChooseStrafeDirection(true, true), (int8)0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNAISimFlatWorldTest, "NAI.Core.SimFlatWorld", NAI_TEST_FLAGS)
+
+bool FNAISimFlatWorldTest::RunTest(const FString& Parameters)
+{
+	/** Keeps what comes back from the flat world. */
+	struct FTestListener : public INAISimQueryListener
+	{
+		TArray<FNAISimQueryTicket> Tickets;
+		TArray<int32> HitCounts;
+		TArray<float> FirstHitHeights;
+		int32 PathPointCount = 0;
+
+		virtual void OnTraceComplete(const FNAISimTraceResult& Result) override
+		{
+			Tickets.Add(Result.Ticket);
+			HitCounts.Add(Result.Hits.Num());
+			FirstHitHeights.Add(Result.Hits.Num() > 0 ? Result.Hits[0].Location.Z : 0.0f);
+		}
+
+		virtual void OnPathComplete(const FNAISimQueryTicket& Ticket, const bool bSucceeded,
+			const TArrayView<const FVector>& Points) override
+		{
+			Tickets.Add(Ticket);
+			PathPointCount = bSucceeded ? Points.Num() : 0;
+		}
+	};
+
+	FNAISimFlatWorld World(0.0f);
+	World.Obstacles.Add(FBox(FVector(-50.0f, -50.0f, 0.0f), FVector(50.0f, 50.0f, 100.0f)));
+	FTestListener Listener;
+	World.SetListener(&Listener);
+
+	const FGuid Guid = FGuid::NewGuid();
+	World.RaycastAsync(FVector(0.0f, 0.0f, 200.0f), FVector(0.0f, 0.0f, -10.0f), ENAISimQueryFilter::World, true,
+		FNAISimQueryTicket(Guid, 1));
+	World.RaycastAsync(FVector(0.0f, 0.0f, 200.0f), FVector(0.0f, 0.0f, -10.0f), ENAISimQueryFilter::World, false,
+		FNAISimQueryTicket(Guid, 2));
+	World.RaycastAsync(FVector(0.0f, 0.0f, 200.0f), FVector(0.0f, 0.0f, -10.0f), ENAISimQueryFilter::Pawns, true,
+		FNAISimQueryTicket(Guid, 3));
+	World.FindPathAsync(FVector::ZeroVector, FVector(500.0f, 0.0f, 0.0f), 34.0f, 176.0f, FNAISimQueryTicket(Guid, 4));
+	TestEqual(TEXT("Nothing comes back until the flush"), Listener.Tickets.Num(), 0);
+
+	World.FlushQueries();
+	if(!TestEqual(TEXT("Everything comes back on the flush"), Listener.Tickets.Num(), 4))
+		return false;
+
+	TestEqual(TEXT("The tickets come back in order"), Listener.Tickets[0].Type, (uint8)1);
+	TestTrue(TEXT("The ticket keeps the Guid"), Listener.Tickets[0].Guid == Guid);
+	TestEqual(TEXT("A multi trace hits the obstacle and the ground"), Listener.HitCounts[0], 2);
+	TestEqual(TEXT("Closest hit first"), Listener.FirstHitHeights[0], 100.0f);
+	TestEqual(TEXT("A single trace stops at the first hit"), Listener.HitCounts[1], 1);
+	TestEqual(TEXT("There are no pawns in the flat world"), Listener.HitCounts[2], 0);
+	TestEqual(TEXT("Paths are straight lines"), Listener.PathPointCount, 2);
+	return true;
+}
+
+#undef NAI_TEST_FLAGS
+
+#endif
@@ -0,0 +1,64 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "NAIAgentSettingsGlobals.h"
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "NAIAgentArchetype.generated.h"
+
+/**
+ * Describes a kind of Agent. Every AgentClient using the same archetype shares one
+ * set of precomputed properties (avoidance grid, navigation, step check.. etc), instead
+ * of each of them working out and holding on to their own copy.
+ * @brief Data asset describing a kind of Agent.
+ */
+UCLASS(BlueprintType)
+class NAI_API UNAIAgentArchetype : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UNAIAgentArchetype();
+	
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype")
+	EAgentType AgentType;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype")
+	EAgentAvoidanceLevel AvoidanceLevel;
+
+	/** The AgentClient's capsule is resized to this when it uses the archetype. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype|Capsule", meta =
+		(ClampMin = 1, ClampMax = 1000, UIMin = 1, UIMax = 1000))
+	float CapsuleRadius;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype|Capsule", meta =
+		(ClampMin = 1, ClampMax = 1000, UIMin = 1, UIMax = 1000))
+	float CapsuleHalfHeight;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype", meta =
+		(ClampMin = 0, ClampMax = 1000, UIMin = 0, UIMax = 1000))
+	float MaxStepHeight;
+
+	/** Default for each Agent, these can still be changed per Agent. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype|Defaults", meta =
+		(ClampMin = 0, ClampMax = 1000, UIMin = 0, UIMax = 1000))
+	float MoveSpeed;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype|Defaults", meta =
+		(ClampMin = 0, ClampMax = 1, UIMin = 0, UIMax = 1))
+	float LookAtRotationRate;
+	
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype|Defaults", meta =
+		(ClampMin = 0, ClampMax = 10, UIMin = 0, UIMax = 10))
+	float MoveTickInterval;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype|Defaults", meta =
+		(ClampMin = 0, ClampMax = 10, UIMin = 0, UIMax = 10))
+	float PathfindingTickInterval;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype|Defaults", meta =
+		(ClampMin = 0, ClampMax = 10, UIMin = 0, UIMax = 10))
+	float AvoidanceTickInterval;
+	/** How often the floor, step and local bounds checks run. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Archetype|Defaults", meta =
+		(ClampMin = 0, ClampMax = 1, UIMin = 0, UIMax = 1))
+	float GroundCheckTickInterval;
+};
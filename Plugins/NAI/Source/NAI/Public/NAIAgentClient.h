@@ -21,7 +21,22 @@ protected:
 	// Called when the game starts or when spawned 
 	virtual void BeginPlay() override;
 
+	// Called when the Agent is destroyed, or the game ends
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	/** Being hurt wakes the Agent up if it's dormant. */
+	virtual float TakeDamage(float DamageAmount, struct FDamageEvent const& DamageEvent, class AController* EventInstigator,
+		AActor* DamageCauser) override;
+
 public:
+	/**
+	 * The archetype this Agent is built from. When set, it's used instead of the
+	 * properties below, and the capsule is resized to match it.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Agent")
+	class UNAIAgentArchetype* Archetype;
+	
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Agent")
 	EAgentType AgentType;
 
@@ -47,6 +62,13 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Agent", meta =
 		(ClampMin = 0, ClampMax = 10, UIMin = 0, UIMax = 10))
 	float AvoidanceTickInterval;
+	/**
+	 * How often the floor, step and local bounds checks run. They're sent from where the Agent
+	 * will be when their results get used, so they don't need to run every frame.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Agent", meta =
+		(ClampMin = 0, ClampMax = 1, UIMin = 0, UIMax = 1))
+	float GroundCheckTickInterval;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Agent")
 	EAgentAvoidanceLevel AvoidanceLevel;
@@ -61,6 +83,44 @@ public:
 	FORCEINLINE class USkeletalMeshComponent* GetSkeletalMeshComponent() { return this->SkeletalMeshComponent; }
     	
 	FORCEINLINE FGuid GetGuid() const { return Guid; }
+
+	/**
+	 * Fill in an Agent from this client's properties.
+	 * Creates the Guid if this client doesn't have one yet.
+	 * The task delegates are NOT bound here, that's up to whichever manager takes the Agent.
+	 * @param Agent The Agent to fill in.
+	 */
+	void InitializeAgent(struct FAgent& Agent);
+
+	/**
+	 * Move this client in or out of an AgentManager's pool.
+	 * While pooled it's hidden, has no collision, and doesn't animate.
+	 * Setting this before the client finishes spawning stops it registering itself with a manager.
+	 */
+	void SetIsPooled(const bool bInIsPooled);
+
+	/** Is this client sitting in a pool, waiting to be spawned? */
+	FORCEINLINE bool IsPooled() const { return bIsPooled; }
+
+	/**
+	 * Take the capsule and mesh out of the physics scene, or put them back as they were.
+	 * Set by the AgentManager, which leaves collision to its proxies in its physics free mode.
+	 */
+	void SetHasPhysicsBody(const bool bInHasPhysicsBody);
+
+	FORCEINLINE bool HasPhysicsBody() const { return bHasPhysicsBody; }
+
+	/**
+	 * Change how this client's skeletal mesh animates. Set by the AgentManager's animation budget.
+	 * @param InAnimationLOD The animation LOD to use.
+	 * @param ReducedTickInterval How long between animation updates at the Reduced LOD, in seconds.
+	 * @param PoseLeader The mesh to copy the pose from at the Shared LOD. Without one it's Frozen instead.
+	 */
+	void SetAnimationLOD(const EAgentAnimationLOD InAnimationLOD, const float ReducedTickInterval,
+		class USkeletalMeshComponent* PoseLeader);
+
+	/** Get how this client's skeletal mesh is animating. */
+	FORCEINLINE EAgentAnimationLOD GetAnimationLOD() const { return AnimationLOD; }
 	
 private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Agent", meta = (AllowPrivateAccess = "true"))
@@ -72,4 +132,13 @@ private:
 private:
 	UPROPERTY()
 	FGuid Guid;
+
+	uint8 bIsPooled : 1;
+	uint8 bHasPhysicsBody : 1;
+
+	/** The collision the capsule and mesh had before their bodies were taken away. */
+	TEnumAsByte<ECollisionEnabled::Type> CapsuleCollisionEnabled;
+	TEnumAsByte<ECollisionEnabled::Type> MeshCollisionEnabled;
+
+	EAgentAnimationLOD AnimationLOD;
 };
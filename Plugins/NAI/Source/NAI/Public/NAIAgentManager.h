@@ -3,12 +3,23 @@
 #pragma once
 
 #include "NAI/NAIUtils/Public/NAICalculator.h"
+#include "NAI/NAIUtils/Public/NAIFrameArena.h"
+#include "NAIDensityField.h"
+#include "NAISimMovement.h"
+#include "NAISimWorldQuery.h"
+#include "NAISimTimer.h"
+#include "NAISpatialHash.h"
 #include "NavigationSystem.h"
+#include "WorldCollision.h"
 
 #include "CoreMinimal.h"
 
 #include "NAIAgentClient.h"
 #include "NAIAgentSettingsGlobals.h"
+#include "NAIDebugDraw.h"
+#include "NAILockstep.h"
+#include "NAIReplication.h"
+#include "NAIStats.h"
 
 #include "GameFramework/Actor.h"
 #include "NAIAgentManager.generated.h"
@@ -24,91 +35,6 @@ enum class NAI_API EAgentAvoidanceTraceDirection : uint8
 	TracingRight,
 };
 
-/**
- * Specialist timer which will automatically stop when a set
- * interval of time has passed, and become "ready".
- * The timer then has to be reset to be used again.
- * @biref Specialist timer for use by the Agents.
- */
-struct NAI_API FAgentTimedProperty
-{
-	/** The tick/time interval this timer should become "ready" at. */
-	float TickRate;
-	/** Used to track time passed. */
-	float Time;
-	/** Has this timer completed it's tick interval? */
-	uint8 bIsReady : 1;
-	/** Used to pause/unpause the timer. */
-	uint8 bIsPaused : 1;
-
-	/** Create the timer, starting in the "ready" state. */
-	FAgentTimedProperty() { TickRate = 1.0f; Time = 0.0f; bIsReady = true; bIsPaused = false;}
-
-	/** Pause the timer. */
-	FORCEINLINE void Pause() { bIsPaused = true; }
-
-	/** Unpause the timer. */
-	FORCEINLINE void Unpause() { bIsPaused = false; }
-
-	/** Resets the timer. This will also unpause the timer. */
-	FORCEINLINE void Reset() { Time = 0.0f; bIsReady = false; bIsPaused = false; }
-
-	/**
-	 * This will only add the InTime if the timer is not
-	 * already in the "ready" state. It will also not add it
-	 * if the timer is paused.
-	 * @param InTime The amount of time to add.
-	 */
-	FORCEINLINE void AddTime(const float InTime)
-	{
-		if(bIsPaused || bIsReady)
-			return;
-		
-		if(Time >= TickRate)
-		{
-			bIsReady = true;
-			Time = 0.0f;
-		}
-		else
-		{
-			Time += InTime;
-		}
-	}
-
-	/** 
-	 * Always add time regardless of the state of the timer.
-	 * @param InTime The amount of time to add.
-	 */
-	FORCEINLINE void AddTimeRaw(const float InTime) { Time += InTime; }
-};
-
-/**
- * This serves as the base type for all the Agents tasks.
- * It's just simply a timer which need to be initialized and
- * incremented.
- */
-struct NAI_API FAgentSimpleTask
-{
-private:
-	FAgentTimedProperty TaskTimer;
-public:
-	/** Initialize the task with a tick rate. */
-	virtual FORCEINLINE void InitializeTask(const float InTickRate)
-	{
-		TaskTimer.TickRate = InTickRate;
-	}
-	
-	virtual FORCEINLINE void IncrementTimers(const float DeltaTime)
-	{
-		TaskTimer.AddTime(DeltaTime);
-	}
-	
-	virtual FORCEINLINE void Reset() { TaskTimer.Reset(); }
-	FORCEINLINE bool IsReady() const { return TaskTimer.bIsReady; }
-
-	virtual ~FAgentSimpleTask() { } // Need this
-};
-
 /**
  * Simple container type for holding the Result type
  * for a given task, which has a result.
@@ -118,7 +44,7 @@ struct NAI_API TAgentResultContainer
 {
 	/** How long before the Task becomes too old. */
 	float Lifespan;
-	/** Used to check whether or not the result has been used. */
+	/** Set when the latest result was different from the one before it. */
 	uint8 bIsDirty : 1;
 	/** The result type which hold the actual result. */
 	TResultType Result;
@@ -131,6 +57,32 @@ struct NAI_API TAgentResultContainer
 	{ }
 };
 
+/**
+ * The shortest a task result lives before it's stale, in seconds. Results come back a frame or so
+ * after they're asked for, so at low frame rates the fast tasks would otherwise always look stale.
+ */
+#define NAI_MIN_RESULT_LIFESPAN 0.2f
+
+/**
+ * How far a task's interval can stretch while its results keep coming back the same.
+ * Filled in from the AgentManager's properties, and handed to the Agents with each result.
+ */
+struct NAI_API FAgentAdaptiveIntervalSettings
+{
+	/** What the interval is multiplied by each time a result comes back unchanged. One keeps it fixed. */
+	float Backoff;
+	/** The longest the interval can get, as a multiple of the task's base interval. */
+	float MaxScale;
+	/** Agents that moved further than this between two queries go back to the base interval. */
+	float MoveThresholdSquared;
+
+	/** Handle default initialization. */
+	FAgentAdaptiveIntervalSettings() : Backoff(1.0f),
+		MaxScale(1.0f),
+		MoveThresholdSquared(0.0f)
+	{ }
+};
+
 /** Regular task type, holding a handle for access to result data. */
 template<typename TResultType>
 struct NAI_API TAgentTaskHandle : public FAgentSimpleTask
@@ -138,18 +90,32 @@ struct NAI_API TAgentTaskHandle : public FAgentSimpleTask
 private:
 	TAgentResultContainer<TResultType> ResultContainer;
 	FTraceHandle TaskHandle;
+	/** When the task's query was last sent off, from FPlatformTime::Cycles(). */
+	uint32 IssueCycles;
+	/** Where the Agent was when the task's query was last sent off. */
+	FVector IssueLocation;
+	/** Where the Agent was when the query for the current result was sent off. */
+	FVector ResultLocation;
+	/** Cleared until there's a result to measure the next one's movement from. */
+	uint8 bHasResultLocation : 1;
 	
 public:
+	/** Handle default initialization. */
+	TAgentTaskHandle() : IssueCycles(0),
+		IssueLocation(FVector::ZeroVector),
+		ResultLocation(FVector::ZeroVector),
+		bHasResultLocation(false)
+	{ }
+
 	/**
 	* Initialize the task with a tick rate.
-	* We also set the lifespan to be equal to the tick rate.
-	* This is because we don't want to use a result that has lived
-	* for longer than one whole tick.
+	* The lifespan is two ticks, so a result is only stale
+	* once the query after it has had a whole tick to come back.
 	*/
 	virtual FORCEINLINE void InitializeTask(const float InTickRate) override
 	{
 		FAgentSimpleTask::InitializeTask(InTickRate);
-		ResultContainer.Lifespan = InTickRate;
+		ResultContainer.Lifespan = GetLifespan(InTickRate);
 	}
 	
 	virtual FORCEINLINE void IncrementTimers(const float DeltaTime) override
@@ -163,6 +129,19 @@ public:
 		FAgentSimpleTask::Reset();
 		TaskHandle = FTraceHandle();
 	}
+
+	/** Also throws away the last result, it belongs to the Agent's previous life. */
+	virtual FORCEINLINE void Restart() override
+	{
+		FAgentSimpleTask::Restart();
+		ResultContainer.Result = TResultType();
+		ResultContainer.Age = FAgentTimedProperty();
+		ResultContainer.Lifespan = GetLifespan(GetBaseTickRate());
+		ResultContainer.bIsDirty = false;
+		TaskHandle = FTraceHandle();
+		IssueCycles = 0;
+		bHasResultLocation = false;
+	}
 	
 	FORCEINLINE const TResultType& GetResult() const { return ResultContainer.Result; }
 	FORCEINLINE void SetResult(const TResultType& InResult)
@@ -170,7 +149,50 @@ public:
 		ResultContainer.Result = InResult;
 		ResultContainer.Age.Reset();
 	}
+	/** Move overload, avoids copying results that own an array (path points.. etc) */
+	FORCEINLINE void SetResult(TResultType&& InResult)
+	{
+		ResultContainer.Result = MoveTemp(InResult);
+		ResultContainer.Age.Reset();
+	}
 	
+	/**
+	 * Remember when and where the task's query was sent off, so the latency can be measured
+	 * and the distance moved since the last query checked when the result comes back.
+	 */
+	FORCEINLINE void MarkIssued(const FVector& Location)
+	{
+		IssueCycles = FPlatformTime::Cycles();
+		IssueLocation = Location;
+	}
+	/** How long it's been since the task's query was sent off, in milliseconds. */
+	FORCEINLINE float GetMsSinceIssued() const { return FPlatformTime::ToMilliseconds(FPlatformTime::Cycles() - IssueCycles); }
+
+	/**
+	 * Stretch the interval out while nothing is changing, or snap it back to the base rate when something has.
+	 * Call after SetResult(), with whether the new result differs from the last one.
+	 * The Agent counts as still if its last two queries were sent from about the same place.
+	 * @param bChanged Whether the new result is different from the last one.
+	 * @param Settings How far the interval may stretch.
+	 */
+	FORCEINLINE void UpdateTickRate(const bool bChanged, const FAgentAdaptiveIntervalSettings& Settings)
+	{
+		ResultContainer.bIsDirty = bChanged;
+		const bool bIsStable = !bChanged && bHasResultLocation &&
+			FVector::DistSquared(IssueLocation, ResultLocation) <= Settings.MoveThresholdSquared;
+		ResultLocation = IssueLocation;
+		bHasResultLocation = true;
+		SetTickRate(bIsStable ?
+			FMath::Min(GetTickRate() * Settings.Backoff, GetBaseTickRate() * Settings.MaxScale) : GetBaseTickRate());
+		ResultContainer.Lifespan = GetLifespan(GetTickRate());
+	}
+
+	/** How long a result lives for at the given tick rate. */
+	static FORCEINLINE float GetLifespan(const float TickRate) { return FMath::Max(TickRate * 2.0f, NAI_MIN_RESULT_LIFESPAN); }
+
+	/** Has the result outlived its lifespan? It's kept, but shouldn't be trusted. */
+	FORCEINLINE bool IsResultStale() const { return ResultContainer.Age.Time > ResultContainer.Lifespan; }
+
 	FORCEINLINE const FTraceHandle& GetTraceHandle() const { return TaskHandle; }
 	FORCEINLINE void SetTraceHandle(const FTraceHandle& InHandle) { TaskHandle = InHandle; }
 };
@@ -180,11 +202,13 @@ template<typename TResultType, typename TDelegateType>
 struct NAI_API TAgentTask : public TAgentTaskHandle<TResultType>
 {
 private:
-	TAgentResultContainer<TResultType> ResultContainer;
 	TDelegateType OnCompleteDelegate;
 	
 public:
 	FORCEINLINE TDelegateType& GetOnCompleteDelegate() { return OnCompleteDelegate; }
+
+	/** Heap memory used by the delegate's payload, in bytes. */
+	FORCEINLINE SIZE_T GetDelegateAllocatedSize() const { return OnCompleteDelegate.GetAllocatedSize(); }
 };
 
 /** Not really using this yet, might keep it.. might not.. */
@@ -220,22 +244,22 @@ struct NAI_API TAgentMultiTask
 		const uint8 Index = 0) const
 	{
 		/** Get the last task if the given Index is out of range */
-		return !(Index > TTaskCount) ?
-			Tasks[Index] : Tasks[TTaskCount];
+		return (Index < TTaskCount) ?
+			Tasks[Index] : Tasks[TTaskCount - 1];
 	}
 
 	FORCEINLINE TResultType& GetTaskResult(const uint8 Index = 0) const
 	{
 		/** Get the last task if the given Index is out of range */
-		return !(Index > TTaskCount) ?
-			Tasks[Index].GetResult() : Tasks[TTaskCount].GetResult();
+		return (Index < TTaskCount) ?
+			Tasks[Index].GetResult() : Tasks[TTaskCount - 1].GetResult();
 	}
 
 	FORCEINLINE TDelegateType& GetTaskOnCompleteDelegate(const uint8 Index = 0) const
 	{
 		/** Get the last task if the given Index is out of range */
-		return !(Index > TTaskCount) ?
-			Tasks[Index].GetOnCompleteDelegate() : Tasks[TTaskCount].GetOnCompleteDelegate();
+		return (Index < TTaskCount) ?
+			Tasks[Index].GetOnCompleteDelegate() : Tasks[TTaskCount - 1].GetOnCompleteDelegate();
 	}
 	
 	FORCEINLINE void GetAllResultsFast(
@@ -272,6 +296,10 @@ struct NAI_API FAgentPathResult : FAgentResultBase
 		: FAgentResultBase(InIsValidPath), Points(InPathPoints)
 	{ }
 
+	FAgentPathResult(const uint8 InIsValidPath, TArray<FNavPathPoint>&& InPathPoints)
+		: FAgentResultBase(InIsValidPath), Points(MoveTemp(InPathPoints))
+	{ }
+
 	FAgentPathResult() { } // Need this
 };
 
@@ -292,7 +320,11 @@ struct NAI_API FAgentTraceResult : FAgentResultBase
 	FORCEINLINE const float& GetHitZValue() const { return DetectedHitLocation.Z; }
 };
 
-/**/
+/**
+ * Result of the Local Bounds Check sweep.
+ * This is kept in the Agent between sweeps, so the HitPoints are a plain heap array,
+ * the frame arena only holds memory that's thrown away at the end of the frame.
+ */
 struct NAI_API FAgentLocalBoundsCheckResult : FAgentResultBase
 {
 private:
@@ -306,15 +338,15 @@ public:
 		const uint8 InIsValid = false,
 		const FVector& InHighestHit = FVector::ZeroVector,
 		const uint8 InHasMultipleHits = false,
-		const TArray<FVector>& InHitPoints = TArray<FVector>())
+		TArray<FVector>&& InHitPoints = TArray<FVector>())
 	:
 		FAgentResultBase(InIsValid),
 		HighestHitPoint(InHighestHit),
 		bHasMultipleHits(InHasMultipleHits),
-		HitPoints(InHitPoints)
+		HitPoints(MoveTemp(InHitPoints))
 	{ }
 
-	FORCEINLINE void Reset() { FAgentLocalBoundsCheckResult(); }
+	FORCEINLINE void Reset() { *this = FAgentLocalBoundsCheckResult(); }
 	
 	FORCEINLINE const FVector& GetHighestHitPoint() const { return HighestHitPoint; }
 	FORCEINLINE void SetHighestHitPoint(const FVector& InHighestHit) { HighestHitPoint = InHighestHit; }
@@ -324,11 +356,14 @@ public:
 
 	FORCEINLINE const TArray<FVector>& GetHitPoints() const { return HitPoints; }
 	FORCEINLINE void SetHitPointByIndex(const uint32 Index = 0, const FVector& InHitPoint = FVector::ZeroVector) { HitPoints[Index] = InHitPoint; }
-	FORCEINLINE void SetHitPoints(const TArray<FVector>& InHitPoints) { HitPoints = InHitPoints; }
+	FORCEINLINE void SetHitPoints(const TArrayView<const FVector>& InHitPoints)
+	{
+		HitPoints.Reset();
+		HitPoints.Append(InHitPoints.GetData(), InHitPoints.Num());
+	}
 };
 
 // TODO: Get rid of this mess by making everything proportional
-// TODO: Actually preform encapsulation here
 // to the agent's size
 #define NORMAL_AVOIDANCE_COLUMNS		3
 #define ADVANCED_AVOIDANCE_COLUMNS		5
@@ -337,50 +372,92 @@ public:
 #define ADVANCED_AVOIDANCE_ROWS			5
 #define AVOIDANCE_WIDTH_MULTIPLIER		1.5f
 #define AVOIDANCE_HEIGHT_MULTIPLIER		0.8f
+#define AVOIDANCE_TRACE_LENGTH			50.0f
+
+/**
+ * The shape of the avoidance grid for an avoidance level and direction.
+ * Cells are numbered row by row, starting at the top left as seen from the Agent.
+ * The factors are how many increments each cell is from the centre of the grid.
+ */
+template<EAgentAvoidanceLevel TLevel, EAgentAvoidanceTraceDirection TDirection>
+struct TAgentAvoidanceGridLayout
+{
+	static constexpr uint8 Columns = (TDirection != EAgentAvoidanceTraceDirection::TracingFront)
+		? (AVOIDANCE_SIDE_COLUMNS)
+		: ((TLevel == EAgentAvoidanceLevel::Normal) ? (NORMAL_AVOIDANCE_COLUMNS) : (ADVANCED_AVOIDANCE_COLUMNS));
+	static constexpr uint8 Rows = (TLevel == EAgentAvoidanceLevel::Normal)
+		? (NORMAL_AVOIDANCE_ROWS) : (ADVANCED_AVOIDANCE_ROWS);
+	static constexpr uint8 Num = Columns * Rows;
+
+	/** How far across (towards the Agent's side of the grid) the cell is. */
+	static constexpr float ColumnFactor(const uint8 Cell) { return ((Columns - 1) * 0.5f) - (Cell % Columns); }
+	/** How far up the cell is. */
+	static constexpr float RowFactor(const uint8 Cell) { return ((Rows - 1) * 0.5f) - (Cell / Columns); }
+};
+
+/**
+ * Maps a grid cell for each trace direction into the Agent's local space,
+ * where X is forward, Y is right and Z is up.
+ */
+template<EAgentAvoidanceTraceDirection TDirection>
+struct TAgentAvoidanceTraceBasis;
+
+template<>
+struct TAgentAvoidanceTraceBasis<EAgentAvoidanceTraceDirection::TracingFront>
+{
+	static FORCEINLINE FVector ToLocal(const float Forward, const float Across, const float Up) { return FVector(Forward, Across, Up); }
+	static FORCEINLINE FVector TraceDirection() { return FVector(1.0f, 0.0f, 0.0f); }
+};
 
+template<>
+struct TAgentAvoidanceTraceBasis<EAgentAvoidanceTraceDirection::TracingLeft>
+{
+	static FORCEINLINE FVector ToLocal(const float Forward, const float Across, const float Up) { return FVector(-Across, -Forward, Up); }
+	static FORCEINLINE FVector TraceDirection() { return FVector(0.0f, -1.0f, 0.0f); }
+};
+
+template<>
+struct TAgentAvoidanceTraceBasis<EAgentAvoidanceTraceDirection::TracingRight>
+{
+	static FORCEINLINE FVector ToLocal(const float Forward, const float Across, const float Up) { return FVector(Across, Forward, Up); }
+	static FORCEINLINE FVector TraceDirection() { return FVector(0.0f, 1.0f, 0.0f); }
+};
+
+/**
+ * The avoidance grid of an archetype. The start of every trace is baked into
+ * a local space offset table for each direction when the archetype is built, so
+ * issuing the grid is just a transform of the table by the Agent's basis.
+ */
 struct NAI_API FAgentAvoidanceProperties
 {
+	/** The most cells any one direction's grid can have. */
+	static constexpr uint8 MaxGridCells = (ADVANCED_AVOIDANCE_COLUMNS * ADVANCED_AVOIDANCE_ROWS);
+	/** How many EAgentAvoidanceTraceDirection there are, front, left and right. */
+	static constexpr uint8 DirectionCount = 3;
+	
 	EAgentAvoidanceLevel AvoidanceLevel;
 	float GridWidth;
-	float GridHalfWidth;
 	float GridHeight;
-	float GridHalfHeight;
-
-	uint8 GridColumns;
-	uint8 GridRows;
-	uint8 SideColumns;
-	uint8 SideRows;
 
-	float WidthIncrementSize;
-	float SideWidthIncrementSize;
-	float HeightIncrementSize;
-	float StartOffsetWidth;
-	float SideStartOffsetWidth;
-	FVector StartOffsetHeightVector;
-	FVector SideStartOffsetHeightVector;
+	/** The local space start point of each trace, for each EAgentAvoidanceTraceDirection. */
+	FVector GridOffsets[DirectionCount][MaxGridCells];
+	/** The local space vector from the start to the end of each trace, for each direction. */
+	FVector GridTraceDeltas[DirectionCount];
+	/** How many of the GridOffsets are used, for each direction. */
+	uint8 GridCellCounts[DirectionCount];
 
 	/** Handle default initialization. */
 	FAgentAvoidanceProperties() : AvoidanceLevel(EAgentAvoidanceLevel::Advanced),
 		GridWidth(0.0f),
-		GridHalfWidth(0.0f),
-		GridHeight(0.0f),
-		GridHalfHeight(0.0f),
-		GridColumns(0),
-		GridRows(0),
-		SideColumns(0),
-		SideRows(0),
-		WidthIncrementSize(0.0f),
-		SideWidthIncrementSize(0.0f),
-		HeightIncrementSize(0.0f),
-		StartOffsetWidth(0.0f),
-		SideStartOffsetWidth(0.0f),
-		StartOffsetHeightVector(FVector::ZeroVector),
-		SideStartOffsetHeightVector(FVector::ZeroVector)
-	{ }
-
-	/**
-	 * TODO: Document this
-	 * @brief Calculates and sets up the Avoidance grid of traces.
+		GridHeight(0.0f)
+	{
+		FMemory::Memzero(GridOffsets);
+		FMemory::Memzero(GridTraceDeltas);
+		FMemory::Memzero(GridCellCounts);
+	}
+
+	/**
+	 * @brief Calculates and bakes the Avoidance grid of traces.
 	 * @param InAvoidanceLevel The avoidance level of the Agent
 	 * @param InRadius The Radius of the Agent
 	 * @param InHalfHeight The Half Height of the Agent
@@ -392,27 +469,52 @@ struct NAI_API FAgentAvoidanceProperties
 	{
 		AvoidanceLevel = InAvoidanceLevel;
 		GridWidth = InRadius * AVOIDANCE_WIDTH_MULTIPLIER;
-		GridHalfWidth = GridWidth * 0.5f;
 		GridHeight = (InHalfHeight * 2.0f) * AVOIDANCE_HEIGHT_MULTIPLIER;
-		GridHalfHeight = GridHeight * 0.5f;
 
-		GridColumns = (AvoidanceLevel == EAgentAvoidanceLevel::Normal)
-					? (NORMAL_AVOIDANCE_COLUMNS) : (ADVANCED_AVOIDANCE_COLUMNS);
-		GridRows = (AvoidanceLevel == EAgentAvoidanceLevel::Normal)
-					? (NORMAL_AVOIDANCE_ROWS) : (ADVANCED_AVOIDANCE_ROWS);
+		switch(AvoidanceLevel)
+		{
+			case EAgentAvoidanceLevel::Normal:
+				BakeGrid<EAgentAvoidanceLevel::Normal>(InRadius);
+				break;
+			case EAgentAvoidanceLevel::Advanced:
+				BakeGrid<EAgentAvoidanceLevel::Advanced>(InRadius);
+				break;
+			default:
+				break;
+		}
+	}
+
+private:
+	template<EAgentAvoidanceLevel TLevel>
+	FORCEINLINE void BakeGrid(const float InRadius)
+	{
+		BakeGridDirection<TLevel, EAgentAvoidanceTraceDirection::TracingFront>(InRadius, GridWidth);
+		// The sides use half the grid width
+		BakeGridDirection<TLevel, EAgentAvoidanceTraceDirection::TracingLeft>(InRadius, GridWidth * 0.5f);
+		BakeGridDirection<TLevel, EAgentAvoidanceTraceDirection::TracingRight>(InRadius, GridWidth * 0.5f);
+	}
 
-		SideColumns = AVOIDANCE_SIDE_COLUMNS;
-		SideRows = GridRows;
+	template<EAgentAvoidanceLevel TLevel, EAgentAvoidanceTraceDirection TDirection>
+	FORCEINLINE void BakeGridDirection(const float InRadius, const float InWidth)
+	{
+		typedef TAgentAvoidanceGridLayout<TLevel, TDirection> FLayout;
+		typedef TAgentAvoidanceTraceBasis<TDirection> FBasis;
+		static_assert(FLayout::Num <= MaxGridCells, "Avoidance grid is too big for the offset table.");
 
-		// TODO: Try get rid of division here
-		WidthIncrementSize = GridWidth / GridColumns;
-		SideWidthIncrementSize = (GridWidth * 0.5f) / SideColumns; // use half grid width for the sides
-		HeightIncrementSize = GridHeight / GridRows;
+		const uint8 DirectionIndex = (uint8)TDirection;
+		const float ForwardOffset = InRadius + 1.0f;
+		const float WidthIncrementSize = InWidth / FLayout::Columns;
+		const float HeightIncrementSize = GridHeight / FLayout::Rows;
 
-		StartOffsetWidth = WidthIncrementSize * ((GridColumns - 1) * 0.5f);
-		SideStartOffsetWidth = WidthIncrementSize * ((SideColumns - 1) * 0.5f);
-		StartOffsetHeightVector = FVector::UpVector * (HeightIncrementSize * ((GridRows - 1) * 0.5f));
-		SideStartOffsetHeightVector = FVector::UpVector * (HeightIncrementSize * ((SideRows - 1) * 0.5f));
+		for(uint8 Cell = 0; Cell < FLayout::Num; Cell++)
+		{
+			GridOffsets[DirectionIndex][Cell] = FBasis::ToLocal(
+				ForwardOffset,
+				FLayout::ColumnFactor(Cell) * WidthIncrementSize,
+				FLayout::RowFactor(Cell) * HeightIncrementSize);
+		}
+		GridTraceDeltas[DirectionIndex] = FBasis::TraceDirection() * AVOIDANCE_TRACE_LENGTH;
+		GridCellCounts[DirectionIndex] = FLayout::Num;
 	}
 };
 
@@ -422,6 +524,8 @@ struct NAI_API FAgentAvoidanceProperties
 #undef NORMAL_AVOIDANCE_ROWS
 #undef ADVANCED_AVOIDANCE_ROWS
 #undef AVOIDANCE_WIDTH_MULTIPLIER
+#undef AVOIDANCE_HEIGHT_MULTIPLIER
+#undef AVOIDANCE_TRACE_LENGTH
 
 struct NAI_API FAgentVirtualCapsuleSweepProperties
 {
@@ -482,6 +586,41 @@ struct NAI_API FAgentNavigationProperties
 	{ }
 };
 
+/**
+ * Everything an archetype's FAgentProperties are built from.
+ * Agents with matching descriptions share the same archetype.
+ */
+struct NAI_API FAgentArchetypeDesc
+{
+	EAgentType AgentType;
+	EAgentAvoidanceLevel AvoidanceLevel;
+	float CapsuleRadius;
+	float CapsuleHalfHeight;
+	float MaxStepHeight;
+
+	/** Handle default initialization. */
+	FAgentArchetypeDesc() : AgentType(EAgentType::PathToPlayer),
+		AvoidanceLevel(EAgentAvoidanceLevel::Advanced),
+		CapsuleRadius(0.0f),
+		CapsuleHalfHeight(0.0f),
+		MaxStepHeight(0.0f)
+	{ }
+
+	FORCEINLINE bool operator==(const FAgentArchetypeDesc& Other) const
+	{
+		return AgentType == Other.AgentType &&
+			AvoidanceLevel == Other.AvoidanceLevel &&
+			CapsuleRadius == Other.CapsuleRadius &&
+			CapsuleHalfHeight == Other.CapsuleHalfHeight &&
+			MaxStepHeight == Other.MaxStepHeight;
+	}
+};
+
+/**
+ * The properties shared by every Agent of an archetype.
+ * These are built once per archetype and live in the World's FNAIAgentArchetypeTable,
+ * the Agents themselves only point at their archetype.
+ */
 struct NAI_API FAgentProperties
 {
 	/** The type of Agent. */
@@ -490,10 +629,6 @@ struct NAI_API FAgentProperties
 	float CapsuleRadius;
 	/** The Half Height of the Agent's Capsule collider. */
 	float CapsuleHalfHeight;
-	/** The MoveSpeed of this Agent. */
-	float MoveSpeed;
-	/** The speed at which the Agent will rotate into the direction it's moving. */
-	float LookAtRotationRate;
 
 	/** The maximum step height for this Agent. */
 	float MaxStepHeight;
@@ -507,15 +642,82 @@ struct NAI_API FAgentProperties
 	FAgentProperties() : AgentType(EAgentType::PathToPlayer),
 		CapsuleRadius(0.0f),
 		CapsuleHalfHeight(0.0f),
-		MoveSpeed(0.0f),
-		LookAtRotationRate(0.0f),
 		MaxStepHeight(0.0f),
 		NavigationProperties(FAgentNavigationProperties()),
 		AvoidanceProperties(FAgentAvoidanceProperties())
 	{ }
+
+	/**
+	 * Work out all the properties for an archetype.
+	 * @param Desc The description of the archetype.
+	 */
+	void Initialize(const FAgentArchetypeDesc& Desc);
+};
+
+/** The per-Agent values that aren't shared through the archetype. */
+struct NAI_API FAgentOverrides
+{
+	/** The MoveSpeed of this Agent. */
+	float MoveSpeed;
+	/** The speed at which the Agent will rotate into the direction it's moving. */
+	float LookAtRotationRate;
+
+	/** Handle default initialization. */
+	FAgentOverrides() : MoveSpeed(0.0f),
+		LookAtRotationRate(0.0f)
+	{ }
+};
+
+/** The most archetypes that can exist at once in a single World. */
+#define NAI_MAX_AGENT_ARCHETYPES 64
+
+/**
+ * Table of every Agent archetype in a World. Each World has its own, so PIE instances
+ * and the editor World don't fill each other's up.
+ * The table has a fixed size and entries are never moved or removed, so once an
+ * archetype has been added it can be read from any thread. Adding is guarded by a lock.
+ * @note ONLY USE THIS AT RUNTIME
+ */
+class NAI_API FNAIAgentArchetypeTable
+{
+public:
+	/** Handle default initialization. */
+	FNAIAgentArchetypeTable() : Count(0)
+	{ }
+	
+	/** Get the table for the given World, making it if there isn't one yet. */
+	static FNAIAgentArchetypeTable& Get(const UWorld* InWorld);
+
+	/** Drop the table for the given World. Nothing in the World can be using its archetypes any more. */
+	static void Remove(const UWorld* InWorld);
+	
+	/**
+	 * Find the archetype matching the description, or build a new one.
+	 * @param Desc The description of the archetype.
+	 * @return The properties of the archetype, or nullptr if the table is full.
+	 */
+	const FAgentProperties* FindOrAdd(const FAgentArchetypeDesc& Desc);
+
+	/** Get how many archetypes there are. */
+	int32 Num() const;
+
+private:
+	FAgentProperties Entries[NAI_MAX_AGENT_ARCHETYPES];
+	FAgentArchetypeDesc Descs[NAI_MAX_AGENT_ARCHETYPES];
+	int32 Count;
+	/** Held while an archetype is being added. */
+	mutable FCriticalSection Lock;
+
+	/** The table for each World. */
+	static TMap<const UWorld*, TUniquePtr<FNAIAgentArchetypeTable>> Tables;
+	static FCriticalSection TablesLock;
 };
 
 class AAgentManager;
+class ANAIAgentManager;
+class UAnimationAsset;
+class USkeletalMesh;
+class USkeletalMeshComponent;
 
 /**
  * This struct serves as a container for all variables related to each Agent.
@@ -545,21 +747,58 @@ struct NAI_API FAgent
 	class ANAIAgentManager *AgentManager;
 	
 	/**
-	 * Contains all the properties for this Agent.
-	 * This includes the UPROPERTY(EditAnywhere) variables that
-	 * are exposed to the Editors UI, along with things related to
-	 * the Agent's tasks.
+	 * This Agent's archetype, in its World's FNAIAgentArchetypeTable.
+	 * The archetype holds all the properties that are the same for every Agent like this one,
+	 * use GetProperties() to get at them.
+	 */
+	const FAgentProperties* Properties;
+	/** The Agent's own copy of its properties, only used if the archetype table was full. */
+	TSharedPtr<const FAgentProperties> OwnedProperties;
+	/** The properties that belong to this Agent alone. */
+	FAgentOverrides Overrides;
+	/** Identifies the Agent to clients, given out the first time it's replicated. Zero until then. */
+	uint32 NetId;
+	/** The group this Agent is in, and which of the group's slots it follows, or INDEX_NONE for both. */
+	int32 GroupId;
+	int32 GroupSlot;
+	/** World time a dormant Agent wakes up at, to check if it still has nothing to do. */
+	float DormantWakeTime;
+	/**
+	 * Where the Agent was put into its manager's density field, and which build of the field that was,
+	 * so it can be left out of its own separation. INDEX_NONE if it isn't in one.
+	 */
+	FVector2D DensitySplatLocation;
+	int32 DensitySplatFrame;
+	/**
+	 * The avoidance directions the manager's neighbour hash found blocked, a bit for each EAgentAvoidanceTraceDirection.
+	 * Only set with bPhysicsFreeAgents, where it's ORed into each direction's trace results.
+	 */
+	uint8 NeighbourBlockedDirections;
+	/**
+	 * Each avoidance direction is traced as a grid of cells, which all come back separately.
+	 * How many cells of each direction's query are still out, and a bit for each direction any of its cells were blocked in.
 	 */
-	FAgentProperties AgentProperties;
+	uint8 AvoidanceCellsPending[FAgentAvoidanceProperties::DirectionCount];
+	uint8 AvoidanceBlockedCells;
+	/** Set while the Agent is dormant, out of the per frame loops until something wakes it. */
+	uint8 bIsDormant : 1;
+	/** Went dormant for being far from every player, so it wakes when one gets close. */
+	uint8 bIsDormantFromDistance : 1;
+	/** Went dormant while halted, so it wakes when it's let go. */
+	uint8 bIsDormantFromHalt : 1;
 
-	/** Agent Tasks */
-	TAgentTask<FAgentPathResult, FNavPathQueryDelegate> PathTask;
-	TAgentTask<FAgentTraceResult, FTraceDelegate> AvoidanceFrontTask;
-	TAgentTask<FAgentTraceResult, FTraceDelegate> AvoidanceRightTask;
-	TAgentTask<FAgentTraceResult, FTraceDelegate> AvoidanceLeftTask;
-	TAgentTask<FAgentTraceResult, FTraceDelegate> FloorCheckTask;
-	TAgentTask<FAgentTraceResult, FTraceDelegate> StepCheckTask;
-	TAgentTask<FAgentLocalBoundsCheckResult, FTraceDelegate> LocalBoundsCheckTask;
+	/**
+	 * Agent Tasks
+	 * Their queries come back to the sending manager with a ticket carrying the Agent's Guid,
+	 * so nothing in flight points into the Agent, and it can be moved about freely.
+	 */
+	TAgentTaskHandle<FAgentPathResult> PathTask;
+	TAgentTaskHandle<FAgentTraceResult> AvoidanceFrontTask;
+	TAgentTaskHandle<FAgentTraceResult> AvoidanceRightTask;
+	TAgentTaskHandle<FAgentTraceResult> AvoidanceLeftTask;
+	TAgentTaskHandle<FAgentTraceResult> FloorCheckTask;
+	TAgentTaskHandle<FAgentTraceResult> StepCheckTask;
+	TAgentTaskHandle<FAgentLocalBoundsCheckResult> LocalBoundsCheckTask;
 
 	/** Simple Tasks. These don't have a result output. */
 	FAgentSimpleTask MoveTask;
@@ -581,24 +820,157 @@ public:
 	/** Handle default initialization. */
 	FAgent() : AgentClient(nullptr),
 		AgentManager(nullptr),
-		AgentProperties(FAgentProperties()),
+		Properties(nullptr),
+		Overrides(FAgentOverrides()),
+		NetId(0),
+		GroupId(INDEX_NONE),
+		GroupSlot(INDEX_NONE),
+		DormantWakeTime(0.0f),
+		DensitySplatLocation(FVector2D::ZeroVector),
+		DensitySplatFrame(INDEX_NONE),
+		NeighbourBlockedDirections(0),
+		AvoidanceCellsPending{ 0 },
+		AvoidanceBlockedCells(0),
+		bIsDormant(false),
+		bIsDormantFromDistance(false),
+		bIsDormantFromHalt(false),
 		Speed(0.0f),
 		bIsHalted(false)
 	{ }
 
+	/** Get the properties shared by every Agent of this Agent's archetype. */
+	FORCEINLINE const FAgentProperties& GetProperties() const { return *Properties; }
+
+	/**
+	 * Give the Agent the archetype matching the description from the World's table.
+	 * If the table is full the Agent gets its own copy instead, so it still behaves as described.
+	 * @param InWorld The World the Agent is in.
+	 * @param Desc The description of the Agent's archetype.
+	 * @return False if the Agent had to be given its own copy.
+	 */
+	FORCEINLINE bool SetArchetype(const UWorld* InWorld, const FAgentArchetypeDesc& Desc)
+	{
+		Properties = FNAIAgentArchetypeTable::Get(InWorld).FindOrAdd(Desc);
+		if(Properties)
+		{
+			OwnedProperties.Reset();
+			return true;
+		}
+
+		const TSharedRef<FAgentProperties> OwnProperties = MakeShared<FAgentProperties>();
+		OwnProperties->Initialize(Desc);
+		OwnedProperties = OwnProperties;
+		Properties = &OwnProperties.Get();
+		return false;
+	}
+
 	/** Set the Velocity of this Agent. */
 	FORCEINLINE void SetVelocity(const FVector& InVelocity) { Velocity = InVelocity; }
 
+	/**
+	 * Get the Agent ready to be used again after coming out of the pool.
+	 * @param Location Where the Agent is being spawned.
+	 */
+	FORCEINLINE void ResetForReuse(const FVector& Location)
+	{
+		PathTask.Restart();
+		AvoidanceFrontTask.Restart();
+		AvoidanceRightTask.Restart();
+		AvoidanceLeftTask.Restart();
+		FloorCheckTask.Restart();
+		StepCheckTask.Restart();
+		LocalBoundsCheckTask.Restart();
+		MoveTask.Restart();
+
+		GroupId = INDEX_NONE;
+		GroupSlot = INDEX_NONE;
+		bIsDormant = false;
+		bIsDormantFromDistance = false;
+		bIsDormantFromHalt = false;
+		Speed = 0.0f;
+		Velocity = FVector::ZeroVector;
+		PositionThisFrame = Location;
+		PositionLastFrame = Location;
+		bIsHalted = false;
+	}
+
+	/**
+	 * Bring the Agent out of dormancy. It paths again straight away, and its speed starts
+	 * from zero rather than from where it was when it went dormant.
+	 * @param Location Where the Agent is now.
+	 */
+	FORCEINLINE void Wake(const FVector& Location)
+	{
+		PathTask.Restart();
+		Speed = 0.0f;
+		Velocity = FVector::ZeroVector;
+		PositionThisFrame = Location;
+		PositionLastFrame = Location;
+		bIsDormant = false;
+		bIsDormantFromDistance = false;
+		bIsDormantFromHalt = false;
+	}
+
 	/** Get whether or not the Agent is halted. */
 	FORCEINLINE bool IsHalted() { return bIsHalted; }
 	
 	/** Set the Agent to either be halted, or not. */
 	FORCEINLINE void SetIsHalted(const uint8 IsHalted) { bIsHalted = IsHalted; }
 	
-	/** Update the Agents PathPoints for their current navigation path. */
-	FORCEINLINE void UpdatePathTaskResults(const FAgentPathResult& InResult)
+	/**
+	 * Update the Agents PathPoints for their current navigation path.
+	 * The path counts as unchanged while it has the same corners, give or take the move threshold,
+	 * other than the first which is always where the Agent was.
+	 */
+	FORCEINLINE void UpdatePathTaskResults(FAgentPathResult&& InResult, const FAgentAdaptiveIntervalSettings& Adaptive)
+	{
+		const FAgentPathResult& OldResult = PathTask.GetResult();
+		bool bChanged = !OldResult.bIsValidResult || (OldResult.Points.Num() != InResult.Points.Num());
+		for(int32 i = 1; !bChanged && i < InResult.Points.Num(); i++)
+		{
+			bChanged = FVector::DistSquared(OldResult.Points[i].Location, InResult.Points[i].Location) >
+				Adaptive.MoveThresholdSquared;
+		}
+		
+		PathTask.SetResult(MoveTemp(InResult));
+		PathTask.UpdateTickRate(bChanged, Adaptive);
+	}
+
+	/**
+	 * Start collecting the cells of an avoidance query, dropping what's left of the last one in that direction.
+	 * @param InDirection The Direction of the query.
+	 * @param CellCount How many cells the query traces.
+	 */
+	FORCEINLINE void BeginAvoidanceCells(const EAgentAvoidanceTraceDirection InDirection, const uint8 CellCount)
+	{
+		const uint8 DirectionIndex = (uint8)InDirection;
+		AvoidanceCellsPending[DirectionIndex] = CellCount;
+		AvoidanceBlockedCells &= ~(1 << DirectionIndex);
+	}
+
+	/**
+	 * Fold the result of one cell into its avoidance query.
+	 * @param InDirection The Direction of the query the cell belongs to.
+	 * @param bInBlocked Whether the cell was blocked.
+	 * @param bOutBlocked Whether any of the query's cells were blocked, only set once they're all in.
+	 * @return True if that was the last cell of the query.
+	 */
+	FORCEINLINE bool AddAvoidanceCell(const EAgentAvoidanceTraceDirection InDirection, const bool bInBlocked, bool& bOutBlocked)
 	{
-		PathTask.SetResult(InResult);
+		const uint8 DirectionIndex = (uint8)InDirection;
+		const uint8 DirectionFlag = 1 << DirectionIndex;
+		if(bInBlocked)
+		{
+			AvoidanceBlockedCells |= DirectionFlag;
+		}
+		if(AvoidanceCellsPending[DirectionIndex] > 1)
+		{
+			AvoidanceCellsPending[DirectionIndex]--;
+			return false;
+		}
+		AvoidanceCellsPending[DirectionIndex] = 0;
+		bOutBlocked = (AvoidanceBlockedCells & DirectionFlag) != 0;
+		return true;
 	}
 
 	/**
@@ -608,25 +980,30 @@ public:
 	 */
 	FORCEINLINE void UpdateAvoidanceResult(
 		const EAgentAvoidanceTraceDirection& InDirection,
-		const bool bInResult)
+		const bool bInResult, const FAgentAdaptiveIntervalSettings& Adaptive)
 	{
 		const FAgentTraceResult NewResult = FAgentTraceResult(
 			bInResult, FVector::ZeroVector);
-	
+
+		TAgentTaskHandle<FAgentTraceResult>* Task = nullptr;
 		switch(InDirection)
 		{
 			case EAgentAvoidanceTraceDirection::TracingFront:
-				AvoidanceFrontTask.SetResult(NewResult);
+				Task = &AvoidanceFrontTask;
 				break;
 			case EAgentAvoidanceTraceDirection::TracingRight:
-				AvoidanceRightTask.SetResult(NewResult);
+				Task = &AvoidanceRightTask;
 				break;
 			case EAgentAvoidanceTraceDirection::TracingLeft:
-				AvoidanceLeftTask.SetResult(NewResult);
+				Task = &AvoidanceLeftTask;
 				break;
 			default:
-				break;
+				return;
 		}
+
+		const bool bChanged = Task->GetResult().IsBlocked() != NewResult.IsBlocked();
+		Task->SetResult(NewResult);
+		Task->UpdateTickRate(bChanged, Adaptive);
 	}
 	
 	/**
@@ -635,15 +1012,17 @@ public:
 	 * @param bSuccess Whether or not the Floor Check worked.
 	*/
 	FORCEINLINE void UpdateFloorCheckResult(
-		const FVector& HitLocation, const bool bSuccess)
+		const FVector& HitLocation, const bool bSuccess, const FAgentAdaptiveIntervalSettings& Adaptive)
 	{
 		// Make sure we set it to 0.0f if the trace failed in order to overwrite the old data
 		const FAgentTraceResult NewResult = FAgentTraceResult(
 			bSuccess,
 			(bSuccess) ? (HitLocation) : (FVector::ZeroVector)
 		);
-		
+
+		const bool bChanged = HasTraceResultChanged(FloorCheckTask.GetResult(), NewResult);
 		FloorCheckTask.SetResult(NewResult);
+		FloorCheckTask.UpdateTickRate(bChanged, Adaptive);
 	}
 
 	/**
@@ -652,21 +1031,35 @@ public:
 	 * @param bStepDetected Whether or not a step was detected.
 	 */
 	FORCEINLINE void UpdateStepCheckResult(
-		const FVector& HitLocation, const bool bStepDetected)
+		const FVector& HitLocation, const bool bStepDetected, const FAgentAdaptiveIntervalSettings& Adaptive)
 	{
 		// Make sure we set it to 0.0f if the trace failed in order to overwrite the old data
 		const FAgentTraceResult NewResult = FAgentTraceResult(
 			bStepDetected,
 			(bStepDetected) ? (HitLocation) : (FVector::ZeroVector)
 		);
-		
+
+		const bool bChanged = HasTraceResultChanged(StepCheckTask.GetResult(), NewResult);
 		StepCheckTask.SetResult(NewResult);
+		StepCheckTask.UpdateTickRate(bChanged, Adaptive);
+	}
+
+	FORCEINLINE void UpdateLocalBoundsCheckResult(const FAgentAdaptiveIntervalSettings& Adaptive,
+		FAgentLocalBoundsCheckResult&& InResult = FAgentLocalBoundsCheckResult())
+	{
+		const FAgentLocalBoundsCheckResult& OldResult = LocalBoundsCheckTask.GetResult();
+		const bool bChanged = (OldResult.bIsValidResult != InResult.bIsValidResult) ||
+			!FMath::IsNearlyEqual(OldResult.GetHighestHitPoint().Z, InResult.GetHighestHitPoint().Z, 1.0f);
+		
+		LocalBoundsCheckTask.SetResult(MoveTemp(InResult));
+		LocalBoundsCheckTask.UpdateTickRate(bChanged, Adaptive);
 	}
 
-	FORCEINLINE void UpdateLocalBoundsCheckResult(
-		const FAgentLocalBoundsCheckResult& InResult = FAgentLocalBoundsCheckResult())
+	/** Did a ground trace hit something else, or the same thing at a different height? Within a centimetre is the same. */
+	static FORCEINLINE bool HasTraceResultChanged(const FAgentTraceResult& OldResult, const FAgentTraceResult& NewResult)
 	{
-		LocalBoundsCheckTask.SetResult(InResult);
+		return (OldResult.bIsValidResult != NewResult.bIsValidResult) ||
+			!FMath::IsNearlyEqual(OldResult.GetHitZValue(), NewResult.GetHitZValue(), 1.0f);
 	}
 	
 	/**
@@ -690,71 +1083,1084 @@ public:
 	}
 
 	/**
-	 * Update the Speed of the AgentClient,
-	 * this is so users can easily check the speed of the Agent.
+	 * Record where the Agent is this frame, keeping where it was last frame.
 	 * @param Location Location of the Agent.
-	 * @param DeltaTime Time passed since last frame.
 	 */
-	FORCEINLINE void CalculateAndUpdateSpeed(
-		const FVector& Location,
-		const float DeltaTime)
+	FORCEINLINE void UpdatePosition(const FVector& Location)
 	{
 		PositionLastFrame = PositionThisFrame;
 		PositionThisFrame = Location;
-		const float Distance = FNAICalculator::Distance(PositionThisFrame, PositionLastFrame);
-		Speed = Distance / DeltaTime;
-		AgentClient->Speed = Speed;
 	}
+
+	/** Heap memory used by the path this Agent is following, in bytes. */
+	FORCEINLINE SIZE_T GetPathAllocatedSize() const { return PathTask.GetResult().Points.GetAllocatedSize(); }
+
+	FORCEINLINE const FVector& GetPositionThisFrame() const { return PositionThisFrame; }
+	FORCEINLINE const FVector& GetPositionLastFrame() const { return PositionLastFrame; }
+
+	/**
+	 * Update the Speed of the Agent. The AgentClient is given it in the ApplyTransforms phase,
+	 * this is called from the worker threads so it mustn't touch the Actor.
+	 * @param InSpeed The new speed, worked out by the AdvanceTimers phase.
+	 */
+	FORCEINLINE void SetSpeed(const float InSpeed) { Speed = InSpeed; }
 };
 
 /**
- * This is the AgentManager. It serves as the "Brain"
- * behind each and every AI, or "Agent". All movement,
- * related tasks, like pathfinding, then following that path,
- * then local avoidance, stepping up/down ledges/stairs, and
- * anything else related to moving and Agent. This avoids the
- * need for a Controller, and it prevents having loads of AI's
- * which all each implement their own Tick() function. Having
- * everything be done in one object like this, significantly
- * improves performance.
- *
- * Everything in here is designed to be as tight as possible
- * when it comes to memory usage. We don't really care about
- * the amount of memory used since it's tiny anyway, but we do
- * care about avoiding references and the heap as much as possible
- * so we can abuse the stack for the speed benefits. 
+ * Everything the Compute phase needs to move one Agent.
+ * This is filled in on the GameThread during the Prepare phase, so the
+ * Compute phase never has to touch the Agent, or its Actor, directly.
  */
-UCLASS(BlueprintType)
-class NAI_API ANAIAgentManager : public AActor
+struct NAI_API FAgentPendingMove : public FNAISimMove
 {
-	GENERATED_BODY()
-	
-public:	
+	/** The Agent this move is for. */
+	FGuid Guid;
+};
+
+/**
+ * The tasks that are due for one Agent this frame.
+ * Built by the GatherDueTasks phase, and used by the IssueQueries phase.
+ */
+struct NAI_API FAgentDueTasks
+{
+	/** The Agent the tasks are for. */
+	FGuid Guid;
+	/** Combination of the AGENT_TASK_XXXX flags in NAIAgentManager.cpp */
+	uint8 TaskFlags;
+
+	FVector Location;
+	/** Where the Agent is expected to be by the time the results get used. The traces and sweeps are sent from here. */
+	FVector QueryLocation;
+	FVector Forward;
+	FVector Right;
+
+	/** Handle default initialization. */
+	FAgentDueTasks() : TaskFlags(0),
+		Location(FVector::ZeroVector),
+		QueryLocation(FVector::ZeroVector),
+		Forward(FVector::ForwardVector),
+		Right(FVector::RightVector)
+	{ }
+};
+
+/**
+ * How many of an Agent's queries are still out.
+ * The manager that sends the queries owns these, keyed by the Agent's Guid, and keeps each one until
+ * every query sent for the Agent has come back. The Agent can be moved, handed off or pooled in the
+ * meantime, its late results reach the manager and are thrown away.
+ */
+struct NAI_API FAgentQueryRecord
+{
+	/** Queries sent for the Agent that haven't come back yet. */
+	int32 QueriesInFlight;
+	/** Of those, how many the next lockstep step is waiting on. Taken off the manager's count when the Agent leaves. */
+	int32 LockstepQueriesInFlight;
+	/** Set once the Agent has left the manager. The record is dropped when its last query comes back. */
+	uint8 bIsReleased : 1;
+
+	/** Handle default initialization. */
+	FAgentQueryRecord() : QueriesInFlight(0),
+		LockstepQueriesInFlight(0),
+		bIsReleased(false)
+	{ }
+};
+
+/** An AgentClient to pick an animation LOD for, and the shard that moves it. */
+struct NAI_API FAgentAnimationCandidate
+{
+	/** To the nearest local player. */
+	float DistanceSquared;
+	ANAIAgentClient* AgentClient;
+	ANAIAgentManager* Shard;
+
+	/** Handle default initialization. */
+	FAgentAnimationCandidate(const float InDistanceSquared, ANAIAgentClient* InAgentClient, ANAIAgentManager* InShard)
+		: DistanceSquared(InDistanceSquared),
+		AgentClient(InAgentClient),
+		Shard(InShard)
+	{ }
+};
+
+/** The state of a single Agent, as published at the end of a frame. */
+struct NAI_API FAgentPublishedState
+{
+	FGuid Guid;
+	FVector Location;
+	float Yaw;
+
+	/** Handle default initialization. */
+	FAgentPublishedState() : Location(FVector::ZeroVector),
+		Yaw(0.0f)
+	{ }
+};
+
+/** Everything the AgentManager publishes to the outside world each frame. */
+struct NAI_API FAgentManagerPublishedState
+{
+	int32 AgentCount;
+	int32 HaltedAgentCount;
+	int32 MovedAgentCount;
+	/** The Agents that moved this frame, and where they ended up. */
+	TArray<FAgentPublishedState> MovedAgents;
+
+	/** Handle default initialization. */
+	FAgentManagerPublishedState() : AgentCount(0),
+		HaltedAgentCount(0),
+		MovedAgentCount(0)
+	{ }
+};
+
+/**
+ * How long each phase of the AgentManager's frame took.
+ * Each phase only ever writes to its own slot, so these can be
+ * updated from whichever thread the phase runs on.
+ */
+struct NAI_API FAgentManagerPhaseTimings
+{
+	/** How long each phase took the last time it ran, in milliseconds. */
+	float LastMs[(uint8)EAgentManagerPhase::Count];
+	/** Rolling average of each phase, in milliseconds. */
+	float AverageMs[(uint8)EAgentManagerPhase::Count];
+
+	/** Handle default initialization. */
+	FAgentManagerPhaseTimings()
+	{
+		FMemory::Memzero(LastMs);
+		FMemory::Memzero(AverageMs);
+	}
+
+	FORCEINLINE void Record(const EAgentManagerPhase Phase, const float Milliseconds)
+	{
+		const uint8 Index = (uint8)Phase;
+		LastMs[Index] = Milliseconds;
+		AverageMs[Index] = FMath::Lerp(AverageMs[Index], Milliseconds, 0.1f);
+	}
+};
+
+/** Times the scope it's in, and records it against a phase. */
+struct NAI_API FAgentManagerPhaseScope
+{
+	FAgentManagerPhaseScope(FAgentManagerPhaseTimings& InTimings, const EAgentManagerPhase InPhase)
+		: Timings(InTimings), Phase(InPhase), StartCycles(FPlatformTime::Cycles64())
+	{ }
+
+	~FAgentManagerPhaseScope()
+	{
+		const uint64 Cycles = FPlatformTime::Cycles64() - StartCycles;
+		Timings.Record(Phase, (float)FPlatformTime::ToMilliseconds64(Cycles));
+	}
+
+private:
+	FAgentManagerPhaseTimings& Timings;
+	EAgentManagerPhase Phase;
+	uint64 StartCycles;
+};
+
+/** How many world queries the IssueQueries phase sent off this frame. */
+struct NAI_API FAgentManagerQueryCounts
+{
+	int32 PathQueries;
+	int32 LineTraces;
+	int32 Sweeps;
+
+	/** Handle default initialization. */
+	FAgentManagerQueryCounts() : PathQueries(0),
+		LineTraces(0),
+		Sweeps(0)
+	{ }
+
+	FORCEINLINE void Reset() { *this = FAgentManagerQueryCounts(); }
+	FORCEINLINE int32 GetTotal() const { return PathQueries + LineTraces + Sweeps; }
+};
+
+/**
+ * How long the Agents' tasks took from their query being sent off, to the result coming back.
+ * The buckets double in size, from under 1ms up to 64ms and over.
+ */
+struct NAI_API FAgentTaskLatencyHistogram
+{
+	static constexpr int32 BucketCount = 8;
+
+	uint32 Counts[BucketCount];
+
+	/** Handle default initialization. */
+	FAgentTaskLatencyHistogram() { Reset(); }
+
+	FORCEINLINE void Reset() { FMemory::Memzero(Counts); }
+
+	FORCEINLINE void Record(const float LatencyMs)
+	{
+		// Bucket 0 is under 1ms, then each bucket is twice as wide as the last
+		const int32 Bucket = (LatencyMs < 1.0f) ? 0 : (1 + (int32)FMath::FloorLog2((uint32)FMath::Min(LatencyMs, 65536.0f)));
+		Counts[FMath::Min(Bucket, BucketCount - 1)]++;
+	}
+
+	/** The upper bound of a bucket in milliseconds. The last bucket has no upper bound. */
+	static FORCEINLINE float GetBucketLimitMs(const int32 Bucket) { return (float)(1 << Bucket); }
+
+	FORCEINLINE uint32 GetTotal() const
+	{
+		uint32 Total = 0;
+		for(const uint32 Count : Counts)
+		{
+			Total += Count;
+		}
+		return Total;
+	}
+};
+
+/**
+ * What a manager's Agents cost in memory, in bytes.
+ * This counts what can be seen from the containers and objects themselves,
+ * run with -llm to see everything the NAI tags caught instead.
+ */
+struct NAI_API FAgentManagerMemoryFootprint
+{
+	int32 AgentCount;
+	/** The FAgent records, and the containers that index them. */
+	SIZE_T AgentRecordBytes;
+	/** The path points the Agents are following. */
+	SIZE_T PathBytes;
+	/** The query records the results come back through, and the frame arena the trace results are kept in. */
+	SIZE_T TraceResultBytes;
+	/** The AgentClient actors and their components. */
+	SIZE_T ActorBytes;
+
+	/** Handle default initialization. */
+	FAgentManagerMemoryFootprint() : AgentCount(0),
+		AgentRecordBytes(0),
+		PathBytes(0),
+		TraceResultBytes(0),
+		ActorBytes(0)
+	{ }
+
+	FORCEINLINE SIZE_T GetTotal() const { return AgentRecordBytes + PathBytes + TraceResultBytes + ActorBytes; }
+
+	FAgentManagerMemoryFootprint& operator+=(const FAgentManagerMemoryFootprint& Other)
+	{
+		AgentCount += Other.AgentCount;
+		AgentRecordBytes += Other.AgentRecordBytes;
+		PathBytes += Other.PathBytes;
+		TraceResultBytes += Other.TraceResultBytes;
+		ActorBytes += Other.ActorBytes;
+		return *this;
+	}
+};
+
+/**
+ * A group of Agents moving together. Only the leader paths, the members follow their slots,
+ * which are laid out along the trail the leader leaves behind it so they follow it round corners.
+ * The members never issue path queries or avoidance traces of their own.
+ */
+struct NAI_API FAgentGroup
+{
+	FGuid Leader;
+	/** The members, the member at each index follows the slot at the same index. */
+	TArray<FGuid> Members;
+	/** Each slot's offset from the leader. X is how far back along the trail, Y how far to the right of it. */
+	TArray<FVector2D> SlotOffsets;
+	/** Where each slot is, projected onto the navmesh. Worked out by UpdateAgentGroups(). */
+	TArray<FVector> SlotLocations;
+	/** Where the leader has been, newest last. A point is added each time it's moved half the spacing. */
+	TArray<FVector> Trail;
+	/** The most points the Trail needs, to reach the slot furthest back. */
+	int32 MaxTrailPoints;
+	float Spacing;
+	/** Counts down to the next time the slots are worked out. */
+	float SlotUpdateTime;
+
+	/** Handle default initialization. */
+	FAgentGroup() : MaxTrailPoints(2),
+		Spacing(150.0f),
+		SlotUpdateTime(0.0f)
+	{ }
+};
+
+/** A change to the groups, queued up until the Agent set isn't locked. */
+struct NAI_API FAgentGroupRequest
+{
+	int32 GroupId;
+	/** Empty when the group is to be disbanded. */
+	TArray<FGuid> Agents;
+	EAgentFormation Formation;
+	float Spacing;
+
+	/** Handle default initialization. */
+	FAgentGroupRequest() : GroupId(INDEX_NONE),
+		Formation(EAgentFormation::Column),
+		Spacing(150.0f)
+	{ }
+};
+
+/** A spawn queued up by ANAIAgentManager::SpawnAgents(), waiting for the spawn budget. */
+struct NAI_API FAgentSpawnRequest
+{
+	TSubclassOf<ANAIAgentClient> AgentClass;
+	FTransform Transform;
+
+	/** Handle default initialization. */
+	FAgentSpawnRequest() : AgentClass(nullptr),
+		Transform(FTransform::Identity)
+	{ }
+
+	FAgentSpawnRequest(const TSubclassOf<ANAIAgentClient>& InAgentClass, const FTransform& InTransform)
+		: AgentClass(InAgentClass), Transform(InTransform)
+	{ }
+};
+
+/**
+ * The pooled AgentClients of a single class, along with their Agents.
+ * Both arrays are always the same length, the Agent at each index belongs
+ * to the client at the same index.
+ */
+USTRUCT()
+struct NAI_API FNAIAgentClientPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<ANAIAgentClient*> Clients;
+
+	UPROPERTY()
+	TArray<FAgent> Agents;
+};
+
+/** The phases of the AgentManager's tick that run outside the PrimaryActorTick. */
+enum class NAI_API EAgentManagerTickPhase : uint8
+{
+	Compute,
+	Apply,
+};
+
+/**
+ * Secondary tick function for the AgentManager.
+ * The PrimaryActorTick is the Prepare phase, and two of these
+ * are used for the Compute and Apply phases.
+ */
+USTRUCT()
+struct NAI_API FNAIAgentManagerTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	/** The manager this tick function belongs to. */
+	class ANAIAgentManager* Target;
+	/** Which phase of the manager's tick this runs. */
+	EAgentManagerTickPhase Phase;
+
+	/** Handle default initialization. */
+	FNAIAgentManagerTickFunction() : Target(nullptr),
+		Phase(EAgentManagerTickPhase::Compute)
+	{ }
+
+	virtual void ExecuteTick(
+		float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread,
+		const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+	virtual FName DiagnosticContext(bool bDetailed) override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FNAIAgentManagerTickFunction> : public TStructOpsTypeTraitsBase2<FNAIAgentManagerTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/**
+ * This is the AgentManager. It serves as the "Brain"
+ * behind each and every AI, or "Agent". All movement,
+ * related tasks, like pathfinding, then following that path,
+ * then local avoidance, stepping up/down ledges/stairs, and
+ * anything else related to moving and Agent. This avoids the
+ * need for a Controller, and it prevents having loads of AI's
+ * which all each implement their own Tick() function. Having
+ * everything be done in one object like this, significantly
+ * improves performance.
+ *
+ * Everything in here is designed to be as tight as possible
+ * when it comes to memory usage. We don't really care about
+ * the amount of memory used since it's tiny anyway, but we do
+ * care about avoiding references and the heap as much as possible
+ * so we can abuse the stack for the speed benefits. 
+ */
+UCLASS(BlueprintType)
+class NAI_API ANAIAgentManager : public AActor, public INAISimQueryListener
+{
+	GENERATED_BODY()
+
+	/** Lines the shards' tick functions up behind the lead shard's. */
+	friend class FNAIAgentManagerRegistry;
+	
+public:	
 	/** Sets default values for this Agent's properties */
 	ANAIAgentManager();
 
 	/**
-	 * If the Agent type is PathToPlayer, we need to know which class the player
-	 * is so that we can then path to it.
+	 * If the Agent type is PathToPlayer, we need to know which class the player
+	 * is so that we can then path to it.
+	 */
+	UPROPERTY(EditAnywhere)
+	TSubclassOf<AActor> PlayerClass;
+
+	/** The maximum amount of Agents this manager should be allowed to spawn. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AgentManager|Agents|Limits", meta =
+		(ClampMin = 0, ClampMax = 10000, UIMin = 0, UIMax = 10000))
+	int MaxAgentCount;
+
+	/**
+	 * If true, this manager owns every Agent in the world that isn't inside another shard's region.
+	 * There should only be one of these per level.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Sharding")
+	bool bOwnsEntireWorld;
+
+	/**
+	 * The region of the world this manager (shard) is responsible for.
+	 * Agents that move out of it are handed off to whichever shard owns their new location.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Sharding", meta =
+		(EditCondition = "!bOwnsEntireWorld"))
+	FBox ShardRegion;
+
+	/**
+	 * Run the Compute phase on a worker thread while physics is simulating.
+	 * Turn this off to keep it on the GameThread when debugging.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category = "AgentManager|Ticking")
+	bool bRunComputeOffGameThread;
+
+	/** The AgentClient class to fill the pool with on BeginPlay, and to spawn when no class is given. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Spawning")
+	TSubclassOf<ANAIAgentClient> PooledAgentClass;
+
+	/** How many PooledAgentClass actors to create up front, so spawning them later is just a teleport. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Spawning", meta =
+		(ClampMin = 0, ClampMax = 10000, UIMin = 0, UIMax = 10000))
+	int32 PoolPrewarmCount;
+
+	/** The most AgentClients the pool will hold on to. Anything despawned past this is destroyed. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AgentManager|Spawning", meta =
+		(ClampMin = 0, ClampMax = 10000, UIMin = 0, UIMax = 10000))
+	int32 MaxPooledAgents;
+
+	/** The most queued spawns that will be processed in a single frame. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AgentManager|Spawning", meta =
+		(ClampMin = 1, ClampMax = 1000, UIMin = 1, UIMax = 1000))
+	int32 MaxSpawnsPerFrame;
+
+	/** How long, in milliseconds, the queued spawns are allowed to take each frame. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AgentManager|Spawning", meta =
+		(ClampMin = 0, ClampMax = 33, UIMin = 0, UIMax = 33))
+	float SpawnBudgetMs;
+
+	/**
+	 * Replicate this manager's Agents to clients, through a grid of ANAIAgentReplicationProxy actors.
+	 * Clients don't simulate the Agents at all, they just move a local AgentClient for each one.
+	 * Set this on the client's copy of the manager too.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Replication")
+	bool bReplicateAgents;
+
+	/** The size of each replication cell. Smaller cells cull more precisely, but need more proxies. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Replication", meta =
+		(EditCondition = "bReplicateAgents", ClampMin = 500, UIMin = 500, UIMax = 20000))
+	float ReplicationCellSize;
+
+	/** How far from a player a cell is still replicated to them. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Replication", meta =
+		(EditCondition = "bReplicateAgents", ClampMin = 0))
+	float ReplicationRelevancyDistance;
+
+	/** Cells closer than this to a player use NearUpdateRate, and get the highest priority. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Replication", meta =
+		(EditCondition = "bReplicateAgents", ClampMin = 0))
+	float ReplicationNearDistance;
+
+	/** Cells further than this from every player use FarUpdateRate, anything between uses MidUpdateRate. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Replication", meta =
+		(EditCondition = "bReplicateAgents", ClampMin = 0))
+	float ReplicationFarDistance;
+
+	/** Updates per second for the cells near a player. The Agents' state is gathered at this rate too. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Replication", meta =
+		(EditCondition = "bReplicateAgents", ClampMin = 1, ClampMax = 60))
+	float NearUpdateRate;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Replication", meta =
+		(EditCondition = "bReplicateAgents", ClampMin = 1, ClampMax = 60))
+	float MidUpdateRate;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Replication", meta =
+		(EditCondition = "bReplicateAgents", ClampMin = 0.5, ClampMax = 60))
+	float FarUpdateRate;
+
+	/**
+	 * How far in the past clients draw the Agents, in seconds, so there's a state either side to blend between.
+	 * Agents in slower updating cells are drawn further back, to match their update rate.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Replication", meta =
+		(EditCondition = "bReplicateAgents", ClampMin = 0, ClampMax = 1))
+	float ClientInterpolationDelay;
+
+	/**
+	 * Run the simulation in lockstep, so every peer given the same commands ends up with the same crowd.
+	 * The manager steps at a fixed rate, only once every peer's commands for the step are in, and holds
+	 * the query results back until they're all in so they can be applied in Agent order.
+	 * Agents may then only be spawned, despawned and sent somewhere through IssueLockstepCommand().
+	 * Peers must run the same build, on the same platform, with a single manager in the World.
+	 * Not to be used together with bReplicateAgents.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Lockstep")
+	bool bLockstep;
+
+	/** Steps per second. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Lockstep", meta =
+		(EditCondition = "bLockstep", ClampMin = 1, ClampMax = 60))
+	float LockstepTickRate;
+
+	/** How many steps ahead commands are scheduled, to give them time to reach the other peers. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Lockstep", meta =
+		(EditCondition = "bLockstep", ClampMin = 0, ClampMax = 30))
+	int32 LockstepInputDelay;
+
+	/**
+	 * Wait for ConfirmLockstepStep() before running each step. Turn this off when there's only one peer,
+	 * or the commands are all known up front, like in a replay.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AgentManager|Lockstep", meta =
+		(EditCondition = "bLockstep"))
+	bool bLockstepWaitForConfirmation;
+
+	/** This peer's id. Every peer needs a different one. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AgentManager|Lockstep", meta =
+		(EditCondition = "bLockstep", ClampMin = 0, ClampMax = 255))
+	int32 LockstepPeerId;
+
+	/** Seeds GetLockstepRandom(). Every peer needs the same one. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AgentManager|Lockstep", meta =
+		(EditCondition = "bLockstep"))
+	int32 LockstepSeed;
+
+	/** Called with every command this peer issues. Send these to the other peers. */
+	UPROPERTY(BlueprintAssignable, Category = "AgentManager|Lockstep")
+	FNAILockstepCommandSignature OnLockstepCommandIssued;
+
+	/** Called with the checksum of every step. Send these to the other peers to check for desyncs. */
+	UPROPERTY(BlueprintAssignable, Category = "AgentManager|Lockstep")
+	FNAILockstepChecksumSignature OnLockstepChecksum;
+
+	/** Called when another peer's checksum doesn't match ours, or one of its commands arrives too late to run. */
+	UPROPERTY(BlueprintAssignable, Category = "AgentManager|Lockstep")
+	FNAILockstepChecksumSignature OnLockstepDesync;
+
+	/**
+	 * Pick how each AgentClient's skeletal mesh animates, from its distance to the nearest local player,
+	 * and keep the animation work done each frame under MaxAnimationUpdatesPerFrame.
+	 * The nearest Agents animate every frame, then at ReducedAnimationRate, and the rest copy a shared pose,
+	 * or hold their last pose if sharing is off. Not run on dedicated servers, nothing is drawn there.
+	 * The World's shards share one budget and one set of pose leaders, using the lead shard's settings.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Animation")
+	bool bBudgetAnimation;
+
+	/** Agents closer than this to a player animate every frame, as long as the budget allows. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Animation", meta =
+		(EditCondition = "bBudgetAnimation", ClampMin = 0))
+	float FullAnimationDistance;
+
+	/** Agents closer than this to a player animate at ReducedAnimationRate, further ones share a pose. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Animation", meta =
+		(EditCondition = "bBudgetAnimation", ClampMin = 0))
+	float ReducedAnimationDistance;
+
+	/** Animation updates per second for Agents at the Reduced LOD. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Animation", meta =
+		(EditCondition = "bBudgetAnimation", ClampMin = 1, ClampMax = 60))
+	float ReducedAnimationRate;
+
+	/**
+	 * The most skeletal mesh animation updates to do each frame, across every shard's Agents and the pose leaders.
+	 * Once it's used up, the remaining Agents drop to a cheaper LOD, nearest first.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Animation", meta =
+		(EditCondition = "bBudgetAnimation", ClampMin = 0))
+	int32 MaxAnimationUpdatesPerFrame;
+
+	/**
+	 * How many pose leaders to make for each skeletal mesh. Far away Agents copy the pose of one of these,
+	 * so a handful of animation updates covers all of them. Zero turns sharing off, and they're frozen instead.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Animation", meta =
+		(EditCondition = "bBudgetAnimation", ClampMin = 0, ClampMax = 16))
+	int32 SharedPoseLeaderCount;
+
+	/**
+	 * The animation the pose leaders loop for each skeletal mesh, with their start times spread out so the
+	 * crowd doesn't move in step. Meshes not in here run the Agents' own animation blueprint instead.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Animation", meta =
+		(EditCondition = "bBudgetAnimation"))
+	TMap<USkeletalMesh*, UAnimationAsset*> SharedPoseAnimations;
+
+	/** How often, in seconds, the Agents' animation LODs are picked again. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Animation", meta =
+		(EditCondition = "bBudgetAnimation", ClampMin = 0, ClampMax = 2))
+	float AnimationLODUpdateInterval;
+
+	/** How often, in seconds, the groups' slots are worked out and projected onto the navmesh. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Groups", meta =
+		(ClampMin = 0, ClampMax = 2))
+	float GroupSlotUpdateInterval;
+
+	/** How much faster than their normal speed group members may move to catch up with their slot. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Groups", meta =
+		(ClampMin = 1, ClampMax = 4))
+	float GroupCatchUpSpeedScale;
+
+	/**
+	 * Send the traces and sweeps from where each Agent is expected to be when their results are used,
+	 * rather than where it is when they're sent. The Agent is moved along its path by its current speed,
+	 * for the average time the results take to come back plus a frame for the move that uses them,
+	 * plus half of the task's current interval, as each result is used until the next one arrives.
+	 * In lockstep the results are always used on the step after, so two steps stand in for the latency.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|LookAhead")
+	bool bPredictQueries;
+
+	/** The furthest ahead the traces and sweeps are sent, in seconds. Stops a hitch sending them off around corners. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|LookAhead", meta =
+		(EditCondition = "bPredictQueries", ClampMin = 0, ClampMax = 1))
+	float MaxLookAheadTime;
+
+	/**
+	 * Let each Agent's queries slow down while their results aren't changing. Every time a result comes back
+	 * the same as the last, and the Agent has moved less than AdaptiveMoveThreshold since the query before it,
+	 * that task's interval is stretched by AdaptiveIntervalBackoff, up to MaxAdaptiveIntervalScale times its
+	 * base interval. The first result that differs, or a query sent after a bigger move, snaps it straight back.
+	 * Results that outlive two intervals are flagged as stale, and aren't used for avoidance or ground height.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|AdaptiveIntervals")
+	bool bAdaptiveQueryIntervals;
+
+	/** What a task's interval is multiplied by each time its result comes back unchanged. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|AdaptiveIntervals", meta =
+		(EditCondition = "bAdaptiveQueryIntervals", ClampMin = 1, ClampMax = 4))
+	float AdaptiveIntervalBackoff;
+
+	/** The longest a task's interval can get, as a multiple of its base interval. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|AdaptiveIntervals", meta =
+		(EditCondition = "bAdaptiveQueryIntervals", ClampMin = 1, ClampMax = 16))
+	float MaxAdaptiveIntervalScale;
+
+	/**
+	 * How far an Agent can move between sending one query and the next, with the interval still stretching.
+	 * Also how far a path's corners can move and the path still count as unchanged.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|AdaptiveIntervals", meta =
+		(EditCondition = "bAdaptiveQueryIntervals", ClampMin = 0))
+	float AdaptiveMoveThreshold;
+
+	/**
+	 * Let Agents with nothing to do go dormant. Dormant Agents are left out of every per frame loop,
+	 * so the cost of a frame follows the active Agents rather than all of them. Agents go dormant when
+	 * they're halted, have reached the end of their path, or are further than DormancyDistance from every
+	 * player. They wake on WakeAgent(), WakeAgentsInRadius() or WakeAllAgents(), when they take damage,
+	 * when a player comes close, and every DormancyHeartbeat to check they still have nothing to do.
+	 * Agents in a group never go dormant, and nothing does in lockstep.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Dormancy")
+	bool bAllowDormancy;
+
+	/** How close to the end of its path an Agent has to be to count as having reached it. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Dormancy", meta =
+		(EditCondition = "bAllowDormancy", ClampMin = 0))
+	float DormancyGoalRadius;
+
+	/**
+	 * Agents further than this from every player go dormant, and wake when one comes within 90% of it.
+	 * They stop where they are, so only use this where that won't be noticed. Zero keeps far Agents awake.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Dormancy", meta =
+		(EditCondition = "bAllowDormancy", ClampMin = 0))
+	float DormancyDistance;
+
+	/** How long, in seconds, an Agent stays dormant before waking to check if it still has nothing to do. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Dormancy", meta =
+		(EditCondition = "bAllowDormancy", ClampMin = 0.5))
+	float DormancyHeartbeat;
+
+	/**
+	 * How long, in seconds, it takes to check every dormant Agent for a player nearby or its heartbeat.
+	 * The checks are spread over the frames, so only a slice of the dormant Agents is looked at each one.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Dormancy", meta =
+		(EditCondition = "bAllowDormancy", ClampMin = 0.05, ClampMax = 10))
+	float DormancyCheckInterval;
+
+	/**
+	 * Keep a coarse grid of how crowded each part of the world is, rebuilt every frame from the Agents' locations.
+	 * Paths are made to cost more through crowded areas, so the Agents spread out over the other routes,
+	 * and the Agents are pushed down the density gradient, which keeps them apart without checking every pair.
+	 * Each shard only counts its own Agents.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Density")
+	bool bUseDensityField;
+
+	/** The size of each density cell. Roughly the space a few Agents take up works best. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Density", meta =
+		(EditCondition = "bUseDensityField", ClampMin = 50, UIMin = 50, UIMax = 2000))
+	float DensityCellSize;
+
+	/**
+	 * How much more it costs to path through a cell, for each Agent in it, as a fraction of the normal cost.
+	 * Only used with a Recast navmesh. Zero turns it off.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Density", meta =
+		(EditCondition = "bUseDensityField", ClampMin = 0))
+	float DensityPathCost;
+
+	/** How often, in seconds, the path queries are given a new copy of the density field. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Density", meta =
+		(EditCondition = "bUseDensityField", ClampMin = 0.05, ClampMax = 10))
+	float DensityPathUpdateInterval;
+
+	/** How fast the Agents are pushed away from the crowd, per Agent per cell the density rises over a cell. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Density", meta =
+		(EditCondition = "bUseDensityField", ClampMin = 0))
+	float SeparationStrength;
+
+	/** The fastest the Agents are ever pushed away from the crowd. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Density", meta =
+		(EditCondition = "bUseDensityField", ClampMin = 0))
+	float MaxSeparationSpeed;
+
+	/**
+	 * Agents in cells at least this crowded skip their avoidance traces, and rely on the separation instead.
+	 * The traces would only see the other Agents there anyway. Zero keeps the traces everywhere.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Density", meta =
+		(EditCondition = "bUseDensityField", ClampMin = 0))
+	float DenseAvoidanceThreshold;
+
+	/**
+	 * Take the physics bodies off the AgentClients, so they cost nothing in the physics scene.
+	 * The Agents find each other with a spatial hash of their locations, while the avoidance traces still look
+	 * for the walls, props, players and proxies. Only the Agents nearest the players and the sources given to
+	 * AddCollisionSource() get a collision proxy, a stand in capsule players can bump into and projectiles can hit.
+	 * Moves are swept against the world static geometry only, above step height.
+	 * Only the Agents this shard owns are seen by the hash, Agents across a shard border don't avoid each other.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Collision")
+	bool bPhysicsFreeAgents;
+
+	/** The most collision proxies there can be, i.e. the most Agents with collision at once. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Collision", meta =
+		(EditCondition = "bPhysicsFreeAgents", ClampMin = 0, ClampMax = 1024))
+	int32 CollisionProxyCount;
+
+	/** How close an Agent has to be to a player or collision source to be given a proxy. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AgentManager|Collision", meta =
+		(EditCondition = "bPhysicsFreeAgents", ClampMin = 0))
+	float CollisionProxyDistance;
+	
+protected:
+	/** Called when the game starts or when spawned */
+	virtual void BeginPlay() override;
+
+	/** Called when the game end or when destroyed. */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Registers the Compute and Apply tick functions alongside the PrimaryActorTick. */
+	virtual void RegisterActorTickFunctions(bool bRegister) override;
+
+public:	
+	/**
+	 * Called every frame, in TG_PrePhysics.
+	 * Waits for this shard's AdvanceTimers -> GatherDueTasks chain, then runs
+	 * the IssueQueries phase.
+	 */
+	virtual void Tick(float DeltaTime) override;
+
+	/**
+	 * The Compute tick, in TG_DuringPhysics and usually on a worker thread.
+	 * The lead shard runs the IntegrateMovement phase of every shard in the World at once,
+	 * the other shards' Apply ticks wait for it.
+	 */
+	void TickCompute(const float DeltaTime);
+
+	/**
+	 * The IntegrateMovement phase. Works out the new location and rotation for each of the PendingMoves.
+	 * Only touches this shard's PendingMoves, so the shards can all run it at the same time.
+	 */
+	void IntegrateMovement(const float DeltaTime);
+
+	/**
+	 * The ApplyTransforms phase, in TG_PostPhysics on the GameThread.
+	 * Moves the Agents using the results of IntegrateMovement, hands off
+	 * any Agents that have left this shard, then kicks off PublishState.
+	 */
+	void TickApply(const float DeltaTime);
+
+	/**
+	 * Launch the AdvanceTimers -> GatherDueTasks chain on the task graph.
+	 * The lead shard calls this for every shard in the World, so they all run at once.
+	 * Locks the Agent set until IssueQueries is done.
+	 * @param DeltaTime Time passed since last frame.
+	 */
+	void LaunchSimulationTasks(const float DeltaTime);
+
+	/** Get the timings for each phase of this manager's frame. */
+	FORCEINLINE const FAgentManagerPhaseTimings& GetPhaseTimings() const { return PhaseTimings; }
+
+	/** Get how many queries were sent off by the IssueQueries phase this frame. */
+	FORCEINLINE const FAgentManagerQueryCounts& GetQueryCounts() const { return QueryCounts; }
+
+	/** Get the arena the short lived allocations are made from. */
+	FORCEINLINE const FNAIFrameArena& GetFrameArena() const { return FrameArena; }
+
+	/** Get how many path queries have been sent off, and haven't come back yet. */
+	FORCEINLINE int32 GetPathQueriesInFlight() const { return PathQueriesInFlight; }
+
+	/** Get how long the tasks have taken to get their results back, since the last ResetTaskLatency(). */
+	FORCEINLINE const FAgentTaskLatencyHistogram& GetTaskLatency() const { return TaskLatency; }
+	FORCEINLINE void ResetTaskLatency() { TaskLatency.Reset(); }
+
+	/**
+	 * Count this manager's Agents at each avoidance level. This walks every Agent,
+	 * so it's meant for tools rather than every frame. GameThread only.
+	 * @param OutNormalCount Receives how many Agents use the Normal avoidance grid.
+	 * @param OutAdvancedCount Receives how many Agents use the Advanced avoidance grid.
+	 */
+	void GetAgentCountsByAvoidanceLevel(int32& OutNormalCount, int32& OutAdvancedCount) const;
+
+	/**
+	 * Work out what this manager's Agents cost in memory. This walks every Agent and its
+	 * components, so it's meant for reports rather than every frame. GameThread only,
+	 * and not while the Agent set is locked.
+	 */
+	FAgentManagerMemoryFootprint GetMemoryFootprint() const;
+
+	/**
+	 * Make the given Agents move as a group. The leader paths as normal, and the members follow it in formation
+	 * without any path queries or avoidance traces of their own. Agents already in a group are moved to this one.
+	 * The group is made at the start of the next frame, and is disbanded when it has no members left.
+	 * Agents owned by another shard are left out.
+	 * @param Leader The Agent the others follow.
+	 * @param Members The Agents following the leader, in slot order.
+	 * @param Formation The shape to follow the leader in.
+	 * @param Spacing The distance between each slot.
+	 * @return The group's id, or INDEX_NONE if the group couldn't be made.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Groups")
+	int32 CreateAgentGroup(ANAIAgentClient* Leader, const TArray<ANAIAgentClient*>& Members,
+		const EAgentFormation Formation = EAgentFormation::Column, const float Spacing = 150.0f);
+
+	/** Let a group's Agents go their own way again. */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Groups")
+	void DisbandAgentGroup(const int32 GroupId);
+
+	/** Get how many groups there are. */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Groups")
+	int32 GetAgentGroupCount() const { return AgentGroups.Num(); }
+
+	/** Wake an Agent up if it's dormant. */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Dormancy")
+	void WakeAgent(ANAIAgentClient* AgentClient);
+
+	/** Wake every dormant Agent within a radius, i.e. around an explosion or a noise. */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Dormancy")
+	void WakeAgentsInRadius(const FVector& Location, const float Radius);
+
+	/** Wake every dormant Agent, i.e. when their goal has changed. */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Dormancy")
+	void WakeAllAgents();
+
+	/** Get how many of this manager's Agents are dormant. */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Dormancy")
+	int32 GetDormantAgentCount() const { return DormantAgentGuids.Num(); }
+
+	/**
+	 * Give the Agents near an Actor collision proxies, and have them avoid it, i.e. a projectile or a vehicle.
+	 * The players' pawns are always sources. Only used with bPhysicsFreeAgents.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Collision")
+	void AddCollisionSource(AActor* Source);
+
+	/** Stop an Actor from being a collision source. Sources are also dropped when they're destroyed. */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Collision")
+	void RemoveCollisionSource(AActor* Source);
+
+	/** Get how many collision proxies are standing in for an Agent right now. */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Collision")
+	int32 GetActiveCollisionProxyCount() const;
+
+	/** Get the density field built by the last GatherDueTasks phase. Not while the Agent set is locked. */
+	FORCEINLINE const FNAIDensityField& GetDensityField() const { return DensityField; }
+
+	/** Get how many of this manager's Agents were at the given animation LOD, when they were last picked. */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Stats")
+	int32 GetAnimationLODCount(const EAgentAnimationLOD AnimationLOD) const
+	{
+		return (AnimationLOD < EAgentAnimationLOD::Count) ? AnimationLODCounts[(uint8)AnimationLOD] : 0;
+	}
+
+	/** Get how long the given phase took on average, in milliseconds. */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Stats")
+	float GetPhaseTimeMs(const EAgentManagerPhase Phase) const
+	{
+		return (Phase < EAgentManagerPhase::Count) ? PhaseTimings.AverageMs[(uint8)Phase] : 0.0f;
+	}
+
+	/**
+	 * Get the latest published state. This waits for PublishState
+	 * if it's still running, so don't call it from inside the tick.
 	 */
-	UPROPERTY(EditAnywhere)
-	TSubclassOf<AActor> PlayerClass;
+	const FAgentManagerPublishedState& GetPublishedState() const;
 
-	/** The maximum amount of Agents this manager should be allowed to spawn. */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AgentManager|Agents|Limits", meta =
-		(ClampMin = 0, ClampMax = 10000, UIMin = 0, UIMax = 10000))
-	int MaxAgentCount;
-	
-protected:
-	/** Called when the game starts or when spawned */
-	virtual void BeginPlay() override;
+	/**
+	 * Check if a location is inside the region this shard owns.
+	 * Shards that own the entire world only claim locations that no other shard does,
+	 * so this always returns true for them.
+	 * @param Location The world location to check.
+	 */
+	FORCEINLINE bool OwnsLocation(const FVector& Location) const
+	{
+		return bOwnsEntireWorld || ShardRegion.IsInsideOrOn(Location);
+	}
 
-	/** Called when the game end or when destroyed. */
-	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	/**
+	 * Advance every Agent's timers, and recalculate their speed.
+	 * This doesn't touch anything outside of this shard's own Agents, so the lead
+	 * shard runs it for all of the shards in the world at once on the worker threads.
+	 * @param DeltaTime Time passed since last frame.
+	 */
+	void UpdateAgentTimersAndSpeed(const float DeltaTime);
 
-public:	
-	/** Called every frame */
-	virtual void Tick(float DeltaTime) override;
+	/**
+	 * Take ownership of an Agent handed off by another shard.
+	 * The Agent isn't added until the start of this shard's next Tick(),
+	 * so it never gets processed twice in one frame.
+	 * @param Agent The Agent to take over.
+	 */
+	FORCEINLINE void QueueIncomingAgent(FAgent&& Agent)
+	{
+		LLM_SCOPE_BYTAG(NAI_AgentRecords);
+		IncomingAgents.Add(MoveTemp(Agent));
+	}
+
+	/**
+	 * Queue up Count Agents of the given class to be spawned, spread over the given locations.
+	 * If there are more Agents than locations, the locations are used again from the start.
+	 * Agents are taken from the pool where possible, and the spawns are spread over as
+	 * many frames as needed to stay within MaxSpawnsPerFrame and SpawnBudgetMs.
+	 * @param AgentClass The class of Agent to spawn, or None to use PooledAgentClass.
+	 * @param Count How many Agents to spawn.
+	 * @param Locations Where to spawn the Agents.
+	 * @return How many Agents were queued, this is limited by MaxAgentCount.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Spawning")
+	int32 SpawnAgents(TSubclassOf<ANAIAgentClient> AgentClass, const int32 Count, const TArray<FVector>& Locations);
+
+	/**
+	 * Take the given Agents out of play and put them back in the pool.
+	 * This happens at the end of the frame, in the ApplyTransforms phase.
+	 * @param AgentClients The Agents to despawn.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Spawning")
+	void DespawnAgents(const TArray<ANAIAgentClient*>& AgentClients);
+
+	/** Get how many Agents this manager currently owns. */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Stats")
+	int32 GetAgentCount() const { return AgentMap.Num(); }
+
+	/** Get how many spawns are still waiting for the spawn budget. */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Spawning")
+	int32 GetPendingSpawnCount() const { return SpawnQueue.Num() - SpawnQueueHead; }
+
+	/** Get how many AgentClients are sitting in the pool, ready to be spawned. */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Spawning")
+	int32 GetPooledAgentCount() const { return PooledAgentCount; }
+
+	/**
+	 * Move an Agent out of this manager, if we have it.
+	 * Fails while the Agent set is locked.
+	 * @param Guid The Guid of the Agent to take.
+	 * @param OutAgent Receives the Agent.
+	 * @return Whether or not the Agent was taken.
+	 */
+	bool TakeAgent(const FGuid& Guid, FAgent& OutAgent);
+
+	/** Is this a client copy of a manager whose Agents are replicated from the server? */
+	FORCEINLINE bool IsReplicatedClient() const
+	{
+		return bReplicateAgents && GetNetMode() == NM_Client;
+	}
+
+	/** Get how much the Agents cost to replicate. Only filled in on the server. */
+	FORCEINLINE const FAgentManagerReplicationStats& GetReplicationStats() const { return ReplicationStats; }
+
+	/**
+	 * Called by the proxies on a client when an Agent arrives, or its state changes.
+	 * @param Proxy The proxy of the cell the Agent is in. The state is stamped with its server time.
+	 * @param NetId The Agent's NetId.
+	 * @param AgentClass The class to show the Agent as, or None to use PooledAgentClass.
+	 * @param Location The Agent's quantized location.
+	 * @param Yaw The Agent's quantized yaw.
+	 */
+	void ReceiveReplicatedAgent(const ANAIAgentReplicationProxy* Proxy, const uint32 NetId, UClass* AgentClass,
+		const FVector& Location, const float Yaw);
+
+	/**
+	 * Called by the proxies on a client when an Agent stops being replicated through them.
+	 * Ignored unless it comes from the proxy the Agent was last replicated through.
+	 */
+	void ReceiveReplicatedAgentRemoval(const ANAIAgentReplicationProxy* Proxy, const uint32 NetId);
+
+	/**
+	 * Schedule a command on this peer, LockstepInputDelay steps from now.
+	 * The step, peer and sequence are filled in, along with the NetId for spawns,
+	 * then the command is passed to OnLockstepCommandIssued to be sent to the other peers.
+	 * @return The command as it was scheduled.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Lockstep")
+	FNAILockstepCommand IssueLockstepCommand(FNAILockstepCommand Command);
+
+	/** Schedule a command received from another peer. One for a step we've already run is dropped and calls OnLockstepDesync. */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Lockstep")
+	void ReceiveLockstepCommand(const FNAILockstepCommand& Command);
+
+	/** Every peer's commands up to and including this step have been received, so it can run. */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Lockstep")
+	void ConfirmLockstepStep(const int32 Step);
+
+	/** Get the step that will run next. */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Lockstep")
+	int32 GetLockstepStep() const { return LockstepStep; }
+
+	/**
+	 * Get the checksum of a step that has run, if it's recent enough to still be kept.
+	 * @return False if the step hasn't run, or is too old.
+	 */
+	UFUNCTION(BlueprintPure, Category = "AgentManager|Lockstep")
+	bool GetLockstepChecksum(const int32 Step, int32& OutChecksum) const;
+
+	/**
+	 * Check another peer's checksum against ours. Calls OnLockstepDesync if they differ.
+	 * @return False on a desync. Steps too old or not yet run here are assumed to match.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "AgentManager|Lockstep")
+	bool CompareLockstepChecksum(const int32 Step, const int32 RemoteChecksum);
+
+	/** Random numbers for game code that has to stay in lockstep. Seeded with LockstepSeed on BeginPlay. */
+	FORCEINLINE FRandomStream& GetLockstepRandom() { return LockstepRandom; }
+
+	/** Get the DeltaTime the simulation phases should use this frame. */
+	FORCEINLINE float GetSimulationDeltaTime(const float DeltaTime) const
+	{
+		return bLockstep ? (1.0f / LockstepTickRate) : DeltaTime;
+	}
 	
 public:
 	/**
@@ -765,8 +2171,46 @@ public:
 	 */
 	FORCEINLINE void AddAgent(const FAgent& Agent)
 	{
-		AgentMap.Add(Agent.Guid, Agent);
-		AgentGuids.AddUnique(Agent.Guid);
+		AddAgent(FAgent(Agent));
+	}
+	FORCEINLINE void AddAgent(FAgent&& Agent)
+	{
+		LLM_SCOPE_BYTAG(NAI_AgentRecords);
+
+		// The Agents are being worked on by the task graph, so wait until it's done
+		if(bIsAgentSetLocked)
+		{
+			IncomingAgents.Add(MoveTemp(Agent));
+			return;
+		}
+
+		// Any density field it's in, and its neighbours, belong to the manager it came from
+		Agent.DensitySplatFrame = INDEX_NONE;
+		Agent.NeighbourBlockedDirections = 0;
+		// The cells still out were sent by that manager too, so their results won't come here
+		FMemory::Memzero(Agent.AvoidanceCellsPending);
+		Agent.AvoidanceBlockedCells = 0;
+
+		// Check the map rather than AddUnique() on the guids, that's a linear search per Agent
+		const FGuid Guid = Agent.Guid;
+		const bool bIsNewAgent = !AgentMap.Contains(Guid);
+		AgentMap.Add(Guid, MoveTemp(Agent));
+		if(bIsNewAgent)
+		{
+			// Dormancy belongs to the manager that put the Agent to sleep, here it starts out awake
+			FAgent& Added = AgentMap[Guid];
+			Added.AgentManager = this;
+			if(Added.bIsDormant)
+			{
+				Added.Wake(Added.GetPositionThisFrame());
+			}
+			// The AgentClient may have come from a shard that does things the other way
+			if(IsValid(Added.AgentClient))
+			{
+				Added.AgentClient->SetHasPhysicsBody(!bPhysicsFreeAgents);
+			}
+			AgentGuids.Add(Guid);
+		}
 	}
 	
 	/**
@@ -775,9 +2219,27 @@ public:
 	 */
 	FORCEINLINE void RemoveAgent(const FGuid& Guid)
 	{
-		AgentMap.Remove(Guid);
-		const uint32 Index = AgentGuids.IndexOfByKey(Guid);
-		AgentGuids.RemoveAtSwap(Index);
+		// The Agents are being worked on by the task graph, so wait until it's done
+		if(bIsAgentSetLocked)
+		{
+			OutgoingAgents.AddUnique(Guid);
+			return;
+		}
+		
+		const FAgent* Agent = AgentMap.Find(Guid);
+		if(Agent && Agent->bIsDormant)
+		{
+			DormantAgentGuids.RemoveSwap(Guid);
+		}
+		if(AgentMap.Remove(Guid) > 0)
+		{
+			ReleaseQueryRecord(Guid);
+		}
+		const int32 Index = AgentGuids.IndexOfByKey(Guid);
+		if(Index != INDEX_NONE)
+		{
+			AgentGuids.RemoveAtSwap(Index);
+		}
 	}
 	
 	/**
@@ -802,21 +2264,50 @@ public:
 	FORCEINLINE void UpdateAgentPathResult(
 		const FGuid& Guid, const FAgentPathResult& InResult)
 	{
-		AgentMap[Guid].UpdatePathTaskResults(InResult);
+		// The Agent may have been handed off to another shard while this task was in flight
+		if(FAgent* Agent = AgentMap.Find(Guid))
+		{
+			Agent->UpdatePathTaskResults(FAgentPathResult(InResult), GetAdaptiveIntervalSettings());
+		}
+	}
+	FORCEINLINE void UpdateAgentPathResult(
+		const FGuid& Guid, FAgentPathResult&& InResult)
+	{
+		// The Agent may have been handed off to another shard while this task was in flight
+		if(FAgent* Agent = AgentMap.Find(Guid))
+		{
+			Agent->UpdatePathTaskResults(MoveTemp(InResult), GetAdaptiveIntervalSettings());
+		}
 	}
 	
 	/**
 	* Update the LatestAvoidanceResult for the given direction
 	* on each Agent.
+	* Each grid cell of the query is passed in as it comes back, the result is only
+	* committed, and the tick rate updated, once the last one is in.
 	* @param Guid The Guid of the Agent to update.
 	* @param TraceDirection The direction of this trace result.
-	* @param bResult Whether or not we are blocked in this direction.
+	* @param bResult Whether or not this cell is blocked.
 	*/
 	FORCEINLINE void UpdateAgentAvoidanceResult(
 		const FGuid& Guid,
 		const EAgentAvoidanceTraceDirection& TraceDirection, const bool bResult)
 	{
-		AgentMap[Guid].UpdateAvoidanceResult(TraceDirection, bResult);
+		// The Agent may have been handed off to another shard while this task was in flight
+		if(FAgent* Agent = AgentMap.Find(Guid))
+		{
+			bool bIsBlocked = false;
+			if(!Agent->AddAvoidanceCell(TraceDirection, bResult, bIsBlocked))
+				return;
+
+			const float LatencyMs =
+				(TraceDirection == EAgentAvoidanceTraceDirection::TracingFront) ? Agent->AvoidanceFrontTask.GetMsSinceIssued() :
+				(TraceDirection == EAgentAvoidanceTraceDirection::TracingLeft) ? Agent->AvoidanceLeftTask.GetMsSinceIssued() :
+				Agent->AvoidanceRightTask.GetMsSinceIssued();
+			RecordTraceLatency(LatencyMs);
+			const bool bBlockedByNeighbour = (Agent->NeighbourBlockedDirections & (1 << (uint8)TraceDirection)) != 0;
+			Agent->UpdateAvoidanceResult(TraceDirection, bIsBlocked || bBlockedByNeighbour, GetAdaptiveIntervalSettings());
+		}
 	}
 	
 	/**
@@ -828,7 +2319,12 @@ public:
 	FORCEINLINE void UpdateAgentFloorCheckResult(
 		const FGuid& Guid, const FVector& HitLocation, const bool bSuccess)
 	{
-		AgentMap[Guid].UpdateFloorCheckResult(HitLocation, bSuccess);
+		// The Agent may have been handed off to another shard while this task was in flight
+		if(FAgent* Agent = AgentMap.Find(Guid))
+		{
+			RecordTraceLatency(Agent->FloorCheckTask.GetMsSinceIssued());
+			Agent->UpdateFloorCheckResult(HitLocation, bSuccess, GetAdaptiveIntervalSettings());
+		}
 	}
 
 	/**
@@ -840,99 +2336,72 @@ public:
 	FORCEINLINE void UpdateAgentStepCheckResult(
 		const FGuid& Guid, const FVector& HitLocation, const bool bStepDetected)
 	{
-		AgentMap[Guid].UpdateStepCheckResult(HitLocation, bStepDetected);
+		// The Agent may have been handed off to another shard while this task was in flight
+		if(FAgent* Agent = AgentMap.Find(Guid))
+		{
+			RecordTraceLatency(Agent->StepCheckTask.GetMsSinceIssued());
+			Agent->UpdateStepCheckResult(HitLocation, bStepDetected, GetAdaptiveIntervalSettings());
+		}
 	}
 	
-	/**
-	 * @brief 
-	 * @param PathId 
-	 * @param ResultType 
-	 * @param NavPointer 
-	 * @param Guid 
-	 */
-	void OnAsyncPathComplete(
-		uint32 PathId, ENavigationQueryResult::Type ResultType, FNavPathSharedPtr NavPointer,
-		FGuid Guid
-	);
-	
-	/**
-	 * @brief 
-	 * @param Handle 
-	 * @param Data
-	 * @param Guid 
-	 * @param Direction 
-	 */
-	void OnAvoidanceTraceComplete(
-		const FTraceHandle& Handle, FTraceDatum& Data,
-		FGuid Guid, EAgentAvoidanceTraceDirection Direction
-	);
+	/** INAISimQueryListener implementation */
+	virtual void OnTraceComplete(const FNAISimTraceResult& Result) override;
+	virtual void OnPathComplete(const FNAISimQueryTicket& Ticket, const bool bSucceeded,
+		const TArrayView<const FVector>& Points) override;
+
+private:
+	/** Hand a trace or sweep result to the callback for its type of query. */
+	void DispatchTraceResult(const FNAISimTraceResult& Result);
 
 	/**
-	 * @brief 
-	 * @param Handle 
-	 * @param Data 
-	 * @param Guid 
-	 */
-	void OnFloorCheckTraceComplete(
-		const FTraceHandle& Handle, FTraceDatum& Data,
-		FGuid Guid
-	);
-	
-	/**
-	 * @brief 
-	 * @param Handle 
-	 * @param Data 
-	 * @param Guid 
+	 * An Agent's path query has come back, or its held back result is being applied.
+	 * @param Guid The Agent the path is for.
+	 * @param bSucceeded Whether or not a path was found.
+	 * @param Points The path, including the start and end points.
 	 */
-	void OnStepCheckTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data, FGuid Guid);
+	void OnAsyncPathComplete(const FGuid& Guid, const bool bSucceeded, const TArrayView<const FVector>& Points);
 
-	/**
-	* @brief 
-	* @param Handle 
-	* @param Data 
-	* @param Guid 
-	*/
-	void OnLocalBoundsCheckTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data, FGuid Guid);
+	/** One of an Agent's avoidance traces has come back. The ticket's Direction is the EAgentAvoidanceTraceDirection. */
+	void OnAvoidanceTraceComplete(const FNAISimTraceResult& Result);
 
-private:
-	/**
-	* @brief 
-	* @param Objects 
-	* @param Guid 
-	* @return 
-	*/
-	bool CheckIfBlockedByAgent(const TArray<FHitResult>& Objects, const FGuid& Guid) const;
-	
-	/**
-	 * @brief 
-	 * @param HitResults 
-	 * @return  
-	 */
-	TArray<FVector> GetAllHitLocationsNotFromAgents(const TArray<FHitResult>& HitResults) const;
+	/** An Agent's floor check has come back. */
+	void OnFloorCheckTraceComplete(const FNAISimTraceResult& Result);
+
+	/** An Agent's step check has come back. */
+	void OnStepCheckTraceComplete(const FNAISimTraceResult& Result);
+
+	/** An Agent's local bounds sweep has come back. */
+	void OnLocalBoundsCheckTraceComplete(const FNAISimTraceResult& Result);
+
+#if NAI_DEBUG_DRAW
+	/** Is the debug category on, and does the Agent pass the NAI.Debug filters? */
+	bool ShouldDebugDraw(const ENAIDebugCategory Category, const FGuid& Guid) const;
+#endif
 	
 private:
 	/**
-	 * // TODO: Document this
+	 * Send off an Agent's path query, through the WorldQuery.
 	 * @param Start The location this Pathfinding task starts from.
 	 * @param Goal The location this Pathfinding task is to.
 	 * @param NavAgentProperties The properties from this Agent related to the NavMesh settings.
-	 * @param PathDelegate The delegate to be executed on completion of this task.
+	 * @param Guid The Agent the path is for.
+	 * @return Whether or not the query was sent off.
 	 */
-	void AgentPathTaskAsync(
+	bool AgentPathTaskAsync(
 		const FVector& Start,
 		const FVector& Goal,
 		const FNavAgentProperties& NavAgentProperties,
-		const FNavPathQueryDelegate& PathDelegate
+		const FGuid& Guid
 	) const;
 	
 	/**
-	 * // TODO: Document this
+	 * Send off the traces for one side of an Agent's avoidance grid, through the WorldQuery.
 	 * @param TraceDirection The Direction or Side of the agent this Trace is for.
 	 * @param AgentLocation The location of the Agent.
 	 * @param Forward The forward vector of the Agent.
 	 * @param Right The right vector of the Agent.
 	 * @param AgentProperties The properties we need from the Agent for this Task.
-	 * @param TraceDirectionDelegate The delegate to be executed on completion of the Task.
+	 * @param Guid The Agent the traces are for.
 	 */
 	void AgentAvoidanceTraceTaskAsync(
 		const EAgentAvoidanceTraceDirection& TraceDirection,
@@ -940,7 +2409,7 @@ private:
 		const FVector& Forward,
 		const FVector& Right,
 		const FAgentProperties& AgentProperties,
-		FTraceDelegate& TraceDirectionDelegate
+		const FGuid& Guid
 	) const;
 	
 	// TODO: Not sure why i didn't inline this..
@@ -960,6 +2429,199 @@ private:
 	 * the Nav System.. etc...
 	 */
 	void Initialize();
+
+	/**
+	 * Add the Agents other shards handed to us since our last Tick(),
+	 * along with any that were added or removed while the Agent set was locked.
+	 */
+	void AddIncomingAgents();
+
+	/** The AdvanceTimers phase. Updates every Agent's timers, and its speed. */
+	void AdvanceTimers(const float DeltaTime);
+
+	/** The GatherDueTasks phase. Finds every task that needs to be issued this frame, along with every move. */
+	void GatherDueTasks();
+
+	/** The IssueQueries phase. Issues all of the DueTasks, this has to be on the GameThread. */
+	void IssueQueries();
+
+	/** Launch the PublishState phase for the frame that just finished. */
+	void LaunchPublishState();
+
+	/** Wait for any of our tasks that are still running on the task graph. */
+	void WaitForOutstandingTasks();
+
+	/**
+	 * Find every Agent that has left this shard's region, and pass it on
+	 * to whichever shard owns its new location.
+	 */
+	void HandOffAgentsOutsideShard();
+
+	/**
+	 * Get the record counting an Agent's queries, making it if there isn't one.
+	 * A released record is taken back into use, the Agent has come back to us.
+	 */
+	FAgentQueryRecord& FindOrAddQueryRecord(const FGuid& Guid);
+
+	/** The Agent has left us. Drop its record, or mark it to be dropped once its queries are back. */
+	void ReleaseQueryRecord(const FGuid& Guid);
+
+	/**
+	 * Count one of an Agent's queries as back.
+	 * @return False if the Agent has left us since it was sent, and the result should be thrown away.
+	 */
+	bool AcceptQueryResult(const FGuid& Guid);
+
+	/** Does any shard in our world still have one of this Agent's queries out? */
+	bool HasQueriesInFlight(const FGuid& Guid) const;
+
+	/** Is this the shard responsible for kicking off the parallel work for its world? */
+	bool IsLeadShard() const;
+
+	/** Fill the pool with PoolPrewarmCount PooledAgentClass actors. */
+	void PrewarmPool();
+
+	/**
+	 * Spawn an AgentClient straight into the pool, hidden and without collision.
+	 * Its Agent is created and bound to us here, so bringing it out of the pool never has to.
+	 */
+	void SpawnPooledAgent(const TSubclassOf<ANAIAgentClient>& AgentClass, const FTransform& Transform);
+
+	/** Put an AgentClient, and its Agent, into the pool. Destroys the client if the pool is full. */
+	void ReleaseAgentToPool(ANAIAgentClient* AgentClient, FAgent&& Agent);
+
+	/**
+	 * Bring an AgentClient out of the pool for the given spawn. Returns null if there wasn't one.
+	 * Agents that still have queries out are left in the pool until they've all come back.
+	 */
+	ANAIAgentClient* SpawnFromPool(const FAgentSpawnRequest& Request);
+
+	/** Process the queued despawns, then as many queued spawns as the spawn budget allows. */
+	void ProcessSpawnQueue();
+
+	/**
+	 * Decide whether a lockstep step runs this frame. It needs a full step of time to have
+	 * passed, the last step's queries to be back, and the step to be confirmed.
+	 * If it runs, the held back results and the step's commands are applied first.
+	 */
+	bool BeginLockstepStep(const float DeltaTime);
+
+	/** Run the commands scheduled for the current step, in order. */
+	void ExecuteLockstepCommands();
+
+	/** Apply the held back query results, sorted into Agent order. */
+	void ApplyLockstepResults();
+
+	/** Checksum every Agent's transform, in Agent order, and finish the step. */
+	void EndLockstepStep();
+
+	/** Should a query result be held back for the next step? */
+	FORCEINLINE bool ShouldDeferLockstepResult() const
+	{
+		return bLockstep && !bIsApplyingLockstepResults;
+	}
+
+	/** Hold back a query result, and count it as back. */
+	FNAILockstepDeferredResult& DeferLockstepResult(const ENAILockstepResultType Type, const FGuid& Guid);
+
+	/**
+	 * Server side replication, run at the end of ApplyTransforms.
+	 * Moves each Agent's quantized state into the proxy for its cell, removes Agents that have gone,
+	 * and sets each proxy's update rate from its distance to the players.
+	 */
+	void UpdateReplication(const float DeltaTime);
+
+	/** Get the proxy for a replication cell, spawning it if there isn't one. */
+	ANAIAgentReplicationProxy* FindOrSpawnReplicationProxy(const FIntPoint& Cell);
+
+	FORCEINLINE FIntPoint GetReplicationCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt(Location.X / ReplicationCellSize), FMath::FloorToInt(Location.Y / ReplicationCellSize));
+	}
+
+	/** Client side, move every replicated Agent to where it was ClientInterpolationDelay ago. */
+	void TickReplicatedClient(const float DeltaTime);
+
+	/** Get an AgentClient to show a replicated Agent with, from the pool if there's one. */
+	ANAIAgentClient* AcquireReplicatedClient(UClass* AgentClass, const FVector& Location, const float Yaw);
+
+	/** Hide a replicated Agent's AgentClient, and keep it for the next one. */
+	void ReleaseReplicatedClient(ANAIAgentClient* AgentClient);
+
+	/**
+	 * Move the Agents GatherDueTasks found nothing to do for out of AgentGuids, wake the ones queued up
+	 * while the Agent set was locked, then check the next slice of dormant Agents for a reason to wake.
+	 * Runs on the GameThread, at the end of ApplyTransforms.
+	 */
+	void UpdateDormancy(const float DeltaTime);
+
+	/** The adaptive interval properties, in the form the Agents take them. */
+	FORCEINLINE FAgentAdaptiveIntervalSettings GetAdaptiveIntervalSettings() const
+	{
+		FAgentAdaptiveIntervalSettings Settings;
+		Settings.MoveThresholdSquared = FMath::Square(AdaptiveMoveThreshold);
+		if(bAdaptiveQueryIntervals)
+		{
+			Settings.Backoff = AdaptiveIntervalBackoff;
+			Settings.MaxScale = MaxAdaptiveIntervalScale;
+		}
+		return Settings;
+	}
+
+	/** Wake a dormant Agent, or queue it up if the Agent set is locked. */
+	void WakeAgentByGuid(const FGuid& Guid);
+
+	/** Wake the dormant Agent at the given index in DormantAgentGuids, and put it back in AgentGuids. */
+	void WakeDormantAgent(const int32 DormantIndex);
+
+	/**
+	 * Apply the queued group changes, drop the members that have gone, and work out where each group's
+	 * slots are, projected onto the navmesh. Runs on the GameThread, between GatherDueTasks and IssueQueries.
+	 */
+	void UpdateAgentGroups(const float DeltaTime);
+
+	/** Take an Agent out of whatever group it's in. It'll path on its own again straight away. */
+	void LeaveAgentGroup(FAgent& Agent);
+
+	/** Get the offset of each slot in a formation. */
+	static void GetFormationSlotOffsets(const EAgentFormation Formation, const int32 SlotCount, const float Spacing,
+		TArray<FVector2D>& OutOffsets);
+
+	/**
+	 * Give the path queries a new copy of the density field, every DensityPathUpdateInterval.
+	 * Queries already sent off keep the copy they were sent with.
+	 */
+	void UpdateDensityQueryFilter(const float DeltaTime);
+
+	/**
+	 * Pick the animation LOD of every AgentClient in the World, across all the shards, nearest to a local
+	 * player first, until the animation budget is used up. Run by the lead shard every AnimationLODUpdateInterval,
+	 * on the GameThread.
+	 */
+	void UpdateAnimationBudget(const float DeltaTime);
+
+	/** Get the pose leader for an AgentClient to copy at the Shared LOD, making the leaders for its mesh if needed. */
+	USkeletalMeshComponent* GetSharedPoseLeader(ANAIAgentClient* AgentClient);
+
+	/**
+	 * Check the area an Agent's avoidance traces would cover in the given direction against its neighbours
+	 * in AgentHash, for when the Agents have no physics bodies for the traces to hit.
+	 * Safe to call from GatherDueTasks.
+	 */
+	bool IsAvoidanceBlockedByNeighbour(const FAgent& Agent, const int32 HashIndex, const FTransform& AgentTransform,
+		const EAgentAvoidanceTraceDirection Direction) const;
+
+	/**
+	 * Cut a move short at the first wall, for Agents with no physics body for MoveComponent() to sweep.
+	 * Only the world static geometry is swept against, and only the move across the ground, the height is left alone.
+	 */
+	void ClipMoveToWorldStatic(const FAgent& Agent, const FVector& Location, FVector& InOutMoveDelta) const;
+
+	/**
+	 * Find where the collision sources are, then move the collision proxies onto the Agents nearest them.
+	 * Agents that still need their proxy keep it. Runs on the GameThread, after ApplyTransforms.
+	 */
+	void UpdateCollisionProxies();
 	
 private:
 	/** Used to hold a reference to the current World. */
@@ -973,6 +2635,17 @@ private:
 	class ANavigationData *NavDataRef;
 	/** Used to hold a reference to the Shared Navigation Query. */
 	FSharedConstNavQueryFilter NavQueryRef;
+	/**
+	 * Every trace, sweep and path query the manager sends goes through here, and comes back
+	 * to OnTraceComplete() or OnPathComplete(). Made by Initialize().
+	 */
+	TSharedPtr<class FNAIWorldQueryAdapter> WorldQuery;
+
+	/**
+	 * All the short lived allocations made during Tick() and the task
+	 * callbacks come from here. It is reset once at the start of every Tick().
+	 */
+	FNAIFrameArena FrameArena;
 	
 	/**
 	 * Hash table containing all of the Agents.
@@ -988,31 +2661,269 @@ private:
 	 */
 	UPROPERTY()
 	TArray<FGuid> AgentGuids;
+
+	/** The dormant Agents. They're still in the AgentMap, but not in AgentGuids. */
+	TArray<FGuid> DormantAgentGuids;
+	/** Agents GatherDueTasks found nothing to do for, waiting to be moved into DormantAgentGuids. */
+	TArray<FGuid> AgentsGoingDormant;
+	/** Agents woken while the Agent set was locked. */
+	TArray<FGuid> AgentsToWake;
+	/** WakeAllAgents() was called while the Agent set was locked, so UpdateDormancy() calls it again. */
+	uint8 bWakeAllAgentsQueued : 1;
+	/** Where the local and remote players were last frame, for GatherDueTasks to check the distance to. */
+	TArray<FVector> DormancyViewLocations;
+	/** The next dormant Agent to check. */
+	int32 DormancyCheckIndex;
+	/** The goal the dormant Agents were going to. Moving it wakes them all. */
+	FVector DormancyGoalLocation;
+
+	/** Agents handed to us by other shards, waiting to be added on our next Tick(). */
+	TArray<FAgent> IncomingAgents;
+
+	/** Agents removed while the Agent set was locked, waiting to be removed on our next Tick(). */
+	TArray<FGuid> OutgoingAgents;
+
+	/** The query counts for every Agent we've sent queries for that hasn't drained yet. */
+	TMap<FGuid, FAgentQueryRecord> QueryRecords;
+	/** Released records with nothing left in flight, dropped by AddIncomingAgents(). */
+	TArray<FGuid> DrainedQueryRecords;
+
+	/**
+	 * While this is set the task graph is working on the Agents, so
+	 * AgentMap and AgentGuids must not be changed.
+	 */
+	uint8 bIsAgentSetLocked : 1;
+
+	/** The tasks gathered by the GatherDueTasks phase this frame. */
+	TArray<FAgentDueTasks> DueTasks;
+
+	/** The moves gathered by the GatherDueTasks phase this frame. */
+	TArray<FAgentPendingMove> PendingMoves;
+
+	/**
+	 * Every active Agent's location and rotation, in AgentGuids order. Copied from the AgentClients on the
+	 * GameThread by LaunchSimulationTasks(), so AdvanceTimers and GatherDueTasks never touch an Actor.
+	 */
+	TArray<FVector> AgentLocations;
+	TArray<FQuat> AgentRotations;
+
+	/**
+	 * Scratch state for the batched math. This is kept around between frames
+	 * so it doesn't have to be reallocated, and is only touched by one phase each.
+	 */
+	/** AdvanceTimers */
+	FNAIVectorStreams SpeedPositionsThisFrame;
+	FNAIVectorStreams SpeedPositionsLastFrame;
+	FNAIFloatStream Speeds;
+	/** IntegrateMovement */
+	FNAISimMovement MoveIntegrator;
+
+	/** How many Agents were halted, as counted by GatherDueTasks. */
+	int32 HaltedAgentCount;
+
+	/** Completion event for this frame's AdvanceTimers -> GatherDueTasks chain. */
+	FGraphEventRef SimulationEvent;
+
+	/**
+	 * The ApplyTransforms phase writes to one of these, while PublishState
+	 * from the previous frame may still be reading the other.
+	 */
+	TArray<FAgentPublishedState> PublishBuffers[2];
+	/** Completion events for the PublishState task reading each buffer. */
+	FGraphEventRef PublishEvents[2];
+	/** Completion event for the most recent PublishState task. */
+	FGraphEventRef LatestPublishEvent;
+	/** Incremented each frame, used to pick which PublishBuffer to write to. */
+	uint32 PublishFrameIndex;
+
+	/** Written by PublishState. */
+	FAgentManagerPublishedState PublishedState;
+
+	/** How long each phase took. */
+	FAgentManagerPhaseTimings PhaseTimings;
+
+	/** Written by the IssueQueries phase, on the GameThread. */
+	FAgentManagerQueryCounts QueryCounts;
+
+	/** Path queries sent off that haven't come back yet. */
+	int32 PathQueriesInFlight;
+
+	/** Written by the query callbacks, on the GameThread. */
+	FAgentTaskLatencyHistogram TaskLatency;
+	/** A running average of how long the traces and sweeps take to come back, in milliseconds. */
+	float AverageTraceLatencyMs;
+	/**
+	 * How long this frame's traces and sweeps take to be used, in seconds. Set before the simulation tasks launch.
+	 * Each Agent looks ahead by this plus half its tasks' interval, up to MaxLookAheadTime.
+	 */
+	float LookAheadTime;
+
+	/** Record a trace or sweep's latency, in the histogram and the average the look ahead is worked out from. */
+	FORCEINLINE void RecordTraceLatency(const float LatencyMs)
+	{
+		TaskLatency.Record(LatencyMs);
+		AverageTraceLatencyMs = FMath::Lerp(AverageTraceLatencyMs, LatencyMs, 0.05f);
+	}
+
+	/** The pooled AgentClients, and their Agents, for each AgentClient class. */
+	UPROPERTY()
+	TMap<UClass*, FNAIAgentClientPool> AgentPools;
+	/** How many AgentClients are in the pools, across all classes. */
+	int32 PooledAgentCount;
+
+	/** Spawns waiting on the spawn budget. Everything before SpawnQueueHead has been done. */
+	TArray<FAgentSpawnRequest> SpawnQueue;
+	int32 SpawnQueueHead;
+
+	/** AgentClients waiting to go back into the pool at the end of the frame. */
+	UPROPERTY()
+	TArray<ANAIAgentClient*> DespawnQueue;
+
+	/** The replication proxy for each cell that has Agents in it. Server only. */
+	UPROPERTY()
+	TMap<FIntPoint, ANAIAgentReplicationProxy*> ReplicationProxies;
+	/** Which cell each of our Agents was last put in. Server only. */
+	TMap<FGuid, FNAIReplicatedAgentRecord> ReplicatedAgents;
+	/** Counts the replication updates, so Agents missing from the latest one can be found. */
+	uint32 ReplicationUpdateCount;
+	/** Time since the Agents' state was last gathered. */
+	float ReplicationUpdateTime;
+	/** Bits sent, and time passed, since the stats were last worked out. */
+	uint64 ReplicationBitsSent;
+	float ReplicationStatsTime;
+	FAgentManagerReplicationStats ReplicationStats;
+
+	/** The Agents replicated to us, by NetId. Client only. */
+	TMap<uint32, FNAIReplicatedAgentView> ReplicatedViews;
+	/** Hidden AgentClients, ready to show replicated Agents with. Only the Clients are used. Client only. */
+	UPROPERTY()
+	TMap<UClass*, FNAIAgentClientPool> ReplicatedClientPools;
+
+	/** Every group, by id. Only changed by UpdateAgentGroups(), and read by GatherDueTasks. */
+	TMap<int32, FAgentGroup> AgentGroups;
+	/** Group changes waiting for UpdateAgentGroups(). */
+	TArray<FAgentGroupRequest> GroupRequests;
+	int32 NextGroupId;
+	/** Scratch list of a group's slots, for UpdateAgentGroups() to project onto the navmesh. */
+	TArray<FNavigationProjectionWork> GroupSlotProjections;
+
+	/**
+	 * The density field is built by GatherDueTasks into DensityFieldNext, while the Agents read last
+	 * frame's from DensityField, then the two are swapped.
+	 */
+	FNAIDensityField DensityField;
+	FNAIDensityField DensityFieldNext;
+	/** The area the Agents covered last frame, the next field is made to cover it. */
+	FBox2D DensityBounds;
+	/** Counts up each time DensityFieldNext is built. DensityField is the build before this one. */
+	int32 DensityFieldFrame;
+	/** The filter the path queries use, with a snapshot of the density field. */
+	FSharedConstNavQueryFilter DensityQueryFilter;
+	float DensityPathTime;
+
+	/** Time since the animation LODs were last picked. */
+	float AnimationLODTime;
+	/** How many Agents were put at each animation LOD. */
+	int32 AnimationLODCounts[(uint8)EAgentAnimationLOD::Count];
+	/** Scratch list of the AgentClients to pick animation LODs for, with their distance squared to a player. */
+	TArray<FAgentAnimationCandidate> AnimationCandidates;
+	/** The hidden meshes the Shared LOD copies its pose from. */
+	UPROPERTY()
+	TArray<USkeletalMeshComponent*> SharedPoseLeaders;
+	/** Where each skeletal mesh's leaders start in SharedPoseLeaders. The meshes are kept alive by the leaders. */
+	TMap<USkeletalMesh*, int32> SharedPoseLeaderStarts;
+
+	/**
+	 * Every Agent's location, active then dormant, built by GatherDueTasks when bPhysicsFreeAgents is on.
+	 * AgentHashGuids holds the guid for each point.
+	 */
+	FNAISpatialHash AgentHash;
+	TArray<FGuid> AgentHashGuids;
+	/** Scratch list of the points AgentHash is built from. */
+	TArray<FVector2D> AgentHashPoints;
+	/** The Actors registered with AddCollisionSource(). */
+	TArray<TWeakObjectPtr<AActor>> CollisionSources;
+	/** Scratch list of where the players and collision sources are. */
+	TArray<FVector> CollisionSourceLocations;
+	/** Scratch list of the Agents near a source, with their distance squared to the nearest one. */
+	TMap<ANAIAgentClient*, float> CollisionCandidates;
+	/** The collision proxies, spawned as they're needed, up to CollisionProxyCount. */
+	UPROPERTY()
+	TArray<class ANAIAgentCollisionProxy*> CollisionProxies;
+
+	/** The step that runs next. */
+	int32 LockstepStep;
+	/** The last step every peer's commands are in for. */
+	int32 LockstepConfirmedStep;
+	/** Counts the commands this peer has issued, and the Agents it has spawned. */
+	int32 LockstepSequence;
+	int32 LockstepSpawnCount;
+	/** Time not yet simulated. */
+	float LockstepAccumulator;
+	/** Set while a step is running, from Tick() through to the end of TickApply(). */
+	uint8 bIsLockstepStepping : 1;
+	/** Set while the held back results are being applied, so they aren't held back again. */
+	uint8 bIsApplyingLockstepResults : 1;
+	/** Queries issued by the last step that haven't come back yet. The next step waits on these. */
+	int32 LockstepQueriesInFlight;
+	/** Commands waiting for their step. */
+	TArray<FNAILockstepCommand> LockstepCommands;
+	/** Query results waiting for the next step. */
+	TArray<FNAILockstepDeferredResult> LockstepResults;
+	/** Each Agent's index in AgentGuids, rebuilt by every step to sort LockstepResults by, and kept to reuse its allocation. */
+	TMap<FGuid, int32> LockstepAgentIndices;
+	/** The checksum of each recent step, indexed by the step modulo NAI_LOCKSTEP_CHECKSUM_HISTORY. */
+	uint32 LockstepChecksums[NAI_LOCKSTEP_CHECKSUM_HISTORY];
+	FRandomStream LockstepRandom;
+	/** Where the crowd was last sent with a SetGoal command. */
+	FVector CrowdGoalLocation;
+	uint8 bHasCrowdGoal : 1;
+
+	/** Tick function for the Compute phase. */
+	FNAIAgentManagerTickFunction ComputeTickFunction;
+	/** Tick function for the Apply phase. */
+	FNAIAgentManagerTickFunction ApplyTickFunction;
 };
 
 /**
- * Static utility class used to get a reference to the
- * active AgentManager, if one exists.
+ * Static registry of every active AgentManager, grouped by the World they live in.
+ * A World can have several managers, each one acting as a shard which owns a
+ * region of that World. Agents use this to find the manager they belong to.
+ * The first manager registered in a World is its "lead" shard, and the others
+ * will always tick after it.
  * @note ONLY USE THIS AT RUNTIME
- * @param bManagerExists This will be true is a manager is active.
- * @param CurrentManager A pointer to the current manager.
  */
-class UAgentManagerStatics
+class NAI_API FNAIAgentManagerRegistry
 {
 public:
-	/** Variable used to check the if a manager reference exists. */
-	static bool bManagerExists;
+	/** Add a manager to the registry for its World. */
+	static void RegisterManager(ANAIAgentManager* InManager);
+
+	/** Remove a manager from the registry. */
+	static void UnregisterManager(ANAIAgentManager* InManager);
 
-	/** Function used to set the CurrentManager pointer. */
-	static void SetManagerReference(ANAIAgentManager* InManager);
+	/** Check if the given World has at least one manager. */
+	static bool HasManager(const UWorld* InWorld);
 
-	/** Return a reference to the current manager. */
-	static ANAIAgentManager* GetManagerReference();
+	/** Get all the managers (shards) in the given World. */
+	static const TArray<ANAIAgentManager*>& GetManagers(const UWorld* InWorld);
 
-	/** Reset the class, remove the reference to the manager. */
-	static void Reset();
+	/** Get the lead shard of the given World, if there is one. */
+	static ANAIAgentManager* GetLeadManager(const UWorld* InWorld);
+
+	/**
+	 * Find the manager that owns the given location.
+	 * Shards with an explicit region take priority over one that owns the entire World.
+	 * @param InWorld The World to search.
+	 * @param Location The world location to find the owner of.
+	 * @return The owning manager, or nullptr if there isn't one.
+	 */
+	static ANAIAgentManager* FindManagerForLocation(const UWorld* InWorld, const FVector& Location);
 
 private:
-	/** Pointer to the current manager. */
-	static ANAIAgentManager* CurrentManager;
+	/** Make every shard in the World tick after the lead shard. */
+	static void RefreshTickPrerequisites(const UWorld* InWorld);
+
+	/** All of the registered managers, for each World. */
+	static TMap<const UWorld*, TArray<ANAIAgentManager*>> Managers;
 };
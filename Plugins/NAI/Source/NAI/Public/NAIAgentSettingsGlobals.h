@@ -18,3 +18,48 @@ enum class EAgentAvoidanceLevel : uint8
 	Normal UMETA(DisplayName = "Normal"),
 	Advanced UMETA(DisplayName = "Advanced"),
 };
+
+/** The phases of the AgentManager's frame, in the order they run. */
+UENUM(BlueprintType, Blueprintable)
+enum class EAgentManagerPhase : uint8
+{
+	AdvanceTimers UMETA(DisplayName = "AdvanceTimers"),
+	GatherDueTasks UMETA(DisplayName = "GatherDueTasks"),
+	IssueQueries UMETA(DisplayName = "IssueQueries"),
+	IntegrateMovement UMETA(DisplayName = "IntegrateMovement"),
+	ApplyTransforms UMETA(DisplayName = "ApplyTransforms"),
+	PublishState UMETA(DisplayName = "PublishState"),
+	Count UMETA(Hidden),
+};
+
+/**
+ * How an Agent's skeletal mesh animates, picked for each Agent by the AgentManager's animation budget.
+ * The nearest Agents animate every frame, and the further away they get the less they're updated.
+ */
+UENUM(BlueprintType, Blueprintable)
+enum class EAgentAnimationLOD : uint8
+{
+	/** Animated every frame. */
+	Full UMETA(DisplayName = "Full"),
+	/** Animated at the manager's ReducedAnimationRate, and only while rendered. */
+	Reduced UMETA(DisplayName = "Reduced"),
+	/** Copies its pose from one of the manager's shared pose leaders, and isn't animated itself. */
+	Shared UMETA(DisplayName = "Shared"),
+	/** Not animated at all, it holds its last pose. */
+	Frozen UMETA(DisplayName = "Frozen"),
+	Count UMETA(Hidden),
+};
+
+/** The shapes a group of Agents can move in. The slots are laid out behind the leader, along the way it came. */
+UENUM(BlueprintType, Blueprintable)
+enum class EAgentFormation : uint8
+{
+	/** Single file behind the leader. */
+	Column UMETA(DisplayName = "Column"),
+	/** Side by side with the leader. */
+	Line UMETA(DisplayName = "Line"),
+	/** A V with the leader at the point. */
+	Wedge UMETA(DisplayName = "Wedge"),
+	/** Rows behind the leader, as close to square as the group allows. */
+	Box UMETA(DisplayName = "Box"),
+};
@@ -0,0 +1,50 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "NAICollisionProxy.generated.h"
+
+class ANAIAgentClient;
+class UCapsuleComponent;
+
+/**
+ * With the AgentManager's bPhysicsFreeAgents on, the AgentClients have no physics bodies at all.
+ * Instead the manager keeps a small pool of these, and puts one on each of the Agents nearest the
+ * players and the other collision sources it's been given. Each one has the same collision as an
+ * AgentClient's capsule, so players bump into it and projectiles hit it, and it hands any damage
+ * it takes on to the Agent it's standing in for.
+ */
+UCLASS(NotPlaceable, Transient)
+class NAI_API ANAIAgentCollisionProxy : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	/** Handle default initialization. */
+	ANAIAgentCollisionProxy();
+
+	/** Passed on to the Agent this proxy is standing in for. */
+	virtual float TakeDamage(float DamageAmount, struct FDamageEvent const& DamageEvent, class AController* EventInstigator,
+		AActor* DamageCauser) override;
+
+	/**
+	 * Stand in for an Agent, matching its capsule and moving to it.
+	 * Passing nullptr takes the proxy out of the physics scene until it's next used.
+	 */
+	void SetAgentClient(ANAIAgentClient* InAgentClient);
+
+	/** Move to where the Agent is now. */
+	void FollowAgentClient();
+
+	/** The Agent this proxy is standing in for, or nullptr if it's free. */
+	UFUNCTION(BlueprintPure, Category = "Agent")
+	ANAIAgentClient* GetAgentClient() const { return AgentClient.Get(); }
+
+private:
+	UPROPERTY(VisibleAnywhere, Category = "Agent")
+	UCapsuleComponent* CapsuleComponent;
+
+	TWeakObjectPtr<ANAIAgentClient> AgentClient;
+};
@@ -0,0 +1,92 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Debug drawing is compiled out of Shipping and Test builds, so profiling
+ * builds measure the real cost of the crowd. Wrap every use in #if NAI_DEBUG_DRAW.
+ */
+#define NAI_DEBUG_DRAW (!(UE_BUILD_SHIPPING || UE_BUILD_TEST))
+
+#if NAI_DEBUG_DRAW
+
+class UWorld;
+class AActor;
+struct FBatchedLine;
+
+/** What can be drawn. Each has its own NAI.Debug.<Category> CVar. */
+enum class ENAIDebugCategory : uint8
+{
+	/** The path segment each moving Agent is following. */
+	Paths,
+	/** The avoidance grid traces, red when blocked. */
+	Avoidance,
+	/** The floor and step check traces. */
+	GroundChecks,
+	/** The local bounds sweep, and the highest point it hit. */
+	LocalBounds,
+	Count
+};
+
+/**
+ * Debug visualisation for the Agents, controlled with the NAI.Debug.* CVars.
+ * Primitives are gathered up over the frame and handed to the World's line batcher
+ * in one go by Flush(), and no more than NAI.Debug.MaxPrimitives are drawn per frame,
+ * so turning it on with a big crowd doesn't bring the editor down.
+ * GameThread only.
+ * @brief Batched, filtered debug drawing for the Agents.
+ */
+class NAI_API FNAIDebugDraw
+{
+public:
+	/** Is the category turned on? Check this before doing any work to build the primitives. */
+	static bool IsCategoryEnabled(const ENAIDebugCategory Category);
+
+	/**
+	 * Does the Agent pass the selection filters (NAI.Debug.SelectedOnly, NAI.Debug.Radius)?
+	 * @param AgentClient The Agent's actor.
+	 */
+	static bool PassesFilters(const AActor* AgentClient);
+
+	/** Both of the above. */
+	static FORCEINLINE bool ShouldDraw(const ENAIDebugCategory Category, const AActor* AgentClient)
+	{
+		return IsCategoryEnabled(Category) && PassesFilters(AgentClient);
+	}
+
+	static void AddLine(const UWorld* World, const FVector& Start, const FVector& End, const FColor& Color);
+
+	/** An upright capsule, drawn as a ring at each end joined by four lines. */
+	static void AddCapsule(const UWorld* World, const FVector& Center, const float HalfHeight, const float Radius, const FColor& Color);
+
+	/** A small cross. */
+	static void AddPoint(const UWorld* World, const FVector& Location, const FColor& Color);
+
+	/**
+	 * Submit everything gathered for the World to its line batcher, and start the primitive budget over.
+	 * Call once per World per frame, the budget is for all of the World's shards together.
+	 */
+	static void Flush(UWorld* World);
+
+	/** Forget everything kept for the World. Call when it's being torn down. */
+	static void RemoveWorld(const UWorld* World);
+
+private:
+	/** Check the primitive cap, and get the World's batch. Null if the cap has been hit. */
+	static TArray<FBatchedLine>* GetBatch(const UWorld* World, const int32 LineCount);
+
+	/** Lines waiting for Flush(), per World. */
+	static TMap<const UWorld*, TArray<FBatchedLine>> PendingLines;
+
+	/** Where the first player was looking from at the last Flush(), for NAI.Debug.Radius. */
+	static TMap<const UWorld*, FVector> ViewLocations;
+
+	/** How many lines have been gathered since the last Flush(), across every World. */
+	static int32 FrameLineCount;
+	/** How many lines were dropped by the cap since the last Flush(). */
+	static int32 FrameDroppedCount;
+};
+
+#endif
@@ -0,0 +1,41 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NAIDensityField.h"
+
+#if WITH_RECAST
+#include "NavMesh/RecastQueryFilter.h"
+
+/**
+ * A navmesh query filter that makes crowded polys cost more to path through, so the Agents
+ * spread out over the other routes instead of all queueing at the same chokepoint.
+ * It reads a snapshot of the AgentManager's density field, which is never changed once
+ * it's handed over, as the path queries using it run on the navigation worker threads.
+ * @brief Congestion aware path costs for the AgentManager.
+ */
+class NAI_API FNAIDensityQueryFilter : public FRecastQueryFilter
+{
+public:
+	/**
+	 * @param Source The filter to take the area costs and flags from.
+	 * @param InDensity The density snapshot to read.
+	 * @param InDensityCost How much extra each Agent per cell adds to the cost, as a fraction of the normal cost.
+	 */
+	FNAIDensityQueryFilter(const FRecastQueryFilter& Source,
+		const TSharedRef<const FNAIDensityField, ESPMode::ThreadSafe>& InDensity, const float InDensityCost);
+
+	virtual INavigationQueryFilterInterface* CreateCopy() const override;
+
+protected:
+	virtual float getVirtualCost(const float* pa, const float* pb,
+		const dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly,
+		const dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+		const dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly) const override;
+
+private:
+	TSharedRef<const FNAIDensityField, ESPMode::ThreadSafe> Density;
+	float DensityCost;
+};
+#endif
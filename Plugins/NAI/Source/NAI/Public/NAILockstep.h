@@ -0,0 +1,130 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NAISimWorldQuery.h"
+#include "NAILockstep.generated.h"
+
+class ANAIAgentClient;
+
+/** How many steps of checksums the manager keeps, for comparing against late peers. */
+#define NAI_LOCKSTEP_CHECKSUM_HISTORY 128
+
+/** The inputs peers exchange in lockstep mode. Everything else is worked out locally. */
+UENUM(BlueprintType)
+enum class ENAILockstepCommandType : uint8
+{
+	/** Spawn an Agent of AgentClass at Location, facing Yaw, with the given NetId. */
+	Spawn,
+	/** Despawn the Agent with the given NetId. */
+	Despawn,
+	/** Send the crowd to Location. */
+	SetGoal,
+};
+
+/** A single input to the lockstep simulation, run by every peer on the same step. */
+USTRUCT(BlueprintType)
+struct NAI_API FNAILockstepCommand
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lockstep")
+	ENAILockstepCommandType Type;
+
+	/** The step the command runs on. Filled in by IssueLockstepCommand(). */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lockstep")
+	int32 Step;
+
+	/** The peer that issued the command. Commands on the same step run in peer, then sequence, order. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lockstep")
+	int32 PeerId;
+
+	/** Counts the commands each peer issues. Filled in by IssueLockstepCommand(). */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lockstep")
+	int32 Sequence;
+
+	/** The Agent to spawn or despawn. Spawns are given one by IssueLockstepCommand(). */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lockstep")
+	int32 NetId;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lockstep")
+	FVector Location;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lockstep")
+	float Yaw;
+
+	/** The class to spawn, or None to use the manager's PooledAgentClass. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Lockstep")
+	TSubclassOf<ANAIAgentClient> AgentClass;
+
+	/** Handle default initialization. */
+	FNAILockstepCommand() : Type(ENAILockstepCommandType::Spawn),
+		Step(0),
+		PeerId(0),
+		Sequence(0),
+		NetId(0),
+		Location(FVector::ZeroVector),
+		Yaw(0.0f),
+		AgentClass(nullptr)
+	{ }
+
+	/** The order commands on the same step are run in. */
+	FORCEINLINE bool operator<(const FNAILockstepCommand& Other) const
+	{
+		if(Step != Other.Step)
+			return Step < Other.Step;
+		if(PeerId != Other.PeerId)
+			return PeerId < Other.PeerId;
+		return Sequence < Other.Sequence;
+	}
+};
+
+/** Called with every command issued on this peer, so it can be sent to the others. */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FNAILockstepCommandSignature, const FNAILockstepCommand&, Command);
+
+/** Called with each step's checksum, or with the step the peers disagreed on. */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FNAILockstepChecksumSignature, int32, Step, int32, Checksum);
+
+/**
+ * The kinds of query the manager sends. Carried as the Type of each query's FNAISimQueryTicket,
+ * and kept with the results held back for the next step.
+ */
+enum class ENAILockstepResultType : uint8
+{
+	Path,
+	Avoidance,
+	FloorCheck,
+	StepCheck,
+	LocalBounds,
+};
+
+/**
+ * A query result held back in lockstep mode.
+ * Results come back in whatever order the physics and navigation threads finish them,
+ * so they're stored until the step's queries are all back, then applied in Agent order.
+ */
+struct NAI_API FNAILockstepDeferredResult
+{
+	FGuid Guid;
+	ENAILockstepResultType Type;
+	/** The avoidance direction, only for Avoidance results. */
+	uint8 Direction;
+
+	/** Trace results. */
+	FVector Start;
+	FVector End;
+	TArray<FNAISimHit> Hits;
+
+	/** Path results. */
+	TArray<FVector> PathPoints;
+	uint8 bPathSucceeded : 1;
+
+	/** Handle default initialization. */
+	FNAILockstepDeferredResult() : Type(ENAILockstepResultType::Path),
+		Direction(0),
+		Start(FVector::ZeroVector),
+		End(FVector::ZeroVector),
+		bPathSucceeded(false)
+	{ }
+};
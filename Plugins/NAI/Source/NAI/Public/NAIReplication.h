@@ -0,0 +1,274 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Engine/NetSerialization.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "NAIReplication.generated.h"
+
+class ANAIAgentClient;
+class ANAIAgentManager;
+class ANAIAgentReplicationProxy;
+struct FNAIReplicatedAgentArray;
+
+/**
+ * The replicated state of a single Agent. Only what a client needs to draw it is sent,
+ * the location is rounded to the nearest centimetre and the yaw is packed into a byte.
+ */
+USTRUCT()
+struct NAI_API FNAIReplicatedAgent : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	/** Identifies the Agent on every connection, and stays the same when it moves between cells and shards. */
+	UPROPERTY()
+	uint32 NetId;
+
+	UPROPERTY()
+	FVector_NetQuantize Location;
+
+	/** The yaw, compressed with FRotator::CompressAxisToByte(). */
+	UPROPERTY()
+	uint8 Yaw;
+
+	/** Index of the Agent's class in the proxy's AgentClasses. */
+	UPROPERTY()
+	uint8 ClassIndex;
+
+	/** Handle default initialization. */
+	FNAIReplicatedAgent() : NetId(0),
+		Location(FVector::ZeroVector),
+		Yaw(0),
+		ClassIndex(0)
+	{ }
+
+	void PreReplicatedRemove(const FNAIReplicatedAgentArray& InArray);
+	void PostReplicatedAdd(const FNAIReplicatedAgentArray& InArray);
+	void PostReplicatedChange(const FNAIReplicatedAgentArray& InArray);
+};
+
+/**
+ * Every Agent in one replication cell. Only the Agents marked dirty since a connection
+ * last received the array are sent to it, so Agents that are standing still cost nothing.
+ */
+USTRUCT()
+struct NAI_API FNAIReplicatedAgentArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FNAIReplicatedAgent> Items;
+
+	/** The proxy this array belongs to. */
+	UPROPERTY(NotReplicated)
+	ANAIAgentReplicationProxy* Owner;
+
+	/** Handle default initialization. */
+	FNAIReplicatedAgentArray() : Owner(nullptr)
+	{ }
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms);
+};
+
+template<>
+struct TStructOpsTypeTraits<FNAIReplicatedAgentArray> : public TStructOpsTypeTraitsBase2<FNAIReplicatedAgentArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true
+	};
+};
+
+/**
+ * The AgentClients themselves are never replicated. Instead each AgentManager on the server
+ * splits its Agents into a grid of cells, and each cell gets one of these to replicate the
+ * Agents inside it. Relevancy and priority are then handled per connection by the NetDriver,
+ * using the cell's distance to the viewer, and the manager lowers the update rate of cells
+ * far from every player.
+ * Clients hand what they receive to their lead AgentManager, which moves a local AgentClient
+ * for each Agent without running any of the simulation.
+ */
+UCLASS(NotPlaceable, Transient)
+class NAI_API ANAIAgentReplicationProxy : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	/** Handle default initialization. */
+	ANAIAgentReplicationProxy();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Cells near the viewer are given a higher priority, so they get their updates first when bandwidth is short. */
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget,
+		UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+
+protected:
+	/** Called when the game end or when destroyed. */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	/**
+	 * Set up a proxy the server has just spawned.
+	 * @param RelevancyDistance How far from a viewer the cell is still replicated to it.
+	 * @param NearDistance Cells closer than this to a viewer get the highest priority.
+	 * @param FarDistance Cells further than this from a viewer get the lowest priority.
+	 */
+	void Setup(const float RelevancyDistance, const float NearDistance, const float FarDistance);
+
+	/**
+	 * Add an Agent to this cell, or update it if it's already here.
+	 * The Agent is only marked dirty if its quantized state has changed. Server only.
+	 */
+	void SetAgent(const uint32 NetId, UClass* AgentClass, const FVector& Location, const float Yaw);
+
+	/** Take an Agent out of this cell. Server only. */
+	void RemoveAgent(const uint32 NetId);
+
+	FORCEINLINE int32 GetAgentCount() const { return Agents.Items.Num(); }
+
+	/** Add to the bits sent for this cell, across every connection. */
+	FORCEINLINE void RecordBitsSent(const int64 Bits) { BitsSent += Bits; }
+
+	/** Get the bits sent since the last call. */
+	FORCEINLINE uint64 ConsumeBitsSent()
+	{
+		const uint64 Bits = BitsSent;
+		BitsSent = 0;
+		return Bits;
+	}
+
+	/** Get the server's World time when this cell's Agents last changed. */
+	FORCEINLINE float GetServerTime() const { return ServerTime; }
+
+	/** Get a new NetId, unique across every manager in the process. */
+	static uint32 AllocateNetId();
+
+	/** Client side, called as the Agents arrive, change and leave. */
+	void OnAgentReplicated(const FNAIReplicatedAgent& Item);
+	void OnAgentRemoved(const FNAIReplicatedAgent& Item);
+
+private:
+	/** The manager on this client to hand the Agents to. */
+	ANAIAgentManager* GetClientManager();
+
+	/** The classes of the Agents in this cell. Declared before Agents, so it's received first. */
+	UPROPERTY(Replicated)
+	TArray<TSubclassOf<ANAIAgentClient>> AgentClasses;
+
+	/**
+	 * The server's World time when the Agents were last changed. Declared before Agents, so the
+	 * states that arrive with it are stamped with the time they were taken at, not when they got here.
+	 */
+	UPROPERTY(Replicated)
+	float ServerTime;
+
+	UPROPERTY(Replicated)
+	FNAIReplicatedAgentArray Agents;
+
+	/** The index of each Agent in Agents.Items, by NetId. Server only. */
+	TMap<uint32, int32> ItemIndices;
+
+	float NearDistanceSquared;
+	float FarDistanceSquared;
+
+	uint64 BitsSent;
+
+	TWeakObjectPtr<ANAIAgentManager> ClientManager;
+};
+
+/**
+ * The last few states received for a replicated Agent.
+ * Clients draw the Agents slightly in the past, so there's almost always
+ * a pair of states either side of the time being drawn to blend between.
+ */
+struct NAI_API FNAIAgentSnapshotBuffer
+{
+	enum { Capacity = 4 };
+
+	FVector Locations[Capacity];
+	float Yaws[Capacity];
+	/** When each state was taken, in the server's World time. */
+	double Times[Capacity];
+	/** How many of the slots are in use. */
+	int32 Count;
+	/** The slot holding the newest state. */
+	int32 Newest;
+
+	/** Handle default initialization. */
+	FNAIAgentSnapshotBuffer() : Count(0),
+		Newest(Capacity - 1)
+	{ }
+
+	/** Add a state. States that are no newer than the newest one we have are dropped, they've arrived out of order. */
+	void Add(const double Time, const FVector& Location, const float Yaw);
+
+	/**
+	 * Blend the states either side of the given time.
+	 * Before the oldest state this gives the oldest, and after the newest it holds on the newest.
+	 * @return False if there aren't any states yet.
+	 */
+	bool Sample(const double Time, FVector& OutLocation, float& OutYaw) const;
+
+	/** Time between the two newest states, or zero if there aren't two yet. */
+	float GetLatestInterval() const;
+};
+
+/** A replicated Agent on a client. */
+struct NAI_API FNAIReplicatedAgentView
+{
+	TWeakObjectPtr<ANAIAgentClient> AgentClient;
+	FNAIAgentSnapshotBuffer Snapshots;
+	/**
+	 * The proxy of the cell the Agent was last replicated through. Only it can remove the Agent,
+	 * a removal from the cell it left can turn up after it has already arrived in the next one.
+	 */
+	TWeakObjectPtr<const ANAIAgentReplicationProxy> OwnerProxy;
+	/**
+	 * When the Agent is due to be removed, or negative while it's still being replicated.
+	 * Removal is held back for a moment, as an Agent moving to another cell leaves one
+	 * proxy before it arrives in the next.
+	 */
+	double RemoveTime;
+
+	/** Handle default initialization. */
+	FNAIReplicatedAgentView() : RemoveTime(-1.0)
+	{ }
+};
+
+/** Where the server has put one of its Agents. */
+struct NAI_API FNAIReplicatedAgentRecord
+{
+	FIntPoint Cell;
+	uint32 NetId;
+	/** The last update the Agent was seen in, Agents missing from an update are removed. */
+	uint32 LastUpdate;
+
+	/** Handle default initialization. */
+	FNAIReplicatedAgentRecord() : Cell(FIntPoint::ZeroValue),
+		NetId(0),
+		LastUpdate(0)
+	{ }
+};
+
+/** How much the Agents cost to replicate, measured over the last second. */
+struct NAI_API FAgentManagerReplicationStats
+{
+	int32 ReplicatedAgentCount;
+	int32 ProxyCount;
+	int32 ConnectionCount;
+	/** Bytes sent for the Agents, summed over every connection. */
+	float BytesPerSecond;
+	/** Bytes sent per Agent, to a single connection. */
+	float BytesPerAgentPerSecond;
+
+	/** Handle default initialization. */
+	FAgentManagerReplicationStats() : ReplicatedAgentCount(0),
+		ProxyCount(0),
+		ConnectionCount(0),
+		BytesPerSecond(0.0f),
+		BytesPerAgentPerSecond(0.0f)
+	{ }
+};
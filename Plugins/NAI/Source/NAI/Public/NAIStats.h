@@ -0,0 +1,83 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+
+/**
+ * All the stats for the NAI plugin live under this group.
+ * Use "stat NAI" in the console to view them.
+ */
+DECLARE_STATS_GROUP(TEXT("NAI"), STATGROUP_NAI, STATCAT_Advanced);
+
+/** Manager phases, in the order they run */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("AdvanceTimers"), STAT_NAI_AdvanceTimers, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("GatherDueTasks"), STAT_NAI_GatherDueTasks, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("IssueQueries"), STAT_NAI_IssueQueries, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("IntegrateMovement"), STAT_NAI_IntegrateMovement, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ApplyTransforms"), STAT_NAI_ApplyTransforms, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ApplyTransforms - MoveComponent"), STAT_NAI_MoveComponent, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("PublishState"), STAT_NAI_PublishState, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ProcessSpawnQueue"), STAT_NAI_ProcessSpawnQueue, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Replication"), STAT_NAI_Replication, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("AnimationBudget"), STAT_NAI_AnimationBudget, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CollisionProxies"), STAT_NAI_CollisionProxies, STATGROUP_NAI, NAI_API);
+
+/** Query callbacks */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Callback - Path"), STAT_NAI_PathCallback, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Callback - Avoidance"), STAT_NAI_AvoidanceCallback, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Callback - Floor Check"), STAT_NAI_FloorCheckCallback, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Callback - Step Check"), STAT_NAI_StepCheckCallback, STATGROUP_NAI, NAI_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Callback - Local Bounds"), STAT_NAI_LocalBoundsCallback, STATGROUP_NAI, NAI_API);
+
+/** Counters, summed over every shard. The per frame ones are cleared at the start of each frame */
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Active Agents"), STAT_NAI_ActiveAgents, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Halted Agents"), STAT_NAI_HaltedAgents, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Dormant Agents"), STAT_NAI_DormantAgents, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Path Queries Issued"), STAT_NAI_PathQueriesIssued, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Path Queries In Flight"), STAT_NAI_PathQueriesInFlight, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Traces Issued"), STAT_NAI_TracesIssued, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sweeps Issued"), STAT_NAI_SweepsIssued, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Callbacks Received"), STAT_NAI_CallbacksReceived, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Stale Results"), STAT_NAI_StaleResults, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Collision Proxies"), STAT_NAI_ActiveCollisionProxies, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Replicated Agents"), STAT_NAI_ReplicatedAgents, STATGROUP_NAI, NAI_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Replication Bytes Per Second"), STAT_NAI_ReplicationBytesPerSecond, STATGROUP_NAI, NAI_API);
+
+/** Memory */
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Frame Arena Used"), STAT_NAI_FrameArenaUsed, STATGROUP_NAI, NAI_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Frame Arena Peak"), STAT_NAI_FrameArenaPeak, STATGROUP_NAI, NAI_API);
+
+/**
+ * Low level memory tracker tags, run with -llm and use "stat LLMFULL" or the LLM csv to view them.
+ * Anything the manager allocates that isn't covered by a sub tag goes under NAI,
+ * and the sub tags are parented to it.
+ */
+LLM_DECLARE_TAG_API(NAI, NAI_API);
+/** The FAgent records, and the containers that index them. */
+LLM_DECLARE_TAG_API(NAI_AgentRecords, NAI_API);
+/** The path points handed back by the path queries. */
+LLM_DECLARE_TAG_API(NAI_Paths, NAI_API);
+/** Anything made while handling the trace and sweep results, mostly frame arena pages. */
+LLM_DECLARE_TAG_API(NAI_TraceResults, NAI_API);
+/** The AgentClient actors and their components. */
+LLM_DECLARE_TAG_API(NAI_Actors, NAI_API);
+
+/**
+ * Unreal Insights channel for the crowd. Enable it with -trace=cpu,NAI
+ * (or "Trace.Enable NAI" at runtime) to see the manager phases and callbacks in timing captures.
+ */
+UE_TRACE_CHANNEL_EXTERN(NAIChannel, NAI_API);
+
+/**
+ * Time a scope in both "stat NAI" and the NAI trace channel.
+ * Used for the phases and callbacks. Per-Agent work like MoveComponent only gets
+ * a cycle counter, a trace event for each Agent would swamp the capture.
+ */
+#define NAI_SCOPE_CYCLE_COUNTER(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL_STR(#Stat, NAIChannel)
@@ -0,0 +1,94 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NAISimWorldQuery.h"
+#include "NavigationData.h"
+#include "WorldCollision.h"
+
+class ANavigationData;
+class UNavigationSystemV1;
+class UWorld;
+struct FHitResult;
+
+/**
+ * Binds the simulation's INAISimWorldQuery to a UWorld.
+ * The synchronous queries use blocking traces and sweeps against the static, dynamic and pawn
+ * object types, and the default NavData for paths. The async ones go through the World's async
+ * traces and the navigation system's async path queries, and come back to the listener on the
+ * GameThread when those do, usually the next frame.
+ * Everything touches the UWorld, so only use this from the GameThread.
+ * The async queries call back through weak delegates, so the adapter has to be owned by a shared pointer,
+ * see Create(). Dropping it drops the results of anything still in flight.
+ * @brief UE adapter for the engine independent simulation.
+ */
+class NAI_API FNAIWorldQueryAdapter : public INAISimWorldQuery, public TSharedFromThis<FNAIWorldQueryAdapter>
+{
+public:
+	/** @param InWorld The World to query, it must outlive the adapter. */
+	explicit FNAIWorldQueryAdapter(UWorld* InWorld);
+
+	/**
+	 * Make an adapter that's ready for async queries.
+	 * @param InWorld The World to query, it must outlive the adapter.
+	 */
+	static TSharedRef<FNAIWorldQueryAdapter> Create(UWorld* InWorld);
+
+	/**
+	 * Set the navigation the async path queries run on. Until this is called they aren't sent.
+	 * @param InNavSys The navigation system to send the queries to.
+	 * @param InNavData The NavData to find the paths on.
+	 */
+	void SetNavigation(UNavigationSystemV1* InNavSys, ANavigationData* InNavData);
+
+	/** Set the filter every async path query is sent with from now on. */
+	FORCEINLINE void SetQueryFilter(const FSharedConstNavQueryFilter& InQueryFilter) { QueryFilter = InQueryFilter; }
+
+	/** INAISimWorldQuery implementation */
+	virtual bool Raycast(const FVector& Start, const FVector& End, FNAISimHit& OutHit) const override;
+	virtual bool SweepCapsule(const FVector& Start, const FVector& End,
+		const float Radius, const float HalfHeight, TArray<FNAISimHit>& OutHits) const override;
+	virtual bool FindPath(const FVector& Start, const FVector& Goal, TArray<FVector>& OutPoints) const override;
+	virtual bool GetGroundHeight(const FVector& Location, const float MaxDrop, float& OutHeight) const override;
+	virtual bool RaycastAsync(const FVector& Start, const FVector& End, const ENAISimQueryFilter Filter,
+		const bool bAllHits, const FNAISimQueryTicket& Ticket) override;
+	virtual bool SweepCapsuleAsync(const FVector& Start, const FVector& End, const float Radius,
+		const float HalfHeight, const ENAISimQueryFilter Filter, const FNAISimQueryTicket& Ticket) override;
+	virtual bool FindPathAsync(const FVector& Start, const FVector& Goal, const float AgentRadius,
+		const float AgentHeight, const FNAISimQueryTicket& Ticket) override;
+
+	/** Heap memory used for the queries in flight and the reused result buffers, in bytes. */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	/** Every async trace and sweep comes back through here. */
+	void OnAsyncTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data);
+
+	/** Every async path query comes back through here. */
+	void OnAsyncPathComplete(uint32 QueryId, ENavigationQueryResult::Type ResultType, FNavPathSharedPtr Path);
+
+	/** Convert an engine hit into a simulation hit. */
+	static FNAISimHit ToSimHit(const FHitResult& Hit);
+
+	/** The object types a filter stands for. */
+	static FCollisionObjectQueryParams ToObjectQueryParams(const ENAISimQueryFilter Filter);
+
+	UWorld* World;
+	UNavigationSystemV1* NavSys;
+	ANavigationData* NavData;
+	FSharedConstNavQueryFilter QueryFilter;
+
+	/** Bound once in Create(), and shared by every async query. */
+	FTraceDelegate TraceDelegate;
+	FNavPathQueryDelegate PathDelegate;
+
+	/** The tickets of the traces and sweeps in flight, the index goes with the trace as its UserData. */
+	TSparseArray<FNAISimQueryTicket> TraceTickets;
+	/** The tickets of the path queries in flight, by query id. */
+	TMap<uint32, FNAISimQueryTicket> PathTickets;
+
+	/** Reused for every result, the listener only sees them for the duration of the callback. */
+	TArray<FNAISimHit> HitScratch;
+	TArray<FVector> PointScratch;
+};
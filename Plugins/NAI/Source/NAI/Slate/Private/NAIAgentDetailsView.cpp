@@ -1,8 +1,13 @@
 ﻿// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
 
 #include "NAI/Slate/Public/NAIAgentDetailsView.h"
+
+#if WITH_EDITOR
+
 #include "NAI.h"
 #include "NAIAgentClient.h"
+#include "NAIAgentManager.h"
+#include "NAI/Slate/Public/SNAIAgentManagerDashboard.h"
 
 #include "DetailCategoryBuilder.h"
 #include "DetailLayoutBuilder.h"
@@ -221,5 +226,23 @@ TSharedRef<IDetailCustomization> FCustomAgentManagerDetailsPanel::MakeInstance()
 
 void FCustomAgentManagerDetailsPanel::CustomizeDetails(IDetailLayoutBuilder& DetailBuilder)
 {
-
+	// The dashboard follows one manager, so don't show it when several are selected
+	DetailBuilder.GetObjectsBeingCustomized(SelectedObjects);
+	if(SelectedObjects.Num() != 1)
+		return;
+
+	ANAIAgentManager* Manager = Cast<ANAIAgentManager>(SelectedObjects[0].Get());
+	if(!Manager || Manager->IsTemplate())
+		return;
+
+	IDetailCategoryBuilder& PerformanceCategory = DetailBuilder.EditCategory(
+		"Performance", FText::FromString("Performance"), ECategoryPriority::Important);
+	PerformanceCategory.AddCustomRow(FText::FromString("Performance"))
+	.WholeRowContent()
+	[
+		SNew(SNAIAgentManagerDashboard)
+		.Manager(Manager)
+	];
 }
+
+#endif
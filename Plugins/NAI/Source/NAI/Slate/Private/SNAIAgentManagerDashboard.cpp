@@ -0,0 +1,251 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAI/Slate/Public/SNAIAgentManagerDashboard.h"
+#include "NAI/Slate/Public/SNAIRollingGraph.h"
+
+#include "Widgets/Input/SButton.h"
+#include "Widgets/Layout/SBox.h"
+#include "Widgets/Notifications/SProgressBar.h"
+#include "Widgets/Text/STextBlock.h"
+
+#if WITH_EDITOR
+#include "Editor.h"
+#endif
+
+#define LOCTEXT_NAMESPACE "SNAIAgentManagerDashboard"
+
+/** How often the dashboard pulls new numbers, in seconds. */
+#define DASHBOARD_REFRESH_INTERVAL 0.1f
+
+void SNAIAgentManagerDashboard::Construct(const FArguments& InArgs)
+{
+	Manager = InArgs._Manager;
+	StatusText = LOCTEXT("NotRunning", "Not running, start PIE to see live data.");
+
+	TSharedRef<SVerticalBox> Content = SNew(SVerticalBox)
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		.Padding(0.0f, 2.0f)
+		[
+			SNew(STextBlock)
+			.Text_Lambda([this]() { return StatusText; })
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		[
+			MakeLabelledRow(LOCTEXT("Agents", "Agents"), TAttribute<FText>::Create([this]() { return AgentsText; }))
+		]
+		+ SVerticalBox::Slot()
+		.AutoHeight()
+		[
+			MakeLabelledRow(LOCTEXT("AvoidanceLevels", "By Avoidance Level"),
+				TAttribute<FText>::Create([this]() { return AvoidanceLevelsText; }))
+		];
+
+	// Every phase of the frame, with its own graph
+	const UEnum* PhaseEnum = StaticEnum<EAgentManagerPhase>();
+	for(uint8 Phase = 0; Phase < (uint8)EAgentManagerPhase::Count; Phase++)
+	{
+		PhaseGraphs[Phase] = SNew(SNAIRollingGraph);
+		Content->AddSlot()
+		.AutoHeight()
+		[
+			MakeLabelledRow(PhaseEnum->GetDisplayNameTextByValue(Phase),
+				TAttribute<FText>::Create([this, Phase]() { return PhaseTexts[Phase]; }), PhaseGraphs[Phase])
+		];
+	}
+
+	QueryGraph = SNew(SNAIRollingGraph).LineColor(FLinearColor(0.9f, 0.6f, 0.1f));
+	PathQueueGraph = SNew(SNAIRollingGraph).LineColor(FLinearColor(0.3f, 0.5f, 1.0f));
+	Content->AddSlot()
+	.AutoHeight()
+	[
+		MakeLabelledRow(LOCTEXT("Queries", "Queries Per Frame"), TAttribute<FText>::Create([this]() { return QueriesText; }), QueryGraph)
+	];
+	Content->AddSlot()
+	.AutoHeight()
+	[
+		MakeLabelledRow(LOCTEXT("PathQueue", "Path Queries In Flight"), TAttribute<FText>::Create([this]() { return PathQueueText; }), PathQueueGraph)
+	];
+
+	// Task latency histogram, one bar per bucket scaled to the fullest bucket
+	Content->AddSlot()
+	.AutoHeight()
+	.Padding(0.0f, 6.0f, 0.0f, 2.0f)
+	[
+		SNew(SHorizontalBox)
+		+ SHorizontalBox::Slot()
+		.FillWidth(1.0f)
+		.VAlign(VAlign_Center)
+		[
+			SNew(STextBlock)
+			.Text(LOCTEXT("TaskLatency", "Task Latency, issue to result"))
+		]
+		+ SHorizontalBox::Slot()
+		.AutoWidth()
+		[
+			SNew(SButton)
+			.Text(LOCTEXT("ResetLatency", "Reset"))
+			.OnClicked(this, &SNAIAgentManagerDashboard::OnResetLatencyClicked)
+		]
+	];
+	for(int32 Bucket = 0; Bucket < FAgentTaskLatencyHistogram::BucketCount; Bucket++)
+	{
+		const FText BucketLabel = (Bucket == 0) ?
+			LOCTEXT("FirstBucket", "< 1 ms") :
+			(Bucket == FAgentTaskLatencyHistogram::BucketCount - 1) ?
+				FText::Format(LOCTEXT("LastBucket", "{0}+ ms"), FAgentTaskLatencyHistogram::GetBucketLimitMs(Bucket - 1)) :
+				FText::Format(LOCTEXT("Bucket", "{0} - {1} ms"),
+					FAgentTaskLatencyHistogram::GetBucketLimitMs(Bucket - 1), FAgentTaskLatencyHistogram::GetBucketLimitMs(Bucket));
+
+		Content->AddSlot()
+		.AutoHeight()
+		.Padding(0.0f, 1.0f)
+		[
+			SNew(SHorizontalBox)
+			+ SHorizontalBox::Slot()
+			.FillWidth(0.3f)
+			[
+				SNew(STextBlock)
+				.Text(BucketLabel)
+			]
+			+ SHorizontalBox::Slot()
+			.FillWidth(0.5f)
+			[
+				SNew(SProgressBar)
+				.Percent_Lambda([this, Bucket]()
+				{
+					uint32 MaxCount = 1;
+					for(const uint32 Count : TaskLatency.Counts)
+					{
+						MaxCount = FMath::Max(MaxCount, Count);
+					}
+					return TOptional<float>((float)TaskLatency.Counts[Bucket] / MaxCount);
+				})
+			]
+			+ SHorizontalBox::Slot()
+			.FillWidth(0.2f)
+			.Padding(4.0f, 0.0f)
+			[
+				SNew(STextBlock)
+				.Text_Lambda([this, Bucket]() { return FText::AsNumber(TaskLatency.Counts[Bucket]); })
+			]
+		];
+	}
+
+	ChildSlot
+	[
+		Content
+	];
+
+	RegisterActiveTimer(DASHBOARD_REFRESH_INTERVAL,
+		FWidgetActiveTimerDelegate::CreateSP(this, &SNAIAgentManagerDashboard::Refresh));
+}
+
+ANAIAgentManager* SNAIAgentManagerDashboard::GetLiveManager() const
+{
+	ANAIAgentManager* SelectedManager = Manager.Get();
+	if(!SelectedManager)
+		return nullptr;
+
+	const UWorld* World = SelectedManager->GetWorld();
+	if(World && World->IsGameWorld())
+		return SelectedManager;
+
+#if WITH_EDITOR
+	// Selected in the editor World, find its copy in the PIE World
+	return Cast<ANAIAgentManager>(EditorUtilities::GetSimWorldCounterpartActor(SelectedManager));
+#else
+	return nullptr;
+#endif
+}
+
+EActiveTimerReturnType SNAIAgentManagerDashboard::Refresh(double InCurrentTime, float InDeltaTime)
+{
+	if(!Manager.IsValid())
+		return EActiveTimerReturnType::Stop;
+
+	const ANAIAgentManager* LiveManager = GetLiveManager();
+	if(!LiveManager)
+	{
+		StatusText = LOCTEXT("NotRunning", "Not running, start PIE to see live data.");
+		return EActiveTimerReturnType::Continue;
+	}
+	StatusText = FText::Format(LOCTEXT("Running", "Live: {0}, graphs sampled every {1}s"),
+		FText::FromString(LiveManager->GetName()), DASHBOARD_REFRESH_INTERVAL);
+
+	const FAgentManagerPublishedState& State = LiveManager->GetPublishedState();
+	AgentsText = FText::Format(LOCTEXT("AgentCounts", "{0} total, {1} active, {2} halted, {3} moving, {4} pooled, {5} waiting to spawn"),
+		State.AgentCount, State.AgentCount - State.HaltedAgentCount, State.HaltedAgentCount, State.MovedAgentCount,
+		LiveManager->GetPooledAgentCount(), LiveManager->GetPendingSpawnCount());
+
+	int32 NormalCount, AdvancedCount;
+	LiveManager->GetAgentCountsByAvoidanceLevel(NormalCount, AdvancedCount);
+	AvoidanceLevelsText = FText::Format(LOCTEXT("AvoidanceLevelCounts", "{0} Normal, {1} Advanced"), NormalCount, AdvancedCount);
+
+	const FAgentManagerPhaseTimings& Timings = LiveManager->GetPhaseTimings();
+	FNumberFormattingOptions MsFormat;
+	MsFormat.SetMinimumFractionalDigits(3).SetMaximumFractionalDigits(3);
+	for(uint8 Phase = 0; Phase < (uint8)EAgentManagerPhase::Count; Phase++)
+	{
+		PhaseTexts[Phase] = FText::Format(LOCTEXT("PhaseMs", "{0} ms, {1} ms avg"),
+			FText::AsNumber(Timings.LastMs[Phase], &MsFormat), FText::AsNumber(Timings.AverageMs[Phase], &MsFormat));
+		PhaseGraphs[Phase]->AddSample(Timings.LastMs[Phase]);
+	}
+
+	const FAgentManagerQueryCounts& Queries = LiveManager->GetQueryCounts();
+	QueriesText = FText::Format(LOCTEXT("QueryCounts", "{0} paths, {1} traces, {2} sweeps"),
+		Queries.PathQueries, Queries.LineTraces, Queries.Sweeps);
+	QueryGraph->AddSample(Queries.GetTotal());
+
+	PathQueueText = FText::AsNumber(LiveManager->GetPathQueriesInFlight());
+	PathQueueGraph->AddSample(LiveManager->GetPathQueriesInFlight());
+
+	TaskLatency = LiveManager->GetTaskLatency();
+
+	return EActiveTimerReturnType::Continue;
+}
+
+FReply SNAIAgentManagerDashboard::OnResetLatencyClicked()
+{
+	if(ANAIAgentManager* LiveManager = GetLiveManager())
+	{
+		LiveManager->ResetTaskLatency();
+	}
+	TaskLatency.Reset();
+	return FReply::Handled();
+}
+
+TSharedRef<SWidget> SNAIAgentManagerDashboard::MakeLabelledRow(const FText& Label, const TAttribute<FText>& Value,
+	const TSharedPtr<SNAIRollingGraph>& Graph) const
+{
+	TSharedRef<SHorizontalBox> Row = SNew(SHorizontalBox)
+		+ SHorizontalBox::Slot()
+		.FillWidth(0.3f)
+		.VAlign(VAlign_Center)
+		[
+			SNew(STextBlock)
+			.Text(Label)
+		]
+		+ SHorizontalBox::Slot()
+		.FillWidth(0.4f)
+		.VAlign(VAlign_Center)
+		[
+			SNew(STextBlock)
+			.Text(Value)
+		];
+
+	if(Graph.IsValid())
+	{
+		Row->AddSlot()
+		.AutoWidth()
+		.Padding(4.0f, 1.0f)
+		[
+			Graph.ToSharedRef()
+		];
+	}
+	return Row;
+}
+
+#undef DASHBOARD_REFRESH_INTERVAL
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,68 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAI/Slate/Public/SNAIRollingGraph.h"
+
+#include "Rendering/DrawElements.h"
+#include "Styling/CoreStyle.h"
+
+void SNAIRollingGraph::Construct(const FArguments& InArgs)
+{
+	SampleCount = FMath::Max(InArgs._SampleCount, 2);
+	LineColor = InArgs._LineColor;
+	DesiredSize = InArgs._DesiredSize;
+
+	Samples.Reset(SampleCount);
+	SampleHead = 0;
+}
+
+void SNAIRollingGraph::AddSample(const float Value)
+{
+	if(Samples.Num() < SampleCount)
+	{
+		Samples.Add(Value);
+		return;
+	}
+
+	Samples[SampleHead] = Value;
+	SampleHead = (SampleHead + 1) % SampleCount;
+}
+
+int32 SNAIRollingGraph::OnPaint(const FPaintArgs& Args, const FGeometry& AllottedGeometry, const FSlateRect& MyCullingRect,
+	FSlateWindowElementList& OutDrawElements, int32 LayerId, const FWidgetStyle& InWidgetStyle, bool bParentEnabled) const
+{
+	FSlateDrawElement::MakeBox(OutDrawElements, LayerId, AllottedGeometry.ToPaintGeometry(),
+		FCoreStyle::Get().GetBrush("WhiteBrush"), ESlateDrawEffect::None, FLinearColor(0.02f, 0.02f, 0.02f));
+
+	if(Samples.Num() < 2)
+		return LayerId;
+
+	float MaxValue = KINDA_SMALL_NUMBER;
+	for(const float Sample : Samples)
+	{
+		MaxValue = FMath::Max(MaxValue, Sample);
+	}
+
+	// Oldest on the left, so the graph scrolls from right to left
+	const FVector2D Size = AllottedGeometry.GetLocalSize();
+	const float StepX = Size.X / (SampleCount - 1);
+	const int32 FirstX = SampleCount - Samples.Num();
+	const int32 Oldest = (Samples.Num() < SampleCount) ? 0 : SampleHead;
+
+	TArray<FVector2D> Points;
+	Points.Reserve(Samples.Num());
+	for(int32 i = 0; i < Samples.Num(); i++)
+	{
+		const float Value = Samples[(Oldest + i) % Samples.Num()];
+		Points.Add(FVector2D((FirstX + i) * StepX, Size.Y - ((Value / MaxValue) * (Size.Y - 2.0f)) - 1.0f));
+	}
+
+	FSlateDrawElement::MakeLines(OutDrawElements, LayerId + 1, AllottedGeometry.ToPaintGeometry(),
+		Points, ESlateDrawEffect::None, LineColor, true, 1.0f);
+
+	return LayerId + 1;
+}
+
+FVector2D SNAIRollingGraph::ComputeDesiredSize(float LayoutScaleMultiplier) const
+{
+	return DesiredSize;
+}
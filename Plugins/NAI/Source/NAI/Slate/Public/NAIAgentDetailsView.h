@@ -4,6 +4,9 @@
 
 #include "CoreMinimal.h"
 
+// The details customizations only exist in the editor
+#if WITH_EDITOR
+
 #include "DetailLayoutBuilder.h"
 #include "IDetailCustomization.h"
 #include "Widgets/Input/SSpinBox.h"
@@ -66,3 +69,5 @@ public:
 
 	virtual void CustomizeDetails(IDetailLayoutBuilder& DetailBuilder) override;
 };
+
+#endif
@@ -0,0 +1,52 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Widgets/SCompoundWidget.h"
+#include "NAIAgentManager.h"
+
+class SNAIRollingGraph;
+
+/**
+ * Live performance view of an AgentManager, for tuning intervals and budgets during PIE.
+ * Shows the Agent counts, the per phase timings with rolling graphs, queries per frame,
+ * the path query queue, and a histogram of how long tasks take to get their results back.
+ * When the manager is selected in the editor World, the numbers come from its PIE copy.
+ */
+class NAI_API SNAIAgentManagerDashboard : public SCompoundWidget
+{
+public:
+	SLATE_BEGIN_ARGS(SNAIAgentManagerDashboard) { }
+		SLATE_ARGUMENT(TWeakObjectPtr<ANAIAgentManager>, Manager)
+	SLATE_END_ARGS()
+
+	void Construct(const FArguments& InArgs);
+
+private:
+	/** The copy of the manager that's running, or null if there isn't one. */
+	ANAIAgentManager* GetLiveManager() const;
+
+	/** Pull the latest numbers from the live manager, and push them into the graphs. */
+	EActiveTimerReturnType Refresh(double InCurrentTime, float InDeltaTime);
+
+	FReply OnResetLatencyClicked();
+
+	TSharedRef<SWidget> MakeLabelledRow(const FText& Label, const TAttribute<FText>& Value,
+		const TSharedPtr<SNAIRollingGraph>& Graph = nullptr) const;
+
+	TWeakObjectPtr<ANAIAgentManager> Manager;
+
+	FText StatusText;
+	FText AgentsText;
+	FText AvoidanceLevelsText;
+	FText QueriesText;
+	FText PathQueueText;
+	FText PhaseTexts[(uint8)EAgentManagerPhase::Count];
+
+	TSharedPtr<SNAIRollingGraph> PhaseGraphs[(uint8)EAgentManagerPhase::Count];
+	TSharedPtr<SNAIRollingGraph> QueryGraph;
+	TSharedPtr<SNAIRollingGraph> PathQueueGraph;
+
+	FAgentTaskLatencyHistogram TaskLatency;
+};
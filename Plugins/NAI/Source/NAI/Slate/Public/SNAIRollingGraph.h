@@ -0,0 +1,44 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Widgets/SLeafWidget.h"
+
+/**
+ * A small line graph of the last few samples of a value, newest on the right.
+ * The vertical scale fits itself to the highest sample being shown.
+ */
+class NAI_API SNAIRollingGraph : public SLeafWidget
+{
+public:
+	SLATE_BEGIN_ARGS(SNAIRollingGraph)
+		: _SampleCount(120)
+		, _LineColor(FLinearColor(0.2f, 0.8f, 0.3f))
+		, _DesiredSize(FVector2D(220.0f, 32.0f))
+		{ }
+		/** How many samples to keep. */
+		SLATE_ARGUMENT(int32, SampleCount)
+		SLATE_ARGUMENT(FLinearColor, LineColor)
+		SLATE_ARGUMENT(FVector2D, DesiredSize)
+	SLATE_END_ARGS()
+
+	void Construct(const FArguments& InArgs);
+
+	/** Push a new sample in, dropping the oldest if the graph is full. */
+	void AddSample(const float Value);
+
+	/** SWidget implementation */
+	virtual int32 OnPaint(const FPaintArgs& Args, const FGeometry& AllottedGeometry, const FSlateRect& MyCullingRect,
+		FSlateWindowElementList& OutDrawElements, int32 LayerId, const FWidgetStyle& InWidgetStyle, bool bParentEnabled) const override;
+	virtual FVector2D ComputeDesiredSize(float LayoutScaleMultiplier) const override;
+
+private:
+	/** Ring buffer of samples, SampleHead is the oldest once it's full. */
+	TArray<float> Samples;
+	int32 SampleHead;
+	int32 SampleCount;
+
+	FLinearColor LineColor;
+	FVector2D DesiredSize;
+};
@@ -0,0 +1,22 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+using UnrealBuildTool;
+
+/**
+ * The engine independent part of NAI. This must only ever depend on Core,
+ * so the simulation can be built and run headless, without a UWorld.
+ */
+public class NAISimulation : ModuleRules
+{
+	public NAISimulation(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+		
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+			}
+			);
+	}
+}
@@ -0,0 +1,101 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIDensityField.h"
+
+FNAIDensityField::FNAIDensityField() : Origin(FVector2D::ZeroVector),
+	CellSize(1.0f),
+	InvCellSize(1.0f),
+	SizeX(0),
+	SizeY(0),
+	SplatWeight(1.0f)
+{ }
+
+void FNAIDensityField::Reset(const FBox2D& Bounds, const float InCellSize, const int32 MaxCellsPerAxis)
+{
+	Cells.Reset();
+	SizeX = 0;
+	SizeY = 0;
+	if(!Bounds.bIsValid || InCellSize <= 0.0f || MaxCellsPerAxis <= 0)
+		return;
+
+	const FVector2D Extent = Bounds.GetSize();
+	CellSize = FMath::Max3(InCellSize, Extent.X / MaxCellsPerAxis, Extent.Y / MaxCellsPerAxis);
+	InvCellSize = 1.0f / CellSize;
+	SplatWeight = FMath::Square(InCellSize * InvCellSize);
+
+	Origin = Bounds.Min;
+	SizeX = FMath::Clamp(FMath::CeilToInt(Extent.X * InvCellSize), 1, MaxCellsPerAxis);
+	SizeY = FMath::Clamp(FMath::CeilToInt(Extent.Y * InvCellSize), 1, MaxCellsPerAxis);
+	Cells.SetNumZeroed(SizeX * SizeY);
+}
+
+void FNAIDensityField::Splat(const FVector2D& Location)
+{
+	if(IsEmpty())
+		return;
+
+	int32 X, Y;
+	FVector2D Fraction;
+	GetCellAndFraction(Location, X, Y, Fraction);
+
+	const float Weights[4] = {
+		(1.0f - Fraction.X) * (1.0f - Fraction.Y),
+		Fraction.X * (1.0f - Fraction.Y),
+		(1.0f - Fraction.X) * Fraction.Y,
+		Fraction.X * Fraction.Y
+	};
+	for(int32 i = 0; i < 4; i++)
+	{
+		const int32 CellX = X + (i & 1);
+		const int32 CellY = Y + (i >> 1);
+		if(CellX >= 0 && CellY >= 0 && CellX < SizeX && CellY < SizeY)
+		{
+			Cells[(CellY * SizeX) + CellX] += Weights[i] * SplatWeight;
+		}
+	}
+}
+
+float FNAIDensityField::Sample(const FVector2D& Location, const FVector2D* ExcludedSplat) const
+{
+	if(IsEmpty())
+		return 0.0f;
+
+	int32 X, Y;
+	FVector2D Fraction;
+	GetCellAndFraction(Location, X, Y, Fraction);
+
+	const float Bottom = FMath::Lerp(GetCellExcluding(X, Y, ExcludedSplat), GetCellExcluding(X + 1, Y, ExcludedSplat), Fraction.X);
+	const float Top = FMath::Lerp(GetCellExcluding(X, Y + 1, ExcludedSplat), GetCellExcluding(X + 1, Y + 1, ExcludedSplat), Fraction.X);
+	return FMath::Lerp(Bottom, Top, Fraction.Y);
+}
+
+FVector2D FNAIDensityField::Gradient(const FVector2D& Location, const FVector2D* ExcludedSplat) const
+{
+	if(IsEmpty())
+		return FVector2D::ZeroVector;
+
+	// Half a cell either side, so the gradient blends across cells the same way the density does
+	const float Offset = CellSize * 0.5f;
+	return FVector2D(
+		Sample(Location + FVector2D(Offset, 0.0f), ExcludedSplat) - Sample(Location - FVector2D(Offset, 0.0f), ExcludedSplat),
+		Sample(Location + FVector2D(0.0f, Offset), ExcludedSplat) - Sample(Location - FVector2D(0.0f, Offset), ExcludedSplat)) * InvCellSize;
+}
+
+float FNAIDensityField::GetCellExcluding(const int32 X, const int32 Y, const FVector2D* ExcludedSplat) const
+{
+	const float Cell = GetCell(X, Y);
+	if(!ExcludedSplat || Cell <= 0.0f)
+		return Cell;
+
+	// The same weights Splat() gave the four cells around the excluded location
+	int32 SplatX, SplatY;
+	FVector2D Fraction;
+	GetCellAndFraction(*ExcludedSplat, SplatX, SplatY, Fraction);
+	if(X < SplatX || Y < SplatY || X > SplatX + 1 || Y > SplatY + 1)
+		return Cell;
+
+	const float WeightX = (X == SplatX) ? (1.0f - Fraction.X) : Fraction.X;
+	const float WeightY = (Y == SplatY) ? (1.0f - Fraction.Y) : Fraction.Y;
+	// Floating point error shouldn't leave a cell less than empty
+	return FMath::Max(Cell - (WeightX * WeightY * SplatWeight), 0.0f);
+}
@@ -0,0 +1,30 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAISimMovement.h"
+
+void FNAISimMovement::BeginIntegrate(const int32 MoveCount)
+{
+	Directions.SetNum(MoveCount);
+	Rotations.SetNum(MoveCount);
+	Separations.SetNum(MoveCount);
+	FNAIVectorStreams::SetNumPadded(Steps, MoveCount);
+	FNAIVectorStreams::SetNumPadded(GroundMask, MoveCount);
+	FNAIVectorStreams::SetNumPadded(GroundDeltaZ, MoveCount);
+	FNAIVectorStreams::SetNumPadded(RotationRates, MoveCount);
+}
+
+void FNAISimMovement::RunKernels()
+{
+	// Get the direction in a normalized format, and work out how far along it we move this update
+	FNAIVectorMath::SafeNormalize(Directions);
+	FNAIVectorMath::Scale(Directions, Steps, Deltas);
+	FNAIVectorMath::Add(Separations, Deltas);
+
+	// Snap to the ground where we know where it is
+	// TODO: When there's no ground height, try get it with the simple floor/step checks
+	FNAIVectorMath::Select(GroundMask, GroundDeltaZ, Deltas.Z);
+
+	// Calculate our new rotation, only the yaw follows the path
+	FNAIVectorMath::YawQuatFromDirection(Directions, LookAtRotations);
+	FNAIVectorMath::Slerp(Rotations, LookAtRotations, RotationRates, NewRotations);
+}
@@ -0,0 +1,283 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAISimWorldQuery.h"
+
+bool FNAISimFlatWorld::Raycast(const FVector& Start, const FVector& End, FNAISimHit& OutHit) const
+{
+	float BestTime = 2.0f;
+	FVector BestNormal = FVector::UpVector;
+
+	// The ground plane, only hit from above
+	if(Start.Z >= GroundHeight && End.Z < GroundHeight)
+	{
+		BestTime = (Start.Z - GroundHeight) / (Start.Z - End.Z);
+	}
+
+	for(const FBox& Obstacle : Obstacles)
+	{
+		float Time;
+		FVector Normal;
+		if(SegmentBoxIntersection(Obstacle, Start, End, Time, Normal) && Time < BestTime)
+		{
+			BestTime = Time;
+			BestNormal = Normal;
+		}
+	}
+
+	if(BestTime > 1.0f)
+		return false;
+
+	OutHit = FNAISimHit(Start + ((End - Start) * BestTime), BestNormal);
+	return true;
+}
+
+bool FNAISimFlatWorld::SweepCapsule(const FVector& Start, const FVector& End,
+	const float Radius, const float HalfHeight, TArray<FNAISimHit>& OutHits) const
+{
+	OutHits.Reset();
+
+	// The bottom of the capsule against the ground plane
+	const float StartBottom = Start.Z - HalfHeight;
+	const float EndBottom = End.Z - HalfHeight;
+	if(FMath::Min(StartBottom, EndBottom) <= GroundHeight)
+	{
+		const float Time = (StartBottom <= GroundHeight) ? (0.0f) : ((StartBottom - GroundHeight) / (StartBottom - EndBottom));
+		const FVector Center = Start + ((End - Start) * Time);
+		OutHits.Emplace(FVector(Center.X, Center.Y, GroundHeight), FVector::UpVector);
+	}
+
+	/**
+	 * Sweeping a capsule against a box is the same as tracing a line against the box grown
+	 * by the capsule's extent. Growing it as a box rounds off nothing, which is close
+	 * enough for a mock.
+	 */
+	const FVector Extent(Radius, Radius, HalfHeight);
+	for(const FBox& Obstacle : Obstacles)
+	{
+		float Time;
+		FVector Normal;
+		if(SegmentBoxIntersection(Obstacle.ExpandBy(Extent), Start, End, Time, Normal))
+		{
+			const FVector Center = Start + ((End - Start) * Time);
+			OutHits.Emplace(Obstacle.GetClosestPointTo(Center), Normal);
+		}
+	}
+
+	return OutHits.Num() > 0;
+}
+
+bool FNAISimFlatWorld::FindPath(const FVector& Start, const FVector& Goal, TArray<FVector>& OutPoints) const
+{
+	OutPoints.Reset();
+	OutPoints.Add(Start);
+	OutPoints.Add(Goal);
+	return true;
+}
+
+bool FNAISimFlatWorld::GetGroundHeight(const FVector& Location, const float MaxDrop, float& OutHeight) const
+{
+	bool bFoundGround = false;
+	float Highest = -BIG_NUMBER;
+
+	if(GroundHeight <= Location.Z && (Location.Z - GroundHeight) <= MaxDrop)
+	{
+		Highest = GroundHeight;
+		bFoundGround = true;
+	}
+
+	// The top of any obstacle we're standing over counts as ground too
+	for(const FBox& Obstacle : Obstacles)
+	{
+		const float Top = Obstacle.Max.Z;
+		if(Top > Location.Z || (Location.Z - Top) > MaxDrop || Top <= Highest)
+			continue;
+
+		if(Location.X >= Obstacle.Min.X && Location.X <= Obstacle.Max.X &&
+			Location.Y >= Obstacle.Min.Y && Location.Y <= Obstacle.Max.Y)
+		{
+			Highest = Top;
+			bFoundGround = true;
+		}
+	}
+
+	if(bFoundGround)
+	{
+		OutHeight = Highest;
+	}
+	return bFoundGround;
+}
+
+bool FNAISimFlatWorld::RaycastAsync(const FVector& Start, const FVector& End, const ENAISimQueryFilter Filter,
+	const bool bAllHits, const FNAISimQueryTicket& Ticket)
+{
+	FPendingTrace& Trace = PendingTraces.AddDefaulted_GetRef();
+	Trace.Ticket = Ticket;
+	Trace.Start = Start;
+	Trace.End = End;
+	Trace.Radius = 0.0f;
+	Trace.HalfHeight = 0.0f;
+	Trace.Filter = Filter;
+	Trace.bIsSweep = false;
+	Trace.bAllHits = bAllHits;
+	return true;
+}
+
+bool FNAISimFlatWorld::SweepCapsuleAsync(const FVector& Start, const FVector& End, const float Radius,
+	const float HalfHeight, const ENAISimQueryFilter Filter, const FNAISimQueryTicket& Ticket)
+{
+	FPendingTrace& Trace = PendingTraces.AddDefaulted_GetRef();
+	Trace.Ticket = Ticket;
+	Trace.Start = Start;
+	Trace.End = End;
+	Trace.Radius = Radius;
+	Trace.HalfHeight = HalfHeight;
+	Trace.Filter = Filter;
+	Trace.bIsSweep = true;
+	Trace.bAllHits = true;
+	return true;
+}
+
+bool FNAISimFlatWorld::FindPathAsync(const FVector& Start, const FVector& Goal, const float AgentRadius,
+	const float AgentHeight, const FNAISimQueryTicket& Ticket)
+{
+	FPendingPath& Path = PendingPaths.AddDefaulted_GetRef();
+	Path.Ticket = Ticket;
+	Path.Start = Start;
+	Path.Goal = Goal;
+	return true;
+}
+
+void FNAISimFlatWorld::FlushQueries()
+{
+	Swap(PendingTraces, FlushingTraces);
+	Swap(PendingPaths, FlushingPaths);
+
+	for(const FPendingTrace& Trace : FlushingTraces)
+	{
+		HitScratch.Reset();
+
+		// There are no pawns in here, only the ground and the obstacles
+		if(Trace.Filter != ENAISimQueryFilter::Pawns)
+		{
+			if(Trace.bIsSweep)
+			{
+				SweepCapsule(Trace.Start, Trace.End, Trace.Radius, Trace.HalfHeight, HitScratch);
+			}
+			else if(Trace.bAllHits)
+			{
+				RaycastAll(Trace.Start, Trace.End, HitScratch);
+			}
+			else
+			{
+				FNAISimHit Hit;
+				if(Raycast(Trace.Start, Trace.End, Hit))
+				{
+					HitScratch.Add(Hit);
+				}
+			}
+		}
+
+		if(Listener)
+		{
+			FNAISimTraceResult Result;
+			Result.Ticket = Trace.Ticket;
+			Result.Start = Trace.Start;
+			Result.End = Trace.End;
+			Result.Hits = HitScratch;
+			Listener->OnTraceComplete(Result);
+		}
+	}
+	FlushingTraces.Reset();
+
+	for(const FPendingPath& Path : FlushingPaths)
+	{
+		const bool bSucceeded = FindPath(Path.Start, Path.Goal, PointScratch);
+		if(Listener)
+		{
+			Listener->OnPathComplete(Path.Ticket, bSucceeded, PointScratch);
+		}
+	}
+	FlushingPaths.Reset();
+}
+
+void FNAISimFlatWorld::RaycastAll(const FVector& Start, const FVector& End, TArray<FNAISimHit>& OutHits) const
+{
+	OutHits.Reset();
+
+	// How far along the line each hit is, to put them in order at the end
+	TArray<float, TInlineAllocator<16>> Times;
+	const FVector Delta = End - Start;
+
+	if(Start.Z >= GroundHeight && End.Z < GroundHeight)
+	{
+		const float Time = (Start.Z - GroundHeight) / (Start.Z - End.Z);
+		OutHits.Emplace(Start + (Delta * Time), FVector::UpVector);
+		Times.Add(Time);
+	}
+
+	for(const FBox& Obstacle : Obstacles)
+	{
+		float Time;
+		FVector Normal;
+		if(SegmentBoxIntersection(Obstacle, Start, End, Time, Normal))
+		{
+			OutHits.Emplace(Start + (Delta * Time), Normal);
+			Times.Add(Time);
+		}
+	}
+
+	// There's only ever a handful of them, so a plain insertion sort does
+	for(int32 i = 1; i < OutHits.Num(); i++)
+	{
+		for(int32 j = i; j > 0 && Times[j] < Times[j - 1]; j--)
+		{
+			Swap(Times[j], Times[j - 1]);
+			OutHits.Swap(j, j - 1);
+		}
+	}
+}
+
+bool FNAISimFlatWorld::SegmentBoxIntersection(const FBox& Box, const FVector& Start, const FVector& End,
+	float& OutTime, FVector& OutNormal)
+{
+	const FVector Delta = End - Start;
+	float EnterTime = 0.0f;
+	float ExitTime = 1.0f;
+	FVector EnterNormal = -Delta.GetSafeNormal();
+
+	// Slab test, one axis at a time
+	for(int32 Axis = 0; Axis < 3; Axis++)
+	{
+		if(FMath::IsNearlyZero(Delta[Axis]))
+		{
+			// Parallel to this slab, so it has to start inside it
+			if(Start[Axis] < Box.Min[Axis] || Start[Axis] > Box.Max[Axis])
+				return false;
+			continue;
+		}
+
+		const float InvDelta = 1.0f / Delta[Axis];
+		float NearTime = (Box.Min[Axis] - Start[Axis]) * InvDelta;
+		float FarTime = (Box.Max[Axis] - Start[Axis]) * InvDelta;
+		FVector NearNormal = FVector::ZeroVector;
+		NearNormal[Axis] = -1.0f;
+		if(NearTime > FarTime)
+		{
+			Swap(NearTime, FarTime);
+			NearNormal[Axis] = 1.0f;
+		}
+
+		if(NearTime > EnterTime)
+		{
+			EnterTime = NearTime;
+			EnterNormal = NearNormal;
+		}
+		ExitTime = FMath::Min(ExitTime, FarTime);
+		if(EnterTime > ExitTime)
+			return false;
+	}
+
+	OutTime = EnterTime;
+	OutNormal = EnterNormal;
+	return true;
+}
@@ -0,0 +1,305 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAISimulation.h"
+
+#include "NAISimResults.h"
+#include "HAL/IConsoleManager.h"
+
+/** How far past its capsule an Agent looks for things to avoid. */
+#define AVOIDANCE_TRACE_LENGTH 50.0f
+
+FNAISimulation::FNAISimulation(const INAISimWorldQuery& InWorld)
+	: World(InWorld)
+{ }
+
+int32 FNAISimulation::AddAgent(const FNAISimAgentDesc& Desc)
+{
+	FNAISimAgent Agent;
+	Agent.Location = Desc.Location;
+	Agent.Rotation = Desc.Rotation;
+	Agent.Goal = Desc.Goal;
+	Agent.MoveSpeed = Desc.MoveSpeed;
+	Agent.LookAtRotationRate = Desc.LookAtRotationRate;
+	Agent.CapsuleRadius = Desc.CapsuleRadius;
+	Agent.CapsuleHalfHeight = Desc.CapsuleHalfHeight;
+	Agent.MaxStepHeight = Desc.MaxStepHeight;
+
+	// The tasks start off ready, so everything runs on the first Tick()
+	Agent.PathTask.InitializeTask(Desc.PathInterval);
+	Agent.AvoidanceTask.InitializeTask(Desc.AvoidanceInterval);
+	Agent.GroundTask.InitializeTask(Desc.GroundInterval);
+
+	return Agents.Add(MoveTemp(Agent));
+}
+
+bool FNAISimulation::RemoveAgent(const int32 AgentId)
+{
+	if(!Agents.IsValidIndex(AgentId))
+		return false;
+
+	Agents.RemoveAt(AgentId);
+	return true;
+}
+
+void FNAISimulation::SetGoal(const int32 AgentId, const FVector& Goal)
+{
+	if(!Agents.IsValidIndex(AgentId))
+		return;
+
+	FNAISimAgent& Agent = Agents[AgentId];
+	Agent.Goal = Goal;
+	Agent.PathPoints.Reset();
+	Agent.PathIndex = 0;
+	Agent.bHasArrived = false;
+	Agent.PathTask.Restart();
+}
+
+const FNAISimAgent* FNAISimulation::GetAgent(const int32 AgentId) const
+{
+	return Agents.IsValidIndex(AgentId) ? &Agents[AgentId] : nullptr;
+}
+
+void FNAISimulation::Tick(const float DeltaTime)
+{
+	Stats = FNAISimFrameStats();
+	Stats.AgentCount = Agents.Num();
+
+	const double StartTime = FPlatformTime::Seconds();
+	AdvanceTimers(DeltaTime);
+	const double TimersEndTime = FPlatformTime::Seconds();
+	RunQueries();
+	const double QueriesEndTime = FPlatformTime::Seconds();
+	IntegrateMovement(DeltaTime);
+	const double EndTime = FPlatformTime::Seconds();
+
+	Stats.AdvanceTimersMs = (TimersEndTime - StartTime) * 1000.0;
+	Stats.QueriesMs = (QueriesEndTime - TimersEndTime) * 1000.0;
+	Stats.IntegrateMovementMs = (EndTime - QueriesEndTime) * 1000.0;
+}
+
+void FNAISimulation::AdvanceTimers(const float DeltaTime)
+{
+	for(FNAISimAgent& Agent : Agents)
+	{
+		Agent.PathTask.IncrementTimers(DeltaTime);
+		Agent.AvoidanceTask.IncrementTimers(DeltaTime);
+		Agent.GroundTask.IncrementTimers(DeltaTime);
+	}
+}
+
+void FNAISimulation::RunQueries()
+{
+	for(FNAISimAgent& Agent : Agents)
+	{
+		// Nothing to do until it's given somewhere else to go
+		if(Agent.bHasArrived)
+			continue;
+
+		RunAgentQueries(Agent);
+	}
+}
+
+void FNAISimulation::RunAgentQueries(FNAISimAgent& Agent)
+{
+	if(Agent.PathTask.IsReady())
+	{
+		Agent.PathTask.Reset();
+		Stats.PathQueries++;
+
+		Agent.PathIndex = 0;
+		if(!World.FindPath(Agent.Location, Agent.Goal, Agent.PathPoints))
+		{
+			Agent.PathPoints.Reset();
+		}
+	}
+
+	if(Agent.GroundTask.IsReady())
+	{
+		Agent.GroundTask.Reset();
+		Stats.GroundQueries++;
+
+		float GroundHeight;
+		Agent.bHasGroundHeight = World.GetGroundHeight(Agent.Location,
+			Agent.CapsuleHalfHeight + Agent.MaxStepHeight, GroundHeight);
+		if(Agent.bHasGroundHeight)
+		{
+			Agent.GroundHeight = GroundHeight;
+		}
+	}
+
+	if(Agent.AvoidanceTask.IsReady())
+	{
+		Agent.AvoidanceTask.Reset();
+		Agent.bIsFrontBlocked = false;
+		Agent.StrafeDirection = 0;
+
+		const FVector Forward = GetPathDirection(Agent);
+		if(Forward.IsZero())
+			return;
+
+		const float TraceLength = Agent.CapsuleRadius + AVOIDANCE_TRACE_LENGTH;
+		FNAISimHit Hit;
+
+		Stats.RaycastQueries++;
+		Agent.bIsFrontBlocked = World.Raycast(Agent.Location, Agent.Location + (Forward * TraceLength), Hit);
+
+		/** Is there something in front of the Agent? Check both sides to see which way it can strafe. */
+		if(Agent.bIsFrontBlocked)
+		{
+			const FVector Right = FVector::CrossProduct(FVector::UpVector, Forward);
+			Stats.RaycastQueries += 2;
+			const bool bIsRightBlocked = World.Raycast(Agent.Location, Agent.Location + (Right * TraceLength), Hit);
+			const bool bIsLeftBlocked = World.Raycast(Agent.Location, Agent.Location - (Right * TraceLength), Hit);
+			Agent.StrafeDirection = FNAISimResults::ChooseStrafeDirection(bIsLeftBlocked, bIsRightBlocked);
+		}
+	}
+}
+
+void FNAISimulation::IntegrateMovement(const float DeltaTime)
+{
+	PendingMoves.Reset();
+
+	for(auto It = Agents.CreateIterator(); It; ++It)
+	{
+		FNAISimAgent& Agent = *It;
+		if(Agent.bHasArrived)
+		{
+			Stats.ArrivedCount++;
+			continue;
+		}
+
+		// Move on to the next path point once we're within a step of this one
+		const float ArriveDistance = FMath::Max(Agent.MoveSpeed * DeltaTime, 1.0f);
+		while(Agent.HasPathSegment() &&
+			FVector::DistSquared2D(Agent.Location, Agent.PathPoints[Agent.PathIndex + 1]) <= FMath::Square(ArriveDistance))
+		{
+			Agent.PathIndex++;
+		}
+
+		if(!Agent.HasPathSegment())
+		{
+			// Walked off the end of the path
+			if(Agent.PathPoints.Num() > 0)
+			{
+				Agent.bHasArrived = true;
+				Stats.ArrivedCount++;
+			}
+			Agent.Speed = 0.0f;
+			continue;
+		}
+
+		FVector Direction = GetPathDirection(Agent);
+		if(Agent.bIsFrontBlocked)
+		{
+			if(Agent.StrafeDirection == 0)
+			{
+				// Boxed in, wait for the next avoidance check
+				Stats.BlockedCount++;
+				Agent.Speed = 0.0f;
+				continue;
+			}
+			Direction = FVector::CrossProduct(FVector::UpVector, Direction) * Agent.StrafeDirection;
+		}
+
+		FPendingMove& Move = PendingMoves.AddDefaulted_GetRef();
+		Move.AgentId = It.GetIndex();
+		Move.Location = Agent.Location;
+		Move.Rotation = Agent.Rotation;
+		Move.PathStart = Agent.Location;
+		Move.PathEnd = Agent.Location + Direction;
+		Move.MoveSpeed = Agent.MoveSpeed;
+		Move.LookAtRotationRate = Agent.LookAtRotationRate;
+		Move.CapsuleHalfHeight = Agent.CapsuleHalfHeight;
+		Move.bHasGroundHeight = Agent.bHasGroundHeight;
+		Move.GroundHeight = Agent.GroundHeight;
+	}
+
+	Movement.Integrate(MakeArrayView(PendingMoves), DeltaTime);
+
+	float SpeedSum = 0.0f;
+	for(const FPendingMove& Move : PendingMoves)
+	{
+		FNAISimAgent& Agent = Agents[Move.AgentId];
+		Agent.Location += Move.MoveDelta;
+		Agent.Rotation = Move.NewRotation;
+		Agent.Speed = (DeltaTime > 0.0f) ? (Move.MoveDelta.Size() / DeltaTime) : (0.0f);
+		SpeedSum += Agent.Speed;
+	}
+
+	Stats.MovedCount = PendingMoves.Num();
+	Stats.AverageSpeed = (Stats.MovedCount > 0) ? (SpeedSum / Stats.MovedCount) : (0.0f);
+}
+
+FVector FNAISimulation::GetPathDirection(const FNAISimAgent& Agent)
+{
+	if(!Agent.HasPathSegment())
+		return FVector::ZeroVector;
+
+	// Only ever steer in 2D, the ground height takes care of Z
+	FVector Direction = Agent.PathPoints[Agent.PathIndex + 1] - Agent.Location;
+	Direction.Z = 0.0f;
+	return Direction.GetSafeNormal();
+}
+
+#undef AVOIDANCE_TRACE_LENGTH
+
+#if !UE_BUILD_SHIPPING
+
+/**
+ * Runs a crowd against an FNAISimFlatWorld, with no UWorld involved,
+ * and logs how long it took.
+ */
+static void RunHeadlessSimulation(const TArray<FString>& Args)
+{
+	const int32 AgentCount = (Args.Num() > 0) ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000;
+	const float Seconds = (Args.Num() > 1) ? FMath::Max(0.1f, FCString::Atof(*Args[1])) : 10.0f;
+	const float DeltaTime = 1.0f / 30.0f;
+	const int32 FrameCount = FMath::CeilToInt(Seconds / DeltaTime);
+
+	// A ring of pillars for the crowd to walk through
+	FNAISimFlatWorld World;
+	for(int32 i = 0; i < 16; i++)
+	{
+		const float Angle = (2.0f * PI * i) / 16.0f;
+		const FVector Center(FMath::Cos(Angle) * 1500.0f, FMath::Sin(Angle) * 1500.0f, 150.0f);
+		World.Obstacles.Add(FBox::BuildAABB(Center, FVector(100.0f, 100.0f, 150.0f)));
+	}
+
+	// Everyone starts on a grid, and walks to the mirrored side of it
+	FNAISimulation Simulation(World);
+	const int32 GridSize = FMath::CeilToInt(FMath::Sqrt(static_cast<float>(AgentCount)));
+	const float Spacing = 100.0f;
+	const float HalfExtent = (GridSize * Spacing) * 0.5f;
+	for(int32 i = 0; i < AgentCount; i++)
+	{
+		FNAISimAgentDesc Desc;
+		Desc.Location = FVector(((i % GridSize) * Spacing) - HalfExtent, ((i / GridSize) * Spacing) - HalfExtent - 2000.0f, 89.0f);
+		Desc.Goal = FVector(-Desc.Location.X, -Desc.Location.Y, Desc.Location.Z);
+		Simulation.AddAgent(Desc);
+	}
+
+	double TotalMs = 0.0;
+	double PeakMs = 0.0;
+	int64 RaycastQueries = 0;
+	for(int32 Frame = 0; Frame < FrameCount; Frame++)
+	{
+		Simulation.Tick(DeltaTime);
+
+		const FNAISimFrameStats& Stats = Simulation.GetStats();
+		const double FrameMs = Stats.AdvanceTimersMs + Stats.QueriesMs + Stats.IntegrateMovementMs;
+		TotalMs += FrameMs;
+		PeakMs = FMath::Max(PeakMs, FrameMs);
+		RaycastQueries += Stats.RaycastQueries;
+	}
+
+	const FNAISimFrameStats& Stats = Simulation.GetStats();
+	UE_LOG(LogTemp, Display, TEXT("NAI.Sim: %d agents, %d frames. Average %.3f ms, peak %.3f ms per frame. %d arrived, %d blocked, %lld raycasts."),
+		AgentCount, FrameCount, TotalMs / FrameCount, PeakMs, Stats.ArrivedCount, Stats.BlockedCount, RaycastQueries);
+}
+
+static FAutoConsoleCommand RunHeadlessCommand(
+	TEXT("NAI.Sim.RunHeadless"),
+	TEXT("Run the NAI simulation against a mock world, without a UWorld. Optional arguments: agent count, seconds."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunHeadlessSimulation));
+
+#endif
@@ -0,0 +1,5 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "Modules/ModuleManager.h"
+
+IMPLEMENT_MODULE(FDefaultModuleImpl, NAISimulation)
@@ -0,0 +1,39 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAISpatialHash.h"
+
+FNAISpatialHash::FNAISpatialHash() : InvCellSize(1.0f),
+	BucketMask(0)
+{ }
+
+void FNAISpatialHash::Build(const TArrayView<const FVector2D>& InPoints, const float InCellSize)
+{
+	Points.Reset();
+	Points.Append(InPoints.GetData(), InPoints.Num());
+	InvCellSize = 1.0f / FMath::Max(InCellSize, 1.0f);
+
+	// Around two buckets per point keeps the collisions down without the bucket array swamping the points
+	const int32 BucketCount = (int32)FMath::RoundUpToPowerOfTwo(FMath::Max(Points.Num() * 2, 16));
+	BucketMask = (uint32)BucketCount - 1;
+	BucketStarts.Reset();
+	BucketStarts.SetNumZeroed(BucketCount + 1);
+	SortedIndices.SetNumUninitialized(Points.Num(), false);
+
+	// Count the points in each bucket, turn the counts into where each bucket starts, then drop the points in
+	for(const FVector2D& Point : Points)
+	{
+		BucketStarts[GetBucket(GetCellX(Point), GetCellY(Point)) + 1]++;
+	}
+	for(int32 i = 1; i <= BucketCount; i++)
+	{
+		BucketStarts[i] += BucketStarts[i - 1];
+	}
+
+	TArray<int32, TInlineAllocator<1024>> Cursors;
+	Cursors.Append(BucketStarts.GetData(), BucketCount);
+	for(int32 i = 0; i < Points.Num(); i++)
+	{
+		const uint32 Bucket = GetBucket(GetCellX(Points[i]), GetCellY(Points[i]));
+		SortedIndices[Cursors[Bucket]++] = i;
+	}
+}
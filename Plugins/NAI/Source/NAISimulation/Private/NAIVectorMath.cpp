@@ -0,0 +1,489 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#include "NAIVectorMath.h"
+
+#include "HAL/IConsoleManager.h"
+
+/** Same threshold FVector::GetSafeNormal() uses. */
+#define NAI_SAFE_NORMAL_TOLERANCE	SMALL_NUMBER
+/** Past this the quaternions are close enough to just lerp, same as FQuat::Slerp(). */
+#define NAI_SLERP_LERP_THRESHOLD	0.9999f
+
+/** sqrt(V), or 0 where V isn't positive. */
+static FORCEINLINE VectorRegister VectorSafeSqrt(const VectorRegister& V)
+{
+	const VectorRegister Zero = VectorZero();
+	const VectorRegister IsPositive = VectorCompareGT(V, Zero);
+	const VectorRegister Safe = VectorSelect(IsPositive, V, VectorOne());
+	return VectorSelect(IsPositive, VectorMultiply(Safe, VectorReciprocalSqrtAccurate(Safe)), Zero);
+}
+
+/**
+ * atan2(Y, X) in radians.
+ * Uses a minimax polynomial for atan on [0, 1], the error is under 1e-5 radians.
+ */
+static FORCEINLINE VectorRegister VectorATan2Approx(const VectorRegister& Y, const VectorRegister& X)
+{
+	const VectorRegister Zero = VectorZero();
+	const VectorRegister AbsX = VectorAbs(X);
+	const VectorRegister AbsY = VectorAbs(Y);
+	const VectorRegister Max = VectorMax(AbsX, AbsY);
+	const VectorRegister Min = VectorMin(AbsX, AbsY);
+
+	// atan2(0, 0) is 0, so guard the divide
+	const VectorRegister IsNonZero = VectorCompareGT(Max, Zero);
+	const VectorRegister A = VectorSelect(IsNonZero,
+		VectorDivide(Min, VectorSelect(IsNonZero, Max, VectorOne())), Zero);
+	const VectorRegister S = VectorMultiply(A, A);
+
+	VectorRegister R = VectorMultiplyAdd(VectorSetFloat1(-0.0464964749f), S, VectorSetFloat1(0.15931422f));
+	R = VectorMultiplyAdd(R, S, VectorSetFloat1(-0.327622764f));
+	R = VectorMultiplyAdd(VectorMultiply(R, S), A, A);
+
+	// Unfold from the first octant
+	R = VectorSelect(VectorCompareGT(AbsY, AbsX), VectorSubtract(VectorSetFloat1(HALF_PI), R), R);
+	R = VectorSelect(VectorCompareGT(Zero, X), VectorSubtract(VectorSetFloat1(PI), R), R);
+	return VectorSelect(VectorCompareGT(Zero, Y), VectorNegate(R), R);
+}
+
+/**
+ * acos(V) in radians, for V in [0, 1].
+ * Abramowitz and Stegun 4.4.45, the error is under 7e-5 radians.
+ */
+static FORCEINLINE VectorRegister VectorACosPositiveApprox(const VectorRegister& V)
+{
+	VectorRegister R = VectorMultiplyAdd(VectorSetFloat1(-0.0187293f), V, VectorSetFloat1(0.0742610f));
+	R = VectorMultiplyAdd(R, V, VectorSetFloat1(-0.2121144f));
+	R = VectorMultiplyAdd(R, V, VectorSetFloat1(1.5707288f));
+	return VectorMultiply(R, VectorSafeSqrt(VectorSubtract(VectorOne(), V)));
+}
+
+void FNAIVectorMath::Distance(const FNAIVectorStreams& A, const FNAIVectorStreams& B, FNAIFloatStream& Out)
+{
+	const int32 Padded = A.GetPaddedNum();
+	FNAIVectorStreams::SetNumPadded(Out, A.GetNum());
+
+	for(int32 i = 0; i < Padded; i += Lanes)
+	{
+		const VectorRegister DX = VectorSubtract(VectorLoadAligned(&A.X[i]), VectorLoadAligned(&B.X[i]));
+		const VectorRegister DY = VectorSubtract(VectorLoadAligned(&A.Y[i]), VectorLoadAligned(&B.Y[i]));
+		const VectorRegister DZ = VectorSubtract(VectorLoadAligned(&A.Z[i]), VectorLoadAligned(&B.Z[i]));
+
+		VectorRegister SizeSquared = VectorMultiply(DX, DX);
+		SizeSquared = VectorMultiplyAdd(DY, DY, SizeSquared);
+		SizeSquared = VectorMultiplyAdd(DZ, DZ, SizeSquared);
+		VectorStoreAligned(VectorSafeSqrt(SizeSquared), &Out[i]);
+	}
+}
+
+void FNAIVectorMath::Speed(
+	const FNAIVectorStreams& Current, const FNAIVectorStreams& Previous, const float DeltaTime, FNAIFloatStream& Out)
+{
+	Distance(Current, Previous, Out);
+
+	const VectorRegister InvDeltaTime = VectorSetFloat1((DeltaTime > 0.0f) ? (1.0f / DeltaTime) : 0.0f);
+	for(int32 i = 0; i < Out.Num(); i += Lanes)
+	{
+		VectorStoreAligned(VectorMultiply(VectorLoadAligned(&Out[i]), InvDeltaTime), &Out[i]);
+	}
+}
+
+void FNAIVectorMath::SafeNormalize(FNAIVectorStreams& InOut)
+{
+	const VectorRegister Zero = VectorZero();
+	const VectorRegister Tolerance = VectorSetFloat1(NAI_SAFE_NORMAL_TOLERANCE);
+
+	for(int32 i = 0; i < InOut.GetPaddedNum(); i += Lanes)
+	{
+		const VectorRegister X = VectorLoadAligned(&InOut.X[i]);
+		const VectorRegister Y = VectorLoadAligned(&InOut.Y[i]);
+		const VectorRegister Z = VectorLoadAligned(&InOut.Z[i]);
+
+		VectorRegister SizeSquared = VectorMultiply(X, X);
+		SizeSquared = VectorMultiplyAdd(Y, Y, SizeSquared);
+		SizeSquared = VectorMultiplyAdd(Z, Z, SizeSquared);
+
+		const VectorRegister CanNormalize = VectorCompareGE(SizeSquared, Tolerance);
+		const VectorRegister InvSize = VectorSelect(CanNormalize,
+			VectorReciprocalSqrtAccurate(VectorSelect(CanNormalize, SizeSquared, VectorOne())), Zero);
+
+		VectorStoreAligned(VectorMultiply(X, InvSize), &InOut.X[i]);
+		VectorStoreAligned(VectorMultiply(Y, InvSize), &InOut.Y[i]);
+		VectorStoreAligned(VectorMultiply(Z, InvSize), &InOut.Z[i]);
+	}
+}
+
+void FNAIVectorMath::Scale(const FNAIVectorStreams& A, const FNAIFloatStream& InScale, FNAIVectorStreams& Out)
+{
+	Out.SetNum(A.GetNum());
+
+	for(int32 i = 0; i < A.GetPaddedNum(); i += Lanes)
+	{
+		const VectorRegister S = VectorLoadAligned(&InScale[i]);
+		VectorStoreAligned(VectorMultiply(VectorLoadAligned(&A.X[i]), S), &Out.X[i]);
+		VectorStoreAligned(VectorMultiply(VectorLoadAligned(&A.Y[i]), S), &Out.Y[i]);
+		VectorStoreAligned(VectorMultiply(VectorLoadAligned(&A.Z[i]), S), &Out.Z[i]);
+	}
+}
+
+void FNAIVectorMath::Add(const FNAIVectorStreams& A, FNAIVectorStreams& InOut)
+{
+	for(int32 i = 0; i < InOut.GetPaddedNum(); i += Lanes)
+	{
+		VectorStoreAligned(VectorAdd(VectorLoadAligned(&InOut.X[i]), VectorLoadAligned(&A.X[i])), &InOut.X[i]);
+		VectorStoreAligned(VectorAdd(VectorLoadAligned(&InOut.Y[i]), VectorLoadAligned(&A.Y[i])), &InOut.Y[i]);
+		VectorStoreAligned(VectorAdd(VectorLoadAligned(&InOut.Z[i]), VectorLoadAligned(&A.Z[i])), &InOut.Z[i]);
+	}
+}
+
+void FNAIVectorMath::Select(const FNAIFloatStream& Mask, const FNAIFloatStream& IfSet, FNAIFloatStream& InOut)
+{
+	const VectorRegister Zero = VectorZero();
+
+	for(int32 i = 0; i < InOut.Num(); i += Lanes)
+	{
+		const VectorRegister IsSet = VectorCompareNE(VectorLoadAligned(&Mask[i]), Zero);
+		VectorStoreAligned(
+			VectorSelect(IsSet, VectorLoadAligned(&IfSet[i]), VectorLoadAligned(&InOut[i])), &InOut[i]);
+	}
+}
+
+void FNAIVectorMath::YawFromDirection(const FNAIVectorStreams& Directions, FNAIFloatStream& OutYaw)
+{
+	FNAIVectorStreams::SetNumPadded(OutYaw, Directions.GetNum());
+	const VectorRegister RadToDeg = VectorSetFloat1(180.0f / PI);
+
+	for(int32 i = 0; i < Directions.GetPaddedNum(); i += Lanes)
+	{
+		const VectorRegister Yaw = VectorATan2Approx(
+			VectorLoadAligned(&Directions.Y[i]), VectorLoadAligned(&Directions.X[i]));
+		VectorStoreAligned(VectorMultiply(Yaw, RadToDeg), &OutYaw[i]);
+	}
+}
+
+void FNAIVectorMath::YawQuatFromDirection(const FNAIVectorStreams& Directions, FNAIQuatStreams& Out)
+{
+	Out.SetNum(Directions.GetNum());
+
+	const VectorRegister Zero = VectorZero();
+	const VectorRegister One = VectorOne();
+	const VectorRegister Half = VectorSetFloat1(0.5f);
+	const VectorRegister Tolerance = VectorSetFloat1(NAI_SAFE_NORMAL_TOLERANCE);
+
+	for(int32 i = 0; i < Directions.GetPaddedNum(); i += Lanes)
+	{
+		const VectorRegister X = VectorLoadAligned(&Directions.X[i]);
+		const VectorRegister Y = VectorLoadAligned(&Directions.Y[i]);
+
+		// The cos and sin of the yaw, which is just the normalized 2D direction. Use a yaw of 0 if there isn't one
+		const VectorRegister SizeSquared = VectorMultiplyAdd(Y, Y, VectorMultiply(X, X));
+		const VectorRegister HasDirection = VectorCompareGE(SizeSquared, Tolerance);
+		const VectorRegister InvSize = VectorReciprocalSqrtAccurate(VectorSelect(HasDirection, SizeSquared, One));
+		const VectorRegister CosYaw = VectorSelect(HasDirection, VectorMultiply(X, InvSize), One);
+		const VectorRegister SinYaw = VectorSelect(HasDirection, VectorMultiply(Y, InvSize), Zero);
+
+		// Half angle identities, so there's no need for the angle itself
+		const VectorRegister W = VectorSafeSqrt(VectorMultiply(VectorAdd(One, CosYaw), Half));
+		const VectorRegister Z = VectorSafeSqrt(VectorMultiply(VectorSubtract(One, CosYaw), Half));
+
+		VectorStoreAligned(Zero, &Out.X[i]);
+		VectorStoreAligned(Zero, &Out.Y[i]);
+		VectorStoreAligned(VectorSelect(VectorCompareGT(Zero, SinYaw), VectorNegate(Z), Z), &Out.Z[i]);
+		VectorStoreAligned(W, &Out.W[i]);
+	}
+}
+
+void FNAIVectorMath::Slerp(
+	const FNAIQuatStreams& A, const FNAIQuatStreams& B, const FNAIFloatStream& Alpha, FNAIQuatStreams& Out)
+{
+	Out.SetNum(A.GetNum());
+
+	const VectorRegister Zero = VectorZero();
+	const VectorRegister One = VectorOne();
+	const VectorRegister LerpThreshold = VectorSetFloat1(NAI_SLERP_LERP_THRESHOLD);
+
+	for(int32 i = 0; i < A.GetPaddedNum(); i += Lanes)
+	{
+		const VectorRegister AX = VectorLoadAligned(&A.X[i]);
+		const VectorRegister AY = VectorLoadAligned(&A.Y[i]);
+		const VectorRegister AZ = VectorLoadAligned(&A.Z[i]);
+		const VectorRegister AW = VectorLoadAligned(&A.W[i]);
+		const VectorRegister BX = VectorLoadAligned(&B.X[i]);
+		const VectorRegister BY = VectorLoadAligned(&B.Y[i]);
+		const VectorRegister BZ = VectorLoadAligned(&B.Z[i]);
+		const VectorRegister BW = VectorLoadAligned(&B.W[i]);
+		const VectorRegister T = VectorLoadAligned(&Alpha[i]);
+
+		VectorRegister RawCosom = VectorMultiply(AX, BX);
+		RawCosom = VectorMultiplyAdd(AY, BY, RawCosom);
+		RawCosom = VectorMultiplyAdd(AZ, BZ, RawCosom);
+		RawCosom = VectorMultiplyAdd(AW, BW, RawCosom);
+		const VectorRegister Cosom = VectorMin(VectorAbs(RawCosom), One);
+
+		// sin(Omega) from cos(Omega), it's only used away from Cosom == 1 where this is accurate
+		const VectorRegister Omega = VectorACosPositiveApprox(Cosom);
+		const VectorRegister SinOmega = VectorSafeSqrt(VectorSubtract(One, VectorMultiply(Cosom, Cosom)));
+		const VectorRegister UseLerp = VectorCompareGE(Cosom, LerpThreshold);
+		const VectorRegister InvSinOmega = VectorReciprocalAccurate(VectorSelect(UseLerp, One, SinOmega));
+
+		VectorRegister Sin0, Sin1, Unused;
+		const VectorRegister Angle0 = VectorMultiply(VectorSubtract(One, T), Omega);
+		const VectorRegister Angle1 = VectorMultiply(T, Omega);
+		VectorSinCos(&Sin0, &Unused, &Angle0);
+		VectorSinCos(&Sin1, &Unused, &Angle1);
+
+		const VectorRegister Scale0 = VectorSelect(UseLerp, VectorSubtract(One, T), VectorMultiply(Sin0, InvSinOmega));
+		VectorRegister Scale1 = VectorSelect(UseLerp, T, VectorMultiply(Sin1, InvSinOmega));
+		// Take the shortest path
+		Scale1 = VectorSelect(VectorCompareGT(Zero, RawCosom), VectorNegate(Scale1), Scale1);
+
+		const VectorRegister RX = VectorMultiplyAdd(Scale1, BX, VectorMultiply(Scale0, AX));
+		const VectorRegister RY = VectorMultiplyAdd(Scale1, BY, VectorMultiply(Scale0, AY));
+		const VectorRegister RZ = VectorMultiplyAdd(Scale1, BZ, VectorMultiply(Scale0, AZ));
+		const VectorRegister RW = VectorMultiplyAdd(Scale1, BW, VectorMultiply(Scale0, AW));
+
+		// Normalize, the padding lanes are all zero so guard against them
+		VectorRegister SizeSquared = VectorMultiply(RX, RX);
+		SizeSquared = VectorMultiplyAdd(RY, RY, SizeSquared);
+		SizeSquared = VectorMultiplyAdd(RZ, RZ, SizeSquared);
+		SizeSquared = VectorMultiplyAdd(RW, RW, SizeSquared);
+		const VectorRegister CanNormalize = VectorCompareGT(SizeSquared, Zero);
+		const VectorRegister InvSize = VectorSelect(CanNormalize,
+			VectorReciprocalSqrtAccurate(VectorSelect(CanNormalize, SizeSquared, One)), Zero);
+
+		VectorStoreAligned(VectorMultiply(RX, InvSize), &Out.X[i]);
+		VectorStoreAligned(VectorMultiply(RY, InvSize), &Out.Y[i]);
+		VectorStoreAligned(VectorMultiply(RZ, InvSize), &Out.Z[i]);
+		VectorStoreAligned(VectorMultiply(RW, InvSize), &Out.W[i]);
+	}
+}
+
+#undef NAI_SAFE_NORMAL_TOLERANCE
+#undef NAI_SLERP_LERP_THRESHOLD
+
+#if !UE_BUILD_SHIPPING
+
+/**
+ * Console commands for checking the kernels against their FMath references,
+ * and timing them against the scalar versions.
+ */
+namespace NAIVectorMathConsole
+{
+	static void FillRandom(FRandomStream& Random, const int32 Num,
+		FNAIVectorStreams& A, FNAIVectorStreams& B, FNAIQuatStreams& QA, FNAIQuatStreams& QB, FNAIFloatStream& Alpha)
+	{
+		A.SetNum(Num);
+		B.SetNum(Num);
+		QA.SetNum(Num);
+		QB.SetNum(Num);
+		FNAIVectorStreams::SetNumPadded(Alpha, Num);
+
+		for(int32 i = 0; i < Num; i++)
+		{
+			A.Set(i, Random.GetUnitVector() * Random.FRandRange(0.0f, 10000.0f));
+			B.Set(i, Random.GetUnitVector() * Random.FRandRange(0.0f, 10000.0f));
+			QA.Set(i, FRotator(Random.FRandRange(-90.0f, 90.0f), Random.FRandRange(-180.0f, 180.0f), Random.FRandRange(-180.0f, 180.0f)).Quaternion());
+			QB.Set(i, FRotator(Random.FRandRange(-90.0f, 90.0f), Random.FRandRange(-180.0f, 180.0f), Random.FRandRange(-180.0f, 180.0f)).Quaternion());
+			Alpha[i] = Random.FRand();
+		}
+
+		// Make sure the edge cases are in there
+		if(Num > 4)
+		{
+			A.Set(0, FVector::ZeroVector);
+			B.Set(0, FVector::ZeroVector);
+			A.Set(1, FVector(0.0f, 0.0f, 5.0f));
+			QB.Set(2, QA.Get(2));
+			QB.Set(3, -QA.Get(3));
+		}
+	}
+
+	/** Keeps track of the worst error for a kernel, and logs it. */
+	struct FErrorTracker
+	{
+		const TCHAR* Name;
+		float Tolerance;
+		float MaxError;
+
+		FErrorTracker(const TCHAR* InName, const float InTolerance) : Name(InName), Tolerance(InTolerance), MaxError(0.0f)
+		{ }
+
+		FORCEINLINE void Add(const float Error) { MaxError = FMath::Max(MaxError, Error); }
+
+		bool Report() const
+		{
+			const bool bPassed = MaxError <= Tolerance;
+			UE_LOG(LogTemp, Display, TEXT("NAI.VectorMath: %-22s max error %g (tolerance %g) %s"),
+				Name, MaxError, Tolerance, bPassed ? TEXT("PASSED") : TEXT("FAILED"));
+			return bPassed;
+		}
+	};
+
+	static void Verify()
+	{
+		const int32 Num = 4099; // Not a whole number of lanes, on purpose
+		FRandomStream Random(0x4E4149);
+		FNAIVectorStreams A, B, Normals, Scaled;
+		FNAIQuatStreams QA, QB, QOut;
+		FNAIFloatStream Alpha, Out;
+		FillRandom(Random, Num, A, B, QA, QB, Alpha);
+
+		bool bAllPassed = true;
+
+		{
+			FErrorTracker Tracker(TEXT("Distance"), 1e-5f);
+			FNAIVectorMath::Distance(A, B, Out);
+			for(int32 i = 0; i < Num; i++)
+			{
+				const float Expected = FVector::Dist(A.Get(i), B.Get(i));
+				Tracker.Add(FMath::Abs(Out[i] - Expected) / FMath::Max(1.0f, Expected));
+			}
+			bAllPassed &= Tracker.Report();
+		}
+		{
+			FErrorTracker Tracker(TEXT("Speed"), 1e-5f);
+			const float DeltaTime = 1.0f / 60.0f;
+			FNAIVectorMath::Speed(A, B, DeltaTime, Out);
+			for(int32 i = 0; i < Num; i++)
+			{
+				const float Expected = FVector::Dist(A.Get(i), B.Get(i)) / DeltaTime;
+				Tracker.Add(FMath::Abs(Out[i] - Expected) / FMath::Max(1.0f, Expected));
+			}
+			bAllPassed &= Tracker.Report();
+		}
+		{
+			FErrorTracker Tracker(TEXT("SafeNormalize"), 1e-5f);
+			Normals = A;
+			FNAIVectorMath::SafeNormalize(Normals);
+			for(int32 i = 0; i < Num; i++)
+			{
+				Tracker.Add((Normals.Get(i) - A.Get(i).GetSafeNormal()).GetAbsMax());
+			}
+			bAllPassed &= Tracker.Report();
+		}
+		{
+			FErrorTracker Tracker(TEXT("Scale"), 1e-5f);
+			FNAIVectorMath::Scale(A, Alpha, Scaled);
+			for(int32 i = 0; i < Num; i++)
+			{
+				const FVector Expected = A.Get(i) * Alpha[i];
+				Tracker.Add((Scaled.Get(i) - Expected).GetAbsMax() / FMath::Max(1.0f, Expected.GetAbsMax()));
+			}
+			bAllPassed &= Tracker.Report();
+		}
+		{
+			FErrorTracker Tracker(TEXT("Add"), 1e-5f);
+			FNAIVectorStreams Sum = B;
+			FNAIVectorMath::Add(A, Sum);
+			for(int32 i = 0; i < Num; i++)
+			{
+				const FVector Expected = B.Get(i) + A.Get(i);
+				Tracker.Add((Sum.Get(i) - Expected).GetAbsMax() / FMath::Max(1.0f, Expected.GetAbsMax()));
+			}
+			bAllPassed &= Tracker.Report();
+		}
+		{
+			FErrorTracker Tracker(TEXT("YawFromDirection"), 1e-2f);
+			FNAIVectorMath::YawFromDirection(A, Out);
+			for(int32 i = 0; i < Num; i++)
+			{
+				Tracker.Add(FMath::Abs(FRotator::NormalizeAxis(Out[i] - A.Get(i).Rotation().Yaw)));
+			}
+			bAllPassed &= Tracker.Report();
+		}
+		{
+			FErrorTracker Tracker(TEXT("YawQuatFromDirection"), 1e-3f);
+			FNAIVectorMath::YawQuatFromDirection(A, QOut);
+			for(int32 i = 0; i < Num; i++)
+			{
+				const FQuat Expected = FRotator(0.0f, A.Get(i).Rotation().Yaw, 0.0f).Quaternion();
+				Tracker.Add(QOut.Get(i).AngularDistance(Expected));
+			}
+			bAllPassed &= Tracker.Report();
+		}
+		{
+			FErrorTracker Tracker(TEXT("Slerp"), 1e-3f);
+			FNAIVectorMath::Slerp(QA, QB, Alpha, QOut);
+			for(int32 i = 0; i < Num; i++)
+			{
+				Tracker.Add(QOut.Get(i).AngularDistance(FQuat::Slerp(QA.Get(i), QB.Get(i), Alpha[i])));
+			}
+			bAllPassed &= Tracker.Report();
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("NAI.VectorMath: %s"), bAllPassed ? TEXT("All kernels PASSED") : TEXT("Some kernels FAILED"));
+	}
+
+	/** Run Func Iterations times, and return the average in milliseconds. */
+	template<typename FuncType>
+	static double Time(const int32 Iterations, FuncType&& Func)
+	{
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for(int32 i = 0; i < Iterations; i++)
+		{
+			Func();
+		}
+		return FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) / Iterations;
+	}
+
+	static void Benchmark(const TArray<FString>& Args)
+	{
+		const int32 Num = (Args.Num() > 0) ? FMath::Max(1, FCString::Atoi(*Args[0])) : 10000;
+		const int32 Iterations = 100;
+
+		FRandomStream Random(0x4E4149);
+		FNAIVectorStreams A, B, Normals;
+		FNAIQuatStreams QA, QB, QOut;
+		FNAIFloatStream Alpha, Out;
+		FillRandom(Random, Num, A, B, QA, QB, Alpha);
+
+		// The scalar versions work on the same data, laid out the way the old code had it
+		TArray<FVector> AoSA, AoSB, AoSOut;
+		TArray<FQuat> AoSQA, AoSQB, AoSQOut;
+		TArray<float> AoSOutFloat;
+		for(int32 i = 0; i < Num; i++)
+		{
+			AoSA.Add(A.Get(i));
+			AoSB.Add(B.Get(i));
+			AoSQA.Add(QA.Get(i));
+			AoSQB.Add(QB.Get(i));
+		}
+		AoSOut.SetNumUninitialized(Num);
+		AoSQOut.SetNumUninitialized(Num);
+		AoSOutFloat.SetNumUninitialized(Num);
+
+		const auto Report = [Num](const TCHAR* Name, const double ScalarMs, const double VectorMs)
+		{
+			UE_LOG(LogTemp, Display, TEXT("NAI.VectorMath: %-22s x%d  scalar %.4f ms  vector %.4f ms  (%.2fx)"),
+				Name, Num, ScalarMs, VectorMs, (VectorMs > 0.0) ? (ScalarMs / VectorMs) : 0.0);
+		};
+
+		Report(TEXT("Distance"),
+			Time(Iterations, [&]() { for(int32 i = 0; i < Num; i++) { AoSOutFloat[i] = FVector::Dist(AoSA[i], AoSB[i]); } }),
+			Time(Iterations, [&]() { FNAIVectorMath::Distance(A, B, Out); }));
+		Report(TEXT("SafeNormalize"),
+			Time(Iterations, [&]() { for(int32 i = 0; i < Num; i++) { AoSOut[i] = AoSA[i].GetSafeNormal(); } }),
+			Time(Iterations, [&]() { Normals = A; FNAIVectorMath::SafeNormalize(Normals); }));
+		Report(TEXT("YawFromDirection"),
+			Time(Iterations, [&]() { for(int32 i = 0; i < Num; i++) { AoSOutFloat[i] = AoSA[i].Rotation().Yaw; } }),
+			Time(Iterations, [&]() { FNAIVectorMath::YawFromDirection(A, Out); }));
+		Report(TEXT("YawQuatFromDirection"),
+			Time(Iterations, [&]() { for(int32 i = 0; i < Num; i++) { AoSQOut[i] = FRotator(0.0f, AoSA[i].Rotation().Yaw, 0.0f).Quaternion(); } }),
+			Time(Iterations, [&]() { FNAIVectorMath::YawQuatFromDirection(A, QOut); }));
+		Report(TEXT("Slerp"),
+			Time(Iterations, [&]() { for(int32 i = 0; i < Num; i++) { AoSQOut[i] = FQuat::Slerp(AoSQA[i], AoSQB[i], Alpha[i]); } }),
+			Time(Iterations, [&]() { FNAIVectorMath::Slerp(QA, QB, Alpha, QOut); }));
+	}
+
+	static FAutoConsoleCommand VerifyCommand(
+		TEXT("NAI.VectorMath.Verify"),
+		TEXT("Check the NAI vector math kernels against their scalar FMath references."),
+		FConsoleCommandDelegate::CreateStatic(&Verify));
+
+	static FAutoConsoleCommand BenchmarkCommand(
+		TEXT("NAI.VectorMath.Benchmark"),
+		TEXT("Time the NAI vector math kernels against their scalar FMath references. Optional argument: element count."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Benchmark));
+}
+
+#endif
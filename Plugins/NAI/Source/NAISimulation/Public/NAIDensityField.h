@@ -0,0 +1,76 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A coarse grid of how crowded each part of the world is, built from the Agents' locations.
+ * Each Agent is spread over the four cells around it, so the density, and its gradient,
+ * change smoothly as the Agents move instead of jumping as they cross a cell edge.
+ * The density is in Agents per cell of the size asked for in Reset(), even if the grid
+ * had to use bigger cells to cover the bounds.
+ * @brief Crowd density grid for the AgentManager.
+ */
+class NAISIMULATION_API FNAIDensityField
+{
+public:
+	/** Handle default initialization. */
+	FNAIDensityField();
+
+	/**
+	 * Empty the field, and set it up to cover the given bounds.
+	 * @param Bounds The area to cover, Agents outside of it are ignored.
+	 * @param InCellSize The size of each cell. Grown if the bounds need more than MaxCellsPerAxis cells.
+	 * @param MaxCellsPerAxis The most cells along each side of the grid.
+	 */
+	void Reset(const FBox2D& Bounds, const float InCellSize, const int32 MaxCellsPerAxis);
+
+	/** Add an Agent at the given location. */
+	void Splat(const FVector2D& Location);
+
+	/**
+	 * Get the density at the given location, blended between the cells around it.
+	 * @param Location Where to sample.
+	 * @param ExcludedSplat If set, an Agent splatted from here is left out, so an Agent doesn't count itself.
+	 */
+	float Sample(const FVector2D& Location, const FVector2D* ExcludedSplat = nullptr) const;
+
+	/**
+	 * Get how fast the density rises per unit moved, at the given location. Points towards the crowd.
+	 * @param Location Where to sample.
+	 * @param ExcludedSplat If set, an Agent splatted from here is left out, so an Agent isn't pushed away from itself.
+	 */
+	FVector2D Gradient(const FVector2D& Location, const FVector2D* ExcludedSplat = nullptr) const;
+
+	FORCEINLINE bool IsEmpty() const { return Cells.Num() == 0; }
+	FORCEINLINE float GetCellSize() const { return CellSize; }
+
+private:
+	/** Find the cell below and to the left of a location's cell centre, and how far past it the location is. */
+	FORCEINLINE void GetCellAndFraction(const FVector2D& Location, int32& OutX, int32& OutY, FVector2D& OutFraction) const
+	{
+		const float X = ((Location.X - Origin.X) * InvCellSize) - 0.5f;
+		const float Y = ((Location.Y - Origin.Y) * InvCellSize) - 0.5f;
+		OutX = FMath::FloorToInt(X);
+		OutY = FMath::FloorToInt(Y);
+		OutFraction = FVector2D(X - OutX, Y - OutY);
+	}
+
+	FORCEINLINE float GetCell(const int32 X, const int32 Y) const
+	{
+		return (X >= 0 && Y >= 0 && X < SizeX && Y < SizeY) ? Cells[(Y * SizeX) + X] : 0.0f;
+	}
+
+	/** Get a cell, less what Splat() added to it for an Agent at the excluded location. */
+	float GetCellExcluding(const int32 X, const int32 Y, const FVector2D* ExcludedSplat) const;
+
+	FVector2D Origin;
+	float CellSize;
+	float InvCellSize;
+	int32 SizeX;
+	int32 SizeY;
+	/** What each Agent adds to a cell, so the density stays in Agents per requested cell size. */
+	float SplatWeight;
+	TArray<float> Cells;
+};
@@ -0,0 +1,119 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NAIVectorMath.h"
+
+/**
+ * Everything needed to move one Agent one step along its path.
+ * The inputs are filled in by whoever owns the Agent, the outputs by FNAISimMovement.
+ */
+struct NAISIMULATION_API FNAISimMove
+{
+	/** Inputs. */
+	FVector Location;
+	FQuat Rotation;
+	FVector PathStart;
+	FVector PathEnd;
+	float MoveSpeed;
+	float LookAtRotationRate;
+	float CapsuleHalfHeight;
+	float GroundHeight;
+	uint8 bHasGroundHeight : 1;
+	/** Velocity added on top of the path, to push the Agent away from the crowd. Doesn't turn the Agent. */
+	FVector Separation;
+
+	/** Outputs. */
+	FVector MoveDelta;
+	FQuat NewRotation;
+
+	/** Handle default initialization. */
+	FNAISimMove() : Location(FVector::ZeroVector),
+		Rotation(FQuat::Identity),
+		PathStart(FVector::ZeroVector),
+		PathEnd(FVector::ZeroVector),
+		MoveSpeed(0.0f),
+		LookAtRotationRate(0.0f),
+		CapsuleHalfHeight(0.0f),
+		GroundHeight(0.0f),
+		bHasGroundHeight(false),
+		Separation(FVector::ZeroVector),
+		MoveDelta(FVector::ZeroVector),
+		NewRotation(FQuat::Identity)
+	{ }
+};
+
+/**
+ * Works out the new location and rotation for a batch of moves.
+ * The moves are laid out as streams and worked on with the FNAIVectorMath kernels,
+ * 4 at a time, instead of going through FVector/FRotator math one Agent at a time.
+ * Holds on to its streams between calls so they don't have to be reallocated,
+ * so one instance must only be used by one thread at a time.
+ * @brief Batched movement integration for the Agents.
+ */
+class NAISIMULATION_API FNAISimMovement
+{
+public:
+	/**
+	 * Fill in MoveDelta and NewRotation for every move.
+	 * @param Moves The moves to integrate, any type deriving from FNAISimMove.
+	 * @param DeltaTime Time passed since last frame.
+	 */
+	template<typename TMoveType>
+	void Integrate(TArrayView<TMoveType> Moves, const float DeltaTime)
+	{
+		static_assert(TIsDerivedFrom<TMoveType, FNAISimMove>::IsDerived, "Moves must derive from FNAISimMove");
+
+		const int32 MoveCount = Moves.Num();
+		if(MoveCount == 0)
+			return;
+
+		BeginIntegrate(MoveCount);
+		for(int32 i = 0; i < MoveCount; i++)
+		{
+			SetInput(i, Moves[i], DeltaTime);
+		}
+
+		RunKernels();
+
+		for(int32 i = 0; i < MoveCount; i++)
+		{
+			GetOutput(i, Moves[i]);
+		}
+	}
+
+private:
+	void BeginIntegrate(const int32 MoveCount);
+	void RunKernels();
+
+	FORCEINLINE void SetInput(const int32 Index, const FNAISimMove& Move, const float DeltaTime)
+	{
+		Directions.Set(Index, Move.PathEnd - Move.PathStart);
+		Rotations.Set(Index, Move.Rotation);
+		Steps[Index] = Move.MoveSpeed * DeltaTime;
+		Separations.Set(Index, Move.Separation * DeltaTime);
+		RotationRates[Index] = Move.LookAtRotationRate;
+
+		// An offset is applied to avoid the agent getting stuck on the floor
+		GroundMask[Index] = (Move.bHasGroundHeight) ? (1.0f) : (0.0f);
+		GroundDeltaZ[Index] = (Move.GroundHeight + (Move.CapsuleHalfHeight + 1.0f)) - Move.Location.Z;
+	}
+
+	FORCEINLINE void GetOutput(const int32 Index, FNAISimMove& Move) const
+	{
+		Move.MoveDelta = Deltas.Get(Index);
+		Move.NewRotation = NewRotations.Get(Index);
+	}
+
+	FNAIVectorStreams Directions;
+	FNAIVectorStreams Deltas;
+	FNAIVectorStreams Separations;
+	FNAIFloatStream Steps;
+	FNAIFloatStream GroundMask;
+	FNAIFloatStream GroundDeltaZ;
+	FNAIFloatStream RotationRates;
+	FNAIQuatStreams Rotations;
+	FNAIQuatStreams LookAtRotations;
+	FNAIQuatStreams NewRotations;
+};
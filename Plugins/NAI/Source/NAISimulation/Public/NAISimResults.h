@@ -0,0 +1,108 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NAISimWorldQuery.h"
+
+/**
+ * Helpers for boiling the raw query results down to what the Agents use.
+ * @brief Result aggregation shared by the simulation and the AgentManager.
+ */
+class NAISIMULATION_API FNAISimResults
+{
+public:
+	/**
+	 * Find the highest of a set of points.
+	 * @param Points The points to search.
+	 * @param OutHighest The highest point, left alone if there are no points.
+	 * @return Whether or not there were any points.
+	 */
+	static FORCEINLINE bool GetHighestPoint(const TArrayView<const FVector>& Points, FVector& OutHighest)
+	{
+		if(Points.Num() == 0)
+			return false;
+
+		OutHighest = Points[0];
+		for(int32 i = 1; i < Points.Num(); i++)
+		{
+			if(Points[i].Z > OutHighest.Z)
+			{
+				OutHighest = Points[i];
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Find the highest of a query's hits.
+	 * @param Hits The hits to search.
+	 * @param OutHighest The highest hit's location, left alone if there are no hits to choose from.
+	 * @param bIgnoreAgents Skip the Agents themselves, they're never the ground. Their collision proxies still count.
+	 * @return Whether or not there were any hits to choose from.
+	 */
+	static FORCEINLINE bool GetHighestHitPoint(const TArrayView<const FNAISimHit>& Hits, FVector& OutHighest,
+		const bool bIgnoreAgents = false)
+	{
+		bool bFound = false;
+		for(const FNAISimHit& Hit : Hits)
+		{
+			if(bIgnoreAgents && Hit.bIsAgent)
+				continue;
+
+			if(!bFound || Hit.Location.Z > OutHighest.Z)
+			{
+				OutHighest = Hit.Location;
+				bFound = true;
+			}
+		}
+		return bFound;
+	}
+
+	/**
+	 * Is an Agent blocked by another Agent? Only the Agents themselves count, not the world or their proxies.
+	 * @param Hits The hits from the Agent's avoidance trace.
+	 * @param Guid The Agent the trace was for, it never blocks itself.
+	 */
+	static FORCEINLINE bool IsBlockedByAgent(const TArrayView<const FNAISimHit>& Hits, const FGuid& Guid)
+	{
+		for(const FNAISimHit& Hit : Hits)
+		{
+			if(Hit.bIsAgent && Hit.AgentGuid != Guid)
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Is an Agent blocked by anything other than itself, or its own collision proxy?
+	 * The traces start inside the proxy that's wrapped around the Agent, so they can clip it on the way out.
+	 * @param Hits The hits from the Agent's avoidance trace.
+	 * @param Guid The Agent the trace was for.
+	 */
+	static FORCEINLINE bool IsBlockedByWorld(const TArrayView<const FNAISimHit>& Hits, const FGuid& Guid)
+	{
+		for(const FNAISimHit& Hit : Hits)
+		{
+			if(Hit.AgentGuid != Guid)
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Which way an Agent should strafe, given which of its sides are blocked.
+	 * Prefers the right when both sides are clear, so crowds tend to flow the same way.
+	 * @param bIsLeftBlocked Is there something to the left of the Agent?
+	 * @param bIsRightBlocked Is there something to the right of the Agent?
+	 * @return 1 for right, -1 for left, or 0 when it can't strafe at all.
+	 */
+	static FORCEINLINE int8 ChooseStrafeDirection(const bool bIsLeftBlocked, const bool bIsRightBlocked)
+	{
+		if(!bIsRightBlocked)
+			return 1;
+		if(!bIsLeftBlocked)
+			return -1;
+		return 0;
+	}
+};
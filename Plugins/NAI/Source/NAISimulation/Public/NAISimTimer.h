@@ -0,0 +1,116 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Specialist timer which will automatically stop when a set
+ * interval of time has passed, and become "ready".
+ * The timer then has to be reset to be used again.
+ * @biref Specialist timer for use by the Agents.
+ */
+struct NAISIMULATION_API FAgentTimedProperty
+{
+	/** The tick/time interval this timer should become "ready" at. */
+	float TickRate;
+	/** Used to track time passed. */
+	float Time;
+	/** Has this timer completed it's tick interval? */
+	uint8 bIsReady : 1;
+	/** Used to pause/unpause the timer. */
+	uint8 bIsPaused : 1;
+
+	/** Create the timer, starting in the "ready" state. */
+	FAgentTimedProperty() { TickRate = 1.0f; Time = 0.0f; bIsReady = true; bIsPaused = false;}
+
+	/** Pause the timer. */
+	FORCEINLINE void Pause() { bIsPaused = true; }
+
+	/** Unpause the timer. */
+	FORCEINLINE void Unpause() { bIsPaused = false; }
+
+	/** Resets the timer. This will also unpause the timer. */
+	FORCEINLINE void Reset() { Time = 0.0f; bIsReady = false; bIsPaused = false; }
+
+	/**
+	 * This will only add the InTime if the timer is not
+	 * already in the "ready" state. It will also not add it
+	 * if the timer is paused.
+	 * @param InTime The amount of time to add.
+	 */
+	FORCEINLINE void AddTime(const float InTime)
+	{
+		if(bIsPaused || bIsReady)
+			return;
+		
+		// Become ready on the same update the interval passes, not the one after it
+		Time += InTime;
+		if(Time >= TickRate)
+		{
+			bIsReady = true;
+			Time = 0.0f;
+		}
+	}
+
+	/** 
+	 * Always add time regardless of the state of the timer.
+	 * @param InTime The amount of time to add.
+	 */
+	FORCEINLINE void AddTimeRaw(const float InTime) { Time += InTime; }
+};
+
+/**
+ * This serves as the base type for all the Agents tasks.
+ * It's just simply a timer which need to be initialized and
+ * incremented.
+ */
+struct NAISIMULATION_API FAgentSimpleTask
+{
+private:
+	FAgentTimedProperty TaskTimer;
+	/** The tick rate the task was initialized with. The current one may have been stretched out since. */
+	float BaseTickRate;
+public:
+	/** Handle default initialization. */
+	FAgentSimpleTask() : BaseTickRate(1.0f)
+	{ }
+
+	/** Initialize the task with a tick rate. */
+	virtual FORCEINLINE void InitializeTask(const float InTickRate)
+	{
+		TaskTimer.TickRate = InTickRate;
+		BaseTickRate = InTickRate;
+	}
+
+	FORCEINLINE float GetTickRate() const { return TaskTimer.TickRate; }
+	FORCEINLINE float GetBaseTickRate() const { return BaseTickRate; }
+
+	/**
+	 * Change how often the task becomes ready, without losing the rate it was initialized with.
+	 * Takes effect from the next interval, the time already counted towards this one is kept.
+	 */
+	FORCEINLINE void SetTickRate(const float InTickRate) { TaskTimer.TickRate = InTickRate; }
+	
+	virtual FORCEINLINE void IncrementTimers(const float DeltaTime)
+	{
+		TaskTimer.AddTime(DeltaTime);
+	}
+	
+	virtual FORCEINLINE void Reset() { TaskTimer.Reset(); }
+	FORCEINLINE bool IsReady() const { return TaskTimer.bIsReady; }
+
+	/**
+	 * Put the task back into the state it was in straight after InitializeTask(),
+	 * keeping its tick rate. Used when a pooled Agent is brought back into play.
+	 */
+	virtual FORCEINLINE void Restart()
+	{
+		TaskTimer.TickRate = BaseTickRate;
+		TaskTimer.Time = 0.0f;
+		TaskTimer.bIsReady = true;
+		TaskTimer.bIsPaused = false;
+	}
+
+	virtual ~FAgentSimpleTask() { } // Need this
+};
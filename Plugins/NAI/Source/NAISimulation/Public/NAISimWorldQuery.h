@@ -0,0 +1,293 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** A single hit from one of the world queries. */
+struct NAISIMULATION_API FNAISimHit
+{
+	/** Where the query hit. */
+	FVector Location;
+	/** The surface normal at the hit. */
+	FVector Normal;
+	/** The Agent this hit belongs to, the Agent itself or its collision proxy. Invalid for everything else. */
+	FGuid AgentGuid;
+	/** Whether or not this hit was an Agent itself, rather than its collision proxy or the world. */
+	uint8 bIsAgent : 1;
+
+	/** Handle default initialization. */
+	FNAISimHit() : Location(FVector::ZeroVector),
+		Normal(FVector::UpVector),
+		bIsAgent(false)
+	{ }
+
+	FNAISimHit(const FVector& InLocation, const FVector& InNormal, const uint8 InIsAgent = false,
+		const FGuid& InAgentGuid = FGuid())
+		: Location(InLocation), Normal(InNormal), AgentGuid(InAgentGuid), bIsAgent(InIsAgent)
+	{ }
+};
+
+/** What kinds of object an async query looks for. */
+enum class ENAISimQueryFilter : uint8
+{
+	/** The level, its static and dynamic geometry. */
+	World,
+	/** The Agents and the players. */
+	Pawns,
+	/** Both of them. */
+	All,
+};
+
+/**
+ * Sent off with an async query, and handed back with its result so the caller knows what it was for.
+ * The world query only carries it, what the fields mean is up to whoever sends the query.
+ */
+struct NAISIMULATION_API FNAISimQueryTicket
+{
+	/** The Agent the query is for. */
+	FGuid Guid;
+	/** What kind of query this is. */
+	uint8 Type;
+	/** Anything else the caller needs, such as which way an avoidance trace points. */
+	uint8 Direction;
+
+	/** Handle default initialization. */
+	FNAISimQueryTicket() : Type(0),
+		Direction(0)
+	{ }
+
+	FNAISimQueryTicket(const FGuid& InGuid, const uint8 InType, const uint8 InDirection = 0)
+		: Guid(InGuid), Type(InType), Direction(InDirection)
+	{ }
+};
+
+/** The result of an async trace or sweep. */
+struct NAISIMULATION_API FNAISimTraceResult
+{
+	/** The ticket the query was sent with. */
+	FNAISimQueryTicket Ticket;
+	FVector Start;
+	FVector End;
+	/** What was hit, in order along the query. Only valid for the duration of the callback. */
+	TArrayView<const FNAISimHit> Hits;
+
+	/** Handle default initialization. */
+	FNAISimTraceResult() : Start(FVector::ZeroVector),
+		End(FVector::ZeroVector)
+	{ }
+};
+
+/**
+ * Whoever sends async queries through an INAISimWorldQuery gets their results through this.
+ * @brief Receives the results of the async world queries.
+ */
+class NAISIMULATION_API INAISimQueryListener
+{
+public:
+	virtual ~INAISimQueryListener() { }
+
+	/**
+	 * An async trace or sweep has come back.
+	 * @param Result The ticket it was sent with, and what it hit.
+	 */
+	virtual void OnTraceComplete(const FNAISimTraceResult& Result) = 0;
+
+	/**
+	 * An async path query has come back.
+	 * @param Ticket The ticket the query was sent with.
+	 * @param bSucceeded Whether or not a path was found.
+	 * @param Points The path, including the start and end points. Only valid for the duration of the callback.
+	 */
+	virtual void OnPathComplete(const FNAISimQueryTicket& Ticket, const bool bSucceeded,
+		const TArrayView<const FVector>& Points) = 0;
+};
+
+/**
+ * Everything the simulation needs to know about the world, and nothing more.
+ * The UE adapter (FNAIWorldQueryAdapter in the NAI module) binds this to a UWorld,
+ * FNAISimFlatWorld is a stand in for running headless.
+ * The synchronous queries must be safe to call from whatever thread the simulation is ticked on.
+ * The async ones are sent off and answered on the thread that owns the listener, the GameThread for the adapter.
+ * @brief Abstract world the simulation runs against.
+ */
+class NAISIMULATION_API INAISimWorldQuery
+{
+public:
+	/** Handle default initialization. */
+	INAISimWorldQuery() : Listener(nullptr)
+	{ }
+
+	virtual ~INAISimWorldQuery() { }
+
+	/**
+	 * Trace a line through the world.
+	 * @param Start Where the trace starts.
+	 * @param End Where the trace ends.
+	 * @param OutHit The first blocking hit, if there was one.
+	 * @return Whether or not anything was hit.
+	 */
+	virtual bool Raycast(const FVector& Start, const FVector& End, FNAISimHit& OutHit) const = 0;
+
+	/**
+	 * Sweep an upright capsule through the world.
+	 * @param Start Where the capsule's center starts.
+	 * @param End Where the capsule's center ends.
+	 * @param Radius Radius of the capsule.
+	 * @param HalfHeight Half height of the capsule.
+	 * @param OutHits Every hit along the sweep.
+	 * @return Whether or not anything was hit.
+	 */
+	virtual bool SweepCapsule(const FVector& Start, const FVector& End,
+		const float Radius, const float HalfHeight, TArray<FNAISimHit>& OutHits) const = 0;
+
+	/**
+	 * Find a path between two points.
+	 * @param Start Where the path starts.
+	 * @param Goal Where the path should end up.
+	 * @param OutPoints The path, including the start and end points.
+	 * @return Whether or not a path was found.
+	 */
+	virtual bool FindPath(const FVector& Start, const FVector& Goal, TArray<FVector>& OutPoints) const = 0;
+
+	/**
+	 * Find the height of the ground under a location.
+	 * @param Location Where to look from, the ground must be below this.
+	 * @param MaxDrop How far below Location to look.
+	 * @param OutHeight The height of the ground, if it was found.
+	 * @return Whether or not there was any ground.
+	 */
+	virtual bool GetGroundHeight(const FVector& Location, const float MaxDrop, float& OutHeight) const = 0;
+
+	/**
+	 * Send off a line trace, the result goes to the listener once it's done.
+	 * @param Start Where the trace starts.
+	 * @param End Where the trace ends.
+	 * @param Filter What the trace looks for.
+	 * @param bAllHits Collect every hit along the trace, rather than just the first one.
+	 * @param Ticket Handed back with the result.
+	 * @return Whether or not the trace was sent. Only the ones that were sent come back.
+	 */
+	virtual bool RaycastAsync(const FVector& Start, const FVector& End, const ENAISimQueryFilter Filter,
+		const bool bAllHits, const FNAISimQueryTicket& Ticket) = 0;
+
+	/**
+	 * Send off a sweep of an upright capsule, the result goes to the listener once it's done.
+	 * Every hit along the sweep is collected.
+	 * @param Start Where the capsule's center starts.
+	 * @param End Where the capsule's center ends.
+	 * @param Radius Radius of the capsule.
+	 * @param HalfHeight Half height of the capsule.
+	 * @param Filter What the sweep looks for.
+	 * @param Ticket Handed back with the result.
+	 * @return Whether or not the sweep was sent. Only the ones that were sent come back.
+	 */
+	virtual bool SweepCapsuleAsync(const FVector& Start, const FVector& End, const float Radius,
+		const float HalfHeight, const ENAISimQueryFilter Filter, const FNAISimQueryTicket& Ticket) = 0;
+
+	/**
+	 * Send off a path query, the result goes to the listener once it's done.
+	 * @param Start Where the path starts.
+	 * @param Goal Where the path should end up.
+	 * @param AgentRadius Radius of the Agent the path is for.
+	 * @param AgentHeight Height of the Agent the path is for.
+	 * @param Ticket Handed back with the result.
+	 * @return Whether or not the query was sent. Only the ones that were sent come back.
+	 */
+	virtual bool FindPathAsync(const FVector& Start, const FVector& Goal, const float AgentRadius,
+		const float AgentHeight, const FNAISimQueryTicket& Ticket) = 0;
+
+	/** Set who gets the results of the async queries. It must outlive every query sent while it's set. */
+	FORCEINLINE void SetListener(INAISimQueryListener* InListener) { Listener = InListener; }
+
+protected:
+	INAISimQueryListener* Listener;
+};
+
+/**
+ * A flat, infinite ground plane with box obstacles on it.
+ * Paths are straight lines, so this is only good for exercising the simulation
+ * without a UWorld, not for testing navigation.
+ * @brief Mock world for running the simulation headless.
+ */
+class NAISIMULATION_API FNAISimFlatWorld : public INAISimWorldQuery
+{
+public:
+	/** The height of the ground plane. */
+	float GroundHeight;
+	/** The obstacles sitting on the ground plane. */
+	TArray<FBox> Obstacles;
+
+	/** Handle default initialization. */
+	FNAISimFlatWorld() : GroundHeight(0.0f)
+	{ }
+
+	explicit FNAISimFlatWorld(const float InGroundHeight) : GroundHeight(InGroundHeight)
+	{ }
+
+	/** INAISimWorldQuery implementation */
+	virtual bool Raycast(const FVector& Start, const FVector& End, FNAISimHit& OutHit) const override;
+	virtual bool SweepCapsule(const FVector& Start, const FVector& End,
+		const float Radius, const float HalfHeight, TArray<FNAISimHit>& OutHits) const override;
+	virtual bool FindPath(const FVector& Start, const FVector& Goal, TArray<FVector>& OutPoints) const override;
+	virtual bool GetGroundHeight(const FVector& Location, const float MaxDrop, float& OutHeight) const override;
+	virtual bool RaycastAsync(const FVector& Start, const FVector& End, const ENAISimQueryFilter Filter,
+		const bool bAllHits, const FNAISimQueryTicket& Ticket) override;
+	virtual bool SweepCapsuleAsync(const FVector& Start, const FVector& End, const float Radius,
+		const float HalfHeight, const ENAISimQueryFilter Filter, const FNAISimQueryTicket& Ticket) override;
+	virtual bool FindPathAsync(const FVector& Start, const FVector& Goal, const float AgentRadius,
+		const float AgentHeight, const FNAISimQueryTicket& Ticket) override;
+
+	/**
+	 * Answer every async query sent since the last flush, in the order they were sent.
+	 * Nothing comes back until this is called, the same as the engine's queries coming back a frame later.
+	 * Queries sent by the listener while this runs are left for the next flush.
+	 */
+	void FlushQueries();
+
+private:
+	/** An async trace or sweep waiting for the next flush. */
+	struct FPendingTrace
+	{
+		FNAISimQueryTicket Ticket;
+		FVector Start;
+		FVector End;
+		/** The capsule's extent for sweeps, zero for traces. */
+		float Radius;
+		float HalfHeight;
+		ENAISimQueryFilter Filter;
+		uint8 bIsSweep : 1;
+		uint8 bAllHits : 1;
+	};
+
+	/** An async path query waiting for the next flush. */
+	struct FPendingPath
+	{
+		FNAISimQueryTicket Ticket;
+		FVector Start;
+		FVector Goal;
+	};
+
+	/** Collect every hit along a line through the world, closest first. */
+	void RaycastAll(const FVector& Start, const FVector& End, TArray<FNAISimHit>& OutHits) const;
+
+	/**
+	 * Intersect a segment with a box.
+	 * @param Box The box to test against.
+	 * @param Start Where the segment starts.
+	 * @param End Where the segment ends.
+	 * @param OutTime How far along the segment the hit is, from 0 to 1.
+	 * @param OutNormal The normal of the face that was hit.
+	 */
+	static bool SegmentBoxIntersection(const FBox& Box, const FVector& Start, const FVector& End,
+		float& OutTime, FVector& OutNormal);
+
+	TArray<FPendingTrace> PendingTraces;
+	TArray<FPendingPath> PendingPaths;
+	/** The queries being answered by FlushQueries(), swapped out so new ones can be sent while it runs. */
+	TArray<FPendingTrace> FlushingTraces;
+	TArray<FPendingPath> FlushingPaths;
+	/** Reused for every result, the listener only sees them for the duration of the callback. */
+	TArray<FNAISimHit> HitScratch;
+	TArray<FVector> PointScratch;
+};
@@ -0,0 +1,177 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NAISimMovement.h"
+#include "NAISimTimer.h"
+#include "NAISimWorldQuery.h"
+
+/** Everything needed to add an Agent to an FNAISimulation. */
+struct NAISIMULATION_API FNAISimAgentDesc
+{
+	FVector Location;
+	FQuat Rotation;
+	FVector Goal;
+	float MoveSpeed;
+	float LookAtRotationRate;
+	float CapsuleRadius;
+	float CapsuleHalfHeight;
+	float MaxStepHeight;
+
+	/** How often, in seconds, each of the Agent's tasks runs. */
+	float PathInterval;
+	float AvoidanceInterval;
+	float GroundInterval;
+
+	/** Handle default initialization. */
+	FNAISimAgentDesc() : Location(FVector::ZeroVector),
+		Rotation(FQuat::Identity),
+		Goal(FVector::ZeroVector),
+		MoveSpeed(300.0f),
+		LookAtRotationRate(0.1f),
+		CapsuleRadius(34.0f),
+		CapsuleHalfHeight(88.0f),
+		MaxStepHeight(45.0f),
+		PathInterval(0.5f),
+		AvoidanceInterval(0.1f),
+		GroundInterval(0.1f)
+	{ }
+};
+
+/** The state of one Agent in an FNAISimulation. */
+struct NAISIMULATION_API FNAISimAgent
+{
+	FVector Location;
+	FQuat Rotation;
+	FVector Goal;
+	float MoveSpeed;
+	float LookAtRotationRate;
+	float CapsuleRadius;
+	float CapsuleHalfHeight;
+	float MaxStepHeight;
+
+	FAgentSimpleTask PathTask;
+	FAgentSimpleTask AvoidanceTask;
+	FAgentSimpleTask GroundTask;
+
+	/** The last path found, and the point the Agent is currently heading to. */
+	TArray<FVector> PathPoints;
+	int32 PathIndex;
+
+	float GroundHeight;
+	float Speed;
+	/** 1 for right, -1 for left, 0 when not strafing. See FNAISimResults::ChooseStrafeDirection(). */
+	int8 StrafeDirection;
+
+	uint8 bHasGroundHeight : 1;
+	uint8 bIsFrontBlocked : 1;
+	uint8 bHasArrived : 1;
+
+	/** Handle default initialization. */
+	FNAISimAgent() : Location(FVector::ZeroVector),
+		Rotation(FQuat::Identity),
+		Goal(FVector::ZeroVector),
+		MoveSpeed(0.0f),
+		LookAtRotationRate(0.0f),
+		CapsuleRadius(0.0f),
+		CapsuleHalfHeight(0.0f),
+		MaxStepHeight(0.0f),
+		PathIndex(0),
+		GroundHeight(0.0f),
+		Speed(0.0f),
+		StrafeDirection(0),
+		bHasGroundHeight(false),
+		bIsFrontBlocked(false),
+		bHasArrived(false)
+	{ }
+
+	/** Does the Agent have somewhere to go on its current path? */
+	FORCEINLINE bool HasPathSegment() const { return PathPoints.IsValidIndex(PathIndex + 1); }
+};
+
+/** What happened during the last FNAISimulation::Tick(). */
+struct NAISIMULATION_API FNAISimFrameStats
+{
+	int32 AgentCount;
+	int32 MovedCount;
+	int32 BlockedCount;
+	int32 ArrivedCount;
+
+	int32 PathQueries;
+	int32 RaycastQueries;
+	int32 GroundQueries;
+
+	float AverageSpeed;
+
+	/** How long each phase took, in milliseconds. */
+	double AdvanceTimersMs;
+	double QueriesMs;
+	double IntegrateMovementMs;
+
+	/** Handle default initialization. */
+	FNAISimFrameStats() { FMemory::Memzero(*this); }
+};
+
+/**
+ * The Agent simulation, with no dependency on the engine: timers, task scheduling,
+ * movement integration, avoidance decisions and result aggregation.
+ * It only sees the world through an INAISimWorldQuery, so it can run against a UWorld
+ * through FNAIWorldQueryAdapter, or headless against FNAISimFlatWorld.
+ * Everything runs synchronously on the thread calling Tick().
+ * @brief Engine independent Agent simulation.
+ */
+class NAISIMULATION_API FNAISimulation
+{
+public:
+	/** @param InWorld The world to run against, it must outlive the simulation. */
+	explicit FNAISimulation(const INAISimWorldQuery& InWorld);
+
+	/**
+	 * Add an Agent to the simulation.
+	 * @return The Agent's id, which stays the same until it's removed.
+	 */
+	int32 AddAgent(const FNAISimAgentDesc& Desc);
+
+	/** Remove an Agent from the simulation. */
+	bool RemoveAgent(const int32 AgentId);
+
+	/** Send an Agent somewhere else, it'll find a new path on its next Tick(). */
+	void SetGoal(const int32 AgentId, const FVector& Goal);
+
+	/** Get an Agent by id, or nullptr if there isn't one. */
+	const FNAISimAgent* GetAgent(const int32 AgentId) const;
+
+	FORCEINLINE int32 Num() const { return Agents.Num(); }
+
+	/** Step the simulation forward. */
+	void Tick(const float DeltaTime);
+
+	/** What happened during the last Tick(). */
+	FORCEINLINE const FNAISimFrameStats& GetStats() const { return Stats; }
+
+private:
+	/** A move for one Agent, so the result can be found again after integrating. */
+	struct FPendingMove : public FNAISimMove
+	{
+		int32 AgentId;
+	};
+
+	void AdvanceTimers(const float DeltaTime);
+	void RunQueries();
+	void IntegrateMovement(const float DeltaTime);
+
+	/** Run an Agent's due tasks against the World. */
+	void RunAgentQueries(FNAISimAgent& Agent);
+
+	/** The direction the Agent is trying to move in, ignoring avoidance. Zero if it isn't. */
+	static FVector GetPathDirection(const FNAISimAgent& Agent);
+
+	const INAISimWorldQuery& World;
+	TSparseArray<FNAISimAgent> Agents;
+
+	TArray<FPendingMove> PendingMoves;
+	FNAISimMovement Movement;
+
+	FNAISimFrameStats Stats;
+};
@@ -0,0 +1,83 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A hashed grid of points, rebuilt from scratch each frame, for finding the Agents near a location.
+ * The cells are hashed into a fixed number of buckets, so it covers any area without growing,
+ * and the points are counting sorted into the buckets, so a build is two passes over them with no
+ * per cell allocations. Buckets can hold points from more than one cell, so queries check the distance.
+ * @brief Neighbour lookup for the AgentManager.
+ */
+class NAISIMULATION_API FNAISpatialHash
+{
+public:
+	/** Handle default initialization. */
+	FNAISpatialHash();
+
+	/**
+	 * Empty the hash, and fill it with the given points.
+	 * @param InPoints The points to add. A point's index here is what the queries hand back.
+	 * @param InCellSize The size of each cell. Around the largest query radius works best.
+	 */
+	void Build(const TArrayView<const FVector2D>& InPoints, const float InCellSize);
+
+	/**
+	 * Call a function with the index of every point within a radius of a location.
+	 * @param Center The location to search around.
+	 * @param Radius How far from the location to search.
+	 * @param Func Called with the index of each point found, and its squared distance from the location.
+	 */
+	template<typename FuncType>
+	void ForEachInRadius(const FVector2D& Center, const float Radius, FuncType Func) const
+	{
+		if(Points.Num() == 0)
+			return;
+
+		const float RadiusSquared = FMath::Square(Radius);
+		const int32 MinX = FMath::FloorToInt((Center.X - Radius) * InvCellSize);
+		const int32 MaxX = FMath::FloorToInt((Center.X + Radius) * InvCellSize);
+		const int32 MinY = FMath::FloorToInt((Center.Y - Radius) * InvCellSize);
+		const int32 MaxY = FMath::FloorToInt((Center.Y + Radius) * InvCellSize);
+		for(int32 Y = MinY; Y <= MaxY; Y++)
+		{
+			for(int32 X = MinX; X <= MaxX; X++)
+			{
+				const uint32 Bucket = GetBucket(X, Y);
+				for(int32 i = BucketStarts[Bucket]; i < BucketStarts[Bucket + 1]; i++)
+				{
+					const int32 Index = SortedIndices[i];
+					const float DistanceSquared = FVector2D::DistSquared(Points[Index], Center);
+					// A bucket shared with another cell in range would otherwise hand the same point back twice
+					if(DistanceSquared <= RadiusSquared && GetCellX(Points[Index]) == X && GetCellY(Points[Index]) == Y)
+					{
+						Func(Index, DistanceSquared);
+					}
+				}
+			}
+		}
+	}
+
+	FORCEINLINE int32 Num() const { return Points.Num(); }
+	FORCEINLINE const FVector2D& GetPoint(const int32 Index) const { return Points[Index]; }
+
+private:
+	FORCEINLINE int32 GetCellX(const FVector2D& Point) const { return FMath::FloorToInt(Point.X * InvCellSize); }
+	FORCEINLINE int32 GetCellY(const FVector2D& Point) const { return FMath::FloorToInt(Point.Y * InvCellSize); }
+
+	FORCEINLINE uint32 GetBucket(const int32 X, const int32 Y) const
+	{
+		// Large primes, so neighbouring cells land in unrelated buckets
+		return (((uint32)X * 73856093u) ^ ((uint32)Y * 19349663u)) & BucketMask;
+	}
+
+	float InvCellSize;
+	uint32 BucketMask;
+	TArray<FVector2D> Points;
+	/** Where each bucket's points start in SortedIndices, with one extra on the end for the last bucket's end. */
+	TArray<int32> BucketStarts;
+	/** The point indices, grouped by bucket. */
+	TArray<int32> SortedIndices;
+};
@@ -0,0 +1,171 @@
+// Copyright NoxxProjects and Primrose Taylor. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A stream of floats for the vector math kernels.
+ * Always 16 byte aligned, and padded up to a whole number of lanes (see FNAIVectorMath::Lanes)
+ * so the kernels never need a scalar tail.
+ */
+typedef TArray<float, TAlignedHeapAllocator<16>> FNAIFloatStream;
+
+struct FNAIVectorStreams;
+struct FNAIQuatStreams;
+
+/**
+ * Math kernels that work on structure of arrays (SoA) streams, 4 lanes at a time
+ * using the VectorRegister intrinsics. Each one has a scalar FMath reference it is
+ * expected to match, these are checked by the "NAI.VectorMath.Verify" console command.
+ * @brief Batched SIMD math for the AgentManager's per-Agent work.
+ */
+class NAISIMULATION_API FNAIVectorMath
+{
+public:
+	/** How many floats each kernel works on at once. */
+	static constexpr int32 Lanes = 4;
+
+	/** Round a count up to a whole number of lanes. */
+	static FORCEINLINE int32 PaddedNum(const int32 Num) { return (Num + (Lanes - 1)) & ~(Lanes - 1); }
+
+	/**
+	 * Out = |A - B|
+	 * Reference: FVector::Dist()
+	 */
+	static void Distance(const FNAIVectorStreams& A, const FNAIVectorStreams& B, FNAIFloatStream& Out);
+
+	/**
+	 * Out = |Current - Previous| / DeltaTime, or 0 if DeltaTime isn't positive.
+	 * Reference: FVector::Dist() / DeltaTime
+	 */
+	static void Speed(
+		const FNAIVectorStreams& Current, const FNAIVectorStreams& Previous, const float DeltaTime, FNAIFloatStream& Out);
+
+	/**
+	 * Normalize every vector, vectors too small to normalize become zero.
+	 * Reference: FVector::GetSafeNormal()
+	 */
+	static void SafeNormalize(FNAIVectorStreams& InOut);
+
+	/**
+	 * Out = A * Scale, where each vector has its own scale.
+	 * Reference: FVector::operator*(float)
+	 */
+	static void Scale(const FNAIVectorStreams& A, const FNAIFloatStream& InScale, FNAIVectorStreams& Out);
+
+	/**
+	 * InOut = InOut + A
+	 * Reference: FVector::operator+=()
+	 */
+	static void Add(const FNAIVectorStreams& A, FNAIVectorStreams& InOut);
+
+	/**
+	 * InOut = Mask != 0 ? IfSet : InOut. Masks should be 0 or 1.
+	 */
+	static void Select(const FNAIFloatStream& Mask, const FNAIFloatStream& IfSet, FNAIFloatStream& InOut);
+
+	/**
+	 * The yaw, in degrees, of each direction. Only X and Y are used.
+	 * Reference: FVector::Rotation().Yaw
+	 */
+	static void YawFromDirection(const FNAIVectorStreams& Directions, FNAIFloatStream& OutYaw);
+
+	/**
+	 * A yaw only rotation facing along each direction. Only X and Y are used,
+	 * directions too small to face along give the identity.
+	 * Reference: FRotator(0, FVector::Rotation().Yaw, 0).Quaternion()
+	 */
+	static void YawQuatFromDirection(const FNAIVectorStreams& Directions, FNAIQuatStreams& Out);
+
+	/**
+	 * Spherical interpolation from A to B by Alpha, with the result normalized.
+	 * Reference: FQuat::Slerp()
+	 */
+	static void Slerp(
+		const FNAIQuatStreams& A, const FNAIQuatStreams& B, const FNAIFloatStream& Alpha, FNAIQuatStreams& Out);
+};
+
+/** Structure of arrays of vectors. */
+struct NAISIMULATION_API FNAIVectorStreams
+{
+	FNAIFloatStream X;
+	FNAIFloatStream Y;
+	FNAIFloatStream Z;
+
+	/** Handle default initialization. */
+	FNAIVectorStreams() : Num(0)
+	{ }
+
+	/** Resize the streams, keeping their allocations. The padding lanes are zeroed. */
+	FORCEINLINE void SetNum(const int32 InNum)
+	{
+		Num = InNum;
+		SetNumPadded(X, InNum);
+		SetNumPadded(Y, InNum);
+		SetNumPadded(Z, InNum);
+	}
+
+	FORCEINLINE int32 GetNum() const { return Num; }
+	FORCEINLINE int32 GetPaddedNum() const { return X.Num(); }
+
+	FORCEINLINE void Set(const int32 Index, const FVector& Vector)
+	{
+		X[Index] = Vector.X;
+		Y[Index] = Vector.Y;
+		Z[Index] = Vector.Z;
+	}
+	FORCEINLINE FVector Get(const int32 Index) const { return FVector(X[Index], Y[Index], Z[Index]); }
+
+	/** Resize a single stream to InNum, padded up to a whole number of lanes. */
+	static FORCEINLINE void SetNumPadded(FNAIFloatStream& Stream, const int32 InNum)
+	{
+		const int32 Padded = FNAIVectorMath::PaddedNum(InNum);
+		Stream.SetNumUninitialized(Padded, false);
+		for(int32 i = InNum; i < Padded; i++)
+		{
+			Stream[i] = 0.0f;
+		}
+	}
+
+private:
+	int32 Num;
+};
+
+/** Structure of arrays of quaternions. */
+struct NAISIMULATION_API FNAIQuatStreams
+{
+	FNAIFloatStream X;
+	FNAIFloatStream Y;
+	FNAIFloatStream Z;
+	FNAIFloatStream W;
+
+	/** Handle default initialization. */
+	FNAIQuatStreams() : Num(0)
+	{ }
+
+	/** Resize the streams, keeping their allocations. The padding lanes are zeroed. */
+	FORCEINLINE void SetNum(const int32 InNum)
+	{
+		Num = InNum;
+		FNAIVectorStreams::SetNumPadded(X, InNum);
+		FNAIVectorStreams::SetNumPadded(Y, InNum);
+		FNAIVectorStreams::SetNumPadded(Z, InNum);
+		FNAIVectorStreams::SetNumPadded(W, InNum);
+	}
+
+	FORCEINLINE int32 GetNum() const { return Num; }
+	FORCEINLINE int32 GetPaddedNum() const { return X.Num(); }
+
+	FORCEINLINE void Set(const int32 Index, const FQuat& Quat)
+	{
+		X[Index] = Quat.X;
+		Y[Index] = Quat.Y;
+		Z[Index] = Quat.Z;
+		W[Index] = Quat.W;
+	}
+	FORCEINLINE FQuat Get(const int32 Index) const { return FQuat(X[Index], Y[Index], Z[Index], W[Index]); }
+
+private:
+	int32 Num;
+};
@@ -2,16 +2,60 @@
 
 #include "BenchmarkingTool.h"
 
+#include "EngineUtils.h"
+#include "NAIAgentArchetype.h"
+#include "NAIAgentClient.h"
+#include "NAIAgentManager.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "GenericPlatform/GenericPlatformMisc.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
 // Sets default values
 ABenchmarkingTool::ABenchmarkingTool()
 {
 	LineTracesPerTick = 100;
+	LineTraceLength = 1000;
 	ObjectSweepsPerTick = 100;
 
+	bRunCrowdScenario = false;
+	AgentCount = 1000;
+	AgentClass = nullptr;
+	WarmupFrames = 30;
+	RecordFrames = 600;
+	AgentSpacing = 150.0f;
+	bGenerateTestMap = true;
+	ObstaclesPerSide = 8;
+	bQuitWhenFinished = false;
+
+	bRunQueryComparison = false;
+	ComparisonShapes = { EBenchmarkQueryShape::LineTrace, EBenchmarkQueryShape::MultiLineTrace,
+		EBenchmarkQueryShape::CapsuleSweep, EBenchmarkQueryShape::Overlap };
+	ComparisonModes = { EBenchmarkQueryMode::Sync, EBenchmarkQueryMode::Async, EBenchmarkQueryMode::ParallelBatch };
+	SceneComplexities = { 0, 8, 32 };
+	QueriesPerFrame = 1000;
+	QueryFramesPerRun = 120;
+
 	WorldRef = nullptr;
-	
+	CrowdExtent = 0.0f;
+	ScenarioFrame = 0;
+	bIsScenarioRunning = false;
+	bIsFinished = false;
+	StressQueryCount = 0;
+	QueryRunIndex = 0;
+	QueryRunFrame = 0;
+	bIsComparisonRunning = false;
+	AsyncRunSerial = 0;
+	QueryGameThreadCycles = 0;
+	QueryWallMs = 0.0;
+
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
+	// Run after everything else, so the AgentManagers have finished their frame when it's recorded
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
 }
 
 // Called when the game starts or when spawned
@@ -20,8 +64,19 @@ void ABenchmarkingTool::BeginPlay()
 	Super::BeginPlay();
 
 	WorldRef = GetWorld();
-	
+
 	LineTraceCompleteDelegate.BindUObject(this, &ABenchmarkingTool::OnLineTraceComplete);
+	QueryTraceDelegate.BindUObject(this, &ABenchmarkingTool::OnQueryTraceComplete);
+	QueryOverlapDelegate.BindUObject(this, &ABenchmarkingTool::OnQueryOverlapComplete);
+
+	if(bRunQueryComparison)
+	{
+		StartQueryComparison();
+	}
+	else if(bRunCrowdScenario)
+	{
+		StartCrowdScenario();
+	}
 }
 
 // Called every frame
@@ -31,13 +86,46 @@ void ABenchmarkingTool::Tick(float DeltaTime)
 
 	if(!WorldRef)
 		return;
-	
+
+	// The extra queries would only skew the comparison
+	if(bIsComparisonRunning)
+	{
+		TickQueryComparison();
+	}
+	else
+	{
+		FireStressQueries();
+	}
+
+	if(!bIsScenarioRunning)
+		return;
+
+	if(ScenarioFrame >= WarmupFrames)
+	{
+		RecordFrame(DeltaTime);
+	}
+	ScenarioFrame++;
+
+	if(ScenarioFrame >= (WarmupFrames + RecordFrames))
+	{
+		FinishCrowdScenario();
+	}
+}
+
+void ABenchmarkingTool::OnLineTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data)
+{
+	//if(!Handle.IsValid())
+	//	return;
+}
+
+void ABenchmarkingTool::FireStressQueries()
+{
 	const FCollisionObjectQueryParams ObjectQueryParams =
 		(ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic));
 
 	const FVector InitialPoint = FVector::ZeroVector;
 	const FVector Gap = FVector(5.0f, 0.0f, 0.0f);
-	
+
 	for(int i = 0; i < LineTracesPerTick; i++)
 	{
 		const FVector StartPoint = InitialPoint + (Gap * i);
@@ -48,10 +136,530 @@ void ABenchmarkingTool::Tick(float DeltaTime)
 			FCollisionQueryParams::DefaultQueryParam, &LineTraceCompleteDelegate
 		);
 	}
-} 
 
-void ABenchmarkingTool::OnLineTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data)
+	const FCollisionShape Capsule = FCollisionShape::MakeCapsule(40.0f, 90.0f);
+	for(int i = 0; i < ObjectSweepsPerTick; i++)
+	{
+		const FVector StartPoint = InitialPoint + (Gap * i) + FVector(0.0f, 500.0f, 0.0f);
+		const FVector EndPoint = StartPoint - FVector(0.0f, 0.0f, LineTraceLength);
+
+		WorldRef->AsyncSweepByObjectType(
+			EAsyncTraceType::Multi, StartPoint, EndPoint, FQuat::Identity, ObjectQueryParams,
+			Capsule, FCollisionQueryParams::DefaultQueryParam, &LineTraceCompleteDelegate
+		);
+	}
+
+	StressQueryCount = FMath::Max(LineTracesPerTick, 0) + FMath::Max(ObjectSweepsPerTick, 0);
+}
+
+void ABenchmarkingTool::StartCrowdScenario()
 {
-	//if(!Handle.IsValid())
-	//	return;
+	if(!WorldRef)
+		return;
+
+	CrowdExtent = FMath::CeilToFloat(FMath::Sqrt(static_cast<float>(AgentCount))) * AgentSpacing;
+
+	if(bGenerateTestMap)
+	{
+		GenerateTestMap(ObstaclesPerSide);
+	}
+
+	// The crowd needs somewhere to live, use the map's manager if it has one
+	TActorIterator<ANAIAgentManager> ManagerIt(WorldRef);
+	if(!ManagerIt)
+	{
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		WorldRef->SpawnActor<ANAIAgentManager>(ANAIAgentManager::StaticClass(), FTransform::Identity, SpawnParameters);
+	}
+
+	SpawnCrowd();
+
+	FrameRecords.Reset(RecordFrames);
+	ScenarioFrame = 0;
+	bIsScenarioRunning = true;
+	bIsFinished = false;
+
+	UE_LOG(LogTemp, Display, TEXT("BenchmarkingTool: Started crowd scenario, %d Agents, %d warmup and %d recorded frames."),
+		AgentCount, WarmupFrames, RecordFrames);
+}
+
+void ABenchmarkingTool::GenerateTestMap(const int32 InObstaclesPerSide)
+{
+	for(AActor* TestMapActor : TestMapActors)
+	{
+		if(IsValid(TestMapActor))
+		{
+			TestMapActor->Destroy();
+		}
+	}
+	TestMapActors.Reset();
+
+	UStaticMesh* CubeMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if(!CubeMesh)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("BenchmarkingTool: Couldn't load the cube mesh, skipping the test map."));
+		return;
+	}
+
+	// A floor with a border around the crowd, so the Agents don't walk straight off it
+	const float FloorExtent = (CrowdExtent * 0.5f) + 2000.0f;
+	SpawnBox(CubeMesh, FBox(FVector(-FloorExtent, -FloorExtent, -50.0f), FVector(FloorExtent, FloorExtent, 0.0f)));
+
+	if(InObstaclesPerSide <= 0)
+		return;
+
+	// A grid of pillars through the crowd, every other one is low enough to be a step
+	const float ObstacleSpacing = (FloorExtent * 2.0f) / InObstaclesPerSide;
+	for(int32 Y = 0; Y < InObstaclesPerSide; Y++)
+	{
+		for(int32 X = 0; X < InObstaclesPerSide; X++)
+		{
+			const FVector Center(
+				-FloorExtent + ((X + 0.5f) * ObstacleSpacing),
+				-FloorExtent + ((Y + 0.5f) * ObstacleSpacing),
+				0.0f);
+			const float Height = ((X + Y) & 1) ? (30.0f) : (300.0f);
+			SpawnBox(CubeMesh, FBox(Center - FVector(100.0f, 100.0f, 0.0f), Center + FVector(100.0f, 100.0f, Height)));
+		}
+	}
+}
+
+void ABenchmarkingTool::SpawnBox(UStaticMesh* CubeMesh, const FBox& Box)
+{
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AStaticMeshActor* BoxActor = WorldRef->SpawnActor<AStaticMeshActor>(
+		AStaticMeshActor::StaticClass(), FTransform(Box.GetCenter()), SpawnParameters);
+	if(!BoxActor)
+		return;
+
+	// The mesh can't be changed on a static component once play has started
+	UStaticMeshComponent* MeshComponent = BoxActor->GetStaticMeshComponent();
+	MeshComponent->SetMobility(EComponentMobility::Movable);
+	MeshComponent->SetStaticMesh(CubeMesh);
+	// The engine cube is 100 units across
+	BoxActor->SetActorScale3D(Box.GetSize() / 100.0f);
+
+	TestMapActors.Add(BoxActor);
+}
+
+void ABenchmarkingTool::SpawnCrowd()
+{
+	UClass* SpawnClass = AgentClass ? AgentClass.Get() : ANAIAgentClient::StaticClass();
+	const int32 GridSize = FMath::CeilToInt(FMath::Sqrt(static_cast<float>(AgentCount)));
+	const float HalfExtent = CrowdExtent * 0.5f;
+
+	for(int32 i = 0; i < AgentCount; i++)
+	{
+		const FVector Location(
+			((i % GridSize) * AgentSpacing) - HalfExtent,
+			((i / GridSize) * AgentSpacing) - HalfExtent,
+			400.0f); // Dropped in from above the tallest obstacle, the floor check puts them on the ground
+		const FTransform Transform(Location);
+
+		ANAIAgentClient* AgentClient = WorldRef->SpawnActorDeferred<ANAIAgentClient>(
+			SpawnClass, Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		if(!AgentClient)
+			continue;
+
+		if(Archetypes.Num() > 0)
+		{
+			AgentClient->Archetype = Archetypes[i % Archetypes.Num()];
+		}
+		AgentClient->FinishSpawning(Transform);
+	}
+}
+
+void ABenchmarkingTool::RecordFrame(const float DeltaTime)
+{
+	FBenchmarkFrameRecord& Record = FrameRecords.AddZeroed_GetRef();
+	Record.Frame = ScenarioFrame - WarmupFrames;
+	Record.FrameMs = DeltaTime * 1000.0f;
+	Record.StressQueries = StressQueryCount;
+
+	// Sum up every shard in the World
+	for(TActorIterator<ANAIAgentManager> It(WorldRef); It; ++It)
+	{
+		const ANAIAgentManager* Manager = *It;
+		const FAgentManagerPhaseTimings& Timings = Manager->GetPhaseTimings();
+		for(uint8 Phase = 0; Phase < (uint8)EAgentManagerPhase::Count; Phase++)
+		{
+			Record.PhaseMs[Phase] += Timings.LastMs[Phase];
+		}
+
+		const FAgentManagerQueryCounts& Queries = Manager->GetQueryCounts();
+		Record.PathQueries += Queries.PathQueries;
+		Record.LineTraces += Queries.LineTraces;
+		Record.Sweeps += Queries.Sweeps;
+
+		Record.AgentCount += Manager->GetAgentCount();
+		Record.FrameArenaBytes += Manager->GetFrameArena().GetBytesUsed();
+	}
+
+	const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+	Record.UsedPhysicalBytes = MemoryStats.UsedPhysical;
+	Record.PeakUsedPhysicalBytes = MemoryStats.PeakUsedPhysical;
+}
+
+void ABenchmarkingTool::FinishCrowdScenario()
+{
+	bIsScenarioRunning = false;
+
+	FString Csv = TEXT("Frame,FrameMs,Agents");
+	const UEnum* PhaseEnum = StaticEnum<EAgentManagerPhase>();
+	for(uint8 Phase = 0; Phase < (uint8)EAgentManagerPhase::Count; Phase++)
+	{
+		Csv += FString::Printf(TEXT(",%sMs"), *PhaseEnum->GetNameStringByValue(Phase));
+	}
+	Csv += TEXT(",PathQueries,LineTraces,Sweeps,StressQueries,FrameArenaBytes,ProcessUsedPhysicalBytes,ProcessUsedPhysicalDeltaBytes,ProcessPeakUsedPhysicalBytes\n");
+
+	double TotalManagerMs = 0.0;
+	int64 TotalQueries = 0;
+	uint64 PreviousUsedPhysical = (FrameRecords.Num() > 0) ? FrameRecords[0].UsedPhysicalBytes : 0;
+	for(const FBenchmarkFrameRecord& Record : FrameRecords)
+	{
+		Csv += FString::Printf(TEXT("%d,%.4f,%d"), Record.Frame, Record.FrameMs, Record.AgentCount);
+		for(uint8 Phase = 0; Phase < (uint8)EAgentManagerPhase::Count; Phase++)
+		{
+			Csv += FString::Printf(TEXT(",%.4f"), Record.PhaseMs[Phase]);
+			TotalManagerMs += Record.PhaseMs[Phase];
+		}
+
+		/**
+		 * How much the whole process's physical memory grew by this frame. This isn't an allocation count,
+		 * freed memory isn't always given back, and it includes everything else in the process too.
+		 * Run with -llm for the allocations the NAI tags caught.
+		 */
+		const int64 UsedPhysicalDelta = (int64)Record.UsedPhysicalBytes - (int64)PreviousUsedPhysical;
+		PreviousUsedPhysical = Record.UsedPhysicalBytes;
+
+		Csv += FString::Printf(TEXT(",%d,%d,%d,%d,%llu,%llu,%lld,%llu\n"),
+			Record.PathQueries, Record.LineTraces, Record.Sweeps, Record.StressQueries,
+			Record.FrameArenaBytes, Record.UsedPhysicalBytes, UsedPhysicalDelta, Record.PeakUsedPhysicalBytes);
+		TotalQueries += Record.PathQueries + Record.LineTraces + Record.Sweeps;
+	}
+
+	const int32 FrameCount = FMath::Max(FrameRecords.Num(), 1);
+	UE_LOG(LogTemp, Display, TEXT("BenchmarkingTool: Finished. Average manager time %.3f ms, %.1f queries per frame."),
+		TotalManagerMs / FrameCount, (double)TotalQueries / FrameCount);
+
+	WriteResults(Csv, FString::Printf(TEXT("CrowdBenchmark-%d"), AgentCount));
+}
+
+void ABenchmarkingTool::WriteResults(const FString& Csv, const FString& DefaultName)
+{
+	ResultsPath = !OutputPath.IsEmpty() ? OutputPath : (FPaths::ProfilingDir() / TEXT("NAI") /
+		FString::Printf(TEXT("%s-%s.csv"), *DefaultName, *FDateTime::Now().ToString()));
+	if(FFileHelper::SaveStringToFile(Csv, *ResultsPath))
+	{
+		UE_LOG(LogTemp, Display, TEXT("BenchmarkingTool: Results written to %s"), *ResultsPath);
+	}
+	else
+	{
+		UE_LOG(LogTemp, Error, TEXT("BenchmarkingTool: Couldn't write the results to %s"), *ResultsPath);
+		ResultsPath.Empty();
+	}
+
+	bIsFinished = true;
+
+	if(bQuitWhenFinished)
+	{
+		FGenericPlatformMisc::RequestExit(false);
+	}
+}
+
+/** The object types the query comparison runs against. */
+#define QUERY_OBJECT_TYPES (ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic))
+/** The size of the square the comparison's queries are spread over. */
+#define QUERY_AREA_EXTENT 8000.0f
+/** Async UserData is the run serial in the top 8 bits, and the index of the query in the rest. */
+#define ASYNC_INDEX_BITS 24
+
+void ABenchmarkingTool::StartQueryComparison()
+{
+	if(!WorldRef)
+		return;
+
+	QueryRuns.Reset();
+	TArray<int32> Complexities = SceneComplexities;
+	if(Complexities.Num() == 0)
+	{
+		Complexities.Add(ObstaclesPerSide);
+	}
+	for(const int32 Complexity : Complexities)
+	{
+		for(const EBenchmarkQueryShape Shape : ComparisonShapes)
+		{
+			for(const EBenchmarkQueryMode Mode : ComparisonModes)
+			{
+				QueryRuns.Add({ Shape, Mode, Complexity });
+			}
+		}
+	}
+
+	// Random, but the same for every run and every session
+	FRandomStream Random(0x4E4149);
+	const float HalfExtent = QUERY_AREA_EXTENT * 0.5f;
+	QueryStarts.SetNum(QueriesPerFrame);
+	QueryEnds.SetNum(QueriesPerFrame);
+	for(int32 i = 0; i < QueriesPerFrame; i++)
+	{
+		// High enough off the floor for the capsule to clear it
+		QueryStarts[i] = FVector(Random.FRandRange(-HalfExtent, HalfExtent), Random.FRandRange(-HalfExtent, HalfExtent), 100.0f);
+		const float Yaw = Random.FRandRange(0.0f, 2.0f * PI);
+		QueryEnds[i] = QueryStarts[i] + (FVector(FMath::Cos(Yaw), FMath::Sin(Yaw), 0.0f) * LineTraceLength);
+	}
+
+	CrowdExtent = QUERY_AREA_EXTENT;
+	QueryResults.Reset(QueryRuns.Num());
+	QueryRunIndex = 0;
+	bIsComparisonRunning = true;
+	bIsFinished = false;
+
+	UE_LOG(LogTemp, Display, TEXT("BenchmarkingTool: Started query comparison, %d runs of %d frames at %d queries per frame."),
+		QueryRuns.Num(), QueryFramesPerRun, QueriesPerFrame);
+
+	StartQueryRun();
 }
+
+void ABenchmarkingTool::StartQueryRun()
+{
+	if(QueryRunIndex >= QueryRuns.Num())
+	{
+		FinishQueryComparison();
+		return;
+	}
+
+	const FQueryRun& Run = QueryRuns[QueryRunIndex];
+	if(QueryRunIndex == 0 || QueryRuns[QueryRunIndex - 1].ObstaclesPerSide != Run.ObstaclesPerSide)
+	{
+		GenerateTestMap(Run.ObstaclesPerSide);
+	}
+
+	QueryRunFrame = 0;
+	QueryLatenciesUs.Reset(QueriesPerFrame * QueryFramesPerRun);
+	AsyncIssueCycles.Reset(Run.Mode == EBenchmarkQueryMode::Async ? QueriesPerFrame * QueryFramesPerRun : 0);
+	AsyncRunSerial++;
+	AsyncLastCompletedCycles = 0;
+	QueryGameThreadCycles = 0;
+	QueryWallMs = 0.0;
+}
+
+void ABenchmarkingTool::TickQueryComparison()
+{
+	const FQueryRun& Run = QueryRuns[QueryRunIndex];
+
+	if(QueryRunFrame < QueryFramesPerRun)
+	{
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		switch(Run.Mode)
+		{
+		case EBenchmarkQueryMode::Sync:
+			{
+				for(int32 i = 0; i < QueriesPerFrame; i++)
+				{
+					const uint64 QueryStartCycles = FPlatformTime::Cycles64();
+					RunSyncQuery(Run.Shape, i);
+					QueryLatenciesUs.Add((float)(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - QueryStartCycles) * 1000.0));
+				}
+				break;
+			}
+		case EBenchmarkQueryMode::Async:
+			{
+				for(int32 i = 0; i < QueriesPerFrame; i++)
+				{
+					RunAsyncQuery(Run.Shape, i);
+				}
+				break;
+			}
+		case EBenchmarkQueryMode::ParallelBatch:
+			{
+				// Each query gets its own slot, so the workers never write to the same place
+				const int32 FirstIndex = QueryLatenciesUs.AddUninitialized(QueriesPerFrame);
+				float* Latencies = QueryLatenciesUs.GetData() + FirstIndex;
+				const EBenchmarkQueryShape Shape = Run.Shape;
+				ParallelFor(QueriesPerFrame, [this, Shape, Latencies](const int32 i)
+				{
+					const uint64 QueryStartCycles = FPlatformTime::Cycles64();
+					RunSyncQuery(Shape, i);
+					Latencies[i] = (float)(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - QueryStartCycles) * 1000.0);
+				});
+				break;
+			}
+		default:
+			break;
+		}
+		const uint64 ElapsedCycles = FPlatformTime::Cycles64() - StartCycles;
+		QueryGameThreadCycles += ElapsedCycles;
+		QueryWallMs += FPlatformTime::ToMilliseconds64(ElapsedCycles);
+	}
+	QueryRunFrame++;
+
+	// Give the last async results a few frames to come back
+	const bool bIsWaitingForAsync = (Run.Mode == EBenchmarkQueryMode::Async) &&
+		(QueryLatenciesUs.Num() < AsyncIssueCycles.Num()) && (QueryRunFrame < QueryFramesPerRun + 10);
+	if(QueryRunFrame >= QueryFramesPerRun && !bIsWaitingForAsync)
+	{
+		FinishQueryRun();
+		QueryRunIndex++;
+		StartQueryRun();
+	}
+}
+
+void ABenchmarkingTool::RunSyncQuery(const EBenchmarkQueryShape Shape, const int32 Index) const
+{
+	const FCollisionObjectQueryParams ObjectQueryParams(QUERY_OBJECT_TYPES);
+	const FCollisionShape Capsule = FCollisionShape::MakeCapsule(40.0f, 90.0f);
+	const FVector& Start = QueryStarts[Index];
+	const FVector& End = QueryEnds[Index];
+
+	switch(Shape)
+	{
+	case EBenchmarkQueryShape::LineTrace:
+		{
+			FHitResult Hit;
+			WorldRef->LineTraceSingleByObjectType(Hit, Start, End, ObjectQueryParams);
+			break;
+		}
+	case EBenchmarkQueryShape::MultiLineTrace:
+		{
+			TArray<FHitResult> Hits;
+			WorldRef->LineTraceMultiByObjectType(Hits, Start, End, ObjectQueryParams);
+			break;
+		}
+	case EBenchmarkQueryShape::CapsuleSweep:
+		{
+			TArray<FHitResult> Hits;
+			WorldRef->SweepMultiByObjectType(Hits, Start, End, FQuat::Identity, ObjectQueryParams, Capsule);
+			break;
+		}
+	case EBenchmarkQueryShape::Overlap:
+		{
+			TArray<FOverlapResult> Overlaps;
+			WorldRef->OverlapMultiByObjectType(Overlaps, Start, FQuat::Identity, ObjectQueryParams, Capsule);
+			break;
+		}
+	default:
+		break;
+	}
+}
+
+void ABenchmarkingTool::RunAsyncQuery(const EBenchmarkQueryShape Shape, const int32 Index)
+{
+	if(AsyncIssueCycles.Num() >= (1 << ASYNC_INDEX_BITS))
+		return;
+
+	const FCollisionObjectQueryParams ObjectQueryParams(QUERY_OBJECT_TYPES);
+	const FCollisionShape Capsule = FCollisionShape::MakeCapsule(40.0f, 90.0f);
+	const FVector& Start = QueryStarts[Index];
+	const FVector& End = QueryEnds[Index];
+	const uint32 UserData = ((uint32)AsyncRunSerial << ASYNC_INDEX_BITS) | (uint32)AsyncIssueCycles.Add(FPlatformTime::Cycles64());
+
+	switch(Shape)
+	{
+	case EBenchmarkQueryShape::LineTrace:
+		WorldRef->AsyncLineTraceByObjectType(EAsyncTraceType::Single, Start, End, ObjectQueryParams,
+			FCollisionQueryParams::DefaultQueryParam, &QueryTraceDelegate, UserData);
+		break;
+	case EBenchmarkQueryShape::MultiLineTrace:
+		WorldRef->AsyncLineTraceByObjectType(EAsyncTraceType::Multi, Start, End, ObjectQueryParams,
+			FCollisionQueryParams::DefaultQueryParam, &QueryTraceDelegate, UserData);
+		break;
+	case EBenchmarkQueryShape::CapsuleSweep:
+		WorldRef->AsyncSweepByObjectType(EAsyncTraceType::Multi, Start, End, FQuat::Identity, ObjectQueryParams,
+			Capsule, FCollisionQueryParams::DefaultQueryParam, &QueryTraceDelegate, UserData);
+		break;
+	case EBenchmarkQueryShape::Overlap:
+		WorldRef->AsyncOverlapByObjectType(Start, FQuat::Identity, ObjectQueryParams,
+			Capsule, FCollisionQueryParams::DefaultQueryParam, &QueryOverlapDelegate, UserData);
+		break;
+	default:
+		break;
+	}
+}
+
+void ABenchmarkingTool::OnQueryTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data)
+{
+	const uint64 CompletedCycles = FPlatformTime::Cycles64();
+	RecordAsyncLatency(Data.UserData, CompletedCycles);
+	QueryGameThreadCycles += FPlatformTime::Cycles64() - CompletedCycles;
+}
+
+void ABenchmarkingTool::OnQueryOverlapComplete(const FTraceHandle& Handle, FOverlapDatum& Data)
+{
+	const uint64 CompletedCycles = FPlatformTime::Cycles64();
+	RecordAsyncLatency(Data.UserData, CompletedCycles);
+	QueryGameThreadCycles += FPlatformTime::Cycles64() - CompletedCycles;
+}
+
+void ABenchmarkingTool::RecordAsyncLatency(const uint32 UserData, const uint64 CompletedCycles)
+{
+	// Results from an earlier run that came back late
+	if(!bIsComparisonRunning || (UserData >> ASYNC_INDEX_BITS) != AsyncRunSerial)
+		return;
+
+	const int32 Index = UserData & ((1 << ASYNC_INDEX_BITS) - 1);
+	if(!AsyncIssueCycles.IsValidIndex(Index))
+		return;
+
+	QueryLatenciesUs.Add((float)(FPlatformTime::ToMilliseconds64(CompletedCycles - AsyncIssueCycles[Index]) * 1000.0));
+	AsyncLastCompletedCycles = FMath::Max(AsyncLastCompletedCycles, CompletedCycles);
+}
+
+void ABenchmarkingTool::FinishQueryRun()
+{
+	const FQueryRun& Run = QueryRuns[QueryRunIndex];
+
+	// Async queries are finished off during the World's tick, so the wall time is from the first issue to the last result
+	if(Run.Mode == EBenchmarkQueryMode::Async && AsyncIssueCycles.Num() > 0 && AsyncLastCompletedCycles > 0)
+	{
+		QueryWallMs = FPlatformTime::ToMilliseconds64(AsyncLastCompletedCycles - AsyncIssueCycles[0]);
+	}
+
+	QueryLatenciesUs.Sort();
+	const auto Percentile = [this](const float Fraction)
+	{
+		return (QueryLatenciesUs.Num() > 0) ?
+			QueryLatenciesUs[FMath::FloorToInt(Fraction * (QueryLatenciesUs.Num() - 1))] : 0.0f;
+	};
+
+	FBenchmarkQueryResult& Result = QueryResults.AddDefaulted_GetRef();
+	Result.Shape = Run.Shape;
+	Result.Mode = Run.Mode;
+	Result.ObstaclesPerSide = Run.ObstaclesPerSide;
+	Result.Queries = QueryLatenciesUs.Num();
+	Result.WallMs = QueryWallMs;
+	Result.GameThreadMs = FPlatformTime::ToMilliseconds64(QueryGameThreadCycles);
+	Result.P50LatencyUs = Percentile(0.5f);
+	Result.P99LatencyUs = Percentile(0.99f);
+
+	UE_LOG(LogTemp, Display, TEXT("BenchmarkingTool: %-14s %-13s x%-3d %9.0f q/s  p50 %8.2f us  p99 %8.2f us  GameThread %7.3f ms/frame"),
+		*StaticEnum<EBenchmarkQueryShape>()->GetNameStringByValue((int64)Run.Shape),
+		*StaticEnum<EBenchmarkQueryMode>()->GetNameStringByValue((int64)Run.Mode),
+		Run.ObstaclesPerSide, (Result.WallMs > 0.0) ? (Result.Queries / (Result.WallMs / 1000.0)) : 0.0,
+		Result.P50LatencyUs, Result.P99LatencyUs, Result.GameThreadMs / QueryFramesPerRun);
+}
+
+void ABenchmarkingTool::FinishQueryComparison()
+{
+	bIsComparisonRunning = false;
+
+	FString Csv = TEXT("Shape,Mode,ObstaclesPerSide,Queries,QueriesPerSecond,P50LatencyUs,P99LatencyUs,GameThreadMs,GameThreadMsPerFrame,WallMs\n");
+	for(const FBenchmarkQueryResult& Result : QueryResults)
+	{
+		Csv += FString::Printf(TEXT("%s,%s,%d,%d,%.1f,%.3f,%.3f,%.4f,%.4f,%.4f\n"),
+			*StaticEnum<EBenchmarkQueryShape>()->GetNameStringByValue((int64)Result.Shape),
+			*StaticEnum<EBenchmarkQueryMode>()->GetNameStringByValue((int64)Result.Mode),
+			Result.ObstaclesPerSide, Result.Queries,
+			(Result.WallMs > 0.0) ? (Result.Queries / (Result.WallMs / 1000.0)) : 0.0,
+			Result.P50LatencyUs, Result.P99LatencyUs,
+			Result.GameThreadMs, Result.GameThreadMs / QueryFramesPerRun, Result.WallMs);
+	}
+
+	WriteResults(Csv, TEXT("QueryComparison"));
+}
+
+#undef QUERY_OBJECT_TYPES
+#undef QUERY_AREA_EXTENT
+#undef ASYNC_INDEX_BITS
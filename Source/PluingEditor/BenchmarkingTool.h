@@ -4,14 +4,86 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "NAIAgentSettingsGlobals.h"
 #include "BenchmarkingTool.generated.h"
 
+class ANAIAgentClient;
+class ANAIAgentManager;
+class UNAIAgentArchetype;
+
+/** One row of the crowd benchmark's CSV. */
+struct FBenchmarkFrameRecord
+{
+	int32 Frame;
+	float FrameMs;
+	int32 AgentCount;
+	float PhaseMs[(uint8)EAgentManagerPhase::Count];
+	int32 PathQueries;
+	int32 LineTraces;
+	int32 Sweeps;
+	int32 StressQueries;
+	uint64 FrameArenaBytes;
+	uint64 UsedPhysicalBytes;
+	uint64 PeakUsedPhysicalBytes;
+};
+
+/** The kinds of physics query the query comparison can run. */
+UENUM(BlueprintType)
+enum class EBenchmarkQueryShape : uint8
+{
+	LineTrace,
+	MultiLineTrace,
+	CapsuleSweep,
+	Overlap,
+	Count UMETA(Hidden)
+};
+
+/** How the query comparison sends its queries off. */
+UENUM(BlueprintType)
+enum class EBenchmarkQueryMode : uint8
+{
+	/** Blocking queries, one after the other on the GameThread. */
+	Sync,
+	/** UWorld async queries, the results come back next frame. */
+	Async,
+	/** Blocking queries, spread over the worker threads with a ParallelFor that the GameThread waits on. */
+	ParallelBatch,
+	Count UMETA(Hidden)
+};
+
+/** The result of one shape, mode and scene complexity combination of the query comparison. */
+struct FBenchmarkQueryResult
+{
+	EBenchmarkQueryShape Shape;
+	EBenchmarkQueryMode Mode;
+	int32 ObstaclesPerSide;
+	int32 Queries;
+	/** Wall time the queries took to complete. For async queries this is the frames they were spread over. */
+	double WallMs;
+	/** Time the GameThread spent issuing, waiting on, or handling the results of the queries. */
+	double GameThreadMs;
+	float P50LatencyUs;
+	float P99LatencyUs;
+};
+
+/**
+ * Load generator and crowd benchmark harness.
+ * With bRunCrowdScenario set it generates a test map, spawns a crowd of Agents,
+ * and records the AgentManagers' per phase timings, query counts, frame arena usage
+ * and the process's physical memory to a CSV for a fixed number of frames.
+ * With bRunQueryComparison set it instead runs line traces, multi line traces,
+ * capsule sweeps and overlaps synchronously, through the UWorld async queries,
+ * and as a parallel batch on the worker threads, and compares their throughput,
+ * latency and GameThread cost.
+ * It can be placed in a map and run with -game -nullrhi, or driven headless
+ * by UNAICrowdBenchmarkCommandlet.
+ */
 UCLASS()
 class PLUINGEDITOR_API ABenchmarkingTool : public AActor
 {
 	GENERATED_BODY()
-	
-public:	
+
+public:
 	// Sets default values for this actor's properties
 	ABenchmarkingTool();
 
@@ -19,24 +91,192 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-public:	
+public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
-	
+
 	void OnLineTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data);
 
+	void OnQueryTraceComplete(const FTraceHandle& Handle, FTraceDatum& Data);
+	void OnQueryOverlapComplete(const FTraceHandle& Handle, FOverlapDatum& Data);
+
+	/** Has the crowd scenario or query comparison finished, and written its results? */
+	FORCEINLINE bool IsFinished() const { return bIsFinished; }
+
+	/** Where the results were written, once it's finished. */
+	FORCEINLINE const FString& GetResultsPath() const { return ResultsPath; }
+
+	/** Extra async line traces to fire every tick, on top of the crowd. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = BenchmarkSettings)
 	int LineTracesPerTick;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = BenchmarkSettings)
 	int LineTraceLength;
 
+	/** Extra async capsule sweeps to fire every tick, on top of the crowd. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = BenchmarkSettings)
 	int ObjectSweepsPerTick;
 
+	/** Run the crowd scenario below when play starts. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd")
+	bool bRunCrowdScenario;
+
+	/** How many Agents to spawn. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd", meta =
+		(ClampMin = 1, ClampMax = 50000, UIMin = 100, UIMax = 50000))
+	int32 AgentCount;
+
+	/** The class of Agent to spawn, or None for the plain ANAIAgentClient. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd")
+	TSubclassOf<ANAIAgentClient> AgentClass;
+
+	/** The archetypes to give the Agents, used in turn. Leave empty to use the AgentClass defaults. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd")
+	TArray<UNAIAgentArchetype*> Archetypes;
+
+	/** Frames to let the crowd settle for before recording. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd", meta = (ClampMin = 0))
+	int32 WarmupFrames;
+
+	/** Frames to record for. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd", meta = (ClampMin = 1))
+	int32 RecordFrames;
+
+	/** Distance between the Agents when they're spawned. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd", meta = (ClampMin = 50))
+	float AgentSpacing;
+
+	/**
+	 * Spawn a floor and a grid of obstacles under the crowd.
+	 * Path queries need a NavMesh, so to include them run on a map with a
+	 * NavMeshBoundsVolume covering the crowd, otherwise they're issued but fail.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd")
+	bool bGenerateTestMap;
+
+	/** How many obstacles the test map has along each side. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd", meta = (ClampMin = 0))
+	int32 ObstaclesPerSide;
+
+	/** Ask the engine to exit once the results are written. Not needed when run from the commandlet. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd")
+	bool bQuitWhenFinished;
+
+	/** Where to write the CSV. Defaults to Saved/Profiling/NAI. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Crowd")
+	FString OutputPath;
+
+	/**
+	 * Compare the query modes against each other when play starts, instead of running the crowd scenario.
+	 * Every shape is run in every mode, at every scene complexity, and the queries per second,
+	 * p50 and p99 latency and GameThread cost of each are written to a CSV.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Queries")
+	bool bRunQueryComparison;
+
+	/** The shapes to compare. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Queries")
+	TArray<EBenchmarkQueryShape> ComparisonShapes;
+
+	/** The modes to compare. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Queries")
+	TArray<EBenchmarkQueryMode> ComparisonModes;
+
+	/** The scene complexities to compare at, as the number of obstacles along each side of the test map. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Queries")
+	TArray<int32> SceneComplexities;
+
+	/** Queries to send off every frame. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Queries", meta = (ClampMin = 1))
+	int32 QueriesPerFrame;
+
+	/** Frames to run each combination for. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "BenchmarkSettings|Queries", meta = (ClampMin = 1))
+	int32 QueryFramesPerRun;
+
 private:
+	/** Fire the extra line traces and sweeps. */
+	void FireStressQueries();
+
+	void StartCrowdScenario();
+	/** Spawn the test map, replacing any test map spawned before. */
+	void GenerateTestMap(const int32 InObstaclesPerSide);
+	void SpawnCrowd();
+	void RecordFrame(const float DeltaTime);
+	void FinishCrowdScenario();
+
+	/** Spawn a cube, scaled to the given box. */
+	void SpawnBox(class UStaticMesh* CubeMesh, const FBox& Box);
+
+	void StartQueryComparison();
+	void TickQueryComparison();
+	/** Start the combination at QueryRunIndex, or write the results if they've all been run. */
+	void StartQueryRun();
+	void FinishQueryRun();
+	void FinishQueryComparison();
+
+	/** Run a single blocking query. Safe to call from the worker threads. */
+	void RunSyncQuery(const EBenchmarkQueryShape Shape, const int32 Index) const;
+	void RunAsyncQuery(const EBenchmarkQueryShape Shape, const int32 Index);
+
+	/** Record how long an async query took to come back. */
+	void RecordAsyncLatency(const uint32 UserData, const uint64 CompletedCycles);
+
+	/** Write a CSV to OutputPath, or to Saved/Profiling/NAI under the default name, and finish up. */
+	void WriteResults(const FString& Csv, const FString& DefaultName);
 	UPROPERTY()
 	class UWorld *WorldRef;
 
 	FTraceDelegate LineTraceCompleteDelegate;
+
+	/** The size of the square the crowd is spawned in. */
+	float CrowdExtent;
+
+	int32 ScenarioFrame;
+	uint8 bIsScenarioRunning : 1;
+	uint8 bIsFinished : 1;
+
+	/** How many extra queries were fired this tick. */
+	int32 StressQueryCount;
+
+	TArray<FBenchmarkFrameRecord> FrameRecords;
+	FString ResultsPath;
+
+	/** Everything GenerateTestMap spawned, so it can be replaced. */
+	UPROPERTY()
+	TArray<AActor*> TestMapActors;
+
+	FTraceDelegate QueryTraceDelegate;
+	FOverlapDelegate QueryOverlapDelegate;
+
+	struct FQueryRun
+	{
+		EBenchmarkQueryShape Shape;
+		EBenchmarkQueryMode Mode;
+		int32 ObstaclesPerSide;
+	};
+
+	/** Every combination to run, in order. */
+	TArray<FQueryRun> QueryRuns;
+	int32 QueryRunIndex;
+	/** The frame of the current run. Async runs are given extra frames at the end for the last results to come back. */
+	int32 QueryRunFrame;
+	uint8 bIsComparisonRunning : 1;
+
+	/** Where each query starts and ends, the same for every run so they're comparable. */
+	TArray<FVector> QueryStarts;
+	TArray<FVector> QueryEnds;
+
+	/** The latency of every query in the current run, in microseconds. */
+	TArray<float> QueryLatenciesUs;
+	/** When each async query in the current run was issued, indexed by its UserData. */
+	TArray<uint64> AsyncIssueCycles;
+	/** Tags async UserData with the run, so results arriving late from an earlier run are ignored. */
+	uint8 AsyncRunSerial;
+	/** When the last async result of the current run came back. */
+	uint64 AsyncLastCompletedCycles;
+	uint64 QueryGameThreadCycles;
+	double QueryWallMs;
+
+	TArray<FBenchmarkQueryResult> QueryResults;
 };
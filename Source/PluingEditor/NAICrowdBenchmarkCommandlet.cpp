@@ -0,0 +1,135 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "NAICrowdBenchmarkCommandlet.h"
+
+#include "BenchmarkingTool.h"
+#include "NAIAgentArchetype.h"
+#include "NAIAgentClient.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "UObject/Package.h"
+
+UNAICrowdBenchmarkCommandlet::UNAICrowdBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UNAICrowdBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 AgentCount = 1000;
+	int32 RecordFrames = 600;
+	int32 WarmupFrames = 30;
+	float DeltaTime = 1.0f / 60.0f;
+	int32 QueriesPerFrame = 1000;
+	int32 QueryFrames = 120;
+	FString MapName, AgentClassName, ArchetypeNames, OutputPath;
+	const bool bRunQueryComparison = FParse::Param(*Params, TEXT("QueryComparison"));
+
+	FParse::Value(*Params, TEXT("Agents="), AgentCount);
+	FParse::Value(*Params, TEXT("Frames="), RecordFrames);
+	FParse::Value(*Params, TEXT("Warmup="), WarmupFrames);
+	FParse::Value(*Params, TEXT("DeltaTime="), DeltaTime);
+	FParse::Value(*Params, TEXT("Map="), MapName);
+	FParse::Value(*Params, TEXT("AgentClass="), AgentClassName);
+	FParse::Value(*Params, TEXT("Archetypes="), ArchetypeNames);
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+	FParse::Value(*Params, TEXT("QueriesPerFrame="), QueriesPerFrame);
+	FParse::Value(*Params, TEXT("QueryFrames="), QueryFrames);
+
+	if(AgentCount <= 0 || RecordFrames <= 0 || DeltaTime <= 0.0f || QueriesPerFrame <= 0 || QueryFrames <= 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("NAICrowdBenchmark: -Agents, -Frames, -DeltaTime, -QueriesPerFrame and -QueryFrames must be above zero."));
+		return 1;
+	}
+
+	// Use the given map, so path queries have a NavMesh to run against, or an empty World
+	UWorld* World = nullptr;
+	if(!MapName.IsEmpty())
+	{
+		UPackage* MapPackage = LoadPackage(nullptr, *MapName, LOAD_None);
+		World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+		if(!World)
+		{
+			UE_LOG(LogTemp, Error, TEXT("NAICrowdBenchmark: Couldn't load the map %s"), *MapName);
+			return 1;
+		}
+		World->WorldType = EWorldType::Game;
+		World->InitWorld();
+	}
+	else
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false);
+	}
+	World->AddToRoot();
+
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.bDeferConstruction = true;
+	ABenchmarkingTool* Tool = World->SpawnActor<ABenchmarkingTool>(ABenchmarkingTool::StaticClass(), FTransform::Identity, SpawnParameters);
+	check(Tool);
+
+	Tool->LineTracesPerTick = 0;
+	Tool->ObjectSweepsPerTick = 0;
+	Tool->bRunCrowdScenario = !bRunQueryComparison;
+	Tool->bRunQueryComparison = bRunQueryComparison;
+	Tool->QueriesPerFrame = QueriesPerFrame;
+	Tool->QueryFramesPerRun = QueryFrames;
+	Tool->AgentCount = AgentCount;
+	Tool->RecordFrames = RecordFrames;
+	Tool->WarmupFrames = FMath::Max(WarmupFrames, 0);
+	Tool->bGenerateTestMap = MapName.IsEmpty();
+	Tool->OutputPath = OutputPath;
+
+	if(!AgentClassName.IsEmpty())
+	{
+		Tool->AgentClass = LoadClass<ANAIAgentClient>(nullptr, *AgentClassName);
+		if(!Tool->AgentClass)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("NAICrowdBenchmark: Couldn't load the Agent class %s, using the default."), *AgentClassName);
+		}
+	}
+
+	TArray<FString> ArchetypePaths;
+	ArchetypeNames.ParseIntoArray(ArchetypePaths, TEXT("+"));
+	for(const FString& ArchetypePath : ArchetypePaths)
+	{
+		if(UNAIAgentArchetype* Archetype = LoadObject<UNAIAgentArchetype>(nullptr, *ArchetypePath))
+		{
+			Tool->Archetypes.Add(Archetype);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("NAICrowdBenchmark: Couldn't load the archetype %s"), *ArchetypePath);
+		}
+	}
+
+	Tool->FinishSpawning(FTransform::Identity);
+	World->BeginPlay();
+
+	// Hard limit, in case the scenario never finishes
+	const int32 QueryRunCount = Tool->ComparisonShapes.Num() * Tool->ComparisonModes.Num() * FMath::Max(Tool->SceneComplexities.Num(), 1);
+	const int32 MaxFrames = bRunQueryComparison ? ((QueryFrames + 20) * QueryRunCount + 1000) : (Tool->WarmupFrames + RecordFrames + 1000);
+	for(int32 Frame = 0; Frame < MaxFrames && !Tool->IsFinished(); Frame++)
+	{
+		World->Tick(LEVELTICK_All, DeltaTime);
+		GFrameCounter++;
+	}
+
+	const bool bSucceeded = Tool->IsFinished() && !Tool->GetResultsPath().IsEmpty();
+	if(!bSucceeded)
+	{
+		UE_LOG(LogTemp, Error, TEXT("NAICrowdBenchmark: The scenario didn't finish."));
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+
+	return bSucceeded ? 0 : 1;
+}
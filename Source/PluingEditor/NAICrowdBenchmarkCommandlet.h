@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "NAICrowdBenchmarkCommandlet.generated.h"
+
+/**
+ * Runs the ABenchmarkingTool crowd scenario headless, at a fixed timestep, so results are comparable between runs.
+ * Usage: UE4Editor-Cmd PluingEditor.uproject -run=NAICrowdBenchmark -Agents=10000 -Frames=600
+ * Optional: -Warmup=30 -DeltaTime=0.0166 -Map=/Game/Maps/Crowd -AgentClass=/Game/BP_Agent.BP_Agent_C
+ *           -Archetypes=/Game/A.A+/Game/B.B -Output=C:/Results.csv
+ * Add -QueryComparison to compare the physics query modes instead, with -QueriesPerFrame=1000 -QueryFrames=120
+ * Returns 0 when the results were written.
+ */
+UCLASS()
+class PLUINGEDITOR_API UNAICrowdBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UNAICrowdBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};